@@ -14,6 +14,8 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <atomic>
+#include <deque>
 #include <stack>
 #include <queue>
 #include "oneflow/core/autograd/autograd_engine.h"
@@ -24,6 +26,9 @@ limitations under the License.
 #include "oneflow/core/autograd/autograd_mode.h"
 #include "oneflow/core/eager/dev_vm_dep_object_consume_mode.h"
 #include "oneflow/core/functional/functional.h"
+#include "oneflow/core/job/lazy_mode.h"
+#include "oneflow/core/thread/thread_pool.h"
+#include "oneflow/core/common/blocking_counter.h"
 
 namespace oneflow {
 namespace one {
@@ -55,6 +60,48 @@ Maybe<void> CopyOrAccGrad(AutogradMeta* autograd_meta, bool autograd_mode) {
   return Maybe<void>::Ok();
 }
 
+int64_t ParallelBackwardThreadNum() {
+  static const int64_t thread_num =
+      ParseIntegerFromEnv("ONEFLOW_AUTOGRAD_PARALLEL_BACKWARD_THREAD_NUM", 1);
+  return thread_num;
+}
+
+bool DeterministicParallelGradAcc() {
+  static const bool deterministic =
+      ParseBooleanFromEnv("ONEFLOW_AUTOGRAD_DETERMINISTIC_GRAD_ACC", true);
+  return deterministic;
+}
+
+bool AccLeafGradInplace() {
+  static const bool inplace = ParseBooleanFromEnv("ONEFLOW_AUTOGRAD_ACC_LEAF_GRAD_INPLACE", false);
+  return inplace;
+}
+
+// A leaf which already owns a gradient buffer, has no hooks and does not retain grad can have its
+// grads added into the buffer as soon as they are computed, rather than summed into current_grad
+// first and then added into acc_grad by its accumulate node.
+bool CanAccGradInplace4Leaf(const AutogradMeta& autograd_meta) {
+  return autograd_meta.is_leaf() && autograd_meta.requires_grad() && !autograd_meta.retain_grad()
+         && autograd_meta.hooks().empty() && autograd_meta.acc_grad();
+}
+
+Maybe<void> AccGradInplace4Leaf(AutogradMeta* autograd_meta, const TensorTuple& grads) {
+  autograd::AutoGradMode mode(false);
+  TensorTuple inputs;
+  inputs.reserve(grads.size() + 1);
+  inputs.push_back(autograd_meta->acc_grad());
+  inputs.insert(inputs.end(), grads.begin(), grads.end());
+  // grads of the same leaf computed by one node are added with a single add_n
+  JUST(functional::AddN(inputs, /*inplace=*/true));
+  return Maybe<void>::Ok();
+}
+
+// the calling thread applies nodes too, so the pool has one thread less
+ThreadPool* ParallelBackwardThreadPool() {
+  static ThreadPool thread_pool(ParallelBackwardThreadNum() - 1);
+  return &thread_pool;
+}
+
 }  // namespace
 
 Maybe<void> AutogradEngine::RunBackwardAndSaveGrads4LeafTensor(const TensorTuple& outputs,
@@ -86,6 +133,7 @@ StackFunctionNode::StackFunctionNode(
       input_meta_datas_.at(i) = inputs.at(i)->mut_autograd_meta();
       next_functions_->emplace_back(inputs.at(i)->mut_grad_fn_node());
     }
+    is_local_ = is_local_ && inputs.at(i)->is_local();
   }
 
   output_meta_datas_.resize(outputs.size());
@@ -96,6 +144,7 @@ StackFunctionNode::StackFunctionNode(
     outputs.at(i)->set_autograd_meta(autograd_meta);
     output_meta_datas_.at(i) = outputs.at(i)->mut_autograd_meta();
     output_tensor_infos_.emplace_back(TensorInfo(*outputs.at(i)));
+    is_local_ = is_local_ && outputs.at(i)->is_local();
   }
 
   backward_fn_ = backward_fn;
@@ -124,12 +173,21 @@ void FunctionNode::ReleaseOutTensorArgs() {
   }
 }
 
+bool FunctionNode::CanApplyOnAnyThread() const {
+  if (!is_local_) { return false; }
+  return std::all_of(output_meta_datas_.begin(), output_meta_datas_.end(),
+                     [](const std::shared_ptr<AutogradMeta>& meta_data) {
+                       return meta_data->hooks().empty();
+                     });
+}
+
 void StackFunctionNode::ReleaseData() {
   if (!input_meta_datas_.empty()) { backward_fn_.reset(); }
   is_in_stack_ = false;
 }
 
-Maybe<bool> FunctionNode::Apply(bool create_graph) {
+Maybe<bool> FunctionNode::Apply(bool create_graph, int64_t partial_grad_order,
+                                bool acc_leaf_grad_inplace) {
   CHECK_NOTNULL_OR_RETURN(backward_fn_.get())
       << "This FunctionNode with name `" << GetOpTypeName() << "` has been released.\n"
       << "Maybe you try to backward through the node a second time. Specify retain_graph=True when "
@@ -145,6 +203,8 @@ Maybe<bool> FunctionNode::Apply(bool create_graph) {
     }
   }
   JUST((*backward_fn_)(output_grads, &input_grads, create_graph));
+  // inputs may appear more than once, e.g. in x * x
+  std::vector<std::pair<AutogradMeta*, TensorTuple>> leaf_meta_and_grads;
   for (int i = 0; i < input_meta_datas_.size(); ++i) {
     if (input_grads.at(i)) {
       CHECK_NOTNULL_OR_RETURN(input_meta_datas_.at(i))
@@ -152,9 +212,31 @@ Maybe<bool> FunctionNode::Apply(bool create_graph) {
           << " calculate grad for tensor which requires_grad is False. Please submit an issue in "
              "`https://github.com/Oneflow-Inc/oneflow/issues` and we will fix it as soon as "
              "possiable";
-      JUST(input_meta_datas_.at(i)->current_grad()->PushPartialTensor(input_grads.at(i)));
+      AutogradMeta* input_meta = input_meta_datas_.at(i).get();
+      if (acc_leaf_grad_inplace && CanAccGradInplace4Leaf(*input_meta)) {
+        const auto& iter =
+            std::find_if(leaf_meta_and_grads.begin(), leaf_meta_and_grads.end(),
+                         [&](const std::pair<AutogradMeta*, TensorTuple>& meta_and_grads) {
+                           return meta_and_grads.first == input_meta;
+                         });
+        if (iter == leaf_meta_and_grads.end()) {
+          leaf_meta_and_grads.emplace_back(input_meta, TensorTuple{input_grads.at(i)});
+        } else {
+          iter->second.push_back(input_grads.at(i));
+        }
+        continue;
+      }
+      const auto& current_grad = input_meta_datas_.at(i)->current_grad();
+      if (partial_grad_order >= 0) {
+        JUST(current_grad->PushPartialTensor(input_grads.at(i), partial_grad_order));
+      } else {
+        JUST(current_grad->PushPartialTensor(input_grads.at(i)));
+      }
     }
   }
+  for (const auto& meta_and_grads : leaf_meta_and_grads) {
+    JUST(AccGradInplace4Leaf(meta_and_grads.first, meta_and_grads.second));
+  }
   return true;
 }
 
@@ -271,6 +353,7 @@ GraphFunctionNode::GraphFunctionNode(
       input_meta_datas_.at(i) = inputs.at(i)->mut_autograd_meta();
       next_functions_->emplace_back(inputs.at(i)->mut_grad_fn_node());
     }
+    is_local_ = is_local_ && inputs.at(i)->is_local();
   }
 
   output_meta_datas_.resize(outputs.size());
@@ -281,13 +364,16 @@ GraphFunctionNode::GraphFunctionNode(
     outputs.at(i)->set_autograd_meta(autograd_meta);
     output_meta_datas_.at(i) = outputs.at(i)->mut_autograd_meta();
     output_tensor_infos_.emplace_back(TensorInfo(*outputs.at(i)));
+    is_local_ = is_local_ && outputs.at(i)->is_local();
   }
 
   backward_fn_ = backward_fn;
 }
 
 GraphTask::GraphTask(const TensorTuple& outputs, bool retain_graph, bool create_graph)
-    : retain_graph_(retain_graph), create_graph_(create_graph) {
+    : retain_graph_(retain_graph),
+      create_graph_(create_graph),
+      acc_leaf_grad_inplace_(AccLeafGradInplace()) {
   roots_.reserve(outputs.size());
   for (const auto& out_tensor : outputs) {
     FunctionNode* node = out_tensor->mut_grad_fn_node().get();
@@ -306,6 +392,7 @@ Maybe<void> GraphTask::ComputeDependencies() {
     FunctionNode* node = stack.top();
     stack.pop();
     if (/*bool has_seen=*/!seen.insert(node).second) { continue; }
+    nodes_.push_back(node);
     for (const auto& next_grad_fn : *(node->GetNextFunctions())) {
       FunctionNode* next_node = next_grad_fn.get();
       dependencies_[next_node] += 1;
@@ -363,6 +450,7 @@ Maybe<void> GraphTask::ComputeDependenciesAndPruneNode(const TensorTuple& inputs
                                       });
       if (need_execute) { need_execute_.insert(frame.node_); }
       seen.insert(frame.node_);
+      nodes_.push_back(frame.node_);
       stack.pop();
     }
   }
@@ -370,6 +458,10 @@ Maybe<void> GraphTask::ComputeDependenciesAndPruneNode(const TensorTuple& inputs
 }
 
 Maybe<void> GraphTask::Apply(bool save_grad_for_leaf) {
+  if (ParallelBackwardThreadNum() > 1 && CanParallelApply()) {
+    return ParallelApply(save_grad_for_leaf, ParallelBackwardThreadPool(),
+                         DeterministicParallelGradAcc());
+  }
   std::queue<FunctionNode*> queue;
   for (FunctionNode* node : roots_) {
     if (dependencies_[node] == 0) { queue.push(node); }
@@ -382,7 +474,13 @@ Maybe<void> GraphTask::Apply(bool save_grad_for_leaf) {
       node->ReleaseOutTensorArgs();
       continue;
     }
-    if (/*bool not_ready_to_apply=*/!(JUST(node->Apply(create_graph_)))) { continue; }
+    // grads added into leaves in place have no backward graph
+    const bool acc_leaf_grad_inplace =
+        acc_leaf_grad_inplace_ && save_grad_for_leaf && !create_graph_;
+    if (/*bool not_ready_to_apply=*/!(JUST(node->Apply(create_graph_, /*partial_grad_order=*/-1,
+                                                       acc_leaf_grad_inplace)))) {
+      continue;
+    }
     if (save_grad_for_leaf) { JUST(node->AccGrad4LeafTensor(create_graph_)); }
     JUST(node->AccGrad4RetainGradTensor());
     node->ReleaseOutTensorArgs();
@@ -397,6 +495,113 @@ Maybe<void> GraphTask::Apply(bool save_grad_for_leaf) {
   return Maybe<void>::Ok();
 }
 
+bool GraphTask::CanParallelApply() const {
+  // building backward graph and lazy job building are not thread safe
+  if (create_graph_ || LazyMode::is_enabled()) { return false; }
+  return std::all_of(nodes_.begin(), nodes_.end(),
+                     [](FunctionNode* node) { return node->CanApplyOnAnyThread(); });
+}
+
+Maybe<void> GraphTask::ParallelApply(bool save_grad_for_leaf, ThreadPool* thread_pool,
+                                     bool deterministic_grad_acc) {
+  struct NodeState {
+    std::atomic<int> dependency_cnt;
+    int64_t order;
+  };
+  HashMap<FunctionNode*, NodeState> node2state;
+  node2state.reserve(nodes_.size());
+  FOR_RANGE(int64_t, i, 0, nodes_.size()) {
+    NodeState* state = &node2state[nodes_.at(i)];
+    state->dependency_cnt = dependencies_.at(nodes_.at(i));
+    state->order = i;
+  }
+
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::deque<FunctionNode*> ready_queue;
+  int64_t running_cnt = 0;
+  // the first error met by any thread
+  std::shared_ptr<cfg::ErrorProto> error;
+  for (FunctionNode* node : roots_) {
+    if (node2state.at(node).dependency_cnt == 0
+        && std::find(ready_queue.begin(), ready_queue.end(), node) == ready_queue.end()) {
+      ready_queue.push_back(node);
+    }
+  }
+
+  // Same as the sequential loop of Apply, except that successors are collected into
+  // `ready_nodes` rather than pushed into the queue directly.
+  const auto ApplyNode = [&](FunctionNode* node,
+                             std::vector<FunctionNode*>* ready_nodes) -> Maybe<void> {
+    if (!need_execute_.empty() && need_execute_.find(node) == need_execute_.end()) {
+      node->ReleaseOutTensorArgs();
+      return Maybe<void>::Ok();
+    }
+    const int64_t order = deterministic_grad_acc ? node2state.at(node).order : -1;
+    // in place accumulation is left out since grads of a leaf may be produced by several threads
+    if (/*bool not_ready_to_apply=*/!(JUST(node->Apply(create_graph_, order,
+                                                       /*acc_leaf_grad_inplace=*/false)))) {
+      return Maybe<void>::Ok();
+    }
+    if (save_grad_for_leaf) { JUST(node->AccGrad4LeafTensor(create_graph_)); }
+    JUST(node->AccGrad4RetainGradTensor());
+    node->ReleaseOutTensorArgs();
+    if (!retain_graph_) { node->ReleaseData(); }
+
+    for (const auto& next_grad_fn : *(node->GetNextFunctions())) {
+      FunctionNode* next_node = next_grad_fn.get();
+      if (node2state.at(next_node).dependency_cnt.fetch_sub(1) == 1) {
+        ready_nodes->push_back(next_node);
+      }
+    }
+    return Maybe<void>::Ok();
+  };
+
+  const bool grad_mode = autograd::GradMode::is_enabled();
+  const auto WorkerLoop = [&]() {
+    DevVmDepObjectConsumeModeGuard consume_mode_guard(DevVmDepObjectConsumeMode::NONE);
+    autograd::AutoGradMode auto_grad_mode(grad_mode);
+    std::vector<FunctionNode*> ready_nodes;
+    while (true) {
+      FunctionNode* node = nullptr;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [&]() { return !ready_queue.empty() || running_cnt == 0; });
+        if (ready_queue.empty()) { return; }
+        node = ready_queue.front();
+        ready_queue.pop_front();
+        ++running_cnt;
+      }
+      ready_nodes.clear();
+      const auto& node_status = ApplyNode(node, &ready_nodes);
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        --running_cnt;
+        if (!node_status.IsOk() && !error) { error = node_status.error(); }
+        // stops scheduling after the first error, nodes in flight still run to completion
+        if (!error) {
+          ready_queue.insert(ready_queue.end(), ready_nodes.begin(), ready_nodes.end());
+        } else {
+          ready_queue.clear();
+        }
+      }
+      cond.notify_all();
+    }
+  };
+
+  BlockingCounter counter(thread_pool->thread_num());
+  FOR_RANGE(int32_t, i, 0, thread_pool->thread_num()) {
+    thread_pool->AddWork([&]() {
+      WorkerLoop();
+      counter.Decrease();
+    });
+  }
+  WorkerLoop();
+  counter.WaitUntilCntEqualZero();
+  if (error) { return error; }
+  return Maybe<void>::Ok();
+}
+
 Maybe<void> GraphAutogradEngine::RunBackwardAndSaveGrads4LeafTensorIf(const TensorTuple& outputs,
                                                                       const TensorTuple& out_grads,
                                                                       bool retain_graph,
@@ -26,6 +26,8 @@ limitations under the License.
 
 namespace oneflow {
 
+class ThreadPool;
+
 namespace one {
 
 class Tensor;
@@ -36,10 +38,21 @@ class FunctionNode {
  public:
   virtual ~FunctionNode() = default;
 
-  Maybe<bool> Apply(bool create_graph);
+  Maybe<bool> Apply(bool create_graph) {
+    return Apply(create_graph, /*partial_grad_order=*/-1, /*acc_leaf_grad_inplace=*/false);
+  }
+  // Partial grads of inputs are summed in ascending `partial_grad_order` of the nodes producing
+  // them if it is non-negative, and in the order they are pushed otherwise.
+  // If `acc_leaf_grad_inplace`, grads of leaf inputs which already own a gradient buffer are added
+  // into it in place right away instead of going through current_grad.
+  Maybe<bool> Apply(bool create_graph, int64_t partial_grad_order, bool acc_leaf_grad_inplace);
   Maybe<void> AccGrad4LeafTensor(bool create_graph);
   Maybe<void> AccGrad4RetainGradTensor();
   void ReleaseOutTensorArgs();
+  // Returns false if this node has to be applied on the thread calling backward, that is if it
+  // touches consistent tensors, whose boxing must be issued in the same order on every rank, or if
+  // its outputs have hooks, which may be python callables.
+  bool CanApplyOnAnyThread() const;
   // Releases the eventual c++ std::function for backward if retain_graph=False to avoid calling
   // `Apply` in second time
   virtual void ReleaseData() = 0;
@@ -52,7 +65,9 @@ class FunctionNode {
 
  protected:
   explicit FunctionNode(const std::string& op_type_name)
-      : op_name_(op_type_name), next_functions_(new std::vector<std::shared_ptr<FunctionNode>>{}) {}
+      : op_name_(op_type_name),
+        next_functions_(new std::vector<std::shared_ptr<FunctionNode>>{}),
+        is_local_(true) {}
 
   const std::string op_name_;
   std::shared_ptr<std::vector<std::shared_ptr<FunctionNode>>> next_functions_;
@@ -63,6 +78,8 @@ class FunctionNode {
   // Actual backward function builds in `AutogradInterpreter` to calculate one backward op
   std::shared_ptr<const std::function<Maybe<void>(const TensorTuple&, TensorTuple*, bool)>>
       backward_fn_;
+  // true if all inputs and outputs are local tensors
+  bool is_local_;
 };
 
 class AutogradEngine {
@@ -170,14 +187,31 @@ class GraphTask final {
 
   Maybe<void> ComputeDependencies();
   Maybe<void> ComputeDependenciesAndPruneNode(const TensorTuple& inputs);
+  // Applies FunctionNodes in parallel if env ONEFLOW_AUTOGRAD_PARALLEL_BACKWARD_THREAD_NUM is
+  // greater than 1 and CanParallelApply(), and one after another on the calling thread otherwise.
   Maybe<void> Apply(bool save_grad_for_leaf);
 
+  bool CanParallelApply() const;
+  // Ready FunctionNodes are applied by the calling thread and all workers of `thread_pool`.
+  // Partial grads are summed in an order fixed by the graph if `deterministic_grad_acc`, and in
+  // the order producers finish otherwise.
+  Maybe<void> ParallelApply(bool save_grad_for_leaf, ThreadPool* thread_pool,
+                            bool deterministic_grad_acc);
+
+  // Defaults to env ONEFLOW_AUTOGRAD_ACC_LEAF_GRAD_INPLACE, only used by the sequential Apply.
+  void set_acc_leaf_grad_inplace(bool acc_leaf_grad_inplace) {
+    acc_leaf_grad_inplace_ = acc_leaf_grad_inplace;
+  }
+
  private:
   bool retain_graph_;
   bool create_graph_;
+  bool acc_leaf_grad_inplace_;
   std::vector<FunctionNode*> roots_;
   HashMap<FunctionNode*, int> dependencies_;
   HashSet<FunctionNode*> need_execute_;
+  // all nodes reachable from roots_ in the order they are first visited
+  std::vector<FunctionNode*> nodes_;
 };
 
 class GraphAutogradEngine final : public AutogradEngine {
@@ -0,0 +1,219 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <chrono>
+#include "oneflow/core/autograd/autograd_engine.h"
+#include "oneflow/core/autograd/autograd_mode.h"
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/eager/eager_blob_object.h"
+#include "oneflow/core/framework/eager_test_util.h"
+#include "oneflow/core/framework/tensor.h"
+#include "oneflow/core/framework/tensor_arg.h"
+#include "oneflow/core/framework/tensor_tuple.h"
+#include "oneflow/core/functional/functional.h"
+#include "oneflow/core/thread/thread_pool.h"
+#include "oneflow/core/vm/vm_util.h"
+
+namespace oneflow {
+namespace one {
+namespace test {
+
+namespace {
+
+// `towers` independent chains of `depth` nodes, each starting from its own leaf and all of them
+// also taking the leaf `shared` in their first node, joined by a single root node.
+struct WideGraph {
+  TensorTuple leaves;
+  std::shared_ptr<Tensor> shared;
+  std::shared_ptr<Tensor> root;
+};
+
+// Attaches a node to relu(inputs[0]) whose backward dispatches one eager relu per input, so that
+// the cost of every node is dominated by eager op dispatch like real backward ops.
+Maybe<Tensor> AddSyntheticNode(const TensorTuple& inputs) {
+  std::shared_ptr<Tensor> output;
+  {
+    autograd::NoGradGuard no_grad;
+    output = JUST(functional::Relu(inputs.at(0), /*inplace=*/false));
+  }
+  output->set_is_leaf(false);
+  output->set_requires_grad(true);
+  const auto backward_fn =
+      std::make_shared<std::function<Maybe<void>(const TensorTuple&, TensorTuple*, bool)>>(
+          [](const TensorTuple& out_grads, TensorTuple* in_grads,
+             bool create_graph) -> Maybe<void> {
+            for (auto& in_grad : *in_grads) {
+              in_grad = JUST(functional::Relu(out_grads.at(0), /*inplace=*/false));
+            }
+            return Maybe<void>::Ok();
+          });
+  TensorTuple outputs{output};
+  JUST(GetThreadLocalAutogradEngine()->AddBackwardFuncPtr("synthetic_backward", backward_fn,
+                                                          inputs, &outputs));
+  return output;
+}
+
+Maybe<WideGraph> MakeWideGraph(const Shape& shape, int64_t towers, int64_t depth) {
+  WideGraph graph;
+  graph.shared = JUST(NewCpuTensor(shape, 1.0));
+  graph.shared->set_requires_grad(true);
+  TensorTuple tower_outputs;
+  FOR_RANGE(int64_t, i, 0, towers) {
+    const auto& leaf = JUST(NewCpuTensor(shape, 1.0));
+    leaf->set_requires_grad(true);
+    graph.leaves.push_back(leaf);
+    std::shared_ptr<Tensor> hidden = JUST(AddSyntheticNode(TensorTuple{leaf, graph.shared}));
+    FOR_RANGE(int64_t, j, 1, depth) { hidden = JUST(AddSyntheticNode(TensorTuple{hidden})); }
+    tower_outputs.push_back(hidden);
+  }
+  graph.root = JUST(AddSyntheticNode(tower_outputs));
+  return graph;
+}
+
+// Runs backward with ones as the root grad, sequentially if `thread_pool` is nullptr.
+Maybe<void> RunBackward(const WideGraph& graph, ThreadPool* thread_pool,
+                        bool deterministic_grad_acc, bool acc_leaf_grad_inplace) {
+  const auto& root_grad = JUST(NewCpuTensor(*graph.root->shape(), 1.0));
+  JUST(JUST(graph.root->current_grad())->PushPartialTensor(root_grad));
+  GraphTask graph_task(TensorTuple{graph.root}, /*retain_graph=*/true, /*create_graph=*/false);
+  graph_task.set_acc_leaf_grad_inplace(acc_leaf_grad_inplace);
+  JUST(graph_task.ComputeDependencies());
+  CHECK_OR_RETURN(graph_task.CanParallelApply());
+  if (thread_pool == nullptr) {
+    JUST(graph_task.Apply(/*save_grad_for_leaf=*/true));
+  } else {
+    JUST(graph_task.ParallelApply(/*save_grad_for_leaf=*/true, thread_pool,
+                                  deterministic_grad_acc));
+  }
+  return Maybe<void>::Ok();
+}
+
+Maybe<void> CheckAndResetGrad(const std::shared_ptr<Tensor>& tensor, float expected) {
+  const auto& grad = JUST(tensor->acc_grad());
+  CHECK_OR_RETURN(static_cast<bool>(grad));
+  const Blob& blob = JUST(grad->eager_blob_object())->blob();
+  const float* dptr = blob.dptr<float>();
+  FOR_RANGE(int64_t, i, 0, blob.shape().elem_cnt()) { CHECK_EQ_OR_RETURN(dptr[i], expected); }
+  JUST(tensor->set_acc_grad(nullptr));
+  return Maybe<void>::Ok();
+}
+
+Maybe<void> TestParallelBackward() {
+  const int64_t kTowers = 8;
+  const WideGraph graph = *JUST(MakeWideGraph(Shape({4, 4}), kTowers, /*depth=*/4));
+  ThreadPool thread_pool(3);
+  for (ThreadPool* pool : {static_cast<ThreadPool*>(nullptr), &thread_pool}) {
+    for (bool deterministic_grad_acc : {true, false}) {
+      JUST(RunBackward(graph, pool, deterministic_grad_acc, /*acc_leaf_grad_inplace=*/false));
+      JUST(vm::MultiClientSync());
+      for (const auto& leaf : graph.leaves) { JUST(CheckAndResetGrad(leaf, 1.0)); }
+      JUST(CheckAndResetGrad(graph.shared, kTowers));
+    }
+  }
+  return Maybe<void>::Ok();
+}
+
+Maybe<void> BenchmarkParallelBackward(int64_t towers, int64_t depth) {
+  const int64_t kIters = 10;
+  const WideGraph graph = *JUST(MakeWideGraph(Shape({64, 64}), towers, depth));
+  const auto TimeBackward = [&](ThreadPool* thread_pool) -> Maybe<double> {
+    JUST(RunBackward(graph, thread_pool, /*deterministic_grad_acc=*/true,
+                     /*acc_leaf_grad_inplace=*/false));
+    JUST(vm::MultiClientSync());
+    const auto start = std::chrono::steady_clock::now();
+    FOR_RANGE(int64_t, i, 0, kIters) {
+      JUST(RunBackward(graph, thread_pool, /*deterministic_grad_acc=*/true,
+                       /*acc_leaf_grad_inplace=*/false));
+    }
+    JUST(vm::MultiClientSync());
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+               .count()
+           / kIters;
+  };
+  const double sequential_ms = JUST(TimeBackward(nullptr));
+  LOG(INFO) << "backward of " << towers << " towers x " << depth
+            << " nodes: sequential " << sequential_ms << "ms";
+  for (int32_t thread_num : {2, 4, 8}) {
+    ThreadPool thread_pool(thread_num - 1);
+    const double parallel_ms = JUST(TimeBackward(&thread_pool));
+    LOG(INFO) << "backward of " << towers << " towers x " << depth << " nodes: " << thread_num
+              << " threads " << parallel_ms << "ms, speedup " << sequential_ms / parallel_ms;
+  }
+  return Maybe<void>::Ok();
+}
+
+Maybe<void> TestAccLeafGradInplace() {
+  const int64_t kTowers = 8;
+  const WideGraph graph = *JUST(MakeWideGraph(Shape({4, 4}), kTowers, /*depth=*/2));
+  // the first backward has no buffer to add into, so leaves keep their summed grads as buffers
+  JUST(RunBackward(graph, nullptr, /*deterministic_grad_acc=*/true,
+                   /*acc_leaf_grad_inplace=*/true));
+  const auto& shared_grad = JUST(graph.shared->acc_grad());
+  JUST(RunBackward(graph, nullptr, /*deterministic_grad_acc=*/true,
+                   /*acc_leaf_grad_inplace=*/true));
+  JUST(vm::MultiClientSync());
+  CHECK_OR_RETURN(JUST(graph.shared->acc_grad()) == shared_grad);
+  for (const auto& leaf : graph.leaves) { JUST(CheckAndResetGrad(leaf, 2.0)); }
+  JUST(CheckAndResetGrad(graph.shared, 2.0 * kTowers));
+  return Maybe<void>::Ok();
+}
+
+// Every tower adds a grad into the shared leaf, so the leaf has `towers` contributions per step.
+Maybe<void> BenchmarkAccLeafGradInplace(int64_t towers) {
+  const int64_t kIters = 20;
+  const WideGraph graph = *JUST(MakeWideGraph(Shape({256, 256}), towers, /*depth=*/1));
+  for (bool acc_leaf_grad_inplace : {false, true}) {
+    JUST(RunBackward(graph, nullptr, /*deterministic_grad_acc=*/true, acc_leaf_grad_inplace));
+    JUST(vm::MultiClientSync());
+    const auto start = std::chrono::steady_clock::now();
+    FOR_RANGE(int64_t, i, 0, kIters) {
+      JUST(RunBackward(graph, nullptr, /*deterministic_grad_acc=*/true, acc_leaf_grad_inplace));
+    }
+    JUST(vm::MultiClientSync());
+    const double ms =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+            .count()
+        / kIters;
+    LOG(INFO) << "backward of " << towers << " towers into one leaf, acc leaf grad in place "
+              << acc_leaf_grad_inplace << ": " << ms << "ms";
+  }
+  return Maybe<void>::Ok();
+}
+
+}  // namespace
+
+TEST(GraphAutogradEngine, parallel_backward) {
+  TestEagerEnvScope scope;
+  CHECK_JUST(TestParallelBackward());
+}
+
+TEST(GraphAutogradEngine, DISABLED_benchmark_parallel_backward) {
+  TestEagerEnvScope scope;
+  CHECK_JUST(BenchmarkParallelBackward(/*towers=*/16, /*depth=*/16));
+}
+
+TEST(GraphAutogradEngine, acc_leaf_grad_inplace) {
+  TestEagerEnvScope scope;
+  CHECK_JUST(TestAccLeafGradInplace());
+}
+
+TEST(GraphAutogradEngine, DISABLED_benchmark_acc_leaf_grad_inplace) {
+  TestEagerEnvScope scope;
+  CHECK_JUST(BenchmarkAccLeafGradInplace(/*towers=*/64));
+}
+
+}  // namespace test
+}  // namespace one
+}  // namespace oneflow
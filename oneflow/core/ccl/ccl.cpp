@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/core/ccl/ccl.h"
+#include "oneflow/core/ccl/cpu_algorithm.h"
 #include "oneflow/core/framework/transport_util.h"
 #include "oneflow/core/job/parallel_desc.h"
 #include "oneflow/core/common/data_type.h"
@@ -39,6 +40,148 @@ Maybe<void> InitBroadcastRankHeap(std::vector<int64_t>* ranks, const ParallelDes
   return Maybe<void>::Ok();
 }
 
+// Messages are split into chunks of at most this many bytes, so that chunks of consecutive steps
+// of a ring are transported and reduced in a pipeline.
+int64_t ChunkByteSize() {
+  static const int64_t chunk_byte_size =
+      ParseIntegerFromEnv("ONEFLOW_CCL_CPU_CHUNK_BYTE_SIZE", 1 << 20);
+  return chunk_byte_size;
+}
+
+// Messages of fewer bytes use latency optimal algorithms, others use bandwidth optimal rings.
+int64_t RingThreshold() {
+  static const int64_t ring_threshold =
+      ParseIntegerFromEnv("ONEFLOW_CCL_CPU_RING_THRESHOLD", 256 << 10);
+  return ring_threshold;
+}
+
+Maybe<void> InitRanks(std::vector<int64_t>* ranks, int64_t* current_index,
+                      const ParallelDesc& parallel_desc) {
+  CHECK_EQ_OR_RETURN(parallel_desc.parallel_num(), parallel_desc.sorted_machine_ids().size());
+  ranks->resize(parallel_desc.parallel_num());
+  *current_index = -1;
+  for (int64_t parallel_id = 0; parallel_id < parallel_desc.parallel_num(); ++parallel_id) {
+    int64_t machine_id = JUST(parallel_desc.MachineId4ParallelId(parallel_id));
+    if (machine_id == GlobalProcessCtx::Rank()) { *current_index = parallel_id; }
+    (*ranks)[parallel_id] = machine_id;
+  }
+  CHECK_NE_OR_RETURN(*current_index, -1);
+  return Maybe<void>::Ok();
+}
+
+Maybe<int64_t> GetRankIndex(const std::vector<int64_t>& ranks, int64_t rank) {
+  for (int64_t i = 0; i < ranks.size(); ++i) {
+    if (ranks.at(i) == rank) { return i; }
+  }
+  UNIMPLEMENTED_THEN_RETURN() << "rank " << rank << " is not in the parallel desc";
+}
+
+// Point to point transfers of a collective. A transfer between two ranks uses the same token on
+// both of them, so every rank creates the same tokens at the beginning of a collective.
+class AsyncTransfers final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(AsyncTransfers);
+  explicit AsyncTransfers(int64_t token_num) {
+    tokens_.reserve(token_num);
+    for (int64_t i = 0; i < token_num; ++i) {
+      tokens_.push_back(TransportToken::NewDataTransportToken());
+    }
+  }
+  ~AsyncTransfers() = default;
+
+  Maybe<void> Send(int64_t token_id, int64_t rank, const void* buffer, size_t size) {
+    if (size == 0) { return Maybe<void>::Ok(); }
+    auto transport_ctx = JUST(NewTransportCtx(token_id, const_cast<void*>(buffer), size));
+    JUST(TransportUtil::SendDataToRank(rank, tokens_.at(token_id), transport_ctx.get()));
+    send_transport_ctxs_.push_back(std::move(transport_ctx));
+    return Maybe<void>::Ok();
+  }
+
+  Maybe<void> Recv(int64_t token_id, int64_t rank, void* buffer, size_t size) {
+    if (size == 0) { return Maybe<void>::Ok(); }
+    auto transport_ctx = JUST(NewTransportCtx(token_id, buffer, size));
+    JUST(TransportUtil::ReceiveDataFromRank(rank, tokens_.at(token_id), transport_ctx.get()));
+    CHECK_OR_RETURN(token_id2recv_transport_ctx_.emplace(token_id, transport_ctx).second);
+    return Maybe<void>::Ok();
+  }
+
+  // Does nothing if nothing is received with the token
+  Maybe<void> WaitRecv(int64_t token_id) {
+    auto it = token_id2recv_transport_ctx_.find(token_id);
+    if (it == token_id2recv_transport_ctx_.end()) { return Maybe<void>::Ok(); }
+    JUST(TransportUtil::WaitUntilDoneOrTimeout(*it->second, TransportUtil::TimeoutSeconds()));
+    token_id2recv_transport_ctx_.erase(it);
+    return Maybe<void>::Ok();
+  }
+
+  Maybe<void> WaitAll() {
+    for (const auto& pair : token_id2recv_transport_ctx_) {
+      JUST(TransportUtil::WaitUntilDoneOrTimeout(*pair.second, TransportUtil::TimeoutSeconds()));
+    }
+    token_id2recv_transport_ctx_.clear();
+    for (const auto& transport_ctx : send_transport_ctxs_) {
+      JUST(TransportUtil::WaitUntilDoneOrTimeout(*transport_ctx, TransportUtil::TimeoutSeconds()));
+    }
+    send_transport_ctxs_.clear();
+    return Maybe<void>::Ok();
+  }
+
+ private:
+  Maybe<AsyncTransportCtx> NewTransportCtx(int64_t token_id, void* buffer, size_t size) {
+    CHECK_GE_OR_RETURN(token_id, 0);
+    CHECK_LT_OR_RETURN(token_id, tokens_.size());
+    const auto& Prepare = [buffer, size](void** out_buffer, std::size_t* out_size,
+                                         std::function<void()>* Cb) -> Maybe<void> {
+      *out_buffer = buffer;
+      *out_size = size;
+      *Cb = [] {};
+      return Maybe<void>::Ok();
+    };
+    return std::shared_ptr<AsyncTransportCtx>(
+        new NaiveAsyncTransportCtx(tokens_.at(token_id), Prepare, Prepare));
+  }
+
+  std::vector<TransportToken> tokens_;
+  std::vector<std::shared_ptr<AsyncTransportCtx>> send_transport_ctxs_;
+  HashMap<int64_t, std::shared_ptr<AsyncTransportCtx>> token_id2recv_transport_ctx_;
+};
+
+int64_t BroadcastChunkNum(size_t byte_size) {
+  return std::max<int64_t>((byte_size + ChunkByteSize() - 1) / ChunkByteSize(), 1);
+}
+
+// Broadcasts down the binary heap of ranks whose root is rank_heap[0]. Every chunk is forwarded to
+// the children as soon as it arrives, so that the latency grows with the heap depth times the
+// chunk size rather than times the buffer size. `src` is read by the root and `dst` is written by
+// the others.
+Maybe<void> PipelinedBroadcastInHeap(const std::vector<int64_t>& rank_heap, int64_t current_index,
+                                     const char* src, char* dst, size_t byte_size,
+                                     AsyncTransfers* transfers) {
+  const int64_t chunk_num = BroadcastChunkNum(byte_size);
+  const auto& ChunkByteRange = [&](int64_t chunk) {
+    const size_t begin = std::min<size_t>(chunk * ChunkByteSize(), byte_size);
+    return std::make_pair(begin, std::min<size_t>(begin + ChunkByteSize(), byte_size) - begin);
+  };
+  if (current_index > 0) {
+    const int64_t parent = rank_heap.at((current_index - 1) / 2);
+    for (int64_t chunk = 0; chunk < chunk_num; ++chunk) {
+      const auto& range = ChunkByteRange(chunk);
+      JUST(transfers->Recv(chunk, parent, dst + range.first, range.second));
+    }
+  }
+  const char* forwarded = (current_index == 0 ? src : dst);
+  for (int64_t chunk = 0; chunk < chunk_num; ++chunk) {
+    JUST(transfers->WaitRecv(chunk));
+    const auto& range = ChunkByteRange(chunk);
+    for (int64_t child_index : {current_index * 2 + 1, current_index * 2 + 2}) {
+      if (child_index >= rank_heap.size()) { continue; }
+      JUST(transfers->Send(chunk, rank_heap.at(child_index), forwarded + range.first,
+                           range.second));
+    }
+  }
+  return Maybe<void>::Ok();
+}
+
 }  // namespace
 
 template<>
@@ -46,32 +189,70 @@ Maybe<void> Broadcast<DeviceType::kCPU>(const void* in, void* out, size_t elem_c
                                         int64_t root, Symbol<ParallelDesc> parallel_desc,
                                         DeviceCtx* ctx) {
   CHECK_EQ_OR_RETURN(parallel_desc->device_type(), DeviceType::kCPU);
+  CHECK_OR_RETURN(IsPODDataType(dtype));
   static thread_local std::vector<int64_t> rank_heap{};
   JUST(InitBroadcastRankHeap(&rank_heap, *parallel_desc, root));
-  TransportToken transport_token = TransportToken::NewDataTransportToken();
-  CHECK_OR_RETURN(IsPODDataType(dtype));
-  size_t buffer_size = elem_cnt * GetSizeOfDataType(dtype);
-  NaiveAsyncTransportCtx transport_ctx(
-      transport_token,
-      [&](void** buffer, std::size_t* size, std::function<void()>* Cb) -> Maybe<void> {
-        *buffer = (root == GlobalProcessCtx::Rank() ? const_cast<void*>(in) : out);
-        *size = buffer_size;
-        *Cb = [] {};
-        return Maybe<void>::Ok();
-      },
-      [&](void** buffer, std::size_t* size, std::function<void()>* Cb) -> Maybe<void> {
-        *buffer = out;
-        *size = buffer_size;
-        *Cb = [] {};
-        return Maybe<void>::Ok();
-      });
-  JUST(TransportUtil::ReceiveDataFromParentInHeap(rank_heap, transport_token, &transport_ctx));
-  JUST(TransportUtil::WaitUntilDoneOrTimeout(transport_ctx, TransportUtil::TimeoutSeconds()));
-  JUST(TransportUtil::SendDataToChildrenInHeap(rank_heap, transport_token, &transport_ctx));
-  if (GlobalProcessCtx::Rank() == root && out != in) { std::memcpy(out, in, buffer_size); }
-  JUST(TransportUtil::WaitUntilDoneOrTimeout(transport_ctx, TransportUtil::TimeoutSeconds()));
+  const int64_t current_index = JUST(GetRankIndex(rank_heap, GlobalProcessCtx::Rank()));
+  const size_t buffer_size = elem_cnt * GetSizeOfDataType(dtype);
+  AsyncTransfers transfers(BroadcastChunkNum(buffer_size));
+  JUST(PipelinedBroadcastInHeap(rank_heap, current_index, static_cast<const char*>(in),
+                                static_cast<char*>(out), buffer_size, &transfers));
+  if (current_index == 0 && out != in) { std::memcpy(out, in, buffer_size); }
+  JUST(transfers.WaitAll());
   return Maybe<void>::Ok();
 }
 
+template<>
+Maybe<void> AllReduce<DeviceType::kCPU>(const void* in, void* out, size_t elem_cnt, DataType dtype,
+                                        ReduceType reduce_type, Symbol<ParallelDesc> parallel_desc,
+                                        DeviceCtx* ctx) {
+  CHECK_EQ_OR_RETURN(parallel_desc->device_type(), DeviceType::kCPU);
+  CHECK_OR_RETURN(IsPODDataType(dtype));
+  std::vector<int64_t> ranks;
+  int64_t current_index = -1;
+  JUST(InitRanks(&ranks, &current_index, *parallel_desc));
+  return AllReduceInRanks<AsyncTransfers>(ranks, current_index, in, out, elem_cnt, dtype,
+                                          reduce_type, RingThreshold(), ChunkByteSize());
+}
+
+template<>
+Maybe<void> ReduceScatter<DeviceType::kCPU>(const void* in, void* out, size_t elem_cnt,
+                                            DataType dtype, ReduceType reduce_type,
+                                            Symbol<ParallelDesc> parallel_desc, DeviceCtx* ctx) {
+  CHECK_EQ_OR_RETURN(parallel_desc->device_type(), DeviceType::kCPU);
+  CHECK_OR_RETURN(IsPODDataType(dtype));
+  std::vector<int64_t> ranks;
+  int64_t current_index = -1;
+  JUST(InitRanks(&ranks, &current_index, *parallel_desc));
+  return ReduceScatterInRanks<AsyncTransfers>(ranks, current_index, in, out, elem_cnt, dtype,
+                                              reduce_type, RingThreshold(), ChunkByteSize());
+}
+
+template<>
+Maybe<void> AllGather<DeviceType::kCPU>(const void* in, void* out, size_t elem_cnt, DataType dtype,
+                                        Symbol<ParallelDesc> parallel_desc, DeviceCtx* ctx) {
+  CHECK_EQ_OR_RETURN(parallel_desc->device_type(), DeviceType::kCPU);
+  CHECK_OR_RETURN(IsPODDataType(dtype));
+  std::vector<int64_t> ranks;
+  int64_t current_index = -1;
+  JUST(InitRanks(&ranks, &current_index, *parallel_desc));
+  return AllGatherInRanks<AsyncTransfers>(ranks, current_index, in, out, elem_cnt, dtype,
+                                          RingThreshold(), ChunkByteSize());
+}
+
+template<>
+Maybe<void> Reduce<DeviceType::kCPU>(const void* in, void* out, size_t elem_cnt, DataType dtype,
+                                     ReduceType reduce_type, int64_t root,
+                                     Symbol<ParallelDesc> parallel_desc, DeviceCtx* ctx) {
+  CHECK_EQ_OR_RETURN(parallel_desc->device_type(), DeviceType::kCPU);
+  CHECK_OR_RETURN(IsPODDataType(dtype));
+  std::vector<int64_t> ranks;
+  int64_t current_index = -1;
+  JUST(InitRanks(&ranks, &current_index, *parallel_desc));
+  const int64_t root_index = JUST(GetRankIndex(ranks, root));
+  return ReduceInRanks<AsyncTransfers>(ranks, current_index, root_index, in, out, elem_cnt, dtype,
+                                       reduce_type, RingThreshold(), ChunkByteSize());
+}
+
 }  // namespace ccl
 }  // namespace oneflow
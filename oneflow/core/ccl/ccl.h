@@ -28,10 +28,38 @@ class ParallelDesc;
 // collective communication library
 namespace ccl {
 
+enum ReduceType {
+  kInvalidReduceType = 0,
+  kSum,
+  kMax,
+};
+
 template<DeviceType device_type>
 Maybe<void> Broadcast(const void* in, void* out, size_t elem_cnt, DataType dtype, int64_t root,
                       Symbol<ParallelDesc> parallel_desc, DeviceCtx* ctx);
 
+// `in` and `out` both have `elem_cnt` elements
+template<DeviceType device_type>
+Maybe<void> AllReduce(const void* in, void* out, size_t elem_cnt, DataType dtype,
+                      ReduceType reduce_type, Symbol<ParallelDesc> parallel_desc, DeviceCtx* ctx);
+
+// `in` has `elem_cnt` * parallel_num elements, `out` of parallel_id i gets the ith `elem_cnt` ones
+template<DeviceType device_type>
+Maybe<void> ReduceScatter(const void* in, void* out, size_t elem_cnt, DataType dtype,
+                          ReduceType reduce_type, Symbol<ParallelDesc> parallel_desc,
+                          DeviceCtx* ctx);
+
+// `in` has `elem_cnt` elements, `out` has `elem_cnt` * parallel_num ones in parallel_id order
+template<DeviceType device_type>
+Maybe<void> AllGather(const void* in, void* out, size_t elem_cnt, DataType dtype,
+                      Symbol<ParallelDesc> parallel_desc, DeviceCtx* ctx);
+
+// Only `out` of rank `root` gets the result, `out` of other ranks is used as a buffer
+template<DeviceType device_type>
+Maybe<void> Reduce(const void* in, void* out, size_t elem_cnt, DataType dtype,
+                   ReduceType reduce_type, int64_t root, Symbol<ParallelDesc> parallel_desc,
+                   DeviceCtx* ctx);
+
 }
 
 }  // namespace oneflow
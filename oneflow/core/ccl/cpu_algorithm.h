@@ -0,0 +1,417 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_CCL_CPU_ALGORITHM_H_
+#define ONEFLOW_CORE_CCL_CPU_ALGORITHM_H_
+
+#include "oneflow/core/ccl/ccl.h"
+#include "oneflow/core/common/data_type.h"
+#include "oneflow/core/common/balanced_splitter.h"
+
+namespace oneflow {
+
+namespace ccl {
+
+// Algorithms of the CPU collectives among `ranks`, run by the rank of index `current_index`.
+//
+// They transfer data through a `Transfers`, created with the number of tokens the collective
+// uses and having
+//   Maybe<void> Send(int64_t token_id, int64_t rank, const void* buffer, size_t size);
+//   Maybe<void> Recv(int64_t token_id, int64_t rank, void* buffer, size_t size);
+//   Maybe<void> WaitRecv(int64_t token_id);
+//   Maybe<void> WaitAll();
+// A send is matched with the receive of the same token id on the peer rank. Every rank creates
+// the same Transfers in the same order, so that token ids stay in step across ranks.
+
+template<typename T>
+void ReduceInplace(const T* in, T* in_out, size_t elem_cnt, ReduceType reduce_type) {
+  if (reduce_type == kSum) {
+    for (size_t i = 0; i < elem_cnt; ++i) { in_out[i] += in[i]; }
+  } else {
+    for (size_t i = 0; i < elem_cnt; ++i) { in_out[i] = std::max(in_out[i], in[i]); }
+  }
+}
+
+inline Maybe<void> ReduceInplace(const void* in, void* in_out, size_t elem_cnt, DataType dtype,
+                                 ReduceType reduce_type) {
+  CHECK_OR_RETURN(reduce_type == kSum || reduce_type == kMax);
+  switch (dtype) {
+#define MAKE_REDUCE_INPLACE_ENTRY(type_cpp, type_proto)                                     \
+  case type_proto:                                                                         \
+    ReduceInplace<type_cpp>(static_cast<const type_cpp*>(in), static_cast<type_cpp*>(in_out), \
+                            elem_cnt, reduce_type);                                        \
+    return Maybe<void>::Ok();
+    OF_PP_FOR_EACH_TUPLE(MAKE_REDUCE_INPLACE_ENTRY,
+                         ARITHMETIC_DATA_TYPE_SEQ UNSIGNED_INT_DATA_TYPE_SEQ)
+#undef MAKE_REDUCE_INPLACE_ENTRY
+    default: UNIMPLEMENTED_THEN_RETURN() << "unsupported data type " << dtype;
+  }
+}
+
+// A buffer evenly split into blocks, one for each rank of a ring. Blocks are split into chunks of
+// at most `chunk_byte_size` bytes, so that chunks of consecutive steps are transported and
+// reduced in a pipeline.
+class Ring final {
+ public:
+  Ring(const std::vector<int64_t>& ranks, int64_t current_index, size_t elem_cnt,
+       size_t elem_size, int64_t chunk_byte_size)
+      : ranks_(ranks),
+        current_index_(current_index),
+        elem_size_(elem_size),
+        splitter_(elem_cnt, ranks.size()) {
+    chunk_elem_cnt_ = std::max<int64_t>(chunk_byte_size / elem_size, 1);
+    const int64_t max_block_elem_cnt = splitter_.At(0).size();
+    chunk_num_ = (max_block_elem_cnt + chunk_elem_cnt_ - 1) / chunk_elem_cnt_;
+    chunk_num_ = std::max<int64_t>(chunk_num_, 1);
+  }
+  ~Ring() = default;
+
+  int64_t size() const { return ranks_.size(); }
+  int64_t current_index() const { return current_index_; }
+  int64_t next_rank() const { return ranks_.at((current_index_ + 1) % size()); }
+  int64_t prev_rank() const { return ranks_.at((current_index_ + size() - 1) % size()); }
+  int64_t chunk_num() const { return chunk_num_; }
+  size_t chunk_byte_size() const { return chunk_elem_cnt_ * elem_size_; }
+  size_t max_block_byte_size() const { return splitter_.At(0).size() * elem_size_; }
+  // Tokens used by n - 1 steps of the ring
+  int64_t token_num() const { return (size() - 1) * chunk_num_; }
+
+  // The block of index `index` modulo ring size
+  int64_t Block(int64_t index) const { return (index % size() + size()) % size(); }
+  size_t BlockByteOffset(int64_t block) const { return splitter_.At(block).begin() * elem_size_; }
+  size_t BlockByteSize(int64_t block) const { return splitter_.At(block).size() * elem_size_; }
+  // Offset and size in bytes of a chunk in the buffer, the size is 0 if the block is shorter
+  std::pair<size_t, size_t> ChunkByteRange(int64_t block, int64_t chunk) const {
+    const Range& range = splitter_.At(block);
+    const int64_t begin = std::min(range.begin() + chunk * chunk_elem_cnt_, range.end());
+    const int64_t end = std::min(begin + chunk_elem_cnt_, range.end());
+    return std::make_pair(begin * elem_size_, (end - begin) * elem_size_);
+  }
+
+ private:
+  const std::vector<int64_t>& ranks_;
+  int64_t current_index_;
+  size_t elem_size_;
+  BalancedSplitter splitter_;
+  int64_t chunk_elem_cnt_;
+  int64_t chunk_num_;
+};
+
+// In step i, each rank sends block `current_index + shift - i` to the next rank and reduces the
+// block received from the previous rank into block `current_index + shift - i - 1`. After n - 1
+// steps, block `current_index + shift + 1` of each rank is reduced from all ranks.
+template<typename Transfers>
+Maybe<void> RingReduceScatter(const Ring& ring, int64_t shift, char* buffer, DataType dtype,
+                              ReduceType reduce_type, int64_t first_token_id,
+                              Transfers* transfers) {
+  const int64_t step_num = ring.size() - 1;
+  const size_t elem_size = GetSizeOfDataType(dtype);
+  const auto& TokenId = [&](int64_t step, int64_t chunk) {
+    return first_token_id + step * ring.chunk_num() + chunk;
+  };
+  const auto& SendBlock = [&](int64_t step) {
+    return ring.Block(ring.current_index() + shift - step);
+  };
+  const auto& RecvBlock = [&](int64_t step) {
+    return ring.Block(ring.current_index() + shift - step - 1);
+  };
+  // double buffered, chunks of step i + 2 are received once the ones of step i are reduced
+  std::vector<char> recv_buffers[2];
+  for (auto& recv_buffer : recv_buffers) { recv_buffer.resize(ring.max_block_byte_size()); }
+  const auto& RecvBuffer = [&](int64_t step, int64_t chunk) {
+    return recv_buffers[step % 2].data() + chunk * ring.chunk_byte_size();
+  };
+  const auto& SendChunk = [&](int64_t step, int64_t chunk) -> Maybe<void> {
+    const auto& range = ring.ChunkByteRange(SendBlock(step), chunk);
+    return transfers->Send(TokenId(step, chunk), ring.next_rank(), buffer + range.first,
+                           range.second);
+  };
+  const auto& RecvChunk = [&](int64_t step, int64_t chunk) -> Maybe<void> {
+    const auto& range = ring.ChunkByteRange(RecvBlock(step), chunk);
+    return transfers->Recv(TokenId(step, chunk), ring.prev_rank(), RecvBuffer(step, chunk),
+                           range.second);
+  };
+  for (int64_t chunk = 0; chunk < ring.chunk_num(); ++chunk) {
+    JUST(RecvChunk(0, chunk));
+    if (step_num > 1) { JUST(RecvChunk(1, chunk)); }
+    JUST(SendChunk(0, chunk));
+  }
+  for (int64_t step = 0; step < step_num; ++step) {
+    for (int64_t chunk = 0; chunk < ring.chunk_num(); ++chunk) {
+      JUST(transfers->WaitRecv(TokenId(step, chunk)));
+      const auto& range = ring.ChunkByteRange(RecvBlock(step), chunk);
+      JUST(ReduceInplace(RecvBuffer(step, chunk), buffer + range.first, range.second / elem_size,
+                         dtype, reduce_type));
+      // the block reduced in this step is sent in the next step
+      if (step + 1 < step_num) { JUST(SendChunk(step + 1, chunk)); }
+      if (step + 2 < step_num) { JUST(RecvChunk(step + 2, chunk)); }
+    }
+  }
+  JUST(transfers->WaitAll());
+  return Maybe<void>::Ok();
+}
+
+// In step i, each rank sends block `current_index + shift - i` to the next rank and receives block
+// `current_index + shift - i - 1` from the previous rank. After n - 1 steps, every rank has the
+// blocks `current_index + shift` of all ranks.
+template<typename Transfers>
+Maybe<void> RingAllGather(const Ring& ring, int64_t shift, char* buffer, int64_t first_token_id,
+                          Transfers* transfers) {
+  const int64_t step_num = ring.size() - 1;
+  const auto& TokenId = [&](int64_t step, int64_t chunk) {
+    return first_token_id + step * ring.chunk_num() + chunk;
+  };
+  const auto& SendChunk = [&](int64_t step, int64_t chunk) -> Maybe<void> {
+    const auto& range =
+        ring.ChunkByteRange(ring.Block(ring.current_index() + shift - step), chunk);
+    return transfers->Send(TokenId(step, chunk), ring.next_rank(), buffer + range.first,
+                           range.second);
+  };
+  // every block is received only once, so all of them are received at once
+  for (int64_t step = 0; step < step_num; ++step) {
+    for (int64_t chunk = 0; chunk < ring.chunk_num(); ++chunk) {
+      const auto& range =
+          ring.ChunkByteRange(ring.Block(ring.current_index() + shift - step - 1), chunk);
+      JUST(transfers->Recv(TokenId(step, chunk), ring.prev_rank(), buffer + range.first,
+                           range.second));
+    }
+  }
+  for (int64_t chunk = 0; chunk < ring.chunk_num(); ++chunk) { JUST(SendChunk(0, chunk)); }
+  for (int64_t step = 0; step < step_num; ++step) {
+    for (int64_t chunk = 0; chunk < ring.chunk_num(); ++chunk) {
+      JUST(transfers->WaitRecv(TokenId(step, chunk)));
+      // the block received in this step is sent in the next step
+      if (step + 1 < step_num) { JUST(SendChunk(step + 1, chunk)); }
+    }
+  }
+  JUST(transfers->WaitAll());
+  return Maybe<void>::Ok();
+}
+
+inline int64_t Log2Floor(int64_t n) {
+  int64_t log2 = 0;
+  while ((int64_t{1} << (log2 + 1)) <= n) { ++log2; }
+  return log2;
+}
+
+inline bool IsPowerOf2(int64_t n) { return n > 0 && (n & (n - 1)) == 0; }
+
+inline int64_t RecursiveDoublingAllReduceTokenNum(int64_t rank_num) {
+  return Log2Floor(rank_num) + 2;
+}
+
+// Ranks beyond the largest power of 2 fold their data into the first ones, which exchange and
+// reduce the whole buffer with the rank whose index differs in bit i in step i.
+template<typename Transfers>
+Maybe<void> RecursiveDoublingAllReduce(const std::vector<int64_t>& ranks, int64_t current_index,
+                                       char* buffer, size_t elem_cnt, DataType dtype,
+                                       ReduceType reduce_type, Transfers* transfers) {
+  const int64_t rank_num = ranks.size();
+  const int64_t pow2_rank_num = int64_t{1} << Log2Floor(rank_num);
+  const int64_t folded_rank_num = rank_num - pow2_rank_num;
+  const size_t size = elem_cnt * GetSizeOfDataType(dtype);
+  const int64_t fold_token_id = 0;
+  const int64_t unfold_token_id = Log2Floor(rank_num) + 1;
+  std::vector<char> recv_buffer(size);
+  if (current_index >= pow2_rank_num) {
+    JUST(transfers->Send(fold_token_id, ranks.at(current_index - pow2_rank_num), buffer, size));
+    JUST(transfers->WaitAll());
+    JUST(transfers->Recv(unfold_token_id, ranks.at(current_index - pow2_rank_num), buffer, size));
+    JUST(transfers->WaitAll());
+    return Maybe<void>::Ok();
+  }
+  if (current_index < folded_rank_num) {
+    JUST(transfers->Recv(fold_token_id, ranks.at(current_index + pow2_rank_num),
+                         recv_buffer.data(), size));
+    JUST(transfers->WaitAll());
+    JUST(ReduceInplace(recv_buffer.data(), buffer, elem_cnt, dtype, reduce_type));
+  }
+  int64_t token_id = fold_token_id + 1;
+  for (int64_t mask = 1; mask < pow2_rank_num; mask <<= 1, ++token_id) {
+    const int64_t peer = ranks.at(current_index ^ mask);
+    JUST(transfers->Send(token_id, peer, buffer, size));
+    JUST(transfers->Recv(token_id, peer, recv_buffer.data(), size));
+    JUST(transfers->WaitAll());
+    // a + b == b + a, so both peers get the same result
+    JUST(ReduceInplace(recv_buffer.data(), buffer, elem_cnt, dtype, reduce_type));
+  }
+  if (current_index < folded_rank_num) {
+    JUST(transfers->Send(unfold_token_id, ranks.at(current_index + pow2_rank_num), buffer, size));
+    JUST(transfers->WaitAll());
+  }
+  return Maybe<void>::Ok();
+}
+
+// For a power of 2 ranks, in step i each rank exchanges the 2^i blocks it has with the rank whose
+// index differs in bit i.
+template<typename Transfers>
+Maybe<void> RecursiveDoublingAllGather(const std::vector<int64_t>& ranks, int64_t current_index,
+                                       char* buffer, size_t block_size, Transfers* transfers) {
+  int64_t token_id = 0;
+  for (int64_t mask = 1; mask < ranks.size(); mask <<= 1, ++token_id) {
+    const int64_t peer_index = current_index ^ mask;
+    const size_t offset = (current_index & ~(mask - 1)) * block_size;
+    const size_t peer_offset = (peer_index & ~(mask - 1)) * block_size;
+    JUST(transfers->Send(token_id, ranks.at(peer_index), buffer + offset, mask * block_size));
+    JUST(transfers->Recv(token_id, ranks.at(peer_index), buffer + peer_offset,
+                         mask * block_size));
+    JUST(transfers->WaitAll());
+  }
+  return Maybe<void>::Ok();
+}
+
+// Binomial tree rooted at `root_index`, in step i each rank whose relative index has lowest set
+// bit i sends its partial result to the rank whose relative index differs in that bit.
+template<typename Transfers>
+Maybe<void> BinomialTreeReduce(const std::vector<int64_t>& ranks, int64_t current_index,
+                               int64_t root_index, char* buffer, size_t elem_cnt, DataType dtype,
+                               ReduceType reduce_type, Transfers* transfers) {
+  const int64_t rank_num = ranks.size();
+  const int64_t relative_index = (current_index - root_index + rank_num) % rank_num;
+  const size_t size = elem_cnt * GetSizeOfDataType(dtype);
+  std::vector<char> recv_buffer(size);
+  int64_t token_id = 0;
+  for (int64_t mask = 1; mask < rank_num; mask <<= 1, ++token_id) {
+    if (relative_index & mask) {
+      const int64_t parent = ranks.at((relative_index - mask + root_index) % rank_num);
+      JUST(transfers->Send(token_id, parent, buffer, size));
+      JUST(transfers->WaitAll());
+      break;
+    }
+    if (relative_index + mask < rank_num) {
+      const int64_t child = ranks.at((relative_index + mask + root_index) % rank_num);
+      JUST(transfers->Recv(token_id, child, recv_buffer.data(), size));
+      JUST(transfers->WaitAll());
+      JUST(ReduceInplace(recv_buffer.data(), buffer, elem_cnt, dtype, reduce_type));
+    }
+  }
+  return Maybe<void>::Ok();
+}
+
+// Messages of fewer than `ring_threshold` bytes use latency optimal algorithms, others use
+// bandwidth optimal rings split into chunks of `chunk_byte_size` bytes.
+
+template<typename Transfers>
+Maybe<void> AllReduceInRanks(const std::vector<int64_t>& ranks, int64_t current_index,
+                             const void* in, void* out, size_t elem_cnt, DataType dtype,
+                             ReduceType reduce_type, int64_t ring_threshold,
+                             int64_t chunk_byte_size) {
+  const size_t size = elem_cnt * GetSizeOfDataType(dtype);
+  if (out != in) { std::memcpy(out, in, size); }
+  if (ranks.size() == 1 || elem_cnt == 0) { return Maybe<void>::Ok(); }
+  char* buffer = static_cast<char*>(out);
+  if (size < ring_threshold) {
+    Transfers transfers(RecursiveDoublingAllReduceTokenNum(ranks.size()));
+    JUST(RecursiveDoublingAllReduce(ranks, current_index, buffer, elem_cnt, dtype, reduce_type,
+                                    &transfers));
+  } else {
+    Ring ring(ranks, current_index, elem_cnt, GetSizeOfDataType(dtype), chunk_byte_size);
+    Transfers transfers(ring.token_num() * 2);
+    JUST(RingReduceScatter(ring, 0, buffer, dtype, reduce_type, 0, &transfers));
+    JUST(RingAllGather(ring, 1, buffer, ring.token_num(), &transfers));
+  }
+  return Maybe<void>::Ok();
+}
+
+template<typename Transfers>
+Maybe<void> ReduceScatterInRanks(const std::vector<int64_t>& ranks, int64_t current_index,
+                                 const void* in, void* out, size_t elem_cnt, DataType dtype,
+                                 ReduceType reduce_type, int64_t ring_threshold,
+                                 int64_t chunk_byte_size) {
+  const size_t block_size = elem_cnt * GetSizeOfDataType(dtype);
+  if (ranks.size() == 1 || elem_cnt == 0) {
+    if (out != in) { std::memcpy(out, in, block_size); }
+    return Maybe<void>::Ok();
+  }
+  std::vector<char> buffer(static_cast<const char*>(in),
+                           static_cast<const char*>(in) + block_size * ranks.size());
+  if (buffer.size() < ring_threshold) {
+    Transfers transfers(RecursiveDoublingAllReduceTokenNum(ranks.size()));
+    JUST(RecursiveDoublingAllReduce(ranks, current_index, buffer.data(), elem_cnt * ranks.size(),
+                                    dtype, reduce_type, &transfers));
+  } else {
+    Ring ring(ranks, current_index, elem_cnt * ranks.size(), GetSizeOfDataType(dtype),
+              chunk_byte_size);
+    Transfers transfers(ring.token_num());
+    JUST(RingReduceScatter(ring, -1, buffer.data(), dtype, reduce_type, 0, &transfers));
+  }
+  std::memcpy(out, buffer.data() + current_index * block_size, block_size);
+  return Maybe<void>::Ok();
+}
+
+template<typename Transfers>
+Maybe<void> AllGatherInRanks(const std::vector<int64_t>& ranks, int64_t current_index,
+                             const void* in, void* out, size_t elem_cnt, DataType dtype,
+                             int64_t ring_threshold, int64_t chunk_byte_size) {
+  const size_t block_size = elem_cnt * GetSizeOfDataType(dtype);
+  char* buffer = static_cast<char*>(out);
+  if (buffer + current_index * block_size != in) {
+    std::memcpy(buffer + current_index * block_size, in, block_size);
+  }
+  if (ranks.size() == 1 || elem_cnt == 0) { return Maybe<void>::Ok(); }
+  if (block_size * ranks.size() < ring_threshold && IsPowerOf2(ranks.size())) {
+    Transfers transfers(Log2Floor(ranks.size()));
+    JUST(RecursiveDoublingAllGather(ranks, current_index, buffer, block_size, &transfers));
+  } else {
+    Ring ring(ranks, current_index, elem_cnt * ranks.size(), GetSizeOfDataType(dtype),
+              chunk_byte_size);
+    Transfers transfers(ring.token_num());
+    JUST(RingAllGather(ring, 0, buffer, 0, &transfers));
+  }
+  return Maybe<void>::Ok();
+}
+
+// Only `out` of the rank of index `root_index` gets the result
+template<typename Transfers>
+Maybe<void> ReduceInRanks(const std::vector<int64_t>& ranks, int64_t current_index,
+                          int64_t root_index, const void* in, void* out, size_t elem_cnt,
+                          DataType dtype, ReduceType reduce_type, int64_t ring_threshold,
+                          int64_t chunk_byte_size) {
+  const size_t size = elem_cnt * GetSizeOfDataType(dtype);
+  if (out != in) { std::memcpy(out, in, size); }
+  if (ranks.size() == 1 || elem_cnt == 0) { return Maybe<void>::Ok(); }
+  char* buffer = static_cast<char*>(out);
+  if (size < ring_threshold) {
+    Transfers transfers(Log2Floor(ranks.size() - 1) + 1);
+    JUST(BinomialTreeReduce(ranks, current_index, root_index, buffer, elem_cnt, dtype, reduce_type,
+                            &transfers));
+  } else {
+    // reduce scatter along the ring, then each rank sends its reduced block to the root
+    Ring ring(ranks, current_index, elem_cnt, GetSizeOfDataType(dtype), chunk_byte_size);
+    // one more token for each rank sending its block to the root
+    Transfers transfers(ring.token_num() + ranks.size());
+    JUST(RingReduceScatter(ring, 0, buffer, dtype, reduce_type, 0, &transfers));
+    if (current_index == root_index) {
+      for (int64_t index = 0; index < ranks.size(); ++index) {
+        if (index == root_index) { continue; }
+        const int64_t block = ring.Block(index + 1);
+        JUST(transfers.Recv(ring.token_num() + index, ranks.at(index),
+                            buffer + ring.BlockByteOffset(block), ring.BlockByteSize(block)));
+      }
+    } else {
+      const int64_t block = ring.Block(current_index + 1);
+      JUST(transfers.Send(ring.token_num() + current_index, ranks.at(root_index),
+                          buffer + ring.BlockByteOffset(block), ring.BlockByteSize(block)));
+    }
+    JUST(transfers.WaitAll());
+  }
+  return Maybe<void>::Ok();
+}
+
+}  // namespace ccl
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_CCL_CPU_ALGORITHM_H_
@@ -0,0 +1,288 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <condition_variable>
+#include <map>
+#include <random>
+#include <thread>
+#include "oneflow/core/ccl/cpu_algorithm.h"
+
+namespace oneflow {
+
+namespace ccl {
+
+namespace {
+
+// Every rank is a thread of this process, a transfer is copied once both of its ends are posted
+class LoopbackNetwork final {
+ public:
+  // token, src rank and dst rank
+  using Key = std::tuple<int64_t, int64_t, int64_t>;
+
+  std::shared_ptr<bool> Post(bool is_send, const Key& key, void* buffer, size_t size) {
+    std::shared_ptr<bool> done = std::make_shared<bool>(false);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto* peer_ends = is_send ? &recvs_ : &sends_;
+    auto it = peer_ends->find(key);
+    if (it == peer_ends->end()) {
+      auto* ends = is_send ? &sends_ : &recvs_;
+      CHECK(ends->emplace(key, End{buffer, size, done}).second);
+      return done;
+    }
+    const End& peer = it->second;
+    CHECK_EQ(peer.size, size);
+    std::memcpy(is_send ? peer.buffer : buffer, is_send ? buffer : peer.buffer, size);
+    *peer.done = true;
+    *done = true;
+    peer_ends->erase(it);
+    cond_.notify_all();
+    return done;
+  }
+
+  void Wait(const std::shared_ptr<bool>& done) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [&done]() { return *done; });
+  }
+
+  bool Empty() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return sends_.empty() && recvs_.empty();
+  }
+
+ private:
+  struct End {
+    void* buffer;
+    size_t size;
+    std::shared_ptr<bool> done;
+  };
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::map<Key, End> sends_;
+  std::map<Key, End> recvs_;
+};
+
+LoopbackNetwork* GetLoopbackNetwork() {
+  static LoopbackNetwork network;
+  return &network;
+}
+
+thread_local int64_t current_rank = -1;
+// tokens are numbered by each rank like TransportToken::NewDataTransportToken() does
+thread_local int64_t next_token = 0;
+
+class LoopbackTransfers final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(LoopbackTransfers);
+  explicit LoopbackTransfers(int64_t token_num) : first_token_(next_token), token_num_(token_num) {
+    next_token += token_num;
+  }
+  ~LoopbackTransfers() = default;
+
+  Maybe<void> Send(int64_t token_id, int64_t rank, const void* buffer, size_t size) {
+    CHECK_GE_OR_RETURN(token_id, 0);
+    CHECK_LT_OR_RETURN(token_id, token_num_);
+    if (size == 0) { return Maybe<void>::Ok(); }
+    const LoopbackNetwork::Key key(first_token_ + token_id, current_rank, rank);
+    sends_.push_back(GetLoopbackNetwork()->Post(true, key, const_cast<void*>(buffer), size));
+    return Maybe<void>::Ok();
+  }
+
+  Maybe<void> Recv(int64_t token_id, int64_t rank, void* buffer, size_t size) {
+    CHECK_GE_OR_RETURN(token_id, 0);
+    CHECK_LT_OR_RETURN(token_id, token_num_);
+    if (size == 0) { return Maybe<void>::Ok(); }
+    const LoopbackNetwork::Key key(first_token_ + token_id, rank, current_rank);
+    CHECK_OR_RETURN(
+        token_id2recv_.emplace(token_id, GetLoopbackNetwork()->Post(false, key, buffer, size))
+            .second);
+    return Maybe<void>::Ok();
+  }
+
+  Maybe<void> WaitRecv(int64_t token_id) {
+    auto it = token_id2recv_.find(token_id);
+    if (it == token_id2recv_.end()) { return Maybe<void>::Ok(); }
+    GetLoopbackNetwork()->Wait(it->second);
+    token_id2recv_.erase(it);
+    return Maybe<void>::Ok();
+  }
+
+  Maybe<void> WaitAll() {
+    for (const auto& pair : token_id2recv_) { GetLoopbackNetwork()->Wait(pair.second); }
+    token_id2recv_.clear();
+    for (const auto& done : sends_) { GetLoopbackNetwork()->Wait(done); }
+    sends_.clear();
+    return Maybe<void>::Ok();
+  }
+
+ private:
+  int64_t first_token_;
+  int64_t token_num_;
+  std::vector<std::shared_ptr<bool>> sends_;
+  std::map<int64_t, std::shared_ptr<bool>> token_id2recv_;
+};
+
+// Ranks are listed in reverse, so that indices in `ranks` and rank ids differ
+std::vector<int64_t> ReversedRanks(int64_t rank_num) {
+  std::vector<int64_t> ranks(rank_num);
+  for (int64_t i = 0; i < rank_num; ++i) { ranks[i] = rank_num - 1 - i; }
+  return ranks;
+}
+
+void RunRanks(const std::vector<int64_t>& ranks,
+              const std::function<Maybe<void>(int64_t current_index)>& Run) {
+  std::vector<std::thread> threads;
+  for (int64_t i = 0; i < ranks.size(); ++i) {
+    threads.emplace_back([&ranks, &Run, i]() {
+      current_rank = ranks.at(i);
+      next_token = 0;
+      CHECK_JUST(Run(i));
+    });
+  }
+  for (std::thread& thread : threads) { thread.join(); }
+  ASSERT_TRUE(GetLoopbackNetwork()->Empty());
+}
+
+std::vector<std::vector<int64_t>> RandomInputs(int64_t rank_num, int64_t elem_cnt) {
+  std::mt19937 gen(rank_num * 1000 + elem_cnt);
+  std::uniform_int_distribution<int64_t> dist(-1000, 1000);
+  std::vector<std::vector<int64_t>> inputs(rank_num, std::vector<int64_t>(elem_cnt));
+  for (auto& input : inputs) {
+    for (int64_t& x : input) { x = dist(gen); }
+  }
+  return inputs;
+}
+
+int64_t ExpectedReduce(const std::vector<std::vector<int64_t>>& inputs, int64_t i,
+                       ReduceType reduce_type) {
+  int64_t ret = inputs.at(0).at(i);
+  for (int64_t r = 1; r < inputs.size(); ++r) {
+    ret = (reduce_type == kSum) ? ret + inputs.at(r).at(i) : std::max(ret, inputs.at(r).at(i));
+  }
+  return ret;
+}
+
+const int64_t kRankNums[] = {2, 3, 4, 5, 8};
+const int64_t kElemCnts[] = {1, 3, 17, 1000};
+
+// Ring thresholds and chunk sizes in bytes. The first one always takes the latency optimal
+// algorithms, the second one takes rings of many chunks and the last one rings of single chunks.
+const std::pair<int64_t, int64_t> kConfs[] = {{1 << 30, 64}, {0, 64}, {0, 1 << 20}};
+
+}  // namespace
+
+TEST(CpuCclAlgorithm, reduce_scatter) {
+  const DataType dtype = GetDataType<int64_t>::value;
+  for (int64_t rank_num : kRankNums) {
+    const std::vector<int64_t> ranks = ReversedRanks(rank_num);
+    for (int64_t elem_cnt : kElemCnts) {
+      const auto& inputs = RandomInputs(rank_num, elem_cnt * rank_num);
+      for (const auto& conf : kConfs) {
+        for (ReduceType reduce_type : {kSum, kMax}) {
+          std::vector<std::vector<int64_t>> outputs(rank_num, std::vector<int64_t>(elem_cnt));
+          RunRanks(ranks, [&](int64_t index) {
+            return ReduceScatterInRanks<LoopbackTransfers>(
+                ranks, index, inputs.at(index).data(), outputs.at(index).data(), elem_cnt, dtype,
+                reduce_type, conf.first, conf.second);
+          });
+          for (int64_t index = 0; index < rank_num; ++index) {
+            for (int64_t i = 0; i < elem_cnt; ++i) {
+              ASSERT_EQ(outputs.at(index).at(i),
+                        ExpectedReduce(inputs, index * elem_cnt + i, reduce_type))
+                  << "rank_num " << rank_num << " elem_cnt " << elem_cnt << " index " << index;
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST(CpuCclAlgorithm, all_gather) {
+  const DataType dtype = GetDataType<int64_t>::value;
+  for (int64_t rank_num : kRankNums) {
+    const std::vector<int64_t> ranks = ReversedRanks(rank_num);
+    for (int64_t elem_cnt : kElemCnts) {
+      const auto& inputs = RandomInputs(rank_num, elem_cnt);
+      for (const auto& conf : kConfs) {
+        std::vector<std::vector<int64_t>> outputs(rank_num,
+                                                  std::vector<int64_t>(elem_cnt * rank_num, -1));
+        RunRanks(ranks, [&](int64_t index) {
+          return AllGatherInRanks<LoopbackTransfers>(ranks, index, inputs.at(index).data(),
+                                                     outputs.at(index).data(), elem_cnt, dtype,
+                                                     conf.first, conf.second);
+        });
+        for (int64_t index = 0; index < rank_num; ++index) {
+          for (int64_t i = 0; i < elem_cnt * rank_num; ++i) {
+            ASSERT_EQ(outputs.at(index).at(i), inputs.at(i / elem_cnt).at(i % elem_cnt))
+                << "rank_num " << rank_num << " elem_cnt " << elem_cnt << " index " << index;
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST(CpuCclAlgorithm, all_reduce) {
+  const DataType dtype = GetDataType<int64_t>::value;
+  for (int64_t rank_num : kRankNums) {
+    const std::vector<int64_t> ranks = ReversedRanks(rank_num);
+    for (int64_t elem_cnt : kElemCnts) {
+      const auto& inputs = RandomInputs(rank_num, elem_cnt);
+      for (const auto& conf : kConfs) {
+        std::vector<std::vector<int64_t>> outputs(rank_num, std::vector<int64_t>(elem_cnt));
+        RunRanks(ranks, [&](int64_t index) {
+          return AllReduceInRanks<LoopbackTransfers>(ranks, index, inputs.at(index).data(),
+                                                     outputs.at(index).data(), elem_cnt, dtype,
+                                                     kSum, conf.first, conf.second);
+        });
+        for (int64_t index = 0; index < rank_num; ++index) {
+          for (int64_t i = 0; i < elem_cnt; ++i) {
+            ASSERT_EQ(outputs.at(index).at(i), ExpectedReduce(inputs, i, kSum))
+                << "rank_num " << rank_num << " elem_cnt " << elem_cnt << " index " << index;
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST(CpuCclAlgorithm, reduce) {
+  const DataType dtype = GetDataType<int64_t>::value;
+  for (int64_t rank_num : kRankNums) {
+    const std::vector<int64_t> ranks = ReversedRanks(rank_num);
+    for (int64_t elem_cnt : kElemCnts) {
+      const auto& inputs = RandomInputs(rank_num, elem_cnt);
+      for (const auto& conf : kConfs) {
+        for (int64_t root_index : {int64_t(0), rank_num - 1}) {
+          std::vector<std::vector<int64_t>> outputs(rank_num, std::vector<int64_t>(elem_cnt));
+          RunRanks(ranks, [&](int64_t index) {
+            return ReduceInRanks<LoopbackTransfers>(
+                ranks, index, root_index, inputs.at(index).data(), outputs.at(index).data(),
+                elem_cnt, dtype, kSum, conf.first, conf.second);
+          });
+          for (int64_t i = 0; i < elem_cnt; ++i) {
+            ASSERT_EQ(outputs.at(root_index).at(i), ExpectedReduce(inputs, i, kSum))
+                << "rank_num " << rank_num << " elem_cnt " << elem_cnt << " root " << root_index;
+          }
+        }
+      }
+    }
+  }
+}
+
+}  // namespace ccl
+
+}  // namespace oneflow
@@ -99,7 +99,7 @@ void EpollCommNet::SendActorMsg(int64_t dst_machine_id, const ActorMsg& actor_ms
   if (actor_msg.IsDataRegstMsgToConsumer()) {
     msg.actor_msg.set_comm_net_token(actor_msg.regst()->comm_net_token());
   }
-  GetSocketHelper(dst_machine_id)->AsyncWrite(msg);
+  GetCtrlSocketHelper(dst_machine_id)->AsyncWrite(msg);
 }
 
 void EpollCommNet::SendTransportMsg(int64_t dst_machine_id, const TransportMsg& transport_msg) {
@@ -110,7 +110,43 @@ void EpollCommNet::SendTransportMsg(int64_t dst_machine_id, const TransportMsg&
 }
 
 void EpollCommNet::SendSocketMsg(int64_t dst_machine_id, const SocketMsg& msg) {
-  GetSocketHelper(dst_machine_id)->AsyncWrite(msg);
+  if (msg.msg_type == SocketMsgType::kRequestRead) {
+    SendRequestReadMsg(dst_machine_id, msg);
+  } else {
+    GetCtrlSocketHelper(dst_machine_id)->AsyncWrite(msg);
+  }
+}
+
+void EpollCommNet::SendRequestReadMsg(int64_t dst_machine_id, const SocketMsg& msg) {
+  auto src_mem_desc = static_cast<const SocketMemDesc*>(msg.request_read_msg.src_token);
+  const int64_t byte_size = src_mem_desc->byte_size;
+  const int64_t stripe_num =
+      GetRequestReadStripeNum(byte_size, min_stripe_bytes_, data_socket_num_);
+  // consecutive bodies start on different data sockets to spread small bodies too
+  const int64_t first_socket_idx =
+      machine_id2data_socket_cursor_.at(dst_machine_id).fetch_add(stripe_num) % data_socket_num_;
+  FOR_RANGE(int64_t, stripe_id, 0, stripe_num) {
+    SocketMsg stripe_msg = msg;
+    SetRequestReadStripe(byte_size, stripe_id, stripe_num, &stripe_msg.request_read_msg);
+    GetDataSocketHelper(dst_machine_id, (first_socket_idx + stripe_id) % data_socket_num_)
+        ->AsyncWrite(stripe_msg);
+  }
+}
+
+void EpollCommNet::ReadStripeDone(void* read_id, int64_t stripe_num) {
+  CHECK_GE(stripe_num, 1);
+  if (stripe_num > 1) {
+    std::unique_lock<std::mutex> lck(read_id2undone_stripe_num_mtx_);
+    auto it = read_id2undone_stripe_num_.find(read_id);
+    if (it == read_id2undone_stripe_num_.end()) {
+      CHECK(read_id2undone_stripe_num_.emplace(read_id, stripe_num - 1).second);
+      return;
+    }
+    it->second -= 1;
+    if (it->second > 0) { return; }
+    read_id2undone_stripe_num_.erase(it);
+  }
+  ReadDone(read_id);
 }
 
 SocketMemDesc* EpollCommNet::NewMemDesc(void* ptr, size_t byte_size) {
@@ -121,6 +157,10 @@ SocketMemDesc* EpollCommNet::NewMemDesc(void* ptr, size_t byte_size) {
 }
 
 EpollCommNet::EpollCommNet() : CommNetIf() {
+  data_socket_num_ = ParseIntegerFromEnv("ONEFLOW_COMM_NET_EPOLL_DATA_SOCKET_NUM", 1);
+  CHECK_GE(data_socket_num_, 1);
+  min_stripe_bytes_ = ParseIntegerFromEnv("ONEFLOW_COMM_NET_EPOLL_MIN_STRIPE_BYTES", 1 << 20);
+  CHECK_GE(min_stripe_bytes_, 1);
   pollers_.resize(Global<ResourceDesc, ForSession>::Get()->CommNetWorkerNum(), nullptr);
   for (size_t i = 0; i < pollers_.size(); ++i) { pollers_[i] = new IOEventPoller; }
   InitSockets();
@@ -131,7 +171,9 @@ void EpollCommNet::InitSockets() {
   int64_t this_machine_id = GlobalProcessCtx::Rank();
   auto this_machine = Global<ResourceDesc, ForSession>::Get()->machine(this_machine_id);
   int64_t total_machine_num = Global<ResourceDesc, ForSession>::Get()->process_ranks().size();
-  machine_id2sockfd_.assign(total_machine_num, -1);
+  machine_id2ctrl_sockfd_.assign(total_machine_num, -1);
+  machine_id2data_sockfds_.assign(total_machine_num, std::vector<int>(data_socket_num_, -1));
+  machine_id2data_socket_cursor_ = std::vector<std::atomic<int64_t>>(total_machine_num);
   sockfd2helper_.clear();
   size_t poller_idx = 0;
   auto NewSocketHelper = [&](int sockfd) {
@@ -139,6 +181,20 @@ void EpollCommNet::InitSockets() {
     poller_idx = (poller_idx + 1) % pollers_.size();
     return new SocketHelper(sockfd, poller);
   };
+  // socket 0 of a peer is the ctrl socket, socket i > 0 is data socket i - 1
+  const int64_t socket_num_per_peer = data_socket_num_ + 1;
+  auto SetPeerSocket = [&](int64_t peer_id, int64_t socket_idx, int sockfd) {
+    const int val = 1;
+    PCHECK(setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, (char*)&val, sizeof(int)) == 0);
+    CHECK(sockfd2helper_.emplace(sockfd, NewSocketHelper(sockfd)).second);
+    if (socket_idx == 0) {
+      CHECK_EQ(machine_id2ctrl_sockfd_.at(peer_id), -1);
+      machine_id2ctrl_sockfd_.at(peer_id) = sockfd;
+    } else {
+      CHECK_EQ(machine_id2data_sockfds_.at(peer_id).at(socket_idx - 1), -1);
+      machine_id2data_sockfds_.at(peer_id).at(socket_idx - 1) = sockfd;
+    }
+  };
 
   // listen
   int listen_sockfd = socket(AF_INET, SOCK_STREAM, 0);
@@ -150,7 +206,8 @@ void EpollCommNet::InitSockets() {
       this_listen_port = Global<EnvDesc>::Get()->data_port();
     }
   }
-  CHECK_EQ(SockListen(listen_sockfd, &this_listen_port, total_machine_num), 0);
+  CHECK_EQ(SockListen(listen_sockfd, &this_listen_port, total_machine_num * socket_num_per_peer),
+           0);
   CHECK_NE(this_listen_port, 0);
   PushPort(this_machine_id, this_listen_port);
   int32_t src_machine_count = 0;
@@ -164,42 +221,51 @@ void EpollCommNet::InitSockets() {
     uint16_t peer_port = PullPort(peer_id);
     auto peer_machine = Global<ResourceDesc, ForSession>::Get()->machine(peer_id);
     sockaddr_in peer_sockaddr = GetSockAddr(peer_machine.addr(), peer_port);
-    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    const int val = 1;
-    PCHECK(setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, (char*)&val, sizeof(int)) == 0);
-    PCHECK(connect(sockfd, reinterpret_cast<sockaddr*>(&peer_sockaddr), sizeof(peer_sockaddr))
-           == 0);
-    ssize_t n = write(sockfd, &this_machine_id, sizeof(int64_t));
-    PCHECK(n == sizeof(int64_t));
-    CHECK(sockfd2helper_.emplace(sockfd, NewSocketHelper(sockfd)).second);
-    machine_id2sockfd_[peer_id] = sockfd;
+    FOR_RANGE(int64_t, socket_idx, 0, socket_num_per_peer) {
+      int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+      PCHECK(connect(sockfd, reinterpret_cast<sockaddr*>(&peer_sockaddr), sizeof(peer_sockaddr))
+             == 0);
+      const int64_t handshake[3] = {this_machine_id, socket_idx, socket_num_per_peer};
+      ssize_t n = write(sockfd, handshake, sizeof(handshake));
+      PCHECK(n == sizeof(handshake));
+      SetPeerSocket(peer_id, socket_idx, sockfd);
+    }
   }
 
   // accept
-  HashSet<int64_t> processed_ranks;
-  FOR_RANGE(int32_t, idx, 0, src_machine_count) {
+  FOR_RANGE(int32_t, idx, 0, src_machine_count * socket_num_per_peer) {
     sockaddr_in peer_sockaddr;
     socklen_t len = sizeof(peer_sockaddr);
     int sockfd = accept(listen_sockfd, reinterpret_cast<sockaddr*>(&peer_sockaddr), &len);
     PCHECK(sockfd != -1);
-    int64_t peer_rank;
-    ssize_t n = read(sockfd, &peer_rank, sizeof(int64_t));
-    PCHECK(n == sizeof(int64_t));
-    CHECK(sockfd2helper_.emplace(sockfd, NewSocketHelper(sockfd)).second);
-    CHECK(processed_ranks.emplace(peer_rank).second);
-    machine_id2sockfd_[peer_rank] = sockfd;
+    int64_t handshake[3];
+    ssize_t n = read(sockfd, handshake, sizeof(handshake));
+    PCHECK(n == sizeof(handshake));
+    CHECK_EQ(handshake[2], socket_num_per_peer)
+        << "ONEFLOW_COMM_NET_EPOLL_DATA_SOCKET_NUM differs from machine " << handshake[0];
+    SetPeerSocket(handshake[0], handshake[1], sockfd);
   }
   PCHECK(close(listen_sockfd) == 0);
   ClearPort(this_machine_id);
 
   // useful log
   FOR_RANGE(int64_t, machine_id, 0, total_machine_num) {
-    LOG(INFO) << "machine " << machine_id << " sockfd " << machine_id2sockfd_[machine_id];
+    std::string data_sockfds;
+    for (int sockfd : machine_id2data_sockfds_[machine_id]) {
+      data_sockfds += " " + std::to_string(sockfd);
+    }
+    LOG(INFO) << "machine " << machine_id << " ctrl sockfd " << machine_id2ctrl_sockfd_[machine_id]
+              << " data sockfds" << data_sockfds;
   }
 }
 
-SocketHelper* EpollCommNet::GetSocketHelper(int64_t machine_id) {
-  int sockfd = machine_id2sockfd_.at(machine_id);
+SocketHelper* EpollCommNet::GetCtrlSocketHelper(int64_t machine_id) {
+  int sockfd = machine_id2ctrl_sockfd_.at(machine_id);
+  return sockfd2helper_.at(sockfd);
+}
+
+SocketHelper* EpollCommNet::GetDataSocketHelper(int64_t machine_id, int64_t data_socket_idx) {
+  int sockfd = machine_id2data_sockfds_.at(machine_id).at(data_socket_idx);
   return sockfd2helper_.at(sockfd);
 }
 
@@ -210,7 +276,7 @@ void EpollCommNet::DoRead(void* read_id, int64_t src_machine_id, void* src_token
   msg.request_write_msg.dst_machine_id = GlobalProcessCtx::Rank();
   msg.request_write_msg.dst_token = dst_token;
   msg.request_write_msg.read_id = read_id;
-  GetSocketHelper(src_machine_id)->AsyncWrite(msg);
+  GetCtrlSocketHelper(src_machine_id)->AsyncWrite(msg);
 }
 
 }  // namespace oneflow
@@ -32,6 +32,9 @@ class EpollCommNet final : public CommNetIf<SocketMemDesc> {
   void SendActorMsg(int64_t dst_machine_id, const ActorMsg& msg) override;
   void SendSocketMsg(int64_t dst_machine_id, const SocketMsg& msg);
   void SendTransportMsg(int64_t dst_machine_id, const TransportMsg& msg);
+  // called by the socket receiving a RequestRead body, the read is done after all of its
+  // stripe_num stripes are received
+  void ReadStripeDone(void* read_id, int64_t stripe_num);
 
  private:
   SocketMemDesc* NewMemDesc(void* ptr, size_t byte_size) override;
@@ -39,12 +42,22 @@ class EpollCommNet final : public CommNetIf<SocketMemDesc> {
   friend class Global<EpollCommNet>;
   EpollCommNet();
   void InitSockets();
-  SocketHelper* GetSocketHelper(int64_t machine_id);
+  SocketHelper* GetCtrlSocketHelper(int64_t machine_id);
+  SocketHelper* GetDataSocketHelper(int64_t machine_id, int64_t data_socket_idx);
+  void SendRequestReadMsg(int64_t dst_machine_id, const SocketMsg& msg);
   void DoRead(void* read_id, int64_t src_machine_id, void* src_token, void* dst_token) override;
 
   std::vector<IOEventPoller*> pollers_;
-  std::vector<int> machine_id2sockfd_;
+  // every peer is connected by one ctrl socket for small msgs and data_socket_num_ data sockets
+  // for RequestRead bodies, so a large body never delays actor msgs
+  int64_t data_socket_num_;
+  int64_t min_stripe_bytes_;
+  std::vector<int> machine_id2ctrl_sockfd_;
+  std::vector<std::vector<int>> machine_id2data_sockfds_;
+  std::vector<std::atomic<int64_t>> machine_id2data_socket_cursor_;
   HashMap<int, SocketHelper*> sockfd2helper_;
+  std::mutex read_id2undone_stripe_num_mtx_;
+  HashMap<void*, int64_t> read_id2undone_stripe_num_;
 };
 
 }  // namespace oneflow
@@ -17,6 +17,7 @@ limitations under the License.
 
 #include "oneflow/core/comm_network/epoll/io_event_poller.h"
 #include <sys/eventfd.h>
+#include <cstring>
 
 namespace oneflow {
 
@@ -92,8 +93,18 @@ void IOEventPoller::EpollLoop() {
     const epoll_event* cur_event = ep_events_;
     for (int event_idx = 0; event_idx < event_num; ++event_idx, ++cur_event) {
       auto io_handler = static_cast<IOHandler*>(cur_event->data.ptr);
-      PCHECK(!(cur_event->events & EPOLLERR)) << "fd: " << io_handler->fd;
       if (io_handler->fd == break_epoll_loop_fd_) { return; }
+      if (cur_event->events & EPOLLERR) {
+        // MSG_ZEROCOPY completions on the socket error queue raise EPOLLERR without a pending
+        // socket error, the write handler reaps them
+        int sock_err = 0;
+        socklen_t sock_err_len = sizeof(sock_err);
+        PCHECK(getsockopt(io_handler->fd, SOL_SOCKET, SO_ERROR, &sock_err, &sock_err_len) == 0)
+            << "fd: " << io_handler->fd;
+        CHECK_EQ(sock_err, 0) << "fd: " << io_handler->fd << " " << std::strerror(sock_err);
+        CHECK(io_handler->write_handler) << "fd: " << io_handler->fd;
+        io_handler->write_handler();
+      }
       if (cur_event->events & EPOLLIN) {
         if (cur_event->events & EPOLLRDHUP) {
           LOG(FATAL) << "fd " << io_handler->fd << " closed by peer";
@@ -54,10 +54,15 @@ struct RequestWriteMsg {
   void* read_id;
 };
 
+// a body larger than the stripe size is split into stripe_num RequestReadMsgs sent over different
+// data sockets, each carries [offset, offset + byte_size) of the registered memory
 struct RequestReadMsg {
   void* src_token;
   void* dst_token;
   void* read_id;
+  int64_t offset;
+  int64_t byte_size;
+  int64_t stripe_num;
 };
 
 struct SocketMsg {
@@ -69,6 +74,18 @@ struct SocketMsg {
   };
 };
 
+inline int64_t GetRequestReadStripeNum(int64_t byte_size, int64_t min_stripe_bytes,
+                                       int64_t max_stripe_num) {
+  return std::max<int64_t>(std::min<int64_t>(byte_size / min_stripe_bytes, max_stripe_num), 1);
+}
+
+inline void SetRequestReadStripe(int64_t byte_size, int64_t stripe_id, int64_t stripe_num,
+                                 RequestReadMsg* msg) {
+  msg->offset = byte_size * stripe_id / stripe_num;
+  msg->byte_size = byte_size * (stripe_id + 1) / stripe_num - msg->offset;
+  msg->stripe_num = stripe_num;
+}
+
 using CallBackList = std::list<std::function<void()>>;
 
 }  // namespace oneflow
@@ -83,7 +83,8 @@ void SocketReadHelper::SetStatusWhenMsgHeadDone() {
 
 void SocketReadHelper::SetStatusWhenMsgBodyDone() {
   if (cur_msg_.msg_type == SocketMsgType::kRequestRead) {
-    Global<EpollCommNet>::Get()->ReadDone(cur_msg_.request_read_msg.read_id);
+    Global<EpollCommNet>::Get()->ReadStripeDone(cur_msg_.request_read_msg.read_id,
+                                                cur_msg_.request_read_msg.stripe_num);
   }
   SwitchToMsgHeadReadHandle();
 }
@@ -94,6 +95,10 @@ void SocketReadHelper::SetStatusWhenRequestWriteMsgHeadDone() {
   msg_to_send.request_read_msg.src_token = cur_msg_.request_write_msg.src_token;
   msg_to_send.request_read_msg.dst_token = cur_msg_.request_write_msg.dst_token;
   msg_to_send.request_read_msg.read_id = cur_msg_.request_write_msg.read_id;
+  // the stripes are set up by EpollCommNet::SendSocketMsg
+  msg_to_send.request_read_msg.offset = 0;
+  msg_to_send.request_read_msg.byte_size = 0;
+  msg_to_send.request_read_msg.stripe_num = 0;
   Global<EpollCommNet>::Get()->SendSocketMsg(cur_msg_.request_write_msg.dst_machine_id,
                                              msg_to_send);
   SwitchToMsgHeadReadHandle();
@@ -101,8 +106,10 @@ void SocketReadHelper::SetStatusWhenRequestWriteMsgHeadDone() {
 
 void SocketReadHelper::SetStatusWhenRequestReadMsgHeadDone() {
   auto mem_desc = static_cast<const SocketMemDesc*>(cur_msg_.request_read_msg.dst_token);
-  read_ptr_ = reinterpret_cast<char*>(mem_desc->mem_ptr);
-  read_size_ = mem_desc->byte_size;
+  CHECK_LE(cur_msg_.request_read_msg.offset + cur_msg_.request_read_msg.byte_size,
+           mem_desc->byte_size);
+  read_ptr_ = reinterpret_cast<char*>(mem_desc->mem_ptr) + cur_msg_.request_read_msg.offset;
+  read_size_ = cur_msg_.request_read_msg.byte_size;
   cur_read_handle_ = &SocketReadHelper::MsgBodyReadHandle;
 }
 
@@ -18,11 +18,28 @@ limitations under the License.
 #include "oneflow/core/comm_network/epoll/socket_write_helper.h"
 #include "oneflow/core/comm_network/epoll/socket_memory_desc.h"
 
+#include <netinet/in.h>
 #include <sys/eventfd.h>
+#include <sys/socket.h>
+
+// MSG_ZEROCOPY needs linux 4.14 headers and glibc 2.27, without them bodies are always copied
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#define OF_EPOLL_ZERO_COPY
+#include <linux/errqueue.h>
+#endif
 
 namespace oneflow {
 
+namespace {
+
+constexpr size_t kMaxBatchMsgNum = 64;
+
+}  // namespace
+
 SocketWriteHelper::~SocketWriteHelper() {
+  VLOG(2) << "sockfd " << sockfd_ << " wrote " << msg_cnt_ << " msgs in " << syscall_cnt_
+          << " syscalls, zero copy sends " << zero_copy_send_cnt_ << " done "
+          << zero_copy_done_cnt_ << " copied " << zero_copy_copied_cnt_;
   delete cur_msg_queue_;
   cur_msg_queue_ = nullptr;
   {
@@ -40,9 +57,31 @@ SocketWriteHelper::SocketWriteHelper(int sockfd, IOEventPoller* poller) {
                                    std::bind(&SocketWriteHelper::ProcessQueueNotEmptyEvent, this));
   cur_msg_queue_ = new std::queue<SocketMsg>;
   pending_msg_queue_ = new std::queue<SocketMsg>;
-  cur_write_handle_ = &SocketWriteHelper::InitMsgWriteHandle;
-  write_ptr_ = nullptr;
-  write_size_ = 0;
+  // header iovecs point into batch_msgs_, it must never reallocate
+  batch_msgs_.reserve(kMaxBatchMsgNum);
+  batch_iovs_.reserve(kMaxBatchMsgNum * 2);
+  batch_iov_idx_ = 0;
+  is_zero_copy_batch_ = false;
+  zero_copy_min_bytes_ = ParseIntegerFromEnv("ONEFLOW_COMM_NET_EPOLL_ZERO_COPY_MIN_BYTES", 0);
+  if (zero_copy_min_bytes_ > 0) {
+#ifdef OF_EPOLL_ZERO_COPY
+    const int val = 1;
+    if (setsockopt(sockfd_, SOL_SOCKET, SO_ZEROCOPY, &val, sizeof(val)) != 0) {
+      PLOG(WARNING) << "SO_ZEROCOPY unsupported on sockfd " << sockfd_;
+      zero_copy_min_bytes_ = 0;
+    }
+#else
+    LOG(WARNING) << "SO_ZEROCOPY unsupported by this build";
+    zero_copy_min_bytes_ = 0;
+#endif
+  }
+  zero_copy_body_.iov_base = nullptr;
+  zero_copy_body_.iov_len = 0;
+  msg_cnt_ = 0;
+  syscall_cnt_ = 0;
+  zero_copy_send_cnt_ = 0;
+  zero_copy_done_cnt_ = 0;
+  zero_copy_copied_cnt_ = 0;
 }
 
 void SocketWriteHelper::AsyncWrite(const SocketMsg& msg) {
@@ -67,81 +106,141 @@ void SocketWriteHelper::ProcessQueueNotEmptyEvent() {
 }
 
 void SocketWriteHelper::WriteUntilMsgQueueEmptyOrSocketNotWriteable() {
-  while ((this->*cur_write_handle_)()) {}
-}
-
-bool SocketWriteHelper::InitMsgWriteHandle() {
-  if (cur_msg_queue_->empty()) {
-    {
-      std::unique_lock<std::mutex> lck(pending_msg_queue_mtx_);
-      std::swap(cur_msg_queue_, pending_msg_queue_);
-    }
-    if (cur_msg_queue_->empty()) { return false; }
+  if (zero_copy_min_bytes_ > 0) { ReapZeroCopyCompletions(); }
+  while (true) {
+    if (batch_iov_idx_ == batch_iovs_.size() && !InitBatch()) { return; }
+    if (!WriteBatch()) { return; }
   }
-  cur_msg_ = cur_msg_queue_->front();
-  cur_msg_queue_->pop();
-  write_ptr_ = reinterpret_cast<const char*>(&cur_msg_);
-  write_size_ = sizeof(cur_msg_);
-  cur_write_handle_ = &SocketWriteHelper::MsgHeadWriteHandle;
-  return true;
-}
-
-bool SocketWriteHelper::MsgHeadWriteHandle() {
-  return DoCurWrite(&SocketWriteHelper::SetStatusWhenMsgHeadDone);
-}
-
-bool SocketWriteHelper::MsgBodyWriteHandle() {
-  return DoCurWrite(&SocketWriteHelper::SetStatusWhenMsgBodyDone);
 }
 
-bool SocketWriteHelper::DoCurWrite(void (SocketWriteHelper::*set_cur_write_done)()) {
-  ssize_t n = write(sockfd_, write_ptr_, write_size_);
-  if (n == write_size_) {
-    (this->*set_cur_write_done)();
+bool SocketWriteHelper::InitBatch() {
+  batch_msgs_.clear();
+  batch_iovs_.clear();
+  batch_iov_idx_ = 0;
+  is_zero_copy_batch_ = false;
+  if (zero_copy_body_.iov_len > 0) {
+    batch_iovs_.push_back(zero_copy_body_);
+    zero_copy_body_.iov_len = 0;
+    is_zero_copy_batch_ = true;
     return true;
-  } else if (n >= 0) {
-    write_ptr_ += n;
-    write_size_ -= n;
-    return true;
-  } else {
-    CHECK_EQ(n, -1);
-    PCHECK(errno == EAGAIN || errno == EWOULDBLOCK);
-    return false;
   }
-}
-
-void SocketWriteHelper::SetStatusWhenMsgHeadDone() {
-  switch (cur_msg_.msg_type) {
-#define MAKE_ENTRY(x, y) \
-  case SocketMsgType::k##x: return SetStatusWhen##x##MsgHeadDone();
-    OF_PP_FOR_EACH_TUPLE(MAKE_ENTRY, SOCKET_MSG_TYPE_SEQ);
-#undef MAKE_ENTRY
-    default: UNIMPLEMENTED();
+  while (batch_msgs_.size() < kMaxBatchMsgNum && zero_copy_body_.iov_len == 0) {
+    if (cur_msg_queue_->empty()) {
+      {
+        std::unique_lock<std::mutex> lck(pending_msg_queue_mtx_);
+        std::swap(cur_msg_queue_, pending_msg_queue_);
+      }
+      if (cur_msg_queue_->empty()) { break; }
+    }
+    AppendMsgToBatch(cur_msg_queue_->front());
+    cur_msg_queue_->pop();
+  }
+  return !batch_iovs_.empty();
+}
+
+void SocketWriteHelper::AppendMsgToBatch(const SocketMsg& msg) {
+  batch_msgs_.push_back(msg);
+  msg_cnt_ += 1;
+  iovec head;
+  head.iov_base = &batch_msgs_.back();
+  head.iov_len = sizeof(SocketMsg);
+  batch_iovs_.push_back(head);
+  if (msg.msg_type == SocketMsgType::kRequestRead) {
+    const void* src_token = msg.request_read_msg.src_token;
+    auto src_mem_desc = static_cast<const SocketMemDesc*>(src_token);
+    CHECK_LE(msg.request_read_msg.offset + msg.request_read_msg.byte_size,
+             src_mem_desc->byte_size);
+    iovec body;
+    body.iov_base = static_cast<char*>(src_mem_desc->mem_ptr) + msg.request_read_msg.offset;
+    body.iov_len = msg.request_read_msg.byte_size;
+    if (zero_copy_min_bytes_ > 0 && body.iov_len >= zero_copy_min_bytes_) {
+      zero_copy_body_ = body;
+    } else {
+      batch_iovs_.push_back(body);
+    }
   }
 }
 
-void SocketWriteHelper::SetStatusWhenMsgBodyDone() {
-  cur_write_handle_ = &SocketWriteHelper::InitMsgWriteHandle;
-}
-
-void SocketWriteHelper::SetStatusWhenRequestWriteMsgHeadDone() {
-  cur_write_handle_ = &SocketWriteHelper::InitMsgWriteHandle;
-}
-
-void SocketWriteHelper::SetStatusWhenRequestReadMsgHeadDone() {
-  const void* src_token = cur_msg_.request_read_msg.src_token;
-  auto src_mem_desc = static_cast<const SocketMemDesc*>(src_token);
-  write_ptr_ = reinterpret_cast<const char*>(src_mem_desc->mem_ptr);
-  write_size_ = src_mem_desc->byte_size;
-  cur_write_handle_ = &SocketWriteHelper::MsgBodyWriteHandle;
-}
-
-void SocketWriteHelper::SetStatusWhenActorMsgHeadDone() {
-  cur_write_handle_ = &SocketWriteHelper::InitMsgWriteHandle;
+bool SocketWriteHelper::WriteBatch() {
+  while (batch_iov_idx_ < batch_iovs_.size()) {
+    const int iov_cnt =
+        static_cast<int>(std::min<size_t>(batch_iovs_.size() - batch_iov_idx_, IOV_MAX));
+    iovec* iov = batch_iovs_.data() + batch_iov_idx_;
+    ssize_t n = 0;
+#ifdef OF_EPOLL_ZERO_COPY
+    if (is_zero_copy_batch_) {
+      msghdr msg = {};
+      msg.msg_iov = iov;
+      msg.msg_iovlen = iov_cnt;
+      n = sendmsg(sockfd_, &msg, MSG_ZEROCOPY);
+    } else {
+      n = writev(sockfd_, iov, iov_cnt);
+    }
+#else
+    n = writev(sockfd_, iov, iov_cnt);
+#endif
+    syscall_cnt_ += 1;
+    if (n == -1) {
+      if (is_zero_copy_batch_ && errno == ENOBUFS) {
+        // out of optmem for pending notifications, send the rest by copy
+        ReapZeroCopyCompletions();
+        is_zero_copy_batch_ = false;
+        continue;
+      }
+      PCHECK(errno == EAGAIN || errno == EWOULDBLOCK);
+      return false;
+    }
+    CHECK_GE(n, 0);
+    if (is_zero_copy_batch_) { zero_copy_send_cnt_ += 1; }
+    size_t written = n;
+    while (written > 0) {
+      iovec* cur = &batch_iovs_.at(batch_iov_idx_);
+      if (written >= cur->iov_len) {
+        written -= cur->iov_len;
+        batch_iov_idx_ += 1;
+      } else {
+        cur->iov_base = static_cast<char*>(cur->iov_base) + written;
+        cur->iov_len -= written;
+        written = 0;
+      }
+    }
+    // skip empty bodies so that a batch is never left with only zero length iovecs
+    while (batch_iov_idx_ < batch_iovs_.size() && batch_iovs_.at(batch_iov_idx_).iov_len == 0) {
+      batch_iov_idx_ += 1;
+    }
+  }
+  return true;
 }
 
-void SocketWriteHelper::SetStatusWhenTransportMsgHeadDone() {
-  cur_write_handle_ = &SocketWriteHelper::InitMsgWriteHandle;
+// Completion notifications of MSG_ZEROCOPY sends are queued on the socket error queue, they are
+// only counted and dropped here so the queue does not grow. A body is register memory which the
+// sender does not touch before the receiver has read the whole of it.
+void SocketWriteHelper::ReapZeroCopyCompletions() {
+#ifdef OF_EPOLL_ZERO_COPY
+  while (true) {
+    char control[CMSG_SPACE(sizeof(sock_extended_err)) + CMSG_SPACE(sizeof(sockaddr_in6))];
+    msghdr msg = {};
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(sockfd_, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1) {
+      PCHECK(errno == EAGAIN || errno == EWOULDBLOCK);
+      return;
+    }
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      if (!((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR)
+            || (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))) {
+        continue;
+      }
+      const auto* err = reinterpret_cast<const sock_extended_err*>(CMSG_DATA(cmsg));
+      CHECK_EQ(err->ee_errno, 0);
+      if (err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) { continue; }
+      // [ee_info, ee_data] is the range of completed sends
+      const int64_t done_cnt = err->ee_data - err->ee_info + 1;
+      zero_copy_done_cnt_ += done_cnt;
+      if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) { zero_copy_copied_cnt_ += done_cnt; }
+    }
+  }
+#endif  // OF_EPOLL_ZERO_COPY
 }
 
 }  // namespace oneflow
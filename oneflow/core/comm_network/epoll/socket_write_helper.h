@@ -21,6 +21,8 @@ limitations under the License.
 
 #ifdef OF_PLATFORM_POSIX
 
+#include <sys/uio.h>
+
 namespace oneflow {
 
 class SocketWriteHelper final {
@@ -40,17 +42,12 @@ class SocketWriteHelper final {
   void ProcessQueueNotEmptyEvent();
 
   void WriteUntilMsgQueueEmptyOrSocketNotWriteable();
-  bool InitMsgWriteHandle();
-  bool MsgHeadWriteHandle();
-  bool MsgBodyWriteHandle();
-
-  bool DoCurWrite(void (SocketWriteHelper::*set_cur_write_done)());
-  void SetStatusWhenMsgHeadDone();
-  void SetStatusWhenMsgBodyDone();
-
-#define MAKE_ENTRY(x, y) void SetStatusWhen##x##MsgHeadDone();
-  OF_PP_FOR_EACH_TUPLE(MAKE_ENTRY, SOCKET_MSG_TYPE_SEQ);
-#undef MAKE_ENTRY
+  // return false if there is nothing to write
+  bool InitBatch();
+  void AppendMsgToBatch(const SocketMsg& msg);
+  // return false if the socket is not writeable
+  bool WriteBatch();
+  void ReapZeroCopyCompletions();
 
   int sockfd_;
   int queue_not_empty_fd_;
@@ -60,10 +57,22 @@ class SocketWriteHelper final {
   std::mutex pending_msg_queue_mtx_;
   std::queue<SocketMsg>* pending_msg_queue_;
 
-  SocketMsg cur_msg_;
-  bool (SocketWriteHelper::*cur_write_handle_)();
-  const char* write_ptr_;
-  size_t write_size_;
+  // queued msgs are coalesced into one batch of iovecs written by writev, a batch holds at most
+  // kMaxBatchMsgNum headers stored in batch_msgs_ and the bodies of RequestRead msgs
+  std::vector<SocketMsg> batch_msgs_;
+  std::vector<iovec> batch_iovs_;
+  size_t batch_iov_idx_;
+  bool is_zero_copy_batch_;
+  // a body of at least zero_copy_min_bytes_ ends the batch and is sent alone with MSG_ZEROCOPY,
+  // zero_copy_min_bytes_ == 0 disables MSG_ZEROCOPY
+  size_t zero_copy_min_bytes_;
+  iovec zero_copy_body_;
+
+  int64_t msg_cnt_;
+  int64_t syscall_cnt_;
+  int64_t zero_copy_send_cnt_;
+  int64_t zero_copy_done_cnt_;
+  int64_t zero_copy_copied_cnt_;
 };
 
 }  // namespace oneflow
@@ -0,0 +1,262 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifdef __linux__
+
+#include "oneflow/core/comm_network/epoll/socket_write_helper.h"
+#include "oneflow/core/comm_network/epoll/socket_memory_desc.h"
+
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+namespace oneflow {
+
+namespace {
+
+struct LoopbackSocketPair {
+  int send_fd;
+  int recv_fd;
+};
+
+LoopbackSocketPair ConnectLoopback(int listen_fd, const sockaddr_in& listen_addr) {
+  LoopbackSocketPair pair;
+  pair.send_fd = socket(AF_INET, SOCK_STREAM, 0);
+  PCHECK(pair.send_fd != -1);
+  PCHECK(connect(pair.send_fd, reinterpret_cast<const sockaddr*>(&listen_addr),
+                 sizeof(listen_addr))
+         == 0);
+  pair.recv_fd = accept(listen_fd, nullptr, nullptr);
+  PCHECK(pair.recv_fd != -1);
+  const int val = 1;
+  PCHECK(setsockopt(pair.send_fd, IPPROTO_TCP, TCP_NODELAY, &val, sizeof(val)) == 0);
+  PCHECK(setsockopt(pair.recv_fd, IPPROTO_TCP, TCP_NODELAY, &val, sizeof(val)) == 0);
+  return pair;
+}
+
+std::vector<LoopbackSocketPair> ConnectLoopback(int64_t num) {
+  int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  PCHECK(bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+  PCHECK(listen(listen_fd, num) == 0);
+  socklen_t addr_len = sizeof(addr);
+  PCHECK(getsockname(listen_fd, reinterpret_cast<sockaddr*>(&addr), &addr_len) == 0);
+  std::vector<LoopbackSocketPair> pairs;
+  FOR_RANGE(int64_t, i, 0, num) { pairs.push_back(ConnectLoopback(listen_fd, addr)); }
+  PCHECK(close(listen_fd) == 0);
+  return pairs;
+}
+
+void ReadFully(int fd, void* ptr, size_t size) {
+  char* cur = static_cast<char*>(ptr);
+  while (size > 0) {
+    ssize_t n = read(fd, cur, size);
+    PCHECK(n > 0);
+    cur += n;
+    size -= n;
+  }
+}
+
+void WriteFully(int fd, const void* ptr, size_t size) {
+  const char* cur = static_cast<const char*>(ptr);
+  while (size > 0) {
+    ssize_t n = write(fd, cur, size);
+    PCHECK(n > 0);
+    cur += n;
+    size -= n;
+  }
+}
+
+// The receiving process: bodies are read and dropped, actor msgs are echoed back on echo_fd and
+// a transport msg ends a socket. An ack is echoed after every socket is ended.
+void RunReceiver(const std::vector<int>& recv_fds, int echo_fd, size_t max_body_size) {
+  std::mutex echo_mtx;
+  std::vector<std::thread> threads;
+  for (int recv_fd : recv_fds) {
+    threads.emplace_back([recv_fd, echo_fd, max_body_size, &echo_mtx]() {
+      std::vector<char> body(max_body_size);
+      SocketMsg msg;
+      while (true) {
+        ReadFully(recv_fd, &msg, sizeof(msg));
+        if (msg.msg_type == SocketMsgType::kRequestRead) {
+          CHECK_LE(msg.request_read_msg.byte_size, max_body_size);
+          ReadFully(recv_fd, body.data(), msg.request_read_msg.byte_size);
+        } else if (msg.msg_type == SocketMsgType::kActor) {
+          std::unique_lock<std::mutex> lck(echo_mtx);
+          WriteFully(echo_fd, &msg, sizeof(msg));
+        } else {
+          break;
+        }
+      }
+    });
+  }
+  for (std::thread& thread : threads) { thread.join(); }
+  SocketMsg ack;
+  ack.msg_type = SocketMsgType::kTransport;
+  WriteFully(echo_fd, &ack, sizeof(ack));
+}
+
+struct PeerBenchmarkResult {
+  double gigabytes_per_second;
+  double median_latency_us;
+  double max_latency_us;
+};
+
+// Forks a receiving process connected by one ctrl socket (if separate_ctrl_socket) and
+// data_socket_num data sockets, then sends body_num striped bodies while ping-ponging ping_num
+// actor msgs over the ctrl socket, or over the first data socket without a separate one.
+PeerBenchmarkResult RunPeerBenchmark(int64_t data_socket_num, bool separate_ctrl_socket,
+                                     int64_t body_num, size_t body_size, int64_t ping_num) {
+  const int64_t socket_num = data_socket_num + (separate_ctrl_socket ? 1 : 0);
+  std::vector<LoopbackSocketPair> pairs = ConnectLoopback(socket_num + 1);
+  const LoopbackSocketPair echo_pair = pairs.back();
+  pairs.pop_back();
+  const int64_t min_stripe_bytes = 1 << 20;
+  const size_t max_body_size = body_size / GetRequestReadStripeNum(body_size, min_stripe_bytes,
+                                                                   data_socket_num)
+                               + data_socket_num;
+  pid_t pid = fork();
+  PCHECK(pid != -1);
+  if (pid == 0) {
+    for (const LoopbackSocketPair& pair : pairs) { PCHECK(close(pair.send_fd) == 0); }
+    PCHECK(close(echo_pair.recv_fd) == 0);
+    std::vector<int> recv_fds;
+    for (const LoopbackSocketPair& pair : pairs) { recv_fds.push_back(pair.recv_fd); }
+    RunReceiver(recv_fds, echo_pair.send_fd, max_body_size);
+    _exit(0);
+  }
+  for (const LoopbackSocketPair& pair : pairs) { PCHECK(close(pair.recv_fd) == 0); }
+  PCHECK(close(echo_pair.send_fd) == 0);
+
+  std::vector<std::unique_ptr<IOEventPoller>> pollers;
+  std::vector<std::unique_ptr<SocketWriteHelper>> helpers;
+  FOR_RANGE(int64_t, i, 0, socket_num) {
+    pollers.emplace_back(new IOEventPoller);
+    const int send_fd = pairs.at(i).send_fd;
+    SocketWriteHelper* helper = new SocketWriteHelper(send_fd, pollers.back().get());
+    helpers.emplace_back(helper);
+    pollers.back()->AddFd(
+        send_fd, []() {}, [helper]() { helper->NotifyMeSocketWriteable(); });
+    pollers.back()->Start();
+  }
+  SocketWriteHelper* ctrl_helper = helpers.front().get();
+  const int64_t first_data_helper_idx = separate_ctrl_socket ? 1 : 0;
+
+  std::vector<char> body(body_size);
+  SocketMemDesc body_mem_desc;
+  body_mem_desc.mem_ptr = body.data();
+  body_mem_desc.byte_size = body_size;
+  const auto start = std::chrono::steady_clock::now();
+  int64_t data_socket_cursor = 0;
+  FOR_RANGE(int64_t, body_id, 0, body_num) {
+    SocketMsg msg;
+    msg.msg_type = SocketMsgType::kRequestRead;
+    msg.request_read_msg.src_token = &body_mem_desc;
+    const int64_t stripe_num =
+        GetRequestReadStripeNum(body_size, min_stripe_bytes, data_socket_num);
+    FOR_RANGE(int64_t, stripe_id, 0, stripe_num) {
+      SetRequestReadStripe(body_size, stripe_id, stripe_num, &msg.request_read_msg);
+      const int64_t data_socket_idx = (data_socket_cursor + stripe_id) % data_socket_num;
+      helpers.at(first_data_helper_idx + data_socket_idx)->AsyncWrite(msg);
+    }
+    data_socket_cursor += stripe_num;
+  }
+  std::vector<double> latencies_us;
+  FOR_RANGE(int64_t, ping_id, 0, ping_num) {
+    SocketMsg ping;
+    ping.msg_type = SocketMsgType::kActor;
+    const auto ping_start = std::chrono::steady_clock::now();
+    ctrl_helper->AsyncWrite(ping);
+    SocketMsg pong;
+    ReadFully(echo_pair.recv_fd, &pong, sizeof(pong));
+    CHECK(pong.msg_type == SocketMsgType::kActor);
+    latencies_us.push_back(
+        std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - ping_start)
+            .count());
+  }
+  for (const auto& helper : helpers) {
+    SocketMsg end;
+    end.msg_type = SocketMsgType::kTransport;
+    helper->AsyncWrite(end);
+  }
+  SocketMsg ack;
+  ReadFully(echo_pair.recv_fd, &ack, sizeof(ack));
+  CHECK(ack.msg_type == SocketMsgType::kTransport);
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  int status = 0;
+  PCHECK(waitpid(pid, &status, 0) == pid);
+  CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  for (const auto& poller : pollers) { poller->Stop(); }
+  helpers.clear();
+  pollers.clear();
+  PCHECK(close(echo_pair.recv_fd) == 0);
+
+  PeerBenchmarkResult result;
+  result.gigabytes_per_second = body_num * body_size / seconds / 1e9;
+  std::sort(latencies_us.begin(), latencies_us.end());
+  result.median_latency_us = latencies_us.empty() ? 0 : latencies_us.at(latencies_us.size() / 2);
+  result.max_latency_us = latencies_us.empty() ? 0 : latencies_us.back();
+  return result;
+}
+
+}  // namespace
+
+TEST(SocketWriteHelper, request_read_stripe) {
+  RequestReadMsg msg;
+  ASSERT_EQ(GetRequestReadStripeNum(0, 1 << 20, 4), 1);
+  ASSERT_EQ(GetRequestReadStripeNum((1 << 20) * 3, 1 << 20, 4), 3);
+  ASSERT_EQ(GetRequestReadStripeNum((1 << 20) * 16, 1 << 20, 4), 4);
+  int64_t covered = 0;
+  FOR_RANGE(int64_t, stripe_id, 0, 3) {
+    SetRequestReadStripe(1000, stripe_id, 3, &msg);
+    ASSERT_EQ(msg.offset, covered);
+    ASSERT_EQ(msg.stripe_num, 3);
+    covered += msg.byte_size;
+  }
+  ASSERT_EQ(covered, 1000);
+}
+
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+TEST(SocketWriteHelper, zero_copy_two_process_loopback) {
+  // every stripe is at least 1MB, so all bodies take the MSG_ZEROCOPY path
+  PCHECK(setenv("ONEFLOW_COMM_NET_EPOLL_ZERO_COPY_MIN_BYTES", "1048576", 1) == 0);
+  const PeerBenchmarkResult result = RunPeerBenchmark(2, true, 4, 4 << 20, 4);
+  PCHECK(unsetenv("ONEFLOW_COMM_NET_EPOLL_ZERO_COPY_MIN_BYTES") == 0);
+  ASSERT_GT(result.gigabytes_per_second, 0);
+}
+#endif
+
+TEST(SocketWriteHelper, DISABLED_benchmark_two_process_loopback) {
+  const int64_t body_num = 32;
+  const size_t body_size = 16 << 20;
+  const int64_t ping_num = 200;
+  for (const int64_t data_socket_num : {1, 2, 4}) {
+    for (const bool separate_ctrl_socket : {false, true}) {
+      const PeerBenchmarkResult result =
+          RunPeerBenchmark(data_socket_num, separate_ctrl_socket, body_num, body_size, ping_num);
+      LOG(INFO) << "data sockets " << data_socket_num << (separate_ctrl_socket ? " + ctrl" : "")
+                << ": " << result.gigabytes_per_second << " GB/s, actor msg round trip median "
+                << result.median_latency_us << "us max " << result.max_latency_us << "us";
+    }
+  }
+}
+
+}  // namespace oneflow
+
+#endif  // __linux__
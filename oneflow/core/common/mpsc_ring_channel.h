@@ -0,0 +1,213 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_COMMON_MPSC_RING_CHANNEL_H_
+#define ONEFLOW_CORE_COMMON_MPSC_RING_CHANNEL_H_
+
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/common/channel.h"
+
+namespace oneflow {
+
+// MpscRingChannel is a multi-producer single-consumer Channel built on a bounded lock-free ring
+// (one sequence number per slot). Only one thread may call Receive().
+//
+// Send() never blocks: when the ring is full the item goes to a mutex-guarded overflow queue, and
+// until the consumer has taken the overflow queue all following items go there too, so items sent
+// by one thread are always received in order. Receive() spins spin_count rounds before it parks.
+template<typename T>
+class MpscRingChannel final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(MpscRingChannel);
+  MpscRingChannel(int64_t capacity_log2, int64_t spin_count);
+  ~MpscRingChannel() = default;
+
+  ChannelStatus Send(const T& item);
+  ChannelStatus Receive(T* item);
+  void Close();
+
+ private:
+  struct Slot {
+    std::atomic<uint64_t> seq;
+    T item;
+  };
+
+  bool TryPushRing(const T& item);
+  bool TryPopRing(T* item);
+  bool TryTakeOverflow();
+  bool HasItemForConsumer() const;
+  void NotifyConsumer();
+
+  const uint64_t mask_;
+  const int64_t spin_count_;
+  std::unique_ptr<Slot[]> slots_;
+  // tail_ written by producers and head_ written by the consumer get cache lines of their own
+  char pad0_[kCacheLineSize];
+  std::atomic<uint64_t> tail_;
+  char pad1_[kCacheLineSize - sizeof(std::atomic<uint64_t>)];
+  // only accessed by the consumer
+  uint64_t head_;
+  char pad2_[kCacheLineSize - sizeof(uint64_t)];
+  std::queue<T> consumer_queue_;
+
+  std::mutex overflow_mutex_;
+  std::queue<T> overflow_queue_;
+  std::atomic<bool> has_overflow_;
+
+  std::mutex sleep_mutex_;
+  std::condition_variable sleep_cond_;
+  std::atomic<bool> consumer_sleeping_;
+  std::atomic<bool> is_closed_;
+};
+
+namespace detail {
+
+inline void MpscRingChannelCpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#else
+  std::this_thread::yield();
+#endif
+}
+
+}  // namespace detail
+
+template<typename T>
+MpscRingChannel<T>::MpscRingChannel(int64_t capacity_log2, int64_t spin_count)
+    : mask_((uint64_t(1) << capacity_log2) - 1),
+      spin_count_(spin_count),
+      slots_(new Slot[mask_ + 1]),
+      tail_(0),
+      head_(0),
+      has_overflow_(false),
+      consumer_sleeping_(false),
+      is_closed_(false) {
+  FOR_RANGE(uint64_t, i, 0, mask_ + 1) { slots_[i].seq.store(i, std::memory_order_relaxed); }
+}
+
+template<typename T>
+ChannelStatus MpscRingChannel<T>::Send(const T& item) {
+  if (is_closed_.load(std::memory_order_acquire)) { return kChannelStatusErrorClosed; }
+  if (has_overflow_.load(std::memory_order_acquire) || !TryPushRing(item)) {
+    std::unique_lock<std::mutex> lock(overflow_mutex_);
+    overflow_queue_.push(item);
+    has_overflow_.store(true, std::memory_order_release);
+  }
+  NotifyConsumer();
+  return kChannelStatusSuccess;
+}
+
+template<typename T>
+ChannelStatus MpscRingChannel<T>::Receive(T* item) {
+  while (true) {
+    if (!consumer_queue_.empty()) {
+      *item = std::move(consumer_queue_.front());
+      consumer_queue_.pop();
+      return kChannelStatusSuccess;
+    }
+    FOR_RANGE(int64_t, i, 0, spin_count_ + 1) {
+      if (TryPopRing(item)) { return kChannelStatusSuccess; }
+      if (TryTakeOverflow()) { break; }
+      detail::MpscRingChannelCpuRelax();
+    }
+    if (!consumer_queue_.empty()) { continue; }
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    consumer_sleeping_.store(true, std::memory_order_relaxed);
+    // pairs with the fence in NotifyConsumer
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (HasItemForConsumer()) {
+      consumer_sleeping_.store(false, std::memory_order_relaxed);
+      continue;
+    }
+    if (is_closed_.load(std::memory_order_acquire)) {
+      consumer_sleeping_.store(false, std::memory_order_relaxed);
+      return kChannelStatusErrorClosed;
+    }
+    sleep_cond_.wait(lock, [this]() {
+      return !consumer_sleeping_.load(std::memory_order_relaxed)
+             || is_closed_.load(std::memory_order_acquire);
+    });
+    consumer_sleeping_.store(false, std::memory_order_relaxed);
+  }
+}
+
+template<typename T>
+void MpscRingChannel<T>::Close() {
+  std::unique_lock<std::mutex> lock(sleep_mutex_);
+  is_closed_.store(true, std::memory_order_release);
+  sleep_cond_.notify_all();
+}
+
+template<typename T>
+bool MpscRingChannel<T>::TryPushRing(const T& item) {
+  uint64_t pos = tail_.load(std::memory_order_relaxed);
+  Slot* slot = nullptr;
+  while (true) {
+    slot = &slots_[pos & mask_];
+    const uint64_t seq = slot->seq.load(std::memory_order_acquire);
+    const int64_t diff = static_cast<int64_t>(seq) - static_cast<int64_t>(pos);
+    if (diff == 0) {
+      if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = tail_.load(std::memory_order_relaxed);
+    }
+  }
+  slot->item = item;
+  slot->seq.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+template<typename T>
+bool MpscRingChannel<T>::TryPopRing(T* item) {
+  Slot* slot = &slots_[head_ & mask_];
+  if (slot->seq.load(std::memory_order_acquire) != head_ + 1) { return false; }
+  *item = std::move(slot->item);
+  slot->seq.store(head_ + mask_ + 1, std::memory_order_release);
+  head_ += 1;
+  return true;
+}
+
+template<typename T>
+bool MpscRingChannel<T>::TryTakeOverflow() {
+  if (!has_overflow_.load(std::memory_order_acquire)) { return false; }
+  // items of a producer in the ring are sent before its items in the overflow queue, so take the
+  // overflow queue only after all claimed slots are received
+  if (tail_.load(std::memory_order_acquire) != head_) { return false; }
+  std::unique_lock<std::mutex> lock(overflow_mutex_);
+  std::swap(consumer_queue_, overflow_queue_);
+  has_overflow_.store(false, std::memory_order_release);
+  return !consumer_queue_.empty();
+}
+
+template<typename T>
+bool MpscRingChannel<T>::HasItemForConsumer() const {
+  return tail_.load(std::memory_order_acquire) != head_
+         || has_overflow_.load(std::memory_order_acquire);
+}
+
+template<typename T>
+void MpscRingChannel<T>::NotifyConsumer() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (!consumer_sleeping_.load(std::memory_order_relaxed)) { return; }
+  std::unique_lock<std::mutex> lock(sleep_mutex_);
+  consumer_sleeping_.store(false, std::memory_order_relaxed);
+  sleep_cond_.notify_one();
+}
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_COMMON_MPSC_RING_CHANNEL_H_
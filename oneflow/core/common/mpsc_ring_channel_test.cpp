@@ -0,0 +1,94 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/common/mpsc_ring_channel.h"
+
+namespace oneflow {
+
+namespace {
+
+// about the size of ActorMsg
+struct FakeActorMsg {
+  int64_t producer_id;
+  int64_t seq;
+  char payload[112];
+};
+
+template<typename ChannelT>
+double ReceiveFromProducers(ChannelT* channel, int64_t producer_num, int64_t msg_num_per_producer) {
+  std::vector<std::thread> producers;
+  const auto start = std::chrono::steady_clock::now();
+  FOR_RANGE(int64_t, producer_id, 0, producer_num) {
+    producers.emplace_back([channel, producer_id, msg_num_per_producer]() {
+      FakeActorMsg msg{};
+      msg.producer_id = producer_id;
+      FOR_RANGE(int64_t, seq, 0, msg_num_per_producer) {
+        msg.seq = seq;
+        CHECK_EQ(channel->Send(msg), kChannelStatusSuccess);
+      }
+    });
+  }
+  std::vector<int64_t> expected_seqs(producer_num, 0);
+  FakeActorMsg msg{};
+  FOR_RANGE(int64_t, i, 0, producer_num * msg_num_per_producer) {
+    CHECK_EQ(channel->Receive(&msg), kChannelStatusSuccess);
+    // messages from the same producer keep their order
+    CHECK_EQ(msg.seq, expected_seqs.at(msg.producer_id));
+    expected_seqs.at(msg.producer_id) += 1;
+  }
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  for (std::thread& producer : producers) { producer.join(); }
+  return producer_num * msg_num_per_producer / seconds;
+}
+
+}  // namespace
+
+TEST(MpscRingChannel, per_producer_order_with_overflow) {
+  // a tiny ring makes most messages go through the overflow queue
+  MpscRingChannel<FakeActorMsg> channel(2, 16);
+  ReceiveFromProducers(&channel, 8, 20000);
+}
+
+TEST(MpscRingChannel, close) {
+  MpscRingChannel<int> channel(4, 0);
+  std::thread consumer([&channel]() {
+    int sum = 0;
+    int item = 0;
+    while (channel.Receive(&item) == kChannelStatusSuccess) { sum += item; }
+    ASSERT_EQ(sum, 100 * 99 / 2);
+  });
+  FOR_RANGE(int, i, 0, 100) { ASSERT_EQ(channel.Send(i), kChannelStatusSuccess); }
+  channel.Close();
+  consumer.join();
+  ASSERT_EQ(channel.Send(0), kChannelStatusErrorClosed);
+}
+
+TEST(MpscRingChannel, DISABLED_benchmark_actor_msg_throughput) {
+  const int64_t producer_num = 4;
+  const int64_t msg_num_per_producer = 100000;
+  {
+    Channel<FakeActorMsg> channel;
+    LOG(INFO) << "Channel: "
+              << ReceiveFromProducers(&channel, producer_num, msg_num_per_producer) << " msgs/s";
+  }
+  {
+    MpscRingChannel<FakeActorMsg> channel(12, 1024);
+    LOG(INFO) << "MpscRingChannel: "
+              << ReceiveFromProducers(&channel, producer_num, msg_num_per_producer) << " msgs/s";
+  }
+}
+
+}  // namespace oneflow
@@ -159,6 +159,9 @@ inline double GetCurTime() {
 }
 
 const size_t kHostAlignSize = 64;
+// Hot members are separated by padding of this size rather than by alignas(), operator new before
+// c++17 ignores extended alignment
+const size_t kCacheLineSize = 64;
 const size_t kCudaAlignSize = 512;
 const size_t kCudaMemAllocAlignSize = 512;
 inline size_t RoundUp(size_t n, size_t val) { return (n + val - 1) / val * val; }
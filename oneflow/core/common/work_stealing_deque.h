@@ -0,0 +1,107 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_COMMON_WORK_STEALING_DEQUE_H_
+#define ONEFLOW_CORE_COMMON_WORK_STEALING_DEQUE_H_
+
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+
+// Bounded Chase-Lev deque (see "Correct and Efficient Work-Stealing for Weak Memory Models").
+// Only the owner thread calls Push() and Pop(), which work on the bottom end without locking.
+// Any thread may call Steal(), which takes items from the top end with a single CAS.
+template<typename T>
+class WorkStealingDeque final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(WorkStealingDeque);
+  explicit WorkStealingDeque(int64_t capacity_log2)
+      : top_(0), bottom_(0), mask_((int64_t(1) << capacity_log2) - 1), buffer_(mask_ + 1) {
+    for (auto& slot : buffer_) { slot.store(nullptr, std::memory_order_relaxed); }
+  }
+  ~WorkStealingDeque() = default;
+
+  // return false if the deque is full
+  bool Push(T* item);
+  // return nullptr if the deque is empty
+  T* Pop();
+  // return nullptr if the deque is empty or the race to the top item is lost
+  T* Steal();
+
+  bool Empty() const {
+    return bottom_.load(std::memory_order_acquire) <= top_.load(std::memory_order_acquire);
+  }
+  int64_t capacity() const { return mask_ + 1; }
+
+ private:
+  // top_ written by thieves and bottom_ written by the owner get cache lines of their own
+  char pad0_[kCacheLineSize];
+  std::atomic<int64_t> top_;
+  char pad1_[kCacheLineSize - sizeof(std::atomic<int64_t>)];
+  std::atomic<int64_t> bottom_;
+  char pad2_[kCacheLineSize - sizeof(std::atomic<int64_t>)];
+  const int64_t mask_;
+  std::vector<std::atomic<T*>> buffer_;
+};
+
+template<typename T>
+bool WorkStealingDeque<T>::Push(T* item) {
+  const int64_t b = bottom_.load(std::memory_order_relaxed);
+  const int64_t t = top_.load(std::memory_order_acquire);
+  if (b - t > mask_) { return false; }
+  buffer_[b & mask_].store(item, std::memory_order_relaxed);
+  bottom_.store(b + 1, std::memory_order_release);
+  return true;
+}
+
+template<typename T>
+T* WorkStealingDeque<T>::Pop() {
+  const int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+  bottom_.store(b, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t t = top_.load(std::memory_order_relaxed);
+  if (t > b) {
+    bottom_.store(b + 1, std::memory_order_relaxed);
+    return nullptr;
+  }
+  T* item = buffer_[b & mask_].load(std::memory_order_relaxed);
+  if (t == b) {
+    // the last item, race against thieves
+    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      item = nullptr;
+    }
+    bottom_.store(b + 1, std::memory_order_relaxed);
+  }
+  return item;
+}
+
+template<typename T>
+T* WorkStealingDeque<T>::Steal() {
+  int64_t t = top_.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  const int64_t b = bottom_.load(std::memory_order_acquire);
+  if (t >= b) { return nullptr; }
+  T* item = buffer_[t & mask_].load(std::memory_order_relaxed);
+  if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                    std::memory_order_relaxed)) {
+    return nullptr;
+  }
+  return item;
+}
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_COMMON_WORK_STEALING_DEQUE_H_
@@ -0,0 +1,61 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/common/work_stealing_deque.h"
+
+namespace oneflow {
+
+TEST(WorkStealingDeque, owner_lifo) {
+  WorkStealingDeque<int> deque(2);
+  std::vector<int> items(5);
+  FOR_RANGE(int, i, 0, 4) { ASSERT_TRUE(deque.Push(&items.at(i))); }
+  ASSERT_FALSE(deque.Push(&items.at(4)));
+  ASSERT_EQ(deque.Steal(), &items.at(0));
+  ASSERT_EQ(deque.Pop(), &items.at(3));
+  ASSERT_EQ(deque.Pop(), &items.at(2));
+  ASSERT_EQ(deque.Pop(), &items.at(1));
+  ASSERT_EQ(deque.Pop(), nullptr);
+  ASSERT_TRUE(deque.Empty());
+}
+
+TEST(WorkStealingDeque, 1owner4thieves) {
+  const int item_num = 100000;
+  WorkStealingDeque<int> deque(8);
+  std::vector<int> items(item_num);
+  std::vector<std::atomic<int>> visits(item_num);
+  for (auto& visit : visits) { visit = 0; }
+  std::atomic<bool> done(false);
+  std::vector<std::thread> thieves;
+  FOR_RANGE(int, i, 0, 4) {
+    thieves.emplace_back([&]() {
+      while (!done || !deque.Empty()) {
+        int* item = deque.Steal();
+        if (item != nullptr) { visits.at(item - items.data()) += 1; }
+      }
+    });
+  }
+  FOR_RANGE(int, i, 0, item_num) {
+    while (!deque.Push(&items.at(i))) {
+      int* item = deque.Pop();
+      if (item != nullptr) { visits.at(item - items.data()) += 1; }
+    }
+  }
+  done = true;
+  for (std::thread& thief : thieves) { thief.join(); }
+  while (int* item = deque.Pop()) { visits.at(item - items.data()) += 1; }
+  FOR_RANGE(int, i, 0, item_num) { ASSERT_EQ(visits.at(i), 1); }
+}
+
+}  // namespace oneflow
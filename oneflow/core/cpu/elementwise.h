@@ -0,0 +1,86 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_CPU_ELEMENTWISE_H_
+#define ONEFLOW_CORE_CPU_ELEMENTWISE_H_
+
+#include "oneflow/core/thread/thread_manager.h"
+
+namespace oneflow {
+
+namespace cpu {
+
+namespace elementwise {
+
+// elements handled by one ParallelFor task, a few of them stay in L2 for unary to ternary ops
+constexpr int64_t kGrainSize = 32768;
+
+constexpr int kMaxPackBytes = 256 / 8;
+constexpr int kMaxPackSize = 8;
+
+constexpr int Min(int a, int b) { return a < b ? a : b; }
+
+template<typename T>
+constexpr int PackSize() {
+  return Min(kMaxPackBytes / sizeof(T), kMaxPackSize);
+}
+
+template<typename T, typename U, typename... Args>
+constexpr int PackSize() {
+  return Min(PackSize<T>(), PackSize<U, Args...>());
+}
+
+// The fixed trip count of the inner loop lets the compiler turn each pack into one SIMD
+// instruction sequence when the functor is simple enough
+template<int pack_size, typename FunctorT, typename R, typename... IN>
+inline void ApplyRange(const FunctorT& functor, int64_t begin, int64_t end, R* r,
+                       const IN*... in) {
+  int64_t i = begin;
+  for (; i + pack_size <= end; i += pack_size) {
+    for (int j = 0; j < pack_size; ++j) { r[i + j] = functor((in[i + j])...); }
+  }
+  for (; i < end; ++i) { r[i] = functor((in[i])...); }
+}
+
+template<typename FunctorT, typename R, typename... IN>
+inline void ApplyGeneric(FunctorT functor, int64_t n, R* r, const IN*... in) {
+  constexpr int pack_size = PackSize<R, IN...>();
+  ParallelFor(n, kGrainSize, ParallelForSchedule::kStatic, [&](size_t begin, size_t end) {
+    ApplyRange<pack_size, FunctorT, R, IN...>(functor, begin, end, r, in...);
+  });
+}
+
+template<typename FunctorT, typename R, typename A>
+inline void Unary(FunctorT functor, int64_t n, R* r, const A* a) {
+  ApplyGeneric<FunctorT, R, A>(functor, n, r, a);
+}
+
+template<typename FunctorT, typename R, typename A, typename B>
+inline void Binary(FunctorT functor, int64_t n, R* r, const A* a, const B* b) {
+  ApplyGeneric<FunctorT, R, A, B>(functor, n, r, a, b);
+}
+
+template<typename FunctorT, typename R, typename A, typename B, typename C>
+inline void Ternary(FunctorT functor, int64_t n, R* r, const A* a, const B* b, const C* c) {
+  ApplyGeneric<FunctorT, R, A, B, C>(functor, n, r, a, b, c);
+}
+
+}  // namespace elementwise
+
+}  // namespace cpu
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_CPU_ELEMENTWISE_H_
@@ -0,0 +1,133 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/cpu/elementwise.h"
+#include "oneflow/core/thread/thread_pool.h"
+#include <random>
+
+namespace oneflow {
+
+namespace cpu {
+
+namespace elementwise {
+
+namespace test {
+
+namespace {
+
+class CpuElementwiseTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    Global<ThreadPool>::New(std::max<int32_t>(std::thread::hardware_concurrency(), 1));
+  }
+  void TearDown() override { Global<ThreadPool>::Delete(); }
+};
+
+std::vector<float> RandomVector(int64_t size) {
+  std::mt19937 gen(size);
+  std::uniform_real_distribution<float> dist(-5.0, 5.0);
+  std::vector<float> vec(size);
+  for (float& v : vec) { v = dist(gen); }
+  return vec;
+}
+
+template<typename T>
+struct HardswishFunctor {
+  T operator()(const T x) const {
+    if (x <= static_cast<T>(-3)) {
+      return static_cast<T>(0);
+    } else if (x >= static_cast<T>(3)) {
+      return x;
+    } else {
+      return (x * (x + static_cast<T>(3))) / static_cast<T>(6);
+    }
+  }
+};
+
+template<typename T>
+struct ReluGradFunctor {
+  T operator()(const T y, const T dy) const {
+    return y > static_cast<T>(0) ? dy : static_cast<T>(0);
+  }
+};
+
+template<typename T>
+struct FusedMulAddFunctor {
+  T operator()(const T a, const int32_t b, const T c) const { return a * static_cast<T>(b) + c; }
+};
+
+}  // namespace
+
+TEST_F(CpuElementwiseTest, elementwise) {
+  for (int64_t n : std::vector<int64_t>{0, 1, 7, 8, 9, 1000, kGrainSize - 1, 5 * kGrainSize + 3}) {
+    const std::vector<float> a = RandomVector(n);
+    const std::vector<float> b = RandomVector(n + 1);
+    std::vector<int32_t> c(n);
+    std::iota(c.begin(), c.end(), -n / 2);
+    std::vector<float> r(n);
+    Unary(HardswishFunctor<float>(), n, r.data(), a.data());
+    FOR_RANGE(int64_t, i, 0, n) { ASSERT_EQ(r[i], HardswishFunctor<float>()(a[i])); }
+    Binary(ReluGradFunctor<float>(), n, r.data(), a.data(), b.data());
+    FOR_RANGE(int64_t, i, 0, n) { ASSERT_EQ(r[i], ReluGradFunctor<float>()(a[i], b[i])); }
+    Ternary(FusedMulAddFunctor<float>(), n, r.data(), a.data(), c.data(), b.data());
+    FOR_RANGE(int64_t, i, 0, n) {
+      ASSERT_EQ(r[i], FusedMulAddFunctor<float>()(a[i], c[i], b[i]));
+    }
+    // in place
+    std::vector<float> inplace = a;
+    Unary(HardswishFunctor<float>(), n, inplace.data(), inplace.data());
+    FOR_RANGE(int64_t, i, 0, n) { ASSERT_EQ(inplace[i], HardswishFunctor<float>()(a[i])); }
+  }
+}
+
+TEST_F(CpuElementwiseTest, DISABLED_benchmark_elementwise) {
+  const int64_t kIters = 20;
+  const int64_t n = 16 * 1024 * 1024;
+  const std::vector<float> a = RandomVector(n);
+  const std::vector<float> b = RandomVector(n + 1);
+  std::vector<float> r(n);
+  const HardswishFunctor<float> hardswish;
+  const ReluGradFunctor<float> relu_grad;
+  const auto scalar_unary_start = std::chrono::steady_clock::now();
+  FOR_RANGE(int64_t, iter, 0, kIters) {
+    FOR_RANGE(int64_t, i, 0, n) { r[i] = hardswish(a[i]); }
+  }
+  const auto unary_start = std::chrono::steady_clock::now();
+  FOR_RANGE(int64_t, iter, 0, kIters) { Unary(hardswish, n, r.data(), a.data()); }
+  const auto scalar_binary_start = std::chrono::steady_clock::now();
+  FOR_RANGE(int64_t, iter, 0, kIters) {
+    FOR_RANGE(int64_t, i, 0, n) { r[i] = relu_grad(a[i], b[i]); }
+  }
+  const auto binary_start = std::chrono::steady_clock::now();
+  FOR_RANGE(int64_t, iter, 0, kIters) { Binary(relu_grad, n, r.data(), a.data(), b.data()); }
+  const auto binary_end = std::chrono::steady_clock::now();
+  auto AvgUs = [&](std::chrono::steady_clock::time_point start,
+                   std::chrono::steady_clock::time_point end) {
+    return std::chrono::duration<double, std::micro>(end - start).count() / kIters;
+  };
+  LOG(INFO) << "hardswish " << n << ": scalar loop " << AvgUs(scalar_unary_start, unary_start)
+            << "us, elementwise " << AvgUs(unary_start, scalar_binary_start) << "us";
+  LOG(INFO) << "relu_grad " << n << ": scalar loop "
+            << AvgUs(scalar_binary_start, binary_start) << "us, elementwise "
+            << AvgUs(binary_start, binary_end) << "us";
+}
+
+}  // namespace test
+
+}  // namespace elementwise
+
+}  // namespace cpu
+
+}  // namespace oneflow
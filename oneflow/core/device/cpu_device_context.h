@@ -25,16 +25,28 @@ class CpuDeviceCtx final : public DeviceCtx {
  public:
   OF_DISALLOW_COPY_AND_MOVE(CpuDeviceCtx);
   CpuDeviceCtx() = default;
+  explicit CpuDeviceCtx(std::unique_ptr<vm::Allocator>&& allocator)
+      : allocator_(std::move(allocator)) {}
   ~CpuDeviceCtx() = default;
 
-  std::unique_ptr<DeviceCtx> Copy() const { return std::unique_ptr<DeviceCtx>(new CpuDeviceCtx()); }
+  // copies share the allocator, which is thread safe when it caches
+  std::unique_ptr<DeviceCtx> Copy() const {
+    return std::unique_ptr<DeviceCtx>(new CpuDeviceCtx(allocator_));
+  }
 
   void SyncDevice() override {}
   void AddCallBack(std::function<void()> callback) const override { callback(); }
 
-  vm::Allocator* mut_allocator() override { return Global<vm::CpuAllocator>::Get(); }
+  vm::Allocator* mut_allocator() override {
+    if (allocator_) { return allocator_.get(); }
+    return Global<vm::CpuAllocator>::Get();
+  }
 
  private:
+  explicit CpuDeviceCtx(const std::shared_ptr<vm::Allocator>& allocator)
+      : allocator_(allocator) {}
+
+  std::shared_ptr<vm::Allocator> allocator_;
 };  // namespace oneflow
 
 }  // namespace oneflow
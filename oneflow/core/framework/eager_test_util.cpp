@@ -0,0 +1,56 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/eager_test_util.h"
+#include "oneflow/core/control/global_process_ctx.h"
+#include "oneflow/core/eager/eager_oneflow.h"
+#include "oneflow/core/framework/device.h"
+#include "oneflow/core/framework/tensor.h"
+#include "oneflow/core/functional/functional.h"
+#include "oneflow/core/job/global_for.h"
+#include "oneflow/core/job/resource_desc.h"
+#include "oneflow/core/thread/thread_pool.h"
+#include "oneflow/core/vm/test_util.h"
+#include "oneflow/core/vm/virtual_machine_scope.h"
+
+namespace oneflow {
+namespace one {
+namespace test {
+
+TestEagerEnvScope::TestEagerEnvScope() {
+  resource_desc_scope_.reset(new vm::TestResourceDescScope(0, 1));
+  const Resource& resource = Global<ResourceDesc, ForSession>::Get()->resource();
+  Global<ResourceDesc, ForEnv>::New(resource, GlobalProcessCtx::NumOfProcessPerNode());
+  Global<ThreadPool>::New(Global<ResourceDesc, ForSession>::Get()->ComputeThreadPoolSize());
+  Global<vm::EagerOneflow>::New();
+  virtual_machine_scope_.reset(new vm::VirtualMachineScope(resource));
+}
+
+TestEagerEnvScope::~TestEagerEnvScope() {
+  virtual_machine_scope_.reset();
+  Global<vm::EagerOneflow>::Delete();
+  Global<ThreadPool>::Delete();
+  Global<ResourceDesc, ForEnv>::Delete();
+  resource_desc_scope_.reset();
+}
+
+Maybe<Tensor> NewCpuTensor(const Shape& shape, float value) {
+  return functional::Constant(shape, functional::Scalar(value), DataType::kFloat,
+                              JUST(Device::New("cpu", 0)));
+}
+
+}  // namespace test
+}  // namespace one
+}  // namespace oneflow
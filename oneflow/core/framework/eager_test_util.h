@@ -0,0 +1,59 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_FRAMEWORK_EAGER_TEST_UTIL_H_
+#define ONEFLOW_CORE_FRAMEWORK_EAGER_TEST_UTIL_H_
+
+#include "oneflow/core/common/maybe.h"
+#include "oneflow/core/common/shape.h"
+
+namespace oneflow {
+
+namespace vm {
+
+class TestResourceDescScope;
+class VirtualMachineScope;
+
+}  // namespace vm
+
+namespace one {
+
+class Tensor;
+
+namespace test {
+
+// The single process part of EnvGlobalObjectsScope that eager cpu ops depend on.
+class TestEagerEnvScope final {
+ public:
+  TestEagerEnvScope(const TestEagerEnvScope&) = delete;
+  TestEagerEnvScope(TestEagerEnvScope&&) = delete;
+  TestEagerEnvScope();
+  ~TestEagerEnvScope();
+
+ private:
+  std::unique_ptr<vm::TestResourceDescScope> resource_desc_scope_;
+  std::unique_ptr<vm::VirtualMachineScope> virtual_machine_scope_;
+};
+
+// a float tensor on cpu 0 filled with `value`
+Maybe<Tensor> NewCpuTensor(const Shape& shape, float value);
+
+}  // namespace test
+
+}  // namespace one
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_FRAMEWORK_EAGER_TEST_UTIL_H_
@@ -0,0 +1,147 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/mirrored_tensor_infer_cache.h"
+#include "oneflow/core/framework/tensor_tuple.h"
+#include "oneflow/core/framework/tensor.h"
+#include "oneflow/core/framework/tensor_impl.h"
+#include "oneflow/core/framework/op_expr.h"
+
+namespace oneflow {
+namespace one {
+
+namespace {
+
+size_t MaxCacheSize() {
+  static const size_t max_cache_size =
+      ParseIntegerFromEnv("ONEFLOW_EAGER_MIRRORED_INFER_CACHE_MAX_SIZE", 1024);
+  return max_cache_size;
+}
+
+}  // namespace
+
+size_t InputMirroredTensorMeta::hash_value() const {
+  size_t hash_value = std::hash<Shape>()(shape_);
+  HashCombine(&hash_value, std::hash<int>()(static_cast<int>(dtype_)));
+  HashCombine(&hash_value, std::hash<bool>()(is_dynamic_));
+  HashCombine(&hash_value, std::hash<Symbol<Device>>()(device_));
+  return hash_value;
+}
+
+bool InputMirroredTensorMeta::operator==(const InputMirroredTensorMeta& other) const {
+  return this->dtype_ == other.dtype_ && this->is_dynamic_ == other.is_dynamic_
+         && this->device_ == other.device_ && this->shape_ == other.shape_;
+}
+
+size_t MirroredTensorMetaInferArgs::hash_value() const {
+  size_t hash_value = std::hash<AttrMap>()(attrs_);
+  HashCombine(&hash_value, std::hash<Symbol<Device>>()(default_device_));
+  const auto& tensor_meta_hash_functor = std::hash<InputMirroredTensorMeta>();
+  for (const auto& tensor_meta : input_mirrored_tensor_metas_) {
+    HashCombine(&hash_value, tensor_meta_hash_functor(tensor_meta));
+  }
+  return hash_value;
+}
+
+bool MirroredTensorMetaInferArgs::operator==(const MirroredTensorMetaInferArgs& other) const {
+  return this->default_device_ == other.default_device_ && this->attrs_ == other.attrs_
+         && this->input_mirrored_tensor_metas_ == other.input_mirrored_tensor_metas_;
+}
+
+Maybe<void> MirroredTensorMetaInferArgs::Init(const AttrMap& attrs, Symbol<Device> default_device,
+                                              const TensorTuple& input_tensors) {
+  attrs_ = attrs;
+  default_device_ = default_device;
+  input_mirrored_tensor_metas_.resize(input_tensors.size());
+  for (int i = 0; i < input_tensors.size(); ++i) {
+    const auto& tensor_meta = JUST(input_tensors.at(i)->mut_eager_mirrored_tensor_impl())
+                                  ->tensor_meta();
+    input_mirrored_tensor_metas_.at(i) =
+        InputMirroredTensorMeta(tensor_meta->shape(), tensor_meta->dtype(),
+                                tensor_meta->is_dynamic(), tensor_meta->device());
+  }
+  return Maybe<void>::Ok();
+}
+
+/* static */ Maybe<const MirroredTensorInferResult> MirroredTensorInferCache::Infer(
+    const UserOpExpr& user_op_expr, const MirroredTensorMetaInferArgs& infer_args,
+    const TensorTuple& input_tensors, TensorTuple* output_tensors) {
+  const size_t output_size = output_tensors->size();
+  auto result = std::make_shared<MirroredTensorInferResult>(output_size);
+  // Infer devices
+  if (!user_op_expr.has_device_infer_fn()) {
+    result->set_op_device(infer_args.default_device());
+    for (auto& device : *result->mut_output_devices()) { device = infer_args.default_device(); }
+  } else {
+    result->set_op_device(
+        JUST(user_op_expr.InferDevices(infer_args.attrs(), input_tensors, output_tensors)));
+    for (int i = 0; i < output_size; ++i) {
+      result->mut_output_devices()->at(i) = JUST(output_tensors->at(i)->device());
+    }
+  }
+  // Infer shapes and dtypes. Only the metas recorded in `infer_args` are visible to the infer
+  // functions, so the result is fully determined by the cache key.
+  const auto& input_metas = infer_args.input_mirrored_tensor_metas();
+  std::vector<TensorMeta> input_tensor_metas;
+  input_tensor_metas.reserve(input_metas.size());
+  for (const auto& input_meta : input_metas) {
+    input_tensor_metas.emplace_back(std::make_shared<const Shape>(input_meta.shape()),
+                                    input_meta.dtype());
+    input_tensor_metas.back().set_is_dynamic(input_meta.is_dynamic());
+  }
+  std::vector<TensorMeta> output_tensor_metas;
+  output_tensor_metas.reserve(output_size);
+  for (int i = 0; i < output_size; ++i) {
+    output_tensor_metas.emplace_back(std::make_shared<const Shape>(), kInvalidDataType);
+  }
+  const auto& device_tag = JUST(result->op_device()->of_type());
+  JUST(user_op_expr.InferLogicalShapeAndDType(
+      infer_args.attrs(), device_tag,
+      [&](int32_t i) -> const TensorMeta* { return &input_tensor_metas.at(i); },
+      [&](int32_t i) -> TensorMeta* { return &output_tensor_metas.at(i); }));
+  for (int i = 0; i < output_size; ++i) {
+    const auto& output_tensor_meta = output_tensor_metas.at(i);
+    result->mut_output_shapes()->at(i) = output_tensor_meta.shape();
+    result->mut_output_dtypes()->at(i) = output_tensor_meta.dtype();
+    result->mut_output_is_dynamics()->at(i) = output_tensor_meta.is_dynamic();
+  }
+  return std::shared_ptr<const MirroredTensorInferResult>(result);
+}
+
+Maybe<const MirroredTensorInferResult> MirroredTensorInferCache::GetOrInfer(
+    const MirroredTensorMetaInferArgs& infer_args, const TensorTuple& input_tensors,
+    TensorTuple* output_tensors) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const auto& iter = cache_.find(infer_args);
+    if (iter != cache_.end()) {
+      ++hit_count_;
+      return iter->second;
+    }
+    ++miss_count_;
+  }
+  const auto& user_op_expr = user_op_expr_.lock();
+  CHECK_OR_RETURN(static_cast<bool>(user_op_expr));
+  const auto& result = JUST(Infer(*user_op_expr, infer_args, input_tensors, output_tensors));
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // Ops fed with ever-changing shapes would otherwise grow the cache without bound.
+    if (cache_.size() >= MaxCacheSize()) { cache_.clear(); }
+    return cache_.emplace(infer_args, result).first->second;
+  }
+}
+
+}  // namespace one
+}  // namespace oneflow
@@ -0,0 +1,175 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_FRAMEWORK_MIRRORED_TENSOR_INFER_CACHE_H_
+#define ONEFLOW_CORE_FRAMEWORK_MIRRORED_TENSOR_INFER_CACHE_H_
+
+#include <mutex>
+#include "oneflow/core/common/symbol.h"
+#include "oneflow/core/common/maybe.h"
+#include "oneflow/core/common/shape.h"
+#include "oneflow/core/common/data_type.pb.h"
+#include "oneflow/core/framework/attr_map.h"
+#include "oneflow/core/framework/device.h"
+
+namespace oneflow {
+namespace one {
+
+class InputMirroredTensorMeta final {
+ public:
+  InputMirroredTensorMeta() : shape_(), dtype_(kInvalidDataType), is_dynamic_(false), device_() {}
+  InputMirroredTensorMeta(const Shape& shape, DataType dtype, bool is_dynamic,
+                          Symbol<Device> device)
+      : shape_(shape), dtype_(dtype), is_dynamic_(is_dynamic), device_(device) {}
+
+  InputMirroredTensorMeta(const InputMirroredTensorMeta&) = default;
+  InputMirroredTensorMeta(InputMirroredTensorMeta&&) = default;
+  InputMirroredTensorMeta& operator=(const InputMirroredTensorMeta&) = default;
+  ~InputMirroredTensorMeta() = default;
+
+  size_t hash_value() const;
+  bool operator==(const InputMirroredTensorMeta& other) const;
+
+  const Shape& shape() const { return shape_; }
+  DataType dtype() const { return dtype_; }
+  bool is_dynamic() const { return is_dynamic_; }
+  Symbol<Device> device() const { return device_; }
+
+ private:
+  Shape shape_;
+  DataType dtype_;
+  bool is_dynamic_;
+  Symbol<Device> device_;
+};
+
+class TensorTuple;
+class UserOpExpr;
+
+class MirroredTensorMetaInferArgs final {
+ public:
+  MirroredTensorMetaInferArgs() = default;
+  MirroredTensorMetaInferArgs(const MirroredTensorMetaInferArgs&) = default;
+  MirroredTensorMetaInferArgs(MirroredTensorMetaInferArgs&&) = default;
+  ~MirroredTensorMetaInferArgs() = default;
+
+  const AttrMap& attrs() const { return attrs_; }
+  Symbol<Device> default_device() const { return default_device_; }
+  const std::vector<InputMirroredTensorMeta>& input_mirrored_tensor_metas() const {
+    return input_mirrored_tensor_metas_;
+  }
+
+  size_t hash_value() const;
+
+  bool operator==(const MirroredTensorMetaInferArgs& other) const;
+
+  // Reuses the storage of input metas so that a thread_local instance allocates nothing on the
+  // dispatch path once warmed up.
+  Maybe<void> Init(const AttrMap& attrs, Symbol<Device> default_device,
+                   const TensorTuple& input_tensors);
+
+ private:
+  AttrMap attrs_;
+  Symbol<Device> default_device_;
+  std::vector<InputMirroredTensorMeta> input_mirrored_tensor_metas_;
+};
+
+}  // namespace one
+}  // namespace oneflow
+
+namespace std {
+
+template<>
+struct hash<oneflow::one::InputMirroredTensorMeta> final {
+  size_t operator()(const oneflow::one::InputMirroredTensorMeta& val) const {
+    return val.hash_value();
+  }
+};
+
+template<>
+struct hash<oneflow::one::MirroredTensorMetaInferArgs> final {
+  size_t operator()(const oneflow::one::MirroredTensorMetaInferArgs& val) const {
+    return val.hash_value();
+  }
+};
+
+}  // namespace std
+
+namespace oneflow {
+namespace one {
+
+class MirroredTensorInferResult final {
+ public:
+  explicit MirroredTensorInferResult(size_t output_size)
+      : output_devices_(output_size),
+        output_shapes_(output_size),
+        output_dtypes_(output_size),
+        output_is_dynamics_(output_size) {}
+  MirroredTensorInferResult(const MirroredTensorInferResult&) = delete;
+  MirroredTensorInferResult(MirroredTensorInferResult&&) = delete;
+  ~MirroredTensorInferResult() = default;
+
+  Symbol<Device> op_device() const { return op_device_; }
+  const std::vector<Symbol<Device>>& output_devices() const { return output_devices_; }
+  // Shapes are owned by the cache. Callers must copy them before handing them to a TensorMeta,
+  // since TensorMeta::mut_shape() writes through the shared pointer.
+  const std::vector<Shape>& output_shapes() const { return output_shapes_; }
+  const std::vector<DataType>& output_dtypes() const { return output_dtypes_; }
+  const std::vector<bool>& output_is_dynamics() const { return output_is_dynamics_; }
+
+  void set_op_device(Symbol<Device> op_device) { op_device_ = op_device; }
+  std::vector<Symbol<Device>>* mut_output_devices() { return &output_devices_; }
+  std::vector<Shape>* mut_output_shapes() { return &output_shapes_; }
+  std::vector<DataType>* mut_output_dtypes() { return &output_dtypes_; }
+  std::vector<bool>* mut_output_is_dynamics() { return &output_is_dynamics_; }
+
+ private:
+  Symbol<Device> op_device_;
+  std::vector<Symbol<Device>> output_devices_;
+  std::vector<Shape> output_shapes_;
+  std::vector<DataType> output_dtypes_;
+  std::vector<bool> output_is_dynamics_;
+};
+
+class MirroredTensorInferCache final {
+ public:
+  MirroredTensorInferCache(const std::shared_ptr<const UserOpExpr>& user_op_expr)
+      : user_op_expr_(user_op_expr), hit_count_(0), miss_count_(0) {}
+
+  // `input_tensors` and `output_tensors` are only touched on a miss, by the device infer function
+  // of the op.
+  Maybe<const MirroredTensorInferResult> GetOrInfer(const MirroredTensorMetaInferArgs& infer_args,
+                                                    const TensorTuple& input_tensors,
+                                                    TensorTuple* output_tensors);
+
+  static Maybe<const MirroredTensorInferResult> Infer(
+      const UserOpExpr& user_op_expr, const MirroredTensorMetaInferArgs& infer_args,
+      const TensorTuple& input_tensors, TensorTuple* output_tensors);
+
+  int64_t hit_count() const { return hit_count_; }
+  int64_t miss_count() const { return miss_count_; }
+
+ private:
+  // ops may be dispatched by several backward threads at the same time
+  std::mutex mutex_;
+  std::weak_ptr<const UserOpExpr> user_op_expr_;
+  HashMap<MirroredTensorMetaInferArgs, std::shared_ptr<const MirroredTensorInferResult>> cache_;
+  int64_t hit_count_;
+  int64_t miss_count_;
+};
+
+}  // namespace one
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_FRAMEWORK_MIRRORED_TENSOR_INFER_CACHE_H_
@@ -101,6 +101,9 @@ Maybe<void> NNGraph::CompileAndInitRuntime() {
     PlanUtil::GenCollectiveBoxingPlan(&job_, &plan_);
     // PlanUtil::SetForceInplaceMemBlock(&plan_); NOTE(chengcheng): only for ssp.
     PlanUtil::DumpCtrlRegstInfoToPlan(&plan_);
+    if (Global<ResourceDesc, ForSession>::Get()->enable_debug_mode()) {
+      PlanUtil::ToMemoryReportJsonFile(plan_, "job_" + name_ + "_plan_memory_report.json");
+    }
   }
   if (GlobalProcessCtx::WorldSize() > 1) {
     std::string plan_name = "plan:" + job_name();
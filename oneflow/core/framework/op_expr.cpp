@@ -21,6 +21,7 @@ limitations under the License.
 #include "oneflow/core/framework/op_expr_grad_function.h"
 #include "oneflow/core/framework/user_op_registry_manager.h"
 #include "oneflow/core/framework/consistent_tensor_infer_cache.h"
+#include "oneflow/core/framework/mirrored_tensor_infer_cache.h"
 #include "oneflow/core/operator/op_conf.pb.h"
 #include "oneflow/user/kernels/stateful_local_opkernel.h"
 
@@ -103,8 +104,11 @@ Maybe<void> BuiltinOpExprImpl<UserOpConf>::BuildOpConf(OperatorConf* op_conf,
 }
 
 Maybe<StatefulLocalOpKernel> UserOpExpr::MutKernel4Device(const Device& device) const {
-  const auto& it = device2kernel_.find(device);
-  if (it != device2kernel_.end()) { return it->second; }
+  {
+    std::unique_lock<std::mutex> lock(device2kernel_mutex_);
+    const auto& it = device2kernel_.find(device);
+    if (it != device2kernel_.end()) { return it->second; }
+  }
 
   std::shared_ptr<OperatorConf> op_conf = std::make_shared<OperatorConf>();
   JUST(BuildOpConf(op_conf.get(), {}));
@@ -113,8 +117,8 @@ Maybe<StatefulLocalOpKernel> UserOpExpr::MutKernel4Device(const Device& device)
   const auto& opkernel =
       JUST(StatefulLocalOpKernel::New(op_conf, SymbolOf(device), base_attrs(), parallel_desc,
                                       input_arg_tuple(), output_arg_tuple()));
-  device2kernel_.emplace(device, opkernel);
-  return opkernel;
+  std::unique_lock<std::mutex> lock(device2kernel_mutex_);
+  return device2kernel_.emplace(device, opkernel).first->second;
 }
 
 template<>
@@ -362,6 +366,7 @@ Maybe<void> UserOpExpr::Init(const std::shared_ptr<const UserOpExpr>& self) {
   CHECK_OR_RETURN(static_cast<bool>(dtype_infer_fn_));
   if (registry->device_infer_fn) { device_infer_fn_ = registry->device_infer_fn; }
   consistent_tensor_infer_cache_.reset(new ConsistentTensorInferCache(self));
+  mirrored_tensor_infer_cache_.reset(new MirroredTensorInferCache(self));
   return Maybe<void>::Ok();
 }
 
@@ -117,6 +117,7 @@ class BuiltinOpExprImpl : public BuiltinOpExpr {
 
 class StatefulLocalOpKernel;
 class ConsistentTensorInferCache;
+class MirroredTensorInferCache;
 
 class UserOpExpr final : public BuiltinOpExprImpl<UserOpConf> {
  public:
@@ -141,6 +142,9 @@ class UserOpExpr final : public BuiltinOpExprImpl<UserOpConf> {
   ConsistentTensorInferCache* mut_consistent_tensor_infer_cache() const {
     return consistent_tensor_infer_cache_.get();
   }
+  MirroredTensorInferCache* mut_mirrored_tensor_infer_cache() const {
+    return mirrored_tensor_infer_cache_.get();
+  }
 
  private:
   UserOpExpr(const std::string& op_name, UserOpConf&& proto, const AttrMap& base_attrs,
@@ -151,8 +155,10 @@ class UserOpExpr final : public BuiltinOpExprImpl<UserOpConf> {
   user_op::TensorDescInferFn shape_infer_fn_;
   user_op::DataTypeInferFn dtype_infer_fn_;
   user_op::DeviceInferFn device_infer_fn_;
+  mutable std::mutex device2kernel_mutex_;
   mutable HashMap<Device, std::shared_ptr<StatefulLocalOpKernel>> device2kernel_;
   std::shared_ptr<ConsistentTensorInferCache> consistent_tensor_infer_cache_;
+  std::shared_ptr<MirroredTensorInferCache> mirrored_tensor_infer_cache_;
 };
 
 class CastConsistentOpExpr : public OpExpr {
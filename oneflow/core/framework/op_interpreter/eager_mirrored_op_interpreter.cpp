@@ -27,6 +27,7 @@ limitations under the License.
 #include "oneflow/core/framework/tensor_tuple.h"
 #include "oneflow/core/framework/stride.h"
 #include "oneflow/core/framework/op_expr_helper.h"
+#include "oneflow/core/framework/mirrored_tensor_infer_cache.h"
 #include "oneflow/core/eager/foreign_boxing_util.h"
 #include "oneflow/core/memory/memory_case_util.h"
 #include "oneflow/core/operator/operator.h"
@@ -78,6 +79,12 @@ std::vector<TensorMeta*>* ThreadLocalDefaultOutputMutTensorMetas(int64_t size) {
   return &ptr_vec;
 }
 
+bool EnableMirroredTensorInferCache() {
+  static const bool enable_cache =
+      ParseBooleanFromEnv("ONEFLOW_EAGER_ENABLE_MIRRORED_INFER_CACHE", true);
+  return enable_cache;
+}
+
 }  // namespace
 
 Maybe<void> NaiveInterpret(const UserOpExpr& user_op_expr, const TensorTuple& inputs,
@@ -112,36 +119,37 @@ Maybe<void> NaiveInterpret(const UserOpExpr& user_op_expr, const TensorTuple& in
   bool need_check_mem_case = true;
   bool need_event_record = false;
 
-  // Infer devices
-  if (!user_op_expr.has_device_infer_fn()) {
-    op_device = default_device;
-    op_parallel_desc = op_device->parallel_desc_ptr();
-    for (int i = 0; i < outputs->size(); i++) {
-      auto* tensor_impl = JUST(TensorImpl4Tensor(outputs->at(i)));
-      *JUST(tensor_impl->mut_device()) = default_device;
-    }
+  // Infer devices, shapes and dtypes
+  static thread_local MirroredTensorMetaInferArgs infer_args;
+  JUST(infer_args.Init(attrs, default_device, inputs));
+  std::shared_ptr<const MirroredTensorInferResult> infer_result;
+  if (EnableMirroredTensorInferCache()) {
+    auto* infer_cache = user_op_expr.mut_mirrored_tensor_infer_cache();
+    infer_result = JUST(infer_cache->GetOrInfer(infer_args, inputs, outputs));
   } else {
+    infer_result = JUST(MirroredTensorInferCache::Infer(user_op_expr, infer_args, inputs, outputs));
+  }
+  op_device = infer_result->op_device();
+  op_parallel_desc = op_device->parallel_desc_ptr();
+  if (user_op_expr.has_device_infer_fn()) {
     need_check_mem_case = false;
-    op_device = JUST(user_op_expr.InferDevices(attrs, inputs, outputs));
     for (const auto& input_tensor : inputs) {
       const auto& input_device = JUST(input_tensor->device());
       need_event_record = need_event_record || !(*op_device == *input_device);
     }
-    op_parallel_desc = op_device->parallel_desc_ptr();
   }
-
-  // Infer shapes and dtypes
-  const auto& device_tag = JUST(op_device->of_type());
-  JUST(user_op_expr.InferLogicalShapeAndDType(
-      attrs, device_tag,
-      [&](int32_t i) -> const TensorMeta* {
-        return CHECK_JUST(TensorImpl4Tensor(inputs.at(i)))->mut_tensor_meta();
-      },
-      [&](int32_t i) -> TensorMeta* {
-        // using thread_local TensorMeta pointer if inplace.
-        // using tensor_impl TensorMeta pointer if not inplace.
-        return output_tensor_metas->at(i);
-      }));
+  for (int i = 0; i < outputs->size(); i++) {
+    auto* tensor_impl = JUST(TensorImpl4Tensor(outputs->at(i)));
+    *JUST(tensor_impl->mut_device()) = infer_result->output_devices().at(i);
+    // using thread_local TensorMeta pointer if inplace.
+    // using tensor_impl TensorMeta pointer if not inplace.
+    auto* output_tensor_meta = output_tensor_metas->at(i);
+    // the cached shape is copied since shapes of output metas are mutated in place later on.
+    const auto& output_shape = infer_result->output_shapes().at(i);
+    output_tensor_meta->set_shape(std::make_shared<const Shape>(output_shape));
+    output_tensor_meta->set_dtype(infer_result->output_dtypes().at(i));
+    output_tensor_meta->set_is_dynamic(infer_result->output_is_dynamics().at(i));
+  }
 
   for (int i = 0; i < output_eager_blob_objects->size(); i++) {
     auto* tensor_impl = JUST(TensorImpl4Tensor(outputs->at(i)));
@@ -0,0 +1,193 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <chrono>
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/framework/device.h"
+#include "oneflow/core/framework/eager_test_util.h"
+#include "oneflow/core/framework/instructions_builder.h"
+#include "oneflow/core/framework/mirrored_tensor_infer_cache.h"
+#include "oneflow/core/framework/op_builder.h"
+#include "oneflow/core/framework/op_expr.h"
+#include "oneflow/core/framework/op_interpreter.h"
+#include "oneflow/core/framework/op_interpreter/op_interpreter_util.h"
+#include "oneflow/core/framework/tensor.h"
+#include "oneflow/core/framework/tensor_tuple.h"
+#include "oneflow/core/functional/functional.h"
+#include "oneflow/core/job/global_for.h"
+#include "oneflow/core/job/resource_desc.h"
+#include "oneflow/core/vm/id_generator.h"
+#include "oneflow/core/vm/thread_ctx.msg.h"
+#include "oneflow/core/vm/virtual_machine.msg.h"
+#include "oneflow/core/vm/vm_desc.msg.h"
+#include "oneflow/core/vm/vm_util.h"
+#include "oneflow/user/kernels/stateful_local_opkernel.h"
+
+namespace oneflow {
+namespace one {
+namespace test {
+
+namespace {
+
+struct DispatchCase {
+  std::string name;
+  std::shared_ptr<UserOpExpr> op_expr;
+  TensorTuple inputs;
+  // the functional api entry of the same op, i.e. what python calls into
+  std::function<Maybe<Tensor>()> Call;
+};
+
+using Clock = std::chrono::steady_clock;
+
+double MicrosecondsPerIter(Clock::time_point start, Clock::time_point end, int64_t iters) {
+  return std::chrono::duration<double, std::micro>(end - start).count() / iters;
+}
+
+double Microseconds(Clock::duration duration, int64_t iters) {
+  return std::chrono::duration<double, std::micro>(duration).count() / iters;
+}
+
+Maybe<std::vector<DispatchCase>> MakeDispatchCases() {
+  const Shape shape({4, 4});
+  const auto& x = JUST(NewCpuTensor(shape, 1.0));
+  const auto& y = JUST(NewCpuTensor(shape, 2.0));
+  std::vector<DispatchCase> cases;
+  cases.push_back(DispatchCase{"relu", JUST(OpBuilder("relu").Input("in").Output("out").Build()),
+                               TensorTuple{x},
+                               [x]() { return functional::Relu(x, /*inplace=*/false); }});
+  cases.push_back(DispatchCase{"add", JUST(OpBuilder("add_n").Input("in", 2).Output("out").Build()),
+                               TensorTuple{x, y},
+                               [x, y]() { return functional::Add(x, y, /*inplace=*/false); }});
+  cases.push_back(
+      DispatchCase{"matmul", JUST(OpBuilder("matmul").Input("a").Input("b").Output("out").Build()),
+                   TensorTuple{x, y}, [x, y]() {
+                     return functional::MatMul(x, y, /*transpose_a=*/false, /*transpose_b=*/false,
+                                               /*alpha=*/1.0);
+                   }});
+  return cases;
+}
+
+// functional api -> NaiveInterpret -> LocalCallOpKernel -> vm, synchronized once at the end.
+Maybe<void> BenchmarkEndToEnd(const DispatchCase& dispatch_case, int64_t iters) {
+  JUST(dispatch_case.Call());
+  JUST(vm::MultiClientSync());
+  const auto start = Clock::now();
+  FOR_RANGE(int64_t, i, 0, iters) { JUST(dispatch_case.Call()); }
+  const auto dispatched = Clock::now();
+  JUST(vm::MultiClientSync());
+  const auto end = Clock::now();
+  const double us_per_op = MicrosecondsPerIter(start, end, iters);
+  LOG(INFO) << dispatch_case.name << " end to end: " << 1e6 / us_per_op << " ops/s, "
+            << us_per_op << "us/op, host dispatch " << MicrosecondsPerIter(start, dispatched, iters)
+            << "us/op";
+  return Maybe<void>::Ok();
+}
+
+Maybe<void> BenchmarkStages(const DispatchCase& dispatch_case, int64_t iters) {
+  const auto& op_expr = *dispatch_case.op_expr;
+  const auto& inputs = dispatch_case.inputs;
+  const auto& device = JUST(Device::New("cpu", 0));
+  const AttrMap attrs;
+  TensorTuple outputs(op_expr.output_size());
+  JUST(OpInterpUtil::Dispatch(op_expr, inputs, &outputs, attrs));
+  JUST(vm::MultiClientSync());
+
+  // Stage 1: device/shape/dtype inference, with and without the per op expr cache.
+  MirroredTensorMetaInferArgs infer_args;
+  auto start = Clock::now();
+  FOR_RANGE(int64_t, i, 0, iters) {
+    JUST(infer_args.Init(attrs, device, inputs));
+    JUST(MirroredTensorInferCache::Infer(op_expr, infer_args, inputs, &outputs));
+  }
+  const double infer_us = MicrosecondsPerIter(start, Clock::now(), iters);
+  auto* infer_cache = op_expr.mut_mirrored_tensor_infer_cache();
+  start = Clock::now();
+  FOR_RANGE(int64_t, i, 0, iters) {
+    JUST(infer_args.Init(attrs, device, inputs));
+    JUST(infer_cache->GetOrInfer(infer_args, inputs, &outputs));
+  }
+  const double cached_infer_us = MicrosecondsPerIter(start, Clock::now(), iters);
+
+  // Stage 2: building the LocalCallOpKernel instruction.
+  auto input_eager_blob_objects = std::make_shared<EagerBlobObjectList>(inputs.size());
+  FOR_RANGE(int64_t, i, 0, inputs.size()) {
+    input_eager_blob_objects->at(i) = JUST(inputs.at(i)->eager_blob_object());
+  }
+  auto output_eager_blob_objects = std::make_shared<EagerBlobObjectList>(outputs.size());
+  FOR_RANGE(int64_t, i, 0, outputs.size()) {
+    output_eager_blob_objects->at(i) = JUST(outputs.at(i)->eager_blob_object());
+  }
+  const auto& kernel = JUST(op_expr.MutKernel4Device(*device));
+  const auto& instr_type_name = JUST(device->local_call_instruction_name());
+  const OpExprInterpContext ctx(attrs);
+  const auto& id_generator = std::make_shared<vm::PhysicalIdGenerator>();
+  vm::InstructionMsgList instruction_list;
+  vm::cfg::EagerSymbolList eager_symbol_list;
+  start = Clock::now();
+  FOR_RANGE(int64_t, i, 0, iters) {
+    // the builder clears its instruction list on destruction
+    InstructionsBuilder builder(id_generator, &instruction_list, &eager_symbol_list);
+    JUST(builder.LocalCallOpKernel(kernel, input_eager_blob_objects, output_eager_blob_objects,
+                                   ctx, device->parallel_desc_ptr(), instr_type_name));
+  }
+  const double build_us = MicrosecondsPerIter(start, Clock::now(), iters);
+
+  // Stage 3 and 4: a private vm driven by this thread so that scheduling and the kernel compute
+  // done by the worker thread context can be timed apart.
+  const Resource& resource = Global<ResourceDesc, ForSession>::Get()->resource();
+  auto virtual_machine = ObjectMsgPtr<vm::VirtualMachine>::New(vm::MakeVmDesc(resource, 0).Get());
+  Clock::duration schedule_duration = Clock::duration::zero();
+  Clock::duration compute_duration = Clock::duration::zero();
+  FOR_RANGE(int64_t, i, 0, iters) {
+    InstructionsBuilder builder(id_generator, &instruction_list, &eager_symbol_list);
+    JUST(builder.LocalCallOpKernel(kernel, input_eager_blob_objects, output_eager_blob_objects,
+                                   ctx, device->parallel_desc_ptr(), instr_type_name));
+    virtual_machine->Receive(&instruction_list);
+    while (!virtual_machine->Empty()) {
+      const auto schedule_start = Clock::now();
+      virtual_machine->Schedule();
+      const auto compute_start = Clock::now();
+      OBJECT_MSG_LIST_UNSAFE_FOR_EACH_PTR(virtual_machine->mut_thread_ctx_list(), thread_ctx) {
+        thread_ctx->TryReceiveAndRun();
+      }
+      const auto compute_end = Clock::now();
+      schedule_duration += compute_start - schedule_start;
+      compute_duration += compute_end - compute_start;
+    }
+  }
+  LOG(INFO) << dispatch_case.name << " stages: infer " << infer_us << "us (cached "
+            << cached_infer_us << "us, " << infer_cache->hit_count() << " hits/"
+            << infer_cache->miss_count() << " misses), build instruction " << build_us
+            << "us, vm schedule " << Microseconds(schedule_duration, iters)
+            << "us, kernel compute " << Microseconds(compute_duration, iters) << "us";
+  return Maybe<void>::Ok();
+}
+
+}  // namespace
+
+TEST(EagerMirroredOpInterpreter, DISABLED_benchmark_dispatch) {
+  TestEagerEnvScope env_scope;
+  const int64_t kIters = 2000;
+  const auto& cases = CHECK_JUST(MakeDispatchCases());
+  for (const auto& dispatch_case : *cases) {
+    CHECK_JUST(BenchmarkEndToEnd(dispatch_case, kIters));
+    CHECK_JUST(BenchmarkStages(dispatch_case, kIters));
+  }
+  CHECK_JUST(vm::MultiClientSync());
+}
+
+}  // namespace test
+}  // namespace one
+}  // namespace oneflow
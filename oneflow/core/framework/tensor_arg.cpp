@@ -21,11 +21,19 @@ limitations under the License.
 namespace oneflow {
 namespace one {
 
-bool TensorArg::Empty() const { return !acc_tensor_; }
+bool TensorArg::Empty() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return !acc_tensor_ && deferred_partial_tensors_.empty();
+}
 
-void TensorArg::Release() { acc_tensor_.reset(); }
+void TensorArg::Release() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  acc_tensor_.reset();
+  deferred_partial_tensors_.clear();
+}
 
 Maybe<void> TensorArg::PushPartialTensor(const std::shared_ptr<Tensor>& partial_tensor) {
+  std::unique_lock<std::mutex> lock(mutex_);
   if (!acc_tensor_) {
     acc_tensor_ = partial_tensor;
   } else {
@@ -34,8 +42,38 @@ Maybe<void> TensorArg::PushPartialTensor(const std::shared_ptr<Tensor>& partial_
   return Maybe<void>::Ok();
 }
 
+Maybe<void> TensorArg::PushPartialTensor(const std::shared_ptr<Tensor>& partial_tensor,
+                                         int64_t order) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  deferred_partial_tensors_.emplace_back(order, partial_tensor);
+  return Maybe<void>::Ok();
+}
+
+Maybe<void> TensorArg::AccDeferredPartialTensors() {
+  // stable so that partial tensors pushed by the same producer keep their order
+  std::stable_sort(deferred_partial_tensors_.begin(), deferred_partial_tensors_.end(),
+                   [](const std::pair<int64_t, std::shared_ptr<Tensor>>& lhs,
+                      const std::pair<int64_t, std::shared_ptr<Tensor>>& rhs) {
+                     return lhs.first < rhs.first;
+                   });
+  TensorTuple partial_tensors;
+  partial_tensors.reserve(deferred_partial_tensors_.size() + 1);
+  if (acc_tensor_) { partial_tensors.push_back(acc_tensor_); }
+  for (const auto& pair : deferred_partial_tensors_) { partial_tensors.push_back(pair.second); }
+  deferred_partial_tensors_.clear();
+  if (partial_tensors.size() == 1) {
+    acc_tensor_ = partial_tensors.at(0);
+  } else {
+    // a single add_n rather than one add per partial tensor
+    acc_tensor_ = JUST(functional::AddN(partial_tensors, /*inplace=*/true));
+  }
+  return Maybe<void>::Ok();
+}
+
 Maybe<Tensor> TensorArg::GetAccTensor() {
-  CHECK_OR_RETURN(Empty() == false) << "Can not GetAccTensor because it is empty";
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!deferred_partial_tensors_.empty()) { JUST(AccDeferredPartialTensors()); }
+  CHECK_OR_RETURN(static_cast<bool>(acc_tensor_)) << "Can not GetAccTensor because it is empty";
   return acc_tensor_;
 }
 
@@ -18,6 +18,7 @@ limitations under the License.
 #define ONEFLOW_CORE_FRAMEWORK_TENSOR_ARG_H_
 
 #include <memory>
+#include <mutex>
 #include <vector>
 #include "oneflow/core/common/util.h"
 
@@ -38,10 +39,18 @@ class TensorArg final {
   bool Empty() const;
   void Release();
   Maybe<void> PushPartialTensor(const std::shared_ptr<Tensor>& partial_tensor);
+  // Defers the sum to GetAccTensor, which adds up deferred partial tensors in ascending `order`
+  // so that the result does not depend on the order they are pushed in.
+  Maybe<void> PushPartialTensor(const std::shared_ptr<Tensor>& partial_tensor, int64_t order);
   Maybe<Tensor> GetAccTensor();
 
  private:
+  Maybe<void> AccDeferredPartialTensors();
+
+  // partial tensors may be pushed by several backward threads at the same time
+  mutable std::mutex mutex_;
   std::shared_ptr<Tensor> acc_tensor_;
+  std::vector<std::pair<int64_t, std::shared_ptr<Tensor>>> deferred_partial_tensors_;
 };
 
 }  // namespace one
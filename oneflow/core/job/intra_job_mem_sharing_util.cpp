@@ -22,6 +22,7 @@ limitations under the License.
 #include "oneflow/core/thread/thread_pool.h"
 #include "oneflow/core/graph/task_node.h"
 #include "oneflow/core/job/plan_util.h"
+#include "oneflow/core/job/mem_block_offset_planner.h"
 
 namespace oneflow {
 
@@ -29,6 +30,7 @@ enum MemAllocAlgoType {
   kMemSizeFirstAlgo = 0,
   kMutualExclusionFirstAlgo = 1,
   kTimeLineAlgo = 2,
+  kRefinedBestFitAlgo = 3,
 };
 
 }  // namespace oneflow
@@ -688,11 +690,69 @@ void MemReusedAlgorithm_TimeLineAlgo(
   result->mem_block_size = bfc_allocator.buffer_size();
 }
 
+void GenBufferLiveRanges(const std::vector<HashSet<RegstDescProto*>>& alloc_regsts_timeline,
+                         const std::vector<HashSet<RegstDescProto*>>& free_regsts_timeline,
+                         std::vector<RegstDescProto*>* regsts,
+                         std::vector<BufferLiveRange>* buffers) {
+  CHECK_EQ(alloc_regsts_timeline.size(), free_regsts_timeline.size());
+  HashMap<RegstDescProto*, int64_t> regst2index;
+  for (int64_t i = 0; i < alloc_regsts_timeline.size(); ++i) {
+    // sort by id, so the plan does not depend on the iteration order of the hash set
+    std::vector<RegstDescProto*> alloc_regsts(alloc_regsts_timeline.at(i).begin(),
+                                              alloc_regsts_timeline.at(i).end());
+    std::sort(alloc_regsts.begin(), alloc_regsts.end(),
+              [](const RegstDescProto* lhs, const RegstDescProto* rhs) {
+                return lhs->regst_desc_id() < rhs->regst_desc_id();
+              });
+    for (RegstDescProto* alloc_regst : alloc_regsts) {
+      CHECK(regst2index.emplace(alloc_regst, regsts->size()).second);
+      regsts->push_back(alloc_regst);
+      BufferLiveRange buffer;
+      buffer.size = RtRegstDesc(*alloc_regst).TotalMainByteSize4AllRegst();
+      buffer.first_step = i;
+      buffer.last_step = -1;
+      buffers->push_back(buffer);
+    }
+    for (RegstDescProto* free_regst : free_regsts_timeline.at(i)) {
+      buffers->at(regst2index.at(free_regst)).last_step = i;
+    }
+  }
+  for (const BufferLiveRange& buffer : *buffers) { CHECK_GE(buffer.last_step, buffer.first_step); }
+}
+
+// Lower bound of the mem block size of the regsts in a mem chain
+int64_t MemBlockSizeLowerBound4Regsts(
+    const std::vector<HashSet<RegstDescProto*>>& alloc_regsts_timeline,
+    const std::vector<HashSet<RegstDescProto*>>& free_regsts_timeline) {
+  std::vector<RegstDescProto*> regsts;
+  std::vector<BufferLiveRange> buffers;
+  GenBufferLiveRanges(alloc_regsts_timeline, free_regsts_timeline, &regsts, &buffers);
+  return MemBlockSizeLowerBound(buffers);
+}
+
+void MemReusedAlgorithm_RefinedBestFitAlgo(
+    const std::vector<HashSet<RegstDescProto*>>& alloc_regsts_timeline,
+    const std::vector<HashSet<RegstDescProto*>>& free_regsts_timeline, int64_t time_budget_ms,
+    MemBlockResultInfo* result) {
+  std::vector<RegstDescProto*> regsts;
+  std::vector<BufferLiveRange> buffers;
+  GenBufferLiveRanges(alloc_regsts_timeline, free_regsts_timeline, &regsts, &buffers);
+  std::vector<int64_t> offsets;
+  const int64_t mem_block_size =
+      PlanMemBlockOffsetsByRefinedBestFit(buffers, time_budget_ms, &offsets);
+  HashMap<RegstDescProto*, int64_t>* regst_desc2offset = &(result->regst_desc2offset);
+  regst_desc2offset->clear();
+  FOR_RANGE(int64_t, i, 0, regsts.size()) {
+    CHECK(regst_desc2offset->emplace(regsts.at(i), offsets.at(i)).second);
+  }
+  result->mem_block_size = std::max<int64_t>(mem_block_size, 1);
+}
+
 void SelectAlgorithmGenMemBlockOffset4Regsts(
     MemAllocAlgoType algo_id, const std::vector<HashSet<RegstDescProto*>>& alloc_regsts_timeline,
     const std::vector<HashSet<RegstDescProto*>>& free_regsts_timeline,
     const HashMap<RegstDescProto*, std::vector<RegstDescProto*>>& regst2mutual_exclusion_regsts,
-    MemBlockResultInfo* result) {
+    int64_t refined_best_fit_time_budget_ms, MemBlockResultInfo* result) {
   CHECK_EQ(result->mem_block_size, 0);
   CHECK(result->regst_desc2offset.empty());
   switch (algo_id) {
@@ -705,6 +765,10 @@ void SelectAlgorithmGenMemBlockOffset4Regsts(
     case kTimeLineAlgo:
       MemReusedAlgorithm_TimeLineAlgo(alloc_regsts_timeline, free_regsts_timeline, result);
       break;
+    case kRefinedBestFitAlgo:
+      MemReusedAlgorithm_RefinedBestFitAlgo(alloc_regsts_timeline, free_regsts_timeline,
+                                            refined_best_fit_time_budget_ms, result);
+      break;
     default: UNIMPLEMENTED();
   }
   CHECK_GT(result->mem_block_size, 0);
@@ -718,6 +782,7 @@ int64_t CountMemAllocAlgoNum() {
   if (mem_alloc_algo_conf.use_mem_size_first_algo()) { ++ret; }
   if (mem_alloc_algo_conf.use_mutual_exclusion_first_algo()) { ++ret; }
   if (mem_alloc_algo_conf.use_time_line_algo()) { ++ret; }
+  if (mem_alloc_algo_conf.use_refined_best_fit_algo()) { ++ret; }
   CHECK_GE(ret, 0);
   return ret;
 }
@@ -735,6 +800,20 @@ void InitAlgo2Result(HashMap<MemAllocAlgoType, MemBlockResultInfo>* algo2result)
   if (mem_alloc_algo_conf.use_time_line_algo()) {
     CHECK(algo2result->emplace(kTimeLineAlgo, MemBlockResultInfo()).second);
   }
+  if (mem_alloc_algo_conf.use_refined_best_fit_algo()) {
+    CHECK(algo2result->emplace(kRefinedBestFitAlgo, MemBlockResultInfo()).second);
+  }
+}
+
+std::string MemAllocAlgoName(MemAllocAlgoType algo_id) {
+  switch (algo_id) {
+    case kMemSizeFirstAlgo: return "mem_size_first";
+    case kMutualExclusionFirstAlgo: return "mutual_exclusion_first";
+    case kTimeLineAlgo: return "time_line";
+    case kRefinedBestFitAlgo: return "refined_best_fit";
+    default: UNIMPLEMENTED();
+  }
+  return "";
 }
 
 }  // namespace
@@ -772,6 +851,10 @@ void IntraJobMemSharingUtil::InferMemBlockId4MemReusedRegst(
   // step 2: multi-thread run several algorithm for each mem chain
   HashMap<int64_t, HashMap<MemAllocAlgoType, MemBlockResultInfo>> mem_chain2algo2result;
   {
+    const MemoryAllocationAlgorithmConf& mem_alloc_algo_conf =
+        GlobalJobDesc().job_conf().memory_allocation_algorithm_conf();
+    const int64_t refined_best_fit_time_budget_ms =
+        mem_alloc_algo_conf.refined_best_fit_time_budget_ms();
     int64_t work_size = mem_chain2mem_reused_regsts.size() * CountMemAllocAlgoNum();
     int64_t thread_pool_size = std::min<int64_t>(work_size, std::thread::hardware_concurrency());
     BlockingCounter counter(work_size);
@@ -783,11 +866,12 @@ void IntraJobMemSharingUtil::InferMemBlockId4MemReusedRegst(
         MemBlockResultInfo* result = &pair.second;
         thread_pool.AddWork([algo_id, mem_chain_id, &mem_chain2task2alloc_regsts,
                              &mem_chain2task2free_regsts, &mem_chain2regst2mutual_exclusion_regsts,
-                             result, &counter]() {
+                             refined_best_fit_time_budget_ms, result, &counter]() {
           SelectAlgorithmGenMemBlockOffset4Regsts(
               algo_id, mem_chain2task2alloc_regsts.at(mem_chain_id),
               mem_chain2task2free_regsts.at(mem_chain_id),
-              mem_chain2regst2mutual_exclusion_regsts.at(mem_chain_id), result);
+              mem_chain2regst2mutual_exclusion_regsts.at(mem_chain_id),
+              refined_best_fit_time_budget_ms, result);
           counter.Decrease();
         });
       }
@@ -798,12 +882,29 @@ void IntraJobMemSharingUtil::InferMemBlockId4MemReusedRegst(
   // step 3: choose best one for each mem chain and set offset for inplace consumer regst
   for (const auto& pair : mem_chain2algo2result) {
     const MemBlockResultInfo* best_result = nullptr;
+    MemAllocAlgoType best_algo_id = kMemSizeFirstAlgo;
     for (const auto& algo_result_pair : pair.second) {
       if (!best_result || algo_result_pair.second.mem_block_size < best_result->mem_block_size) {
         best_result = &algo_result_pair.second;
+        best_algo_id = algo_result_pair.first;
       }
     }
     CHECK(best_result != nullptr);
+    {
+      const int64_t lower_bound = MemBlockSizeLowerBound4Regsts(
+          mem_chain2task2alloc_regsts.at(pair.first), mem_chain2task2free_regsts.at(pair.first));
+      std::ostringstream algo_results;
+      for (const auto& algo_result_pair : pair.second) {
+        const int64_t mem_block_size = algo_result_pair.second.mem_block_size;
+        const double gap = lower_bound > 0 ? 100.0 * (mem_block_size - lower_bound) / lower_bound
+                                           : 0.0;
+        algo_results << " " << MemAllocAlgoName(algo_result_pair.first) << ": " << mem_block_size
+                     << " (+" << gap << "%)";
+      }
+      LOG(INFO) << "mem chain " << pair.first << " with " << best_result->regst_desc2offset.size()
+                << " regsts, mem block size lower bound: " << lower_bound << ","
+                << algo_results.str() << ", choose " << MemAllocAlgoName(best_algo_id);
+    }
     int64_t mem_block_id = Global<IDMgr>::Get()->NewMemBlockId();
     CHECK_EQ(mem_chain2mem_reused_regsts.at(pair.first).size(),
              (best_result->regst_desc2offset.size()
@@ -0,0 +1,208 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/job/mem_block_offset_planner.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+
+namespace {
+
+// Buffers conflict if their live ranges intersect.
+std::vector<std::vector<int32_t>> GenConflicts(const std::vector<BufferLiveRange>& buffers) {
+  std::vector<int32_t> sorted(buffers.size());
+  for (int32_t i = 0; i < buffers.size(); ++i) { sorted.at(i) = i; }
+  std::sort(sorted.begin(), sorted.end(), [&](int32_t lhs, int32_t rhs) {
+    return buffers.at(lhs).first_step < buffers.at(rhs).first_step;
+  });
+  std::vector<std::vector<int32_t>> conflicts(buffers.size());
+  std::vector<int32_t> alive;
+  for (int32_t buffer : sorted) {
+    const int64_t first_step = buffers.at(buffer).first_step;
+    const auto IsReleased = [&](int32_t other) { return buffers.at(other).last_step < first_step; };
+    alive.erase(std::remove_if(alive.begin(), alive.end(), IsReleased), alive.end());
+    for (int32_t other : alive) {
+      conflicts.at(buffer).push_back(other);
+      conflicts.at(other).push_back(buffer);
+    }
+    alive.push_back(buffer);
+  }
+  return conflicts;
+}
+
+class BestFitPlacer final {
+ public:
+  explicit BestFitPlacer(const std::vector<BufferLiveRange>& buffers)
+      : buffers_(buffers),
+        conflicts_(GenConflicts(buffers)),
+        position_(buffers.size()),
+        top_buffer_(0) {}
+  ~BestFitPlacer() = default;
+
+  // Places buffers order[from:] one after another, offsets of order[:from] are kept.
+  // Returns the mem block size.
+  int64_t Place(const std::vector<int32_t>& order, int64_t from, std::vector<int64_t>* offsets);
+  // Position in the order of a buffer which ends at the top of the mem block in the last placement
+  int64_t top_buffer_position() const { return position_.at(top_buffer_); }
+
+ private:
+  int64_t BestFitOffset(int32_t buffer, const std::vector<int64_t>& offsets);
+
+  const std::vector<BufferLiveRange>& buffers_;
+  std::vector<std::vector<int32_t>> conflicts_;
+  std::vector<int64_t> position_;
+  int32_t top_buffer_;
+  // [begin, end) of placed conflicting buffers
+  std::vector<std::pair<int64_t, int64_t>> occupied_;
+};
+
+int64_t BestFitPlacer::Place(const std::vector<int32_t>& order, int64_t from,
+                             std::vector<int64_t>* offsets) {
+  for (int64_t i = 0; i < order.size(); ++i) { position_.at(order.at(i)) = i; }
+  for (int64_t i = from; i < order.size(); ++i) {
+    offsets->at(order.at(i)) = BestFitOffset(order.at(i), *offsets);
+  }
+  int64_t mem_block_size = 0;
+  for (int32_t i = 0; i < buffers_.size(); ++i) {
+    if (offsets->at(i) + buffers_.at(i).size > mem_block_size) {
+      mem_block_size = offsets->at(i) + buffers_.at(i).size;
+      top_buffer_ = i;
+    }
+  }
+  return mem_block_size;
+}
+
+int64_t BestFitPlacer::BestFitOffset(int32_t buffer, const std::vector<int64_t>& offsets) {
+  const int64_t position = position_.at(buffer);
+  occupied_.clear();
+  for (int32_t other : conflicts_.at(buffer)) {
+    if (position_.at(other) < position) {
+      occupied_.emplace_back(offsets.at(other), offsets.at(other) + buffers_.at(other).size);
+    }
+  }
+  std::sort(occupied_.begin(), occupied_.end());
+  const int64_t size = buffers_.at(buffer).size;
+  int64_t best_offset = -1;
+  int64_t best_gap = 0;
+  int64_t top = 0;
+  for (const auto& range : occupied_) {
+    const int64_t gap = range.first - top;
+    if (gap >= size && (best_offset == -1 || gap < best_gap)) {
+      best_offset = top;
+      best_gap = gap;
+    }
+    top = std::max(top, range.second);
+  }
+  return best_offset == -1 ? top : best_offset;
+}
+
+std::vector<int32_t> BestFitDecreasingOrder(const std::vector<BufferLiveRange>& buffers) {
+  std::vector<int32_t> order(buffers.size());
+  for (int32_t i = 0; i < buffers.size(); ++i) { order.at(i) = i; }
+  // longer lived buffers first among buffers of the same size, they conflict with more buffers
+  std::stable_sort(order.begin(), order.end(), [&](int32_t lhs, int32_t rhs) {
+    const BufferLiveRange& l = buffers.at(lhs);
+    const BufferLiveRange& r = buffers.at(rhs);
+    if (l.size != r.size) { return l.size > r.size; }
+    return l.last_step - l.first_step > r.last_step - r.first_step;
+  });
+  return order;
+}
+
+}  // namespace
+
+int64_t MemBlockSizeLowerBound(const std::vector<BufferLiveRange>& buffers) {
+  // (step, size delta), a buffer is released in the step after its last one
+  std::vector<std::pair<int64_t, int64_t>> events;
+  events.reserve(buffers.size() * 2);
+  for (const BufferLiveRange& buffer : buffers) {
+    CHECK_LE(buffer.first_step, buffer.last_step);
+    events.emplace_back(buffer.first_step, buffer.size);
+    events.emplace_back(buffer.last_step + 1, -buffer.size);
+  }
+  // releases go before allocations of the same step
+  std::sort(events.begin(), events.end());
+  int64_t alive_size = 0;
+  int64_t max_alive_size = 0;
+  for (const auto& event : events) {
+    alive_size += event.second;
+    max_alive_size = std::max(max_alive_size, alive_size);
+  }
+  return max_alive_size;
+}
+
+int64_t PlanMemBlockOffsetsByBestFitDecreasing(const std::vector<BufferLiveRange>& buffers,
+                                               std::vector<int64_t>* offsets) {
+  offsets->assign(buffers.size(), 0);
+  BestFitPlacer placer(buffers);
+  return placer.Place(BestFitDecreasingOrder(buffers), 0, offsets);
+}
+
+int64_t PlanMemBlockOffsetsByRefinedBestFit(const std::vector<BufferLiveRange>& buffers,
+                                            int64_t time_budget_ms, std::vector<int64_t>* offsets) {
+  offsets->assign(buffers.size(), 0);
+  BestFitPlacer placer(buffers);
+  std::vector<int32_t> order = BestFitDecreasingOrder(buffers);
+  const int64_t init_size = placer.Place(order, 0, offsets);
+  const int64_t lower_bound = MemBlockSizeLowerBound(buffers);
+  if (buffers.size() < 2 || init_size <= lower_bound) { return init_size; }
+
+  int64_t cur_size = init_size;
+  int64_t best_size = init_size;
+  std::vector<int64_t> best_offsets = *offsets;
+  std::vector<int64_t> prev_offsets;
+  // fixed seed so that the same buffers get the same plan within the same number of iterations
+  std::mt19937 gen(buffers.size());
+  std::uniform_int_distribution<int32_t> pick(0, buffers.size() - 1);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  const auto start = std::chrono::steady_clock::now();
+  const double budget_ms = std::max<int64_t>(time_budget_ms, 0);
+  while (best_size > lower_bound) {
+    const double elapsed_ms =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+            .count();
+    if (elapsed_ms >= budget_ms) { break; }
+    // cools down linearly from 1% of the initial mem block size to 0
+    const double temperature = 0.01 * init_size * (1.0 - elapsed_ms / budget_ms);
+    int32_t i = pick(gen);
+    int32_t j = pick(gen);
+    // half of the moves place a buffer at the top of the mem block earlier
+    if (unit(gen) < 0.5) { j = placer.top_buffer_position(); }
+    if (i == j) { continue; }
+    if (i > j) { std::swap(i, j); }
+    std::swap(order.at(i), order.at(j));
+    prev_offsets = *offsets;
+    const int64_t size = placer.Place(order, i, offsets);
+    const int64_t delta = size - cur_size;
+    if (delta <= 0 || (temperature > 0 && unit(gen) < std::exp(-delta / temperature))) {
+      cur_size = size;
+      if (size < best_size) {
+        best_size = size;
+        best_offsets = *offsets;
+      }
+    } else {
+      std::swap(order.at(i), order.at(j));
+      offsets->swap(prev_offsets);
+    }
+  }
+  offsets->swap(best_offsets);
+  return best_size;
+}
+
+}  // namespace oneflow
@@ -0,0 +1,48 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_JOB_MEM_BLOCK_OFFSET_PLANNER_H_
+#define ONEFLOW_CORE_JOB_MEM_BLOCK_OFFSET_PLANNER_H_
+
+#include <vector>
+#include <cstdint>
+
+namespace oneflow {
+
+// A buffer to be placed in a mem block, alive from time step `first_step` to `last_step`
+// inclusively. Buffers alive at a same time step must not overlap in the mem block.
+struct BufferLiveRange {
+  int64_t size;
+  int64_t first_step;
+  int64_t last_step;
+};
+
+// Max total size of buffers alive at a same time step, no plan fits in a smaller mem block.
+int64_t MemBlockSizeLowerBound(const std::vector<BufferLiveRange>& buffers);
+
+// Places buffers in descending size order, each one into the smallest gap between the already
+// placed buffers alive at the same time which fits it, or on top of them if none does.
+// Returns the mem block size, offsets are indexed as buffers.
+int64_t PlanMemBlockOffsetsByBestFitDecreasing(const std::vector<BufferLiveRange>& buffers,
+                                               std::vector<int64_t>* offsets);
+
+// Starts from the best fit decreasing order and refines it by simulated annealing on swaps of two
+// buffers in the order, until `time_budget_ms` is used up or the lower bound is reached.
+int64_t PlanMemBlockOffsetsByRefinedBestFit(const std::vector<BufferLiveRange>& buffers,
+                                            int64_t time_budget_ms, std::vector<int64_t>* offsets);
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_JOB_MEM_BLOCK_OFFSET_PLANNER_H_
@@ -0,0 +1,117 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "gtest/gtest.h"
+#include <random>
+#include "oneflow/core/job/mem_block_offset_planner.h"
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+std::vector<BufferLiveRange> GenRandomBuffers(int64_t buffer_num, int64_t step_num, int seed) {
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<int64_t> step(0, step_num - 1);
+  std::uniform_int_distribution<int64_t> length(0, step_num / 8);
+  std::uniform_int_distribution<int64_t> size(1, 1024);
+  std::vector<BufferLiveRange> buffers(buffer_num);
+  for (BufferLiveRange& buffer : buffers) {
+    buffer.size = size(gen) * 512;
+    buffer.first_step = step(gen);
+    buffer.last_step = std::min(buffer.first_step + length(gen), step_num - 1);
+  }
+  return buffers;
+}
+
+void CheckPlan(const std::vector<BufferLiveRange>& buffers, const std::vector<int64_t>& offsets,
+               int64_t mem_block_size) {
+  ASSERT_EQ(offsets.size(), buffers.size());
+  int64_t top = 0;
+  FOR_RANGE(int64_t, i, 0, buffers.size()) {
+    ASSERT_GE(offsets.at(i), 0);
+    top = std::max(top, offsets.at(i) + buffers.at(i).size);
+    FOR_RANGE(int64_t, j, 0, i) {
+      const BufferLiveRange& a = buffers.at(i);
+      const BufferLiveRange& b = buffers.at(j);
+      if (a.last_step < b.first_step || b.last_step < a.first_step) { continue; }
+      const bool disjoint =
+          offsets.at(i) + a.size <= offsets.at(j) || offsets.at(j) + b.size <= offsets.at(i);
+      ASSERT_TRUE(disjoint) << "buffer " << i << " overlaps buffer " << j;
+    }
+  }
+  ASSERT_EQ(top, mem_block_size);
+}
+
+}  // namespace
+
+TEST(MemBlockOffsetPlanner, lower_bound) {
+  std::vector<BufferLiveRange> buffers{{4, 0, 1}, {2, 1, 2}, {8, 3, 3}, {1, 3, 5}};
+  ASSERT_EQ(MemBlockSizeLowerBound(buffers), 9);
+  ASSERT_EQ(MemBlockSizeLowerBound({}), 0);
+}
+
+TEST(MemBlockOffsetPlanner, best_fit_reuses_gap) {
+  // buffer 2 and buffer 3 reuse the space of buffer 0 which is released below buffer 1
+  std::vector<BufferLiveRange> buffers{{8, 0, 0}, {6, 0, 3}, {4, 1, 3}, {2, 1, 3}};
+  std::vector<int64_t> offsets;
+  const int64_t mem_block_size = PlanMemBlockOffsetsByBestFitDecreasing(buffers, &offsets);
+  CheckPlan(buffers, offsets, mem_block_size);
+  ASSERT_EQ(mem_block_size, 14);
+  ASSERT_EQ(offsets, (std::vector<int64_t>{0, 8, 0, 4}));
+}
+
+TEST(MemBlockOffsetPlanner, random_plans) {
+  FOR_RANGE(int, seed, 0, 16) {
+    const auto buffers = GenRandomBuffers(64, 32, seed);
+    const int64_t lower_bound = MemBlockSizeLowerBound(buffers);
+    std::vector<int64_t> bfd_offsets;
+    const int64_t bfd_size = PlanMemBlockOffsetsByBestFitDecreasing(buffers, &bfd_offsets);
+    CheckPlan(buffers, bfd_offsets, bfd_size);
+    std::vector<int64_t> refined_offsets;
+    const int64_t refined_size = PlanMemBlockOffsetsByRefinedBestFit(buffers, 20, &refined_offsets);
+    CheckPlan(buffers, refined_offsets, refined_size);
+    ASSERT_GE(bfd_size, lower_bound);
+    ASSERT_GE(refined_size, lower_bound);
+    ASSERT_LE(refined_size, bfd_size);
+  }
+}
+
+TEST(MemBlockOffsetPlanner, DISABLED_benchmark_refined_best_fit) {
+  for (int64_t buffer_num : {256, 1024, 4096}) {
+    const auto buffers = GenRandomBuffers(buffer_num, buffer_num / 4, buffer_num);
+    const int64_t lower_bound = MemBlockSizeLowerBound(buffers);
+    std::vector<int64_t> offsets;
+    const int64_t bfd_size = PlanMemBlockOffsetsByBestFitDecreasing(buffers, &offsets);
+    const auto GapPercent = [&](int64_t size) {
+      return 100.0 * (size - lower_bound) / lower_bound;
+    };
+    LOG(INFO) << "buffer_num: " << buffer_num << ", lower bound: " << lower_bound
+              << ", best fit decreasing: " << bfd_size << " (+" << GapPercent(bfd_size) << "%)";
+    for (int64_t time_budget_ms : {10, 100, 1000}) {
+      const int64_t refined_size =
+          PlanMemBlockOffsetsByRefinedBestFit(buffers, time_budget_ms, &offsets);
+      CheckPlan(buffers, offsets, refined_size);
+      LOG(INFO) << "buffer_num: " << buffer_num << ", refined best fit in " << time_budget_ms
+                << "ms: " << refined_size << " (+" << GapPercent(refined_size) << "%)";
+    }
+  }
+}
+
+}  // namespace test
+
+}  // namespace oneflow
@@ -982,6 +982,7 @@ Maybe<void> CompileJobsAndMergePlans(const PbRpf<Job>& job_confs, Plan& plan) {
   if (Global<ResourceDesc, ForSession>::Get()->enable_debug_mode()) {
     TeePersistentLogStream::Create("merged_plan")->Write(plan);
     PlanUtil::ToDotFile(plan, "/dot/merged_plan.dot");
+    PlanUtil::ToMemoryReportJsonFile(plan, "merged_plan_memory_report.json");
   }
   return Maybe<void>::Ok();
 }
@@ -23,6 +23,7 @@ limitations under the License.
 #include "oneflow/core/memory/memory_case_util.h"
 #include "oneflow/core/register/runtime_register_desc.h"
 #include "oneflow/core/persistence/tee_persistent_log_stream.h"
+#include <json.hpp>
 
 namespace oneflow {
 
@@ -779,4 +780,237 @@ void PlanUtil::PopulateOpAttibute(
   }
 }
 
+namespace {
+
+std::string MemCase2DeviceName(const MemoryCase& mem_case) {
+  if (mem_case.has_device_cuda_mem()) {
+    return "gpu:" + std::to_string(mem_case.device_cuda_mem().device_id());
+  } else if (mem_case.host_mem().has_cuda_pinned_mem()) {
+    return "cpu_pinned:" + std::to_string(mem_case.host_mem().cuda_pinned_mem().device_id());
+  } else {
+    return "cpu";
+  }
+}
+
+double WastePercent(int64_t mem_size, int64_t peak_live_size) {
+  if (mem_size <= 0) { return 0.0; }
+  return 100.0 * (mem_size - peak_live_size) / mem_size;
+}
+
+// Main memory of a regst, alive from its producer to its last consumer in the same job. Time
+// steps are order_in_graph of the tasks.
+struct RegstMemInfo {
+  const RegstDescProto* regst;
+  const TaskProto* producer;
+  std::string name;
+  int64_t size;
+  int64_t first_step;
+  int64_t last_step;
+  // -1 if it owns its memory, otherwise the regst whose memory it reuses inplace
+  int64_t inplaced_regst_desc_id;
+};
+
+// Total size of regsts alive at each time step where it changes, regsts reusing memory inplace
+// are counted in the regsts they reuse.
+std::vector<std::pair<int64_t, int64_t>> GenPeakLiveTimeline(
+    const std::vector<const RegstMemInfo*>& regsts) {
+  std::map<int64_t, int64_t> step2size_delta;
+  for (const RegstMemInfo* info : regsts) {
+    if (info->inplaced_regst_desc_id != -1) { continue; }
+    step2size_delta[info->first_step] += info->size;
+    step2size_delta[info->last_step + 1] -= info->size;
+  }
+  std::vector<std::pair<int64_t, int64_t>> timeline;
+  int64_t live_size = 0;
+  for (const auto& pair : step2size_delta) {
+    live_size += pair.second;
+    timeline.emplace_back(pair.first, live_size);
+  }
+  return timeline;
+}
+
+}  // namespace
+
+void PlanUtil::ToMemoryReportJsonFile(const Plan& plan, const std::string& filepath) {
+  const size_t kTopConsumerNum = 16;
+  auto TaskProto4TaskId = MakeGetterTaskProto4TaskId(plan);
+
+  // step 1: lifetime of each regst
+  HashMap<int64_t, RegstMemInfo> regst_desc_id2info;
+  for (const TaskProto& task : plan.task()) {
+    std::string op_name = "task_" + std::to_string(task.task_id());
+    if (task.exec_sequence().exec_node_size() > 0) {
+      const KernelConf& kernel_conf = task.exec_sequence().exec_node(0).kernel_conf();
+      op_name = GetOpAttribute(&plan, task.job_id(), kernel_conf).op_conf().name();
+    }
+    for (const auto& pair : task.produced_regst_desc()) {
+      const RegstDescProto& regst = pair.second;
+      if (regst.mem_block_id() == -1 || !regst.regst_desc_type().has_data_regst_desc()) {
+        continue;
+      }
+      RegstMemInfo info;
+      info.regst = &regst;
+      info.producer = &task;
+      info.name = op_name + "/" + pair.first;
+      info.size = RtRegstDesc(regst).TotalMainByteSize4AllRegst();
+      info.first_step = task.task_set_info().order_in_graph();
+      info.last_step = info.first_step;
+      for (int64_t consumer_task_id : regst.consumer_task_id()) {
+        const TaskProto* consumer = TaskProto4TaskId(consumer_task_id);
+        if (consumer->job_id() != task.job_id()) { continue; }
+        info.last_step = std::max(info.last_step, consumer->task_set_info().order_in_graph());
+      }
+      info.inplaced_regst_desc_id = regst.inplace_consumed_regst_desc_id();
+      CHECK(regst_desc_id2info.emplace(regst.regst_desc_id(), info).second);
+    }
+  }
+  // a regst reusing memory inplace keeps the memory it reuses alive
+  for (auto& pair : regst_desc_id2info) {
+    RegstMemInfo* info = &pair.second;
+    if (info->inplaced_regst_desc_id == -1) { continue; }
+    RegstMemInfo* root = &regst_desc_id2info.at(info->inplaced_regst_desc_id);
+    while (root->inplaced_regst_desc_id != -1) {
+      root = &regst_desc_id2info.at(root->inplaced_regst_desc_id);
+    }
+    info->inplaced_regst_desc_id = root->regst->regst_desc_id();
+    root->last_step = std::max(root->last_step, info->last_step);
+  }
+
+  // step 2: group regsts by device and mem block
+  HashMap<int64_t, const MemBlockProto*> mem_block_id2mem_block;
+  for (const MemBlockProto& mem_block : plan.block_chunk_list().mem_block()) {
+    mem_block_id2mem_block.emplace(mem_block.mem_block_id(), &mem_block);
+  }
+  std::map<std::pair<int64_t, std::string>, std::map<int64_t, std::vector<const RegstMemInfo*>>>
+      device2mem_block_id2regsts;
+  for (const auto& pair : regst_desc_id2info) {
+    const RegstMemInfo& info = pair.second;
+    const auto device =
+        std::make_pair(info.producer->machine_id(), MemCase2DeviceName(info.regst->mem_case()));
+    device2mem_block_id2regsts[device][info.regst->mem_block_id()].push_back(&info);
+  }
+
+  // step 3: report each device
+  nlohmann::json report;
+  report["devices"] = nlohmann::json::array();
+  for (auto& device_pair : device2mem_block_id2regsts) {
+    int64_t device_mem_size = 0;
+    int64_t device_peak_live_size = 0;
+    int64_t device_register_num_extra_size = 0;
+    std::vector<const RegstMemInfo*> device_regsts;
+    nlohmann::json mem_blocks_json = nlohmann::json::array();
+    for (auto& mem_block_pair : device_pair.second) {
+      std::vector<const RegstMemInfo*>* regsts = &mem_block_pair.second;
+      std::sort(regsts->begin(), regsts->end(),
+                [](const RegstMemInfo* lhs, const RegstMemInfo* rhs) {
+                  return lhs->regst->regst_desc_id() < rhs->regst->regst_desc_id();
+                });
+      int64_t mem_size = 0;
+      for (const RegstMemInfo* info : *regsts) {
+        mem_size = std::max(mem_size, info->regst->mem_block_offset() + info->size);
+      }
+      nlohmann::json mem_block_json;
+      mem_block_json["mem_block_id"] = mem_block_pair.first;
+      auto mem_block_it = mem_block_id2mem_block.find(mem_block_pair.first);
+      if (mem_block_it != mem_block_id2mem_block.end()) {
+        const MemBlockProto* mem_block = mem_block_it->second;
+        mem_size = mem_block->mem_size();
+        mem_block_json["job_ids"] =
+            std::vector<int64_t>(mem_block->job_id().begin(), mem_block->job_id().end());
+        mem_block_json["enable_reuse_mem"] = mem_block->enable_reuse_mem();
+        mem_block_json["chunk_id"] = mem_block->chunk_id();
+        if (!mem_block->variable_op_name().empty()) {
+          mem_block_json["variable_op_name"] = mem_block->variable_op_name();
+        }
+      }
+      // regsts of different jobs never run at the same time
+      std::map<int64_t, std::vector<const RegstMemInfo*>> job_id2regsts;
+      for (const RegstMemInfo* info : *regsts) {
+        job_id2regsts[info->producer->job_id()].push_back(info);
+      }
+      int64_t peak_live_size = 0;
+      nlohmann::json timeline_json = nlohmann::json::array();
+      for (const auto& job_pair : job_id2regsts) {
+        for (const auto& step_size_pair : GenPeakLiveTimeline(job_pair.second)) {
+          peak_live_size = std::max(peak_live_size, step_size_pair.second);
+          timeline_json.push_back({{"job_id", job_pair.first},
+                                   {"step", step_size_pair.first},
+                                   {"live_size", step_size_pair.second}});
+        }
+      }
+      mem_block_json["mem_size"] = mem_size;
+      mem_block_json["peak_live_size"] = peak_live_size;
+      mem_block_json["waste_percent"] = WastePercent(mem_size, peak_live_size);
+      mem_block_json["regst_desc_ids"] = nlohmann::json::array();
+      for (const RegstMemInfo* info : *regsts) {
+        mem_block_json["regst_desc_ids"].push_back(info->regst->regst_desc_id());
+      }
+      if (regsts->size() > 1) { mem_block_json["peak_live_timeline"] = timeline_json; }
+      mem_blocks_json.push_back(mem_block_json);
+
+      device_mem_size += mem_size;
+      device_peak_live_size += peak_live_size;
+      for (const RegstMemInfo* info : *regsts) {
+        if (info->inplaced_regst_desc_id != -1) { continue; }
+        device_register_num_extra_size +=
+            info->size - info->size / std::max<int64_t>(info->regst->register_num(), 1);
+      }
+      device_regsts.insert(device_regsts.end(), regsts->begin(), regsts->end());
+    }
+
+    nlohmann::json regsts_json = nlohmann::json::array();
+    for (const RegstMemInfo* info : device_regsts) {
+      nlohmann::json regst_json;
+      regst_json["regst_desc_id"] = info->regst->regst_desc_id();
+      regst_json["name"] = info->name;
+      regst_json["job_id"] = info->producer->job_id();
+      regst_json["mem_block_id"] = info->regst->mem_block_id();
+      regst_json["mem_block_offset"] = info->regst->mem_block_offset();
+      regst_json["size"] = info->size;
+      regst_json["register_num"] = info->regst->register_num();
+      regst_json["first_step"] = info->first_step;
+      regst_json["last_step"] = info->last_step;
+      if (info->inplaced_regst_desc_id != -1) {
+        regst_json["inplaced_regst_desc_id"] = info->inplaced_regst_desc_id;
+      }
+      regsts_json.push_back(regst_json);
+    }
+    std::stable_sort(device_regsts.begin(), device_regsts.end(),
+                     [](const RegstMemInfo* lhs, const RegstMemInfo* rhs) {
+                       const bool lhs_owns_mem = lhs->inplaced_regst_desc_id == -1;
+                       const bool rhs_owns_mem = rhs->inplaced_regst_desc_id == -1;
+                       if (lhs_owns_mem != rhs_owns_mem) { return lhs_owns_mem; }
+                       return lhs->size > rhs->size;
+                     });
+    nlohmann::json top_consumers_json = nlohmann::json::array();
+    for (const RegstMemInfo* info : device_regsts) {
+      if (top_consumers_json.size() >= kTopConsumerNum) { break; }
+      if (info->inplaced_regst_desc_id != -1) { break; }
+      top_consumers_json.push_back({{"regst_desc_id", info->regst->regst_desc_id()},
+                                    {"name", info->name},
+                                    {"size", info->size},
+                                    {"register_num", info->regst->register_num()}});
+    }
+
+    nlohmann::json device_json;
+    device_json["machine_id"] = device_pair.first.first;
+    device_json["device"] = device_pair.first.second;
+    device_json["mem_size"] = device_mem_size;
+    device_json["peak_live_size"] = device_peak_live_size;
+    device_json["waste_percent"] = WastePercent(device_mem_size, device_peak_live_size);
+    device_json["register_num_extra_size"] = device_register_num_extra_size;
+    device_json["top_consumers"] = top_consumers_json;
+    device_json["mem_blocks"] = mem_blocks_json;
+    device_json["regsts"] = regsts_json;
+    report["devices"].push_back(device_json);
+
+    LOG(INFO) << "machine " << device_pair.first.first << " " << device_pair.first.second
+              << " plan memory: " << device_mem_size << " bytes, peak live: "
+              << device_peak_live_size << " bytes, waste: "
+              << WastePercent(device_mem_size, device_peak_live_size)
+              << "%, extra by register_num: " << device_register_num_extra_size << " bytes";
+  }
+  TeePersistentLogStream::Create(filepath)->Write(report.dump(2));
+}
+
 }  // namespace oneflow
@@ -33,6 +33,8 @@ struct PlanUtil {
       Plan* plan, const HashSet<std::string>& variable_op_names);
   static void CleanUselessMemBlockAndCheckValid(Plan* plan);
   static void ToDotFile(const Plan& plan, const std::string& filepath);
+  // Per device mem blocks, regst lifetimes, peak live timelines, waste and top consumers
+  static void ToMemoryReportJsonFile(const Plan& plan, const std::string& filepath);
   static std::function<RegstDescProto*(int64_t)> MakeMutRegstDesc4Id(Plan* plan);
   static void SetForceInplaceMemBlock(Plan* plan);
   static void DumpCtrlRegstInfoToPlan(Plan* plan);
@@ -16,30 +16,90 @@ limitations under the License.
 #include "oneflow/core/kernel/util/host_arithemetic_interface.h"
 #include "oneflow/core/register/blob.h"
 #include "oneflow/core/operator/op_conf_util.h"
+#include "oneflow/core/thread/thread_manager.h"
 
 namespace oneflow {
 
 namespace {
 
-void ComputeOffset(const int32_t num_axes, const int64_t* shape, const int32_t* permutation,
-                   DimVector& offset) {
-  offset.resize(num_axes);
-  DimVector buff(num_axes);
-  int64_t cur_offset = 1;
-  for (int32_t i = num_axes - 1; i >= 0; --i) {
-    buff[i] = cur_offset;
-    cur_offset *= shape[i];
+// elements moved by one ParallelFor task
+constexpr int64_t kTransposeGrainElemCnt = 32768;
+// a cache block of kTransposeBlockSize x kTransposeBlockSize elements is transposed by
+// kTransposeTileSize x kTransposeTileSize register tiles
+constexpr int64_t kTransposeBlockSize = 32;
+constexpr int64_t kTransposeTileSize = 8;
+
+// Drops unit axes and merges x axes which stay adjacent and in order in y, e.g. transposing
+// (N, C, H, W) by (0, 2, 3, 1) becomes transposing (N, C, H * W) by (0, 2, 1)
+void SimplifyPermutation(const int32_t num_axis, const ShapeView& x_shape,
+                         const std::vector<int32_t>& permutation, DimVector* dims,
+                         std::vector<int32_t>* perm) {
+  std::vector<int32_t> x_axis2kept_axis(num_axis, -1);
+  int32_t num_kept_axes = 0;
+  FOR_RANGE(int32_t, i, 0, num_axis) {
+    if (x_shape.At(i) != 1) { x_axis2kept_axis[i] = num_kept_axes++; }
   }
-  for (int32_t i = 0; i < num_axes; ++i) { offset[permutation[i]] = buff[i]; }
+  DimVector kept_dims;
+  FOR_RANGE(int32_t, i, 0, num_axis) {
+    if (x_shape.At(i) != 1) { kept_dims.push_back(x_shape.At(i)); }
+  }
+  std::vector<int32_t> y_order;
+  FOR_RANGE(int32_t, i, 0, num_axis) {
+    const int32_t kept_axis = x_axis2kept_axis[permutation[i]];
+    if (kept_axis != -1) { y_order.push_back(kept_axis); }
+  }
+  // runs of consecutive x axes in y order, identified by their first x axis
+  std::vector<int32_t> run_begins;
+  std::vector<int32_t> kept_axis2run(num_kept_axes, -1);
+  FOR_RANGE(int32_t, i, 0, y_order.size()) {
+    if (i == 0 || y_order[i] != y_order[i - 1] + 1) { run_begins.push_back(y_order[i]); }
+    kept_axis2run[y_order[i]] = run_begins.size() - 1;
+  }
+  // merged x axes are the runs sorted by their position in x
+  std::vector<int32_t> run2merged_axis(run_begins.size(), -1);
+  dims->clear();
+  FOR_RANGE(int32_t, i, 0, num_kept_axes) {
+    const int32_t run = kept_axis2run[i];
+    if (run2merged_axis[run] == -1) {
+      run2merged_axis[run] = dims->size();
+      dims->push_back(kept_dims[i]);
+    } else {
+      dims->back() *= kept_dims[i];
+    }
+  }
+  perm->resize(run_begins.size());
+  FOR_RANGE(int32_t, i, 0, run_begins.size()) { (*perm)[i] = run2merged_axis[i]; }
 }
 
-void IncreaseIndex(const int64_t* shape, DimVector& index) {
-  for (int32_t i = index.size() - 1; i >= 0; --i) {
-    ++index[i];
-    if (index[i] >= shape[i]) {
-      index[i] -= shape[i];
-    } else {
-      break;
+template<typename T>
+void TransposeTile(const T* x, int64_t x_row_stride, T* y, int64_t y_row_stride, int64_t rows,
+                   int64_t cols) {
+  if (rows == kTransposeTileSize && cols == kTransposeTileSize) {
+    // fixed trip counts let the compiler keep the tile in registers
+    T tile[kTransposeTileSize][kTransposeTileSize];
+    FOR_RANGE(int64_t, i, 0, kTransposeTileSize) {
+      FOR_RANGE(int64_t, j, 0, kTransposeTileSize) { tile[j][i] = x[i * x_row_stride + j]; }
+    }
+    FOR_RANGE(int64_t, j, 0, kTransposeTileSize) {
+      FOR_RANGE(int64_t, i, 0, kTransposeTileSize) { y[j * y_row_stride + i] = tile[j][i]; }
+    }
+  } else {
+    FOR_RANGE(int64_t, i, 0, rows) {
+      FOR_RANGE(int64_t, j, 0, cols) { y[j * y_row_stride + i] = x[i * x_row_stride + j]; }
+    }
+  }
+}
+
+// y(j, i) = x(i, j) for a rows x cols block, rows of x and y are x_row_stride and y_row_stride
+// elements apart
+template<typename T>
+void TransposeBlock(const T* x, int64_t x_row_stride, T* y, int64_t y_row_stride, int64_t rows,
+                    int64_t cols) {
+  for (int64_t i = 0; i < rows; i += kTransposeTileSize) {
+    const int64_t tile_rows = std::min(kTransposeTileSize, rows - i);
+    for (int64_t j = 0; j < cols; j += kTransposeTileSize) {
+      TransposeTile<T>(x + i * x_row_stride + j, x_row_stride, y + j * y_row_stride + i,
+                       y_row_stride, tile_rows, std::min(kTransposeTileSize, cols - j));
     }
   }
 }
@@ -48,31 +108,84 @@ template<typename T>
 void TransposeImpl(DeviceCtx* ctx, const int32_t num_axis, const ShapeView& x_shape,
                    const ShapeView& y_shape, const std::vector<int32_t>& permutation,
                    const int64_t elem_cnt, const T* x, T* y) {
-  int64_t block_size = 1;
-  int32_t shared_idxs_num = 0;
-  for (int32_t i = num_axis - 1; i >= 0 && permutation[i] == i; --i) {
-    block_size *= y_shape.At(i);
-    ++shared_idxs_num;
-  }
-  if (num_axis < 2 || shared_idxs_num == num_axis) {
+  if (elem_cnt == 0) { return; }
+  DimVector dims;
+  std::vector<int32_t> perm;
+  SimplifyPermutation(num_axis, x_shape, permutation, &dims, &perm);
+  const int32_t ndims = dims.size();
+  if (ndims <= 1) {
     memcpy(y, x, elem_cnt * sizeof(T));
     return;
   }
-  int32_t trans_axis = num_axis - shared_idxs_num;
-  DimVector x_to_y_offset;
-  ComputeOffset(trans_axis, y_shape.ptr(), permutation.data(), x_to_y_offset);
-  DimVector x_index_digits(trans_axis, 0);
-  int64_t num_blocks = elem_cnt / block_size;
-  FOR_RANGE(int64_t, x_idx, 0, num_blocks) {
-    int64_t y_idx = std::inner_product(x_to_y_offset.cbegin(), x_to_y_offset.cend(),
-                                       x_index_digits.cbegin(), 0);
-    if (block_size == 1) {
-      y[y_idx] = x[x_idx];
-    } else {
-      memcpy(y + block_size * y_idx, x + block_size * x_idx, block_size * sizeof(T));
+  DimVector x_strides(ndims);
+  DimVector y_dims(ndims);
+  DimVector y_strides(ndims);
+  x_strides[ndims - 1] = 1;
+  for (int32_t i = ndims - 2; i >= 0; --i) { x_strides[i] = x_strides[i + 1] * dims[i + 1]; }
+  FOR_RANGE(int32_t, i, 0, ndims) { y_dims[i] = dims[perm[i]]; }
+  y_strides[ndims - 1] = 1;
+  for (int32_t i = ndims - 2; i >= 0; --i) { y_strides[i] = y_strides[i + 1] * y_dims[i + 1]; }
+  if (perm[ndims - 1] == ndims - 1) {
+    // the innermost axis stays innermost, copy contiguous rows of it
+    const int64_t row_size = dims[ndims - 1];
+    const int64_t num_rows = elem_cnt / row_size;
+    const int64_t grain = std::max<int64_t>(1, kTransposeGrainElemCnt / row_size);
+    ParallelFor(num_rows, grain, ParallelForSchedule::kStatic, [&](size_t begin, size_t end) {
+      FOR_RANGE(int64_t, row, begin, end) {
+        int64_t remain = row;
+        int64_t x_offset = 0;
+        for (int32_t i = ndims - 2; i >= 0; --i) {
+          x_offset += remain % y_dims[i] * x_strides[perm[i]];
+          remain /= y_dims[i];
+        }
+        memcpy(y + row * row_size, x + x_offset, row_size * sizeof(T));
+      }
+    });
+    return;
+  }
+  // transpose 2D blocks spanned by the innermost axes of x and y, looping over the other axes
+  const int32_t x_inner_axis = ndims - 1;
+  const int32_t y_inner_axis = perm[ndims - 1];
+  const int64_t rows = dims[y_inner_axis];
+  const int64_t cols = dims[x_inner_axis];
+  const int64_t x_row_stride = x_strides[y_inner_axis];
+  int64_t y_row_stride = 0;
+  DimVector outer_dims;
+  DimVector outer_x_strides;
+  DimVector outer_y_strides;
+  FOR_RANGE(int32_t, i, 0, ndims) {
+    if (perm[i] == x_inner_axis) {
+      y_row_stride = y_strides[i];
+    } else if (perm[i] != y_inner_axis) {
+      outer_dims.push_back(y_dims[i]);
+      outer_x_strides.push_back(x_strides[perm[i]]);
+      outer_y_strides.push_back(y_strides[i]);
     }
-    IncreaseIndex(x_shape.ptr(), x_index_digits);
   }
+  const int64_t row_blocks = RoundUp(rows, kTransposeBlockSize) / kTransposeBlockSize;
+  const int64_t col_blocks = RoundUp(cols, kTransposeBlockSize) / kTransposeBlockSize;
+  const int64_t num_blocks = elem_cnt / (rows * cols) * row_blocks * col_blocks;
+  const int64_t grain = std::max<int64_t>(
+      1, kTransposeGrainElemCnt / (std::min(rows, kTransposeBlockSize)
+                                   * std::min(cols, kTransposeBlockSize)));
+  ParallelFor(num_blocks, grain, ParallelForSchedule::kStatic, [&](size_t begin, size_t end) {
+    FOR_RANGE(int64_t, block, begin, end) {
+      const int64_t col = block % col_blocks * kTransposeBlockSize;
+      const int64_t row = block / col_blocks % row_blocks * kTransposeBlockSize;
+      int64_t remain = block / (col_blocks * row_blocks);
+      int64_t x_offset = row * x_row_stride + col;
+      int64_t y_offset = col * y_row_stride + row;
+      for (int32_t i = static_cast<int32_t>(outer_dims.size()) - 1; i >= 0; --i) {
+        const int64_t coord = remain % outer_dims[i];
+        remain /= outer_dims[i];
+        x_offset += coord * outer_x_strides[i];
+        y_offset += coord * outer_y_strides[i];
+      }
+      TransposeBlock<T>(x + x_offset, x_row_stride, y + y_offset, y_row_stride,
+                        std::min(kTransposeBlockSize, rows - row),
+                        std::min(kTransposeBlockSize, cols - col));
+    }
+  });
 }
 
 template<typename T>
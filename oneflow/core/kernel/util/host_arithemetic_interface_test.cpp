@@ -0,0 +1,133 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/kernel/util/host_arithemetic_interface.h"
+#include "oneflow/core/common/shape.h"
+#include "oneflow/core/thread/thread_pool.h"
+#include <random>
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+class HostTransposeTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    Global<ThreadPool>::New(std::max<int32_t>(std::thread::hardware_concurrency(), 1));
+  }
+  void TearDown() override { Global<ThreadPool>::Delete(); }
+};
+
+// the former element-wise implementation, which walks x linearly and scatters into y
+template<typename T>
+void NaiveTranspose(const DimVector& x_dims, const std::vector<int32_t>& perm, const T* x, T* y) {
+  const int32_t num_axes = x_dims.size();
+  DimVector y_strides(num_axes);
+  int64_t cur_stride = 1;
+  for (int32_t i = num_axes - 1; i >= 0; --i) {
+    y_strides[i] = cur_stride;
+    cur_stride *= x_dims[perm[i]];
+  }
+  DimVector x_to_y_offset(num_axes);
+  FOR_RANGE(int32_t, i, 0, num_axes) { x_to_y_offset[perm[i]] = y_strides[i]; }
+  DimVector index(num_axes, 0);
+  FOR_RANGE(int64_t, x_idx, 0, cur_stride) {
+    int64_t y_idx = 0;
+    FOR_RANGE(int32_t, i, 0, num_axes) { y_idx += index[i] * x_to_y_offset[i]; }
+    y[y_idx] = x[x_idx];
+    for (int32_t i = num_axes - 1; i >= 0; --i) {
+      if (++index[i] < x_dims[i]) { break; }
+      index[i] = 0;
+    }
+  }
+}
+
+template<typename T>
+void Transpose(const DimVector& x_dims, const std::vector<int32_t>& perm, const T* x, T* y) {
+  DimVector y_dims(x_dims.size());
+  FOR_RANGE(int32_t, i, 0, x_dims.size()) { y_dims[i] = x_dims[perm[i]]; }
+  const Shape x_shape(x_dims);
+  const Shape y_shape(y_dims);
+  ArithemeticIf<DeviceType::kCPU>::Transpose(nullptr, x_dims.size(), ShapeView(x_shape),
+                                             ShapeView(y_shape), perm, x_shape.elem_cnt(), x, y);
+}
+
+template<typename T>
+void CheckTranspose(const DimVector& x_dims, const std::vector<int32_t>& perm) {
+  const int64_t elem_cnt = Shape(x_dims).elem_cnt();
+  std::vector<T> x(elem_cnt);
+  std::iota(x.begin(), x.end(), 0);
+  std::vector<T> y(elem_cnt);
+  std::vector<T> expected(elem_cnt);
+  Transpose<T>(x_dims, perm, x.data(), y.data());
+  NaiveTranspose<T>(x_dims, perm, x.data(), expected.data());
+  ASSERT_EQ(y, expected);
+}
+
+}  // namespace
+
+TEST_F(HostTransposeTest, transpose) {
+  CheckTranspose<float>({1}, {0});
+  CheckTranspose<float>({7, 1}, {1, 0});
+  CheckTranspose<float>({37, 45}, {1, 0});
+  CheckTranspose<double>({64, 64}, {1, 0});
+  CheckTranspose<int32_t>({2, 3, 4, 5}, {0, 2, 3, 1});
+  CheckTranspose<int32_t>({2, 3, 4, 5}, {0, 3, 1, 2});
+  CheckTranspose<int64_t>({3, 5, 7, 9}, {3, 2, 1, 0});
+  CheckTranspose<float>({3, 5, 7, 9}, {1, 0, 2, 3});
+  CheckTranspose<float>({4, 1, 33, 17}, {2, 1, 0, 3});
+  CheckTranspose<float>({2, 70, 3, 41}, {0, 2, 1, 3});
+  CheckTranspose<float>({5, 1, 1, 66, 3}, {4, 3, 2, 1, 0});
+  CheckTranspose<int8_t>({3, 40, 5, 50}, {3, 1, 0, 2});
+  CheckTranspose<float>({2, 3, 4, 5, 6, 7}, {5, 0, 4, 1, 3, 2});
+}
+
+TEST_F(HostTransposeTest, DISABLED_benchmark_transpose) {
+  const int64_t kIters = 10;
+  const std::vector<std::pair<DimVector, std::vector<int32_t>>> cases{
+      {{32, 64, 56, 56}, {0, 2, 3, 1}},    // NCHW -> NHWC
+      {{32, 56, 56, 64}, {0, 3, 1, 2}},    // NHWC -> NCHW
+      {{64, 128, 16, 64}, {0, 2, 1, 3}},   // split attention heads
+      {{64, 16, 128, 64}, {0, 1, 3, 2}},   // transpose keys
+      {{4096, 4096}, {1, 0}},              // matrix
+  };
+  for (const auto& shape_and_perm : cases) {
+    const DimVector& x_dims = shape_and_perm.first;
+    const std::vector<int32_t>& perm = shape_and_perm.second;
+    const int64_t elem_cnt = Shape(x_dims).elem_cnt();
+    std::vector<float> x(elem_cnt);
+    std::iota(x.begin(), x.end(), 0);
+    std::vector<float> y(elem_cnt);
+    const auto naive_start = std::chrono::steady_clock::now();
+    FOR_RANGE(int64_t, iter, 0, kIters) { NaiveTranspose<float>(x_dims, perm, x.data(), y.data()); }
+    const auto tiled_start = std::chrono::steady_clock::now();
+    FOR_RANGE(int64_t, iter, 0, kIters) { Transpose<float>(x_dims, perm, x.data(), y.data()); }
+    const auto tiled_end = std::chrono::steady_clock::now();
+    const double naive_us =
+        std::chrono::duration<double, std::micro>(tiled_start - naive_start).count() / kIters;
+    const double tiled_us =
+        std::chrono::duration<double, std::micro>(tiled_end - tiled_start).count() / kIters;
+    std::string perm_str;
+    for (int32_t axis : perm) { perm_str += std::to_string(axis); }
+    LOG(INFO) << "transpose " << Shape(x_dims).ToString() << " by " << perm_str << ": naive "
+              << naive_us << "us, tiled " << tiled_us << "us, speedup " << naive_us / tiled_us;
+  }
+}
+
+}  // namespace test
+
+}  // namespace oneflow
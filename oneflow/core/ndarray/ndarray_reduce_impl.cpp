@@ -17,26 +17,229 @@ limitations under the License.
 #include "oneflow/core/common/preprocessor.h"
 #include "oneflow/core/ndarray/ndarray_reduce_impl.h"
 #include "oneflow/core/ndarray/binary_func.h"
+#include "oneflow/core/thread/thread_manager.h"
 
 namespace oneflow {
 
-#define SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL(struct_name)                                            \
-  template<typename T, template<typename> class binary_func>                                       \
-  struct struct_name<DeviceType::kCPU, T, binary_func> final {                                     \
-    static bool Matched(const XpuVarNdarray<T>& y, const XpuVarNdarray<const T>& x) {              \
-      return false;                                                                                \
-    }                                                                                              \
-    static void Reduce(DeviceCtx* ctx, const XpuVarNdarray<T>& y, const XpuVarNdarray<const T>& x, \
-                       const XpuVarNdarray<T>& tmp_storage) {                                      \
-      UNIMPLEMENTED();                                                                             \
-    }                                                                                              \
-  }
-SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL(NdarrayScalarReduce);
-SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL(NdarrayMatrixRowReduce);
-SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL(NdarrayMatrixColReduce);
-SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL(NdarrayXYZCubeYReduce);
-SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL(NdarrayXYZCubeXZReduce);
-#undef SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL
+namespace {
+
+// elements reduced by one ParallelFor task, partitions only depend on shapes so results are
+// deterministic regardless of the thread number
+constexpr int64_t kReduceChunkSize = 32768;
+// contiguous runs up to this length are reduced with independent lanes, longer ones pairwise
+constexpr int64_t kPairwiseBlockSize = 256;
+constexpr int64_t kReduceLaneNum = 8;
+// rows accumulated sequentially before two halves are combined in column reductions
+constexpr int64_t kColReduceRowBlockSize = 16;
+// columns handled by one column reduction task, small enough to keep partials on stack
+constexpr int64_t kColReduceTileSize = 128;
+
+template<typename T, template<typename> class binary_func>
+T ReduceContiguous(const T* x, int64_t n) {
+  if (n > kPairwiseBlockSize) {
+    const int64_t half = n / 2;
+    return binary_func<T>::Invoke(ReduceContiguous<T, binary_func>(x, half),
+                                  ReduceContiguous<T, binary_func>(x + half, n - half));
+  }
+  T lanes[kReduceLaneNum];
+  std::fill(lanes, lanes + kReduceLaneNum, UnitOfBinaryFunc<T, binary_func>::Val());
+  const int64_t vec_n = n / kReduceLaneNum * kReduceLaneNum;
+  for (int64_t i = 0; i < vec_n; i += kReduceLaneNum) {
+    FOR_RANGE(int64_t, j, 0, kReduceLaneNum) {
+      lanes[j] = binary_func<T>::Invoke(lanes[j], x[i + j]);
+    }
+  }
+  FOR_RANGE(int64_t, i, vec_n, n) { lanes[0] = binary_func<T>::Invoke(lanes[0], x[i]); }
+  for (int64_t width = kReduceLaneNum / 2; width > 0; width /= 2) {
+    FOR_RANGE(int64_t, j, 0, width) {
+      lanes[j] = binary_func<T>::Invoke(lanes[j], lanes[j + width]);
+    }
+  }
+  return lanes[0];
+}
+
+template<typename T, template<typename> class binary_func>
+T ParallelReduceContiguous(const T* x, int64_t n) {
+  const int64_t num_chunks = RoundUp(n, kReduceChunkSize) / kReduceChunkSize;
+  if (num_chunks <= 1) { return ReduceContiguous<T, binary_func>(x, n); }
+  std::vector<T> partials(num_chunks);
+  ParallelFor(num_chunks, 1, ParallelForSchedule::kStatic, [&](size_t begin, size_t end) {
+    FOR_RANGE(int64_t, i, begin, end) {
+      const int64_t offset = i * kReduceChunkSize;
+      partials[i] = ReduceContiguous<T, binary_func>(x + offset,
+                                                     std::min(kReduceChunkSize, n - offset));
+    }
+  });
+  return ReduceContiguous<T, binary_func>(partials.data(), num_chunks);
+}
+
+// y[c] = reduce(x[0][c], ..., x[num_rows - 1][c]) for c in [0, width), x rows are row_stride apart
+template<typename T, template<typename> class binary_func>
+void ColReduceTile(const T* x, int64_t num_rows, int64_t row_stride, int64_t width, T* y) {
+  if (num_rows > kColReduceRowBlockSize) {
+    const int64_t half = num_rows / 2;
+    T other[kColReduceTileSize];
+    ColReduceTile<T, binary_func>(x, half, row_stride, width, y);
+    ColReduceTile<T, binary_func>(x + half * row_stride, num_rows - half, row_stride, width, other);
+    FOR_RANGE(int64_t, c, 0, width) { y[c] = binary_func<T>::Invoke(y[c], other[c]); }
+    return;
+  }
+  std::copy(x, x + width, y);
+  FOR_RANGE(int64_t, r, 1, num_rows) {
+    const T* row = x + r * row_stride;
+    FOR_RANGE(int64_t, c, 0, width) { y[c] = binary_func<T>::Invoke(y[c], row[c]); }
+  }
+}
+
+// x is num_batches matrices of shape (num_rows, num_cols), y[b][c] reduces column c of matrix b.
+// Long columns are split into row chunks reduced in parallel and combined afterwards.
+template<typename T, template<typename> class binary_func>
+void BatchMatrixColReduce(int64_t num_batches, int64_t num_rows, int64_t num_cols, const T* x,
+                          T* y) {
+  if (num_rows == 0) {
+    std::fill(y, y + num_batches * num_cols, UnitOfBinaryFunc<T, binary_func>::Val());
+    return;
+  }
+  if (num_cols == 0) { return; }
+  const int64_t num_tiles = RoundUp(num_cols, kColReduceTileSize) / kColReduceTileSize;
+  const int64_t rows_per_chunk =
+      std::max(kColReduceRowBlockSize,
+               kReduceChunkSize / std::min(num_cols, kColReduceTileSize) / kColReduceRowBlockSize
+                   * kColReduceRowBlockSize);
+  const int64_t num_row_chunks = RoundUp(num_rows, rows_per_chunk) / rows_per_chunk;
+  std::vector<T> partials;
+  if (num_row_chunks > 1) { partials.resize(num_batches * num_row_chunks * num_cols); }
+  const int64_t num_tasks = num_batches * num_row_chunks * num_tiles;
+  ParallelFor(num_tasks, 1, ParallelForSchedule::kStatic, [&](size_t begin, size_t end) {
+    FOR_RANGE(int64_t, i, begin, end) {
+      const int64_t batch = i / (num_row_chunks * num_tiles);
+      const int64_t row_chunk = i / num_tiles % num_row_chunks;
+      const int64_t col = i % num_tiles * kColReduceTileSize;
+      const int64_t row = row_chunk * rows_per_chunk;
+      const T* x_ptr = x + (batch * num_rows + row) * num_cols + col;
+      T* y_ptr = num_row_chunks > 1
+                     ? partials.data() + (batch * num_row_chunks + row_chunk) * num_cols + col
+                     : y + batch * num_cols + col;
+      ColReduceTile<T, binary_func>(x_ptr, std::min(rows_per_chunk, num_rows - row), num_cols,
+                                    std::min(kColReduceTileSize, num_cols - col), y_ptr);
+    }
+  });
+  if (num_row_chunks == 1) { return; }
+  ParallelFor(num_batches * num_tiles, 1, ParallelForSchedule::kStatic,
+              [&](size_t begin, size_t end) {
+                FOR_RANGE(int64_t, i, begin, end) {
+                  const int64_t batch = i / num_tiles;
+                  const int64_t col = i % num_tiles * kColReduceTileSize;
+                  ColReduceTile<T, binary_func>(
+                      partials.data() + batch * num_row_chunks * num_cols + col, num_row_chunks,
+                      num_cols, std::min(kColReduceTileSize, num_cols - col),
+                      y + batch * num_cols + col);
+                }
+              });
+}
+
+template<typename T, template<typename> class binary_func>
+void MatrixRowReduce(int64_t num_rows, int64_t num_cols, const T* x, T* y) {
+  if (num_cols == 0) {
+    std::fill(y, y + num_rows, UnitOfBinaryFunc<T, binary_func>::Val());
+    return;
+  }
+  if (num_cols >= kReduceChunkSize && num_rows < 16) {
+    // too few rows to keep all threads busy, split every row instead
+    FOR_RANGE(int64_t, i, 0, num_rows) {
+      y[i] = ParallelReduceContiguous<T, binary_func>(x + i * num_cols, num_cols);
+    }
+    return;
+  }
+  const int64_t grain = std::max<int64_t>(1, kReduceChunkSize / num_cols);
+  ParallelFor(num_rows, grain, ParallelForSchedule::kStatic, [&](size_t begin, size_t end) {
+    FOR_RANGE(int64_t, i, begin, end) {
+      y[i] = ReduceContiguous<T, binary_func>(x + i * num_cols, num_cols);
+    }
+  });
+}
+
+}  // namespace
+
+template<typename T, template<typename> class binary_func>
+struct NdarrayScalarReduce<DeviceType::kCPU, T, binary_func> final {
+  static bool Matched(const XpuVarNdarray<T>& y, const XpuVarNdarray<const T>& x) {
+    return y.shape().ElemNum() == 1;
+  }
+
+  static void Reduce(DeviceCtx* ctx, const XpuVarNdarray<T>& y, const XpuVarNdarray<const T>& x,
+                     const XpuVarNdarray<T>& tmp_storage) {
+    CHECK(Matched(y, x));
+    *y.ptr() = ParallelReduceContiguous<T, binary_func>(x.ptr(), x.shape().ElemNum());
+  }
+};
+
+template<typename T, template<typename> class binary_func>
+struct NdarrayMatrixRowReduce<DeviceType::kCPU, T, binary_func> final {
+  static bool Matched(const XpuVarNdarray<T>& y, const XpuVarNdarray<const T>& x) {
+    if (x.shape().NumAxes() != 2) { return false; }
+    if (y.shape().NumAxes() != 2) { return false; }
+    return x.shape().At(0) == y.shape().At(0) && y.shape().At(1) == 1;
+  }
+
+  static void Reduce(DeviceCtx* ctx, const XpuVarNdarray<T>& y, const XpuVarNdarray<const T>& x,
+                     const XpuVarNdarray<T>& tmp_storage) {
+    CHECK(Matched(y, x));
+    MatrixRowReduce<T, binary_func>(x.shape().At(0), x.shape().At(1), x.ptr(), y.ptr());
+  }
+};
+
+template<typename T, template<typename> class binary_func>
+struct NdarrayMatrixColReduce<DeviceType::kCPU, T, binary_func> final {
+  static bool Matched(const XpuVarNdarray<T>& y, const XpuVarNdarray<const T>& x) {
+    if (x.shape().NumAxes() != 2) { return false; }
+    if (y.shape().NumAxes() != 2) { return false; }
+    return y.shape().At(0) == 1 && x.shape().At(1) == y.shape().At(1);
+  }
+
+  static void Reduce(DeviceCtx* ctx, const XpuVarNdarray<T>& y, const XpuVarNdarray<const T>& x,
+                     const XpuVarNdarray<T>& tmp_storage) {
+    CHECK(Matched(y, x));
+    BatchMatrixColReduce<T, binary_func>(1, x.shape().At(0), x.shape().At(1), x.ptr(), y.ptr());
+  }
+};
+
+template<typename T, template<typename> class binary_func>
+struct NdarrayXYZCubeYReduce<DeviceType::kCPU, T, binary_func> final {
+  static bool Matched(const XpuVarNdarray<T>& y, const XpuVarNdarray<const T>& x) {
+    if (x.shape().NumAxes() != 3) { return false; }
+    if (y.shape().NumAxes() != 3) { return false; }
+    return x.shape().At(0) == y.shape().At(0) && y.shape().At(1) == 1
+           && x.shape().At(2) == y.shape().At(2);
+  }
+
+  static void Reduce(DeviceCtx* ctx, const XpuVarNdarray<T>& y, const XpuVarNdarray<const T>& x,
+                     const XpuVarNdarray<T>& tmp_storage) {
+    CHECK(Matched(y, x));
+    BatchMatrixColReduce<T, binary_func>(x.shape().At(0), x.shape().At(1), x.shape().At(2),
+                                         x.ptr(), y.ptr());
+  }
+};
+
+template<typename T, template<typename> class binary_func>
+struct NdarrayXYZCubeXZReduce<DeviceType::kCPU, T, binary_func> final {
+  static bool Matched(const XpuVarNdarray<T>& y, const XpuVarNdarray<const T>& x) {
+    if (x.shape().NumAxes() != 3) { return false; }
+    if (y.shape().NumAxes() != 3) { return false; }
+    return y.shape().At(0) == 1 && x.shape().At(1) == y.shape().At(1) && y.shape().At(2) == 1;
+  }
+
+  static void Reduce(DeviceCtx* ctx, const XpuVarNdarray<T>& y, const XpuVarNdarray<const T>& x,
+                     const XpuVarNdarray<T>& tmp_storage) {
+    CHECK(Matched(y, x));
+    // reduce the contiguous z axis first, then the x axis of the (x, y) partials
+    const int64_t dim_x = x.shape().At(0);
+    const int64_t dim_y = x.shape().At(1);
+    std::vector<T> xy_partials(dim_x * dim_y);
+    MatrixRowReduce<T, binary_func>(dim_x * dim_y, x.shape().At(2), x.ptr(), xy_partials.data());
+    BatchMatrixColReduce<T, binary_func>(1, dim_x, dim_y, xy_partials.data(), y.ptr());
+  }
+};
 
 #define INSTANTIATE_NDARRAY_REDUCE_IMPL(dtype, binary_func)                                       \
   template struct NdarrayScalarReduce<DeviceType::kCPU, OF_PP_PAIR_FIRST(dtype), binary_func>;    \
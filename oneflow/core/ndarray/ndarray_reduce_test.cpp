@@ -0,0 +1,175 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/ndarray/ndarray_reduce.h"
+#include "oneflow/core/thread/thread_pool.h"
+#include <random>
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+class NdarrayReduceTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    Global<ThreadPool>::New(std::max<int32_t>(std::thread::hardware_concurrency(), 1));
+  }
+  void TearDown() override { Global<ThreadPool>::Delete(); }
+};
+
+std::vector<float> RandomVector(int64_t size) {
+  std::mt19937 gen(size);
+  std::uniform_real_distribution<float> dist(-1.0, 1.0);
+  std::vector<float> vec(size);
+  for (float& v : vec) { v = dist(gen); }
+  return vec;
+}
+
+template<template<typename> class binary_func>
+void NaiveReduce(const DimVector& x_dims, const DimVector& y_dims, const float* x, double* y) {
+  const Shape x_shape(x_dims);
+  const Shape y_shape(y_dims);
+  std::vector<bool> inited(y_shape.elem_cnt(), false);
+  FOR_RANGE(int64_t, i, 0, x_shape.elem_cnt()) {
+    int64_t remain = i;
+    int64_t y_offset = 0;
+    FOR_RANGE(int64_t, axis, 0, x_shape.NumAxes()) {
+      const int64_t coord = remain / x_shape.Count(axis + 1);
+      remain %= x_shape.Count(axis + 1);
+      if (y_shape.At(axis) != 1) { y_offset += coord * y_shape.Count(axis + 1); }
+    }
+    y[y_offset] = inited[y_offset] ? binary_func<double>::Invoke(y[y_offset], x[i]) : x[i];
+    inited[y_offset] = true;
+  }
+}
+
+template<template<typename> class binary_func>
+void CheckReduce(const DimVector& x_dims, const DimVector& y_dims) {
+  const Shape x_shape(x_dims);
+  const Shape y_shape(y_dims);
+  const std::vector<float> x = RandomVector(x_shape.elem_cnt());
+  std::vector<float> y(y_shape.elem_cnt());
+  std::vector<float> tmp(x_shape.elem_cnt());
+  NdarrayReduce<DeviceType::kCPU, float, binary_func>::Reduce(
+      nullptr, XpuVarNdarray<float>(y_shape, y.data()),
+      XpuVarNdarray<const float>(x_shape, x.data()), XpuVarNdarray<float>(x_shape, tmp.data()));
+  std::vector<double> expected(y_shape.elem_cnt());
+  NaiveReduce<binary_func>(x_dims, y_dims, x.data(), expected.data());
+  const int64_t reduce_num = x_shape.elem_cnt() / y_shape.elem_cnt();
+  FOR_RANGE(int64_t, i, 0, y_shape.elem_cnt()) {
+    // pairwise summation keeps the error around log(n) ulps
+    ASSERT_NEAR(y[i], expected[i], 1e-6 * std::sqrt(reduce_num) + 1e-6) << i;
+  }
+}
+
+template<template<typename> class binary_func>
+void CheckAllPatterns() {
+  // scalar
+  CheckReduce<binary_func>({1}, {1});
+  CheckReduce<binary_func>({1000003}, {1});
+  CheckReduce<binary_func>({7, 9, 11}, {1, 1, 1});
+  // matrix row
+  CheckReduce<binary_func>({37, 1001}, {37, 1});
+  CheckReduce<binary_func>({3, 100003}, {3, 1});
+  CheckReduce<binary_func>({2, 3, 5, 7}, {2, 3, 1, 1});
+  // matrix col
+  CheckReduce<binary_func>({1001, 37}, {1, 37});
+  CheckReduce<binary_func>({100003, 3}, {1, 3});
+  CheckReduce<binary_func>({65, 300}, {1, 300});
+  // xyz cube y
+  CheckReduce<binary_func>({5, 333, 129}, {5, 1, 129});
+  CheckReduce<binary_func>({2, 30001, 7}, {2, 1, 7});
+  // xyz cube xz
+  CheckReduce<binary_func>({16, 33, 197}, {1, 33, 1});
+  CheckReduce<binary_func>({1000, 3, 5}, {1, 3, 1});
+}
+
+template<template<typename> class binary_func>
+void CheckEmptyReduce(const DimVector& x_dims, const DimVector& y_dims) {
+  const Shape x_shape(x_dims);
+  const Shape y_shape(y_dims);
+  std::vector<float> y(y_shape.elem_cnt(), 1.5f);
+  NdarrayReduce<DeviceType::kCPU, float, binary_func>::Reduce(
+      nullptr, XpuVarNdarray<float>(y_shape, y.data()),
+      XpuVarNdarray<const float>(x_shape, nullptr), XpuVarNdarray<float>(x_shape, nullptr));
+  for (const float v : y) { ASSERT_EQ(v, (UnitOfBinaryFunc<float, binary_func>::Val())); }
+}
+
+template<template<typename> class binary_func>
+void CheckEmptyPatterns() {
+  CheckEmptyReduce<binary_func>({0}, {1});
+  CheckEmptyReduce<binary_func>({4, 0}, {4, 1});
+  CheckEmptyReduce<binary_func>({0, 4}, {1, 4});
+  CheckEmptyReduce<binary_func>({3, 0, 5}, {3, 1, 5});
+  CheckEmptyReduce<binary_func>({3, 4, 0}, {1, 4, 1});
+}
+
+}  // namespace
+
+TEST_F(NdarrayReduceTest, sum) { CheckAllPatterns<BinaryFuncSum>(); }
+
+TEST_F(NdarrayReduceTest, max) { CheckAllPatterns<BinaryFuncMax>(); }
+
+TEST_F(NdarrayReduceTest, min) { CheckAllPatterns<BinaryFuncMin>(); }
+
+TEST_F(NdarrayReduceTest, empty) {
+  CheckEmptyPatterns<BinaryFuncSum>();
+  CheckEmptyPatterns<BinaryFuncMax>();
+}
+
+TEST_F(NdarrayReduceTest, DISABLED_benchmark_sum) {
+  const int64_t kIters = 10;
+  const std::vector<std::pair<DimVector, DimVector>> cases{
+      {{16 * 1024 * 1024}, {1}},                  // scalar, e.g. loss
+      {{4096, 1024}, {4096, 1}},                  // row, e.g. softmax
+      {{256 * 128, 512}, {1, 512}},               // col, e.g. bias_add grad
+      {{64, 256, 56 * 56}, {1, 256, 1}},          // xz, e.g. NCHW batch norm statistics
+      {{64, 56 * 56, 256}, {64, 1, 256}},         // y, e.g. NHWC global pooling
+  };
+  for (const auto& shapes : cases) {
+    const Shape x_shape(shapes.first);
+    const Shape y_shape(shapes.second);
+    const std::vector<float> x = RandomVector(x_shape.elem_cnt());
+    std::vector<float> y(y_shape.elem_cnt());
+    std::vector<float> tmp(x_shape.elem_cnt());
+    XpuVarNdarray<float> y_arr(y_shape, y.data());
+    XpuVarNdarray<const float> x_arr(x_shape, x.data());
+    XpuVarNdarray<float> tmp_arr(x_shape, tmp.data());
+    const auto default_start = std::chrono::steady_clock::now();
+    FOR_RANGE(int64_t, iter, 0, kIters) {
+      NdarrayDefaultReduce<DeviceType::kCPU, float, BinaryFuncSum>::Reduce(nullptr, y_arr, x_arr,
+                                                                          tmp_arr);
+    }
+    const auto fast_start = std::chrono::steady_clock::now();
+    FOR_RANGE(int64_t, iter, 0, kIters) {
+      NdarrayReduce<DeviceType::kCPU, float, BinaryFuncSum>::Reduce(nullptr, y_arr, x_arr,
+                                                                   tmp_arr);
+    }
+    const auto fast_end = std::chrono::steady_clock::now();
+    const double default_us =
+        std::chrono::duration<double, std::micro>(fast_start - default_start).count() / kIters;
+    const double fast_us =
+        std::chrono::duration<double, std::micro>(fast_end - fast_start).count() / kIters;
+    LOG(INFO) << "reduce_sum " << x_shape.ToString() << " -> " << y_shape.ToString()
+              << ": default " << default_us << "us, fast path " << fast_us << "us, speedup "
+              << default_us / fast_us;
+  }
+}
+
+}  // namespace test
+
+}  // namespace oneflow
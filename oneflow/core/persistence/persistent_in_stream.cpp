@@ -24,7 +24,8 @@ namespace oneflow {
 
 namespace {
 
-constexpr size_t kDefaultBufferSize = 32 * 1024;  // 32KB
+constexpr size_t kDefaultBufferSize = 32 * 1024;                 // 32KB
+constexpr size_t kDefaultReadAheadChunkSize = 4 * 1024 * 1024;  // 4MB
 
 size_t GetBufferSize() {
   const char* buf_size_str = std::getenv("ONEFLOW_PERSISTENT_IN_STREAM_BUFFER_SIZE_BYTES");
@@ -43,6 +44,14 @@ size_t GetBufferSize() {
 
 }  // namespace
 
+PersistentInStream::~PersistentInStream() {
+  if (is_read_ahead_) {
+    free_read_ahead_buffers_.Close();
+    filled_read_ahead_chunks_.Close();
+    read_ahead_thread_.join();
+  }
+}
+
 PersistentInStream::PersistentInStream(fs::FileSystem* fs,
                                        const std::vector<std::string>& file_paths, uint64_t offset,
                                        bool cyclic, bool with_local_copy)
@@ -65,10 +74,47 @@ PersistentInStream::PersistentInStream(int64_t session_id, fs::FileSystem* fs,
   } else {
     stream_scanner_.reset(new AcyclicStreamScanner(fs, streams, offset));
   }
-  buffer_.resize(GetBufferSize() + 1);
-  cur_buf_begin_ = buffer_.data();
-  cur_buf_end_ = buffer_.data();
-  *cur_buf_end_ = '\0';
+  is_read_ahead_ = false;
+  is_read_ahead_eof_ = false;
+  cur_read_ahead_buffer_ = nullptr;
+  const int64_t read_ahead_depth =
+      ParseIntegerFromEnv("ONEFLOW_PERSISTENT_IN_STREAM_READ_AHEAD_DEPTH", 0);
+  if (read_ahead_depth > 0) {
+    StartReadAhead(read_ahead_depth,
+                   ParseIntegerFromEnv("ONEFLOW_PERSISTENT_IN_STREAM_READ_AHEAD_CHUNK_SIZE_BYTES",
+                                       kDefaultReadAheadChunkSize));
+  } else {
+    buffer_.resize(GetBufferSize() + 1);
+    cur_buf_begin_ = buffer_.data();
+    cur_buf_end_ = buffer_.data();
+    *cur_buf_end_ = '\0';
+  }
+}
+
+void PersistentInStream::StartReadAhead(int64_t depth, size_t chunk_size) {
+  CHECK_GT(chunk_size, 0);
+  is_read_ahead_ = true;
+  // one more buffer than depth for the chunk being consumed
+  read_ahead_buffers_.resize(depth + 1);
+  for (std::vector<char>& buffer : read_ahead_buffers_) {
+    buffer.resize(chunk_size + 1);
+    CHECK_EQ(free_read_ahead_buffers_.Send(&buffer), kChannelStatusSuccess);
+  }
+  cur_buf_begin_ = nullptr;
+  cur_buf_end_ = nullptr;
+  read_ahead_thread_ = std::thread(&PersistentInStream::ReadAheadLoop, this);
+}
+
+void PersistentInStream::ReadAheadLoop() {
+  std::vector<char>* buffer = nullptr;
+  while (free_read_ahead_buffers_.Receive(&buffer) == kChannelStatusSuccess) {
+    ReadAheadChunk chunk;
+    chunk.buffer = buffer;
+    chunk.size = stream_scanner_->UpdateBuffer(buffer);
+    if (filled_read_ahead_chunks_.Send(chunk) != kChannelStatusSuccess) { break; }
+    // an empty chunk marks the end of an acyclic stream
+    if (chunk.size == 0) { break; }
+  }
 }
 
 PersistentInStream::PersistentInStream(fs::FileSystem* fs,
@@ -126,13 +172,32 @@ int32_t PersistentInStream::ReadFully(char* s, size_t n) {
 
 void PersistentInStream::UpdateBuffer() {
   CHECK_EQ(cur_buf_begin_, cur_buf_end_);
+  if (is_read_ahead_) {
+    if (is_read_ahead_eof_) { return; }
+    if (cur_read_ahead_buffer_ != nullptr) {
+      CHECK_EQ(free_read_ahead_buffers_.Send(cur_read_ahead_buffer_), kChannelStatusSuccess);
+    }
+    ReadAheadChunk chunk;
+    CHECK_EQ(filled_read_ahead_chunks_.Receive(&chunk), kChannelStatusSuccess);
+    cur_read_ahead_buffer_ = chunk.buffer;
+    cur_buf_begin_ = chunk.buffer->data();
+    cur_buf_end_ = chunk.buffer->data() + chunk.size;
+    *cur_buf_end_ = '\0';
+    if (chunk.size == 0) { is_read_ahead_eof_ = true; }
+    return;
+  }
   uint64_t n = stream_scanner_->UpdateBuffer(&buffer_);
   cur_buf_begin_ = buffer_.data();
   cur_buf_end_ = buffer_.data() + n;
   *cur_buf_end_ = '\0';
 }
 
-bool PersistentInStream::IsEof() const {
+bool PersistentInStream::IsEof() {
+  if (is_read_ahead_) {
+    // stream_scanner_ belongs to the read-ahead thread, wait for the next chunk instead
+    if (cur_buf_begin_ == cur_buf_end_) { UpdateBuffer(); }
+    return cur_buf_begin_ == cur_buf_end_;
+  }
   return cur_buf_begin_ == cur_buf_end_ && stream_scanner_->IsEof();
 }
 }  // namespace oneflow
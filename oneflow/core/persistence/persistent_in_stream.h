@@ -18,13 +18,14 @@ limitations under the License.
 
 #include "oneflow/core/persistence/file_system.h"
 #include "oneflow/core/persistence/stream_scanner.h"
+#include "oneflow/core/common/channel.h"
 
 namespace oneflow {
 
 class PersistentInStream {
  public:
   OF_DISALLOW_COPY_AND_MOVE(PersistentInStream);
-  virtual ~PersistentInStream() {}
+  virtual ~PersistentInStream();
   PersistentInStream(fs::FileSystem* fs, const std::vector<std::string>& file_paths,
                      uint64_t offset, bool cyclic, bool with_local_copy);
   PersistentInStream(fs::FileSystem* fs, const std::vector<std::string>& file_paths, bool cyclic,
@@ -45,14 +46,31 @@ class PersistentInStream {
   int32_t ReadFully(char* s, size_t n);
 
  private:
-  bool IsEof() const;
+  struct ReadAheadChunk {
+    std::vector<char>* buffer;
+    uint64_t size;
+  };
+
+  bool IsEof();
   void UpdateBuffer();
+  void StartReadAhead(int64_t depth, size_t chunk_size);
+  void ReadAheadLoop();
 
   std::unique_ptr<StreamScanner> stream_scanner_;
 
   std::vector<char> buffer_;
   char* cur_buf_begin_;
   char* cur_buf_end_;
+
+  // With read-ahead, a background thread owns stream_scanner_ and keeps up to depth chunks filled
+  // ahead of the one being consumed, which is buffer_ in the synchronous mode.
+  bool is_read_ahead_;
+  bool is_read_ahead_eof_;
+  std::vector<std::vector<char>> read_ahead_buffers_;
+  std::vector<char>* cur_read_ahead_buffer_;
+  Channel<std::vector<char>*> free_read_ahead_buffers_;
+  Channel<ReadAheadChunk> filled_read_ahead_chunks_;
+  std::thread read_ahead_thread_;
 };
 
 }  // namespace oneflow
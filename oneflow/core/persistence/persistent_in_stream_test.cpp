@@ -0,0 +1,145 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/persistence/persistent_in_stream.h"
+#include "oneflow/core/common/process_state.h"
+#include "oneflow/core/common/str_util.h"
+#include "oneflow/core/persistence/posix/posix_file_system.h"
+
+namespace oneflow {
+
+#ifdef OF_PLATFORM_POSIX
+
+namespace {
+
+class ScopedReadAheadEnv final {
+ public:
+  ScopedReadAheadEnv(int64_t depth, int64_t chunk_size) {
+    setenv("ONEFLOW_PERSISTENT_IN_STREAM_READ_AHEAD_DEPTH", std::to_string(depth).c_str(), 1);
+    setenv("ONEFLOW_PERSISTENT_IN_STREAM_READ_AHEAD_CHUNK_SIZE_BYTES",
+           std::to_string(chunk_size).c_str(), 1);
+  }
+  ~ScopedReadAheadEnv() {
+    unsetenv("ONEFLOW_PERSISTENT_IN_STREAM_READ_AHEAD_DEPTH");
+    unsetenv("ONEFLOW_PERSISTENT_IN_STREAM_READ_AHEAD_CHUNK_SIZE_BYTES");
+  }
+};
+
+std::string WriteTestFile(fs::FileSystem* file_system, const std::string& name,
+                          const std::string& content) {
+  std::string current_dir = GetCwd();
+  StringReplace(&current_dir, '\\', '/');
+  const std::string file_name = JoinPath(current_dir, name);
+  std::unique_ptr<fs::WritableFile> writable_file;
+  file_system->NewWritableFile(file_name, &writable_file);
+  writable_file->Append(content.data(), content.size());
+  writable_file->Close();
+  return file_name;
+}
+
+std::string GenLines(int64_t line_num) {
+  std::string content;
+  FOR_RANGE(int64_t, i, 0, line_num) { content += "line-" + std::to_string(i * 7919) + "\n"; }
+  return content;
+}
+
+std::vector<std::string> ReadAllLines(fs::FileSystem* file_system, const std::string& file_name) {
+  PersistentInStream in_stream(file_system, file_name);
+  std::vector<std::string> lines;
+  std::string line;
+  while (in_stream.ReadLine(&line) == 0) { lines.push_back(line); }
+  return lines;
+}
+
+}  // namespace
+
+TEST(PersistentInStream, read_ahead_read_line) {
+  fs::PosixFileSystem file_system;
+  const std::string file_name =
+      WriteTestFile(&file_system, "tmp_persistent_in_stream_lines", GenLines(50000));
+  const std::vector<std::string> expected = ReadAllLines(&file_system, file_name);
+  ASSERT_EQ(expected.size(), 50000);
+  for (const int64_t depth : {1, 2, 3}) {
+    // chunks much smaller than the file, and not aligned with lines
+    ScopedReadAheadEnv env(depth, 1000 + depth);
+    ASSERT_EQ(ReadAllLines(&file_system, file_name), expected);
+  }
+  file_system.DelFile(file_name);
+}
+
+TEST(PersistentInStream, read_ahead_read_fully) {
+  fs::PosixFileSystem file_system;
+  std::string content(300000, '\0');
+  FOR_RANGE(size_t, i, 0, content.size()) { content[i] = static_cast<char>(i * 131 + i / 977); }
+  const std::string file_name =
+      WriteTestFile(&file_system, "tmp_persistent_in_stream_bytes", content);
+  ScopedReadAheadEnv env(2, 4096);
+  {
+    PersistentInStream in_stream(&file_system, file_name);
+    std::string read_content(content.size(), '\0');
+    const size_t piece_size = 1000;
+    for (size_t offset = 0; offset < content.size(); offset += piece_size) {
+      ASSERT_EQ(in_stream.ReadFully(&read_content[offset],
+                                    std::min(piece_size, content.size() - offset)),
+                0);
+    }
+    ASSERT_EQ(read_content, content);
+    char c = 0;
+    ASSERT_EQ(in_stream.ReadFully(&c, 1), -1);
+  }
+  {
+    // a cyclic stream wraps around and never ends
+    PersistentInStream in_stream(&file_system, std::vector<std::string>({file_name}), true, false);
+    std::string read_content(content.size() * 2 + 10, '\0');
+    ASSERT_EQ(in_stream.ReadFully(&read_content[0], read_content.size()), 0);
+    ASSERT_EQ(read_content, content + content + content.substr(0, 10));
+  }
+  file_system.DelFile(file_name);
+}
+
+TEST(PersistentInStream, DISABLED_benchmark_read_ahead_throughput) {
+  fs::PosixFileSystem file_system;
+  const size_t file_size = 128 * 1024 * 1024;
+  std::string content(file_size, '\0');
+  FOR_RANGE(size_t, i, 0, content.size()) { content[i] = static_cast<char>(i * 131); }
+  const std::string file_name =
+      WriteTestFile(&file_system, "tmp_persistent_in_stream_benchmark", content);
+  content.clear();
+  // reads records the way OFRecord loading does, with a checksum standing in for parsing
+  auto ReadRecords = [&]() {
+    PersistentInStream in_stream(&file_system, file_name);
+    std::vector<char> record(64 * 1024);
+    int64_t checksum = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t offset = 0; offset < file_size; offset += record.size()) {
+      CHECK_EQ(in_stream.ReadFully(record.data(), record.size()), 0);
+      for (char c : record) { checksum = checksum * 31 + c; }
+    }
+    const double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    CHECK_NE(checksum, 1);
+    return file_size / seconds / (1024 * 1024);
+  };
+  LOG(INFO) << "synchronous: " << ReadRecords() << " MB/s";
+  for (const int64_t depth : {2, 3}) {
+    ScopedReadAheadEnv env(depth, 4 * 1024 * 1024);
+    LOG(INFO) << "read-ahead depth " << depth << ": " << ReadRecords() << " MB/s";
+  }
+  file_system.DelFile(file_name);
+}
+
+#endif  // OF_PLATFORM_POSIX
+
+}  // namespace oneflow
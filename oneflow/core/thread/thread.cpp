@@ -21,7 +21,9 @@ limitations under the License.
 
 namespace oneflow {
 
-Thread::Thread() {
+Thread::Thread()
+    : msg_channel_(ParseIntegerFromEnv("ONEFLOW_THREAD_MSG_CHANNEL_CAPACITY_LOG2", 12),
+                   ParseIntegerFromEnv("ONEFLOW_THREAD_MSG_CHANNEL_SPIN_COUNT", 1024)) {
   local_msg_queue_enabled_ =
       ParseBooleanFromEnv("ONEFLOW_THREAD_ENABLE_LOCAL_MESSAGE_QUEUE", false);
 }
@@ -46,12 +48,14 @@ void Thread::EnqueueActorMsg(const ActorMsg& msg) {
 }
 
 void Thread::PollMsgChannel(const ThreadCtx& thread_ctx) {
+  ActorMsg msg;
   while (true) {
     if (local_msg_queue_.empty()) {
-      CHECK_EQ(msg_channel_.ReceiveMany(&local_msg_queue_), kChannelStatusSuccess);
+      CHECK_EQ(msg_channel_.Receive(&msg), kChannelStatusSuccess);
+    } else {
+      msg = std::move(local_msg_queue_.front());
+      local_msg_queue_.pop();
     }
-    ActorMsg msg = std::move(local_msg_queue_.front());
-    local_msg_queue_.pop();
     if (msg.msg_type() == ActorMsgType::kCmdMsg) {
       if (msg.actor_cmd() == ActorCmd::kStopThread) {
         CHECK(id2actor_ptr_.empty());
@@ -17,7 +17,7 @@ limitations under the License.
 #define ONEFLOW_CORE_THREAD_THREAD_H_
 
 #include "oneflow/core/actor/actor_message_bus.h"
-#include "oneflow/core/common/channel.h"
+#include "oneflow/core/common/mpsc_ring_channel.h"
 #include "oneflow/core/common/util.h"
 #include "oneflow/core/job/task.pb.h"
 #include "oneflow/core/thread/thread_context.h"
@@ -32,7 +32,7 @@ class Thread {
 
   void AddTask(const TaskProto&);
 
-  Channel<ActorMsg>* GetMsgChannelPtr() { return &msg_channel_; }
+  MpscRingChannel<ActorMsg>* GetMsgChannelPtr() { return &msg_channel_; }
   void EnqueueActorMsg(const ActorMsg& msg);
 
   void JoinAllActor() { actor_thread_.join(); }
@@ -50,7 +50,7 @@ class Thread {
   std::mutex id2task_mtx_;
 
   std::thread actor_thread_;
-  Channel<ActorMsg> msg_channel_;
+  MpscRingChannel<ActorMsg> msg_channel_;
   HashMap<int64_t, std::unique_ptr<Actor>> id2actor_ptr_;
   std::queue<ActorMsg> local_msg_queue_;
   bool local_msg_queue_enabled_;
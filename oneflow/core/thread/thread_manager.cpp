@@ -18,8 +18,6 @@ limitations under the License.
 #include "oneflow/core/job/global_for.h"
 #include "oneflow/core/thread/cpu_thread.h"
 #include "oneflow/core/thread/gpu_thread.h"
-#include "oneflow/core/common/balanced_splitter.h"
-#include "oneflow/core/common/blocking_counter.h"
 #include "oneflow/core/control/global_process_ctx.h"
 #include "oneflow/core/job/global_for.h"
 #include "oneflow/core/common/id_util.h"
@@ -62,17 +60,21 @@ void SingleThreadLoop(size_t num, std::function<void(size_t i)> Callback) {
 }
 
 void MultiThreadLoop(size_t num, std::function<void(size_t i)> Callback) {
-  size_t thread_num = Global<ThreadPool>::Get()->thread_num();
-  thread_num = std::min(num, thread_num);
-  BalancedSplitter bs(num, thread_num);
-  BlockingCounter bc(thread_num);
-  FOR_RANGE(size_t, range_id, 0, thread_num) {
-    Global<ThreadPool>::Get()->AddWork([&bc, &bs, range_id, Callback] {
-      FOR_RANGE(size_t, i, bs.At(range_id).begin(), bs.At(range_id).end()) { Callback(i); }
-      bc.Decrease();
-    });
-  }
-  bc.WaitUntilCntEqualZero();
+  ParallelFor(num, 1, ParallelForSchedule::kStatic, [&Callback](size_t begin, size_t end) {
+    FOR_RANGE(size_t, i, begin, end) { Callback(i); }
+  });
+}
+
+void ParallelFor(size_t num, size_t grain_size, ParallelForSchedule schedule,
+                 const std::function<void(size_t begin, size_t end)>& RangeCallback) {
+  Global<ThreadPool>::Get()->ParallelFor(num, grain_size, schedule, RangeCallback);
+}
+
+size_t GetRowGrainSize(int64_t row_size) {
+  // rows taken by one ParallelFor chunk are about this many elements
+  constexpr int64_t kRowGrainElemCnt = 32768;
+  return static_cast<size_t>(
+      std::max<int64_t>(kRowGrainElemCnt / std::max<int64_t>(row_size, 1), 1));
 }
 
 }  // namespace oneflow
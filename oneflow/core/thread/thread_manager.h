@@ -43,6 +43,12 @@ class ThreadMgr final {
 
 void SingleThreadLoop(size_t num, std::function<void(size_t i)> Callback);
 void MultiThreadLoop(size_t num, std::function<void(size_t i)> Callback);
+// see ThreadPool::ParallelFor, run on Global<ThreadPool>
+void ParallelFor(size_t num, size_t grain_size, ParallelForSchedule schedule,
+                 const std::function<void(size_t begin, size_t end)>& RangeCallback);
+// grain size of a ParallelFor over rows of row_size elements, a chunk of rows takes about 32K
+// elements
+size_t GetRowGrainSize(int64_t row_size);
 
 #define REGISTER_DEVICE_THREAD_CREATOR_WITH_STREAM_ID(device, creator) \
   REGISTER_CLASS_CREATOR(int, device, Thread, creator, const StreamId&)
@@ -17,28 +17,230 @@ limitations under the License.
 
 namespace oneflow {
 
+namespace {
+
+constexpr int64_t kLocalDequeCapacityLog2 = 12;
+
+struct WorkerThreadCtx {
+  const void* pool;
+  int32_t worker_id;
+};
+
+thread_local WorkerThreadCtx worker_thread_ctx = {nullptr, -1};
+
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#else
+  std::this_thread::yield();
+#endif
+}
+
+class ParallelForCtx final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(ParallelForCtx);
+  ParallelForCtx(size_t num, size_t grain_size, ParallelForSchedule schedule, size_t party_num,
+                 const std::function<void(size_t, size_t)>* RangeCallback)
+      : num_(num),
+        grain_size_(grain_size),
+        schedule_(schedule),
+        party_num_(party_num),
+        static_chunk_size_(RoundUp((num + party_num - 1) / party_num, grain_size)),
+        RangeCallback_(RangeCallback),
+        next_(0),
+        done_cnt_(0) {}
+  ~ParallelForCtx() = default;
+
+  void RunChunks() {
+    size_t begin = 0;
+    size_t end = 0;
+    while (TakeChunk(&begin, &end)) {
+      (*RangeCallback_)(begin, end);
+      if (done_cnt_.fetch_add(end - begin, std::memory_order_acq_rel) + (end - begin) == num_) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.notify_all();
+      }
+    }
+  }
+
+  void WaitUntilDone() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this]() { return done_cnt_.load(std::memory_order_acquire) == num_; });
+  }
+
+ private:
+  bool TakeChunk(size_t* begin, size_t* end) {
+    size_t cur = next_.load(std::memory_order_relaxed);
+    while (cur < num_) {
+      size_t chunk_size = grain_size_;
+      if (schedule_ == ParallelForSchedule::kStatic) {
+        chunk_size = static_chunk_size_;
+      } else if (schedule_ == ParallelForSchedule::kGuided) {
+        chunk_size = std::max(grain_size_, (num_ - cur) / (2 * party_num_));
+      }
+      const size_t next = std::min(num_, cur + chunk_size);
+      if (next_.compare_exchange_weak(cur, next, std::memory_order_relaxed)) {
+        *begin = cur;
+        *end = next;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  const size_t num_;
+  const size_t grain_size_;
+  const ParallelForSchedule schedule_;
+  const size_t party_num_;
+  const size_t static_chunk_size_;
+  // only dereferenced for a taken chunk, the caller outlives all taken chunks
+  const std::function<void(size_t, size_t)>* RangeCallback_;
+  std::atomic<size_t> next_;
+  std::atomic<size_t> done_cnt_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+};
+
+}  // namespace
+
+ThreadPool::Worker::Worker() : local_deque(kLocalDequeCapacityLog2) {}
+
 ThreadPool::ThreadPool(int32_t thread_num)
-    : work_chans_(thread_num), threads_(thread_num), work_cnt_(0) {
+    : ThreadPool(thread_num, ParseIntegerFromEnv("ONEFLOW_THREAD_POOL_SPIN_COUNT", 0)) {}
+
+ThreadPool::ThreadPool(int32_t thread_num, int32_t spin_count)
+    : threads_(thread_num),
+      spin_count_(spin_count),
+      work_cnt_(0),
+      num_sleeping_(0),
+      wakeup_cnt_(0),
+      is_closed_(false) {
+  CHECK_GT(thread_num, 0);
+  FOR_RANGE(int32_t, i, 0, thread_num) { workers_.emplace_back(new Worker()); }
   FOR_RANGE(int32_t, i, 0, thread_num) {
-    Channel<std::function<void()>>* chan = &(work_chans_.at(i));
-    threads_[i] = std::thread([chan]() {
-      std::function<void()> work;
-      while (chan->Receive(&work) == kChannelStatusSuccess) { work(); }
-    });
+    threads_[i] = std::thread([this, i]() { WorkerLoop(i); });
   }
 }
 
 ThreadPool::~ThreadPool() {
-  FOR_RANGE(int32_t, i, 0, work_chans_.size()) {
-    work_chans_.at(i).Close();
-    threads_.at(i).join();
+  {
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    is_closed_ = true;
+    sleep_cond_.notify_all();
   }
+  // workers drain all remaining works before exiting
+  for (std::thread& thread : threads_) { thread.join(); }
 }
 
+bool ThreadPool::IsInWorkerThread() const { return worker_thread_ctx.pool == this; }
+
 void ThreadPool::AddWork(const std::function<void()>& work) {
-  const size_t cur_chan_idx =
-      work_cnt_.fetch_add(1, std::memory_order_relaxed) % work_chans_.size();
-  work_chans_.at(cur_chan_idx).Send(work);
+  Work* new_work = new Work(work);
+  if (IsInWorkerThread()) {
+    const int32_t worker_id = worker_thread_ctx.worker_id;
+    if (!workers_.at(worker_id)->local_deque.Push(new_work)) { PushInbound(worker_id, new_work); }
+  } else {
+    const size_t worker_id = work_cnt_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+    PushInbound(worker_id, new_work);
+  }
+  NotifyOneIfSleeping();
+}
+
+void ThreadPool::ParallelFor(size_t num, size_t grain_size, ParallelForSchedule schedule,
+                             const std::function<void(size_t begin, size_t end)>& RangeCallback) {
+  if (num == 0) { return; }
+  grain_size = std::max<size_t>(grain_size, 1);
+  const size_t party_num = std::min<size_t>(thread_num(), (num + grain_size - 1) / grain_size);
+  if (party_num <= 1) {
+    RangeCallback(0, num);
+    return;
+  }
+  // works not started before the caller returns find no chunk left and just exit
+  auto ctx = std::make_shared<ParallelForCtx>(num, grain_size, schedule, party_num, &RangeCallback);
+  FOR_RANGE(size_t, i, 1, party_num) { AddWork([ctx]() { ctx->RunChunks(); }); }
+  ctx->RunChunks();
+  ctx->WaitUntilDone();
+}
+
+void ThreadPool::PushInbound(int32_t worker_id, Work* work) {
+  Worker* worker = workers_.at(worker_id).get();
+  std::unique_lock<std::mutex> lock(worker->inbound_mutex);
+  worker->inbound_queue.push_back(work);
+}
+
+ThreadPool::Work* ThreadPool::PopInbound(int32_t worker_id) {
+  Worker* worker = workers_.at(worker_id).get();
+  std::unique_lock<std::mutex> lock(worker->inbound_mutex);
+  if (worker->inbound_queue.empty()) { return nullptr; }
+  Work* work = worker->inbound_queue.front();
+  worker->inbound_queue.pop_front();
+  return work;
+}
+
+ThreadPool::Work* ThreadPool::FindWork(int32_t worker_id) {
+  Work* work = workers_.at(worker_id)->local_deque.Pop();
+  if (work != nullptr) { return work; }
+  work = PopInbound(worker_id);
+  if (work != nullptr) { return work; }
+  const int32_t worker_num = workers_.size();
+  FOR_RANGE(int32_t, i, 1, worker_num) {
+    const int32_t victim_id = (worker_id + i) % worker_num;
+    work = workers_.at(victim_id)->local_deque.Steal();
+    if (work != nullptr) { return work; }
+    work = PopInbound(victim_id);
+    if (work != nullptr) { return work; }
+  }
+  return nullptr;
+}
+
+bool ThreadPool::HasWork() {
+  for (const auto& worker : workers_) {
+    if (!worker->local_deque.Empty()) { return true; }
+    std::unique_lock<std::mutex> lock(worker->inbound_mutex);
+    if (!worker->inbound_queue.empty()) { return true; }
+  }
+  return false;
+}
+
+void ThreadPool::NotifyOneIfSleeping() {
+  // pairs with the fence in WorkerLoop, either the sleeping worker sees the new work or we see it
+  // sleeping
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (num_sleeping_.load(std::memory_order_relaxed) == 0) { return; }
+  std::unique_lock<std::mutex> lock(sleep_mutex_);
+  if (wakeup_cnt_ < num_sleeping_.load(std::memory_order_relaxed)) { wakeup_cnt_ += 1; }
+  sleep_cond_.notify_one();
+}
+
+void ThreadPool::WorkerLoop(int32_t worker_id) {
+  worker_thread_ctx.pool = this;
+  worker_thread_ctx.worker_id = worker_id;
+  while (true) {
+    Work* work = FindWork(worker_id);
+    for (int32_t i = 0; work == nullptr && i < spin_count_; ++i) {
+      CpuRelax();
+      work = FindWork(worker_id);
+    }
+    if (work != nullptr) {
+      (*work)();
+      delete work;
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    num_sleeping_.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!HasWork()) {
+      if (is_closed_) {
+        num_sleeping_.fetch_sub(1, std::memory_order_relaxed);
+        break;
+      }
+      sleep_cond_.wait(lock, [this]() { return wakeup_cnt_ > 0 || is_closed_; });
+      if (wakeup_cnt_ > 0) { wakeup_cnt_ -= 1; }
+    }
+    num_sleeping_.fetch_sub(1, std::memory_order_relaxed);
+  }
+  worker_thread_ctx.pool = nullptr;
+  worker_thread_ctx.worker_id = -1;
 }
 
 }  // namespace oneflow
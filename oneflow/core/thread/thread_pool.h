@@ -17,25 +17,73 @@ limitations under the License.
 #define ONEFLOW_CORE_THREAD_THREAD_POOL_H_
 
 #include "oneflow/core/common/util.h"
-#include "oneflow/core/common/channel.h"
+#include "oneflow/core/common/work_stealing_deque.h"
 
 namespace oneflow {
 
+enum class ParallelForSchedule {
+  // about one chunk per thread
+  kStatic = 0,
+  // chunks of grain_size taken on demand
+  kDynamic,
+  // chunks of remaining / (2 * thread_num) taken on demand, shrinking down to grain_size
+  kGuided,
+};
+
+// ThreadPool is a work-stealing thread pool.
+// Works added by threads outside the pool are dispatched round-robin to the inbound queue of
+// each worker, works added by a worker itself are pushed into its lock-free local deque. An idle
+// worker pops its local deque first, then its inbound queue, then steals from other workers, and
+// spins spin_count rounds before sleeping.
+// With thread_num == 1 works added from outside are executed in FIFO order.
 class ThreadPool final {
  public:
   OF_DISALLOW_COPY_AND_MOVE(ThreadPool);
   ThreadPool() = delete;
   ThreadPool(int32_t thread_num);
+  ThreadPool(int32_t thread_num, int32_t spin_count);
   ~ThreadPool();
 
   int32_t thread_num() const { return threads_.size(); }
   void AddWork(const std::function<void()>& work);
 
+  // return true if called from a worker thread of this pool
+  bool IsInWorkerThread() const;
+
+  // Calls RangeCallback(begin, end) on disjoint chunks covering [0, num), each chunk except the
+  // last one has at least grain_size iterations. The calling thread runs chunks too and only
+  // waits for chunks already taken by other workers, so it is safe to call from a work of this
+  // pool.
+  void ParallelFor(size_t num, size_t grain_size, ParallelForSchedule schedule,
+                   const std::function<void(size_t begin, size_t end)>& RangeCallback);
+
  private:
-  std::vector<Channel<std::function<void()>>> work_chans_;
+  using Work = std::function<void()>;
+
+  struct Worker {
+    Worker();
+    WorkStealingDeque<Work> local_deque;
+    std::mutex inbound_mutex;
+    std::deque<Work*> inbound_queue;
+  };
+
+  void WorkerLoop(int32_t worker_id);
+  void PushInbound(int32_t worker_id, Work* work);
+  Work* PopInbound(int32_t worker_id);
+  Work* FindWork(int32_t worker_id);
+  bool HasWork();
+  void NotifyOneIfSleeping();
+
+  std::vector<std::unique_ptr<Worker>> workers_;
   std::vector<std::thread> threads_;
+  int32_t spin_count_;
 
   std::atomic<size_t> work_cnt_;
+  std::atomic<int32_t> num_sleeping_;
+  std::mutex sleep_mutex_;
+  std::condition_variable sleep_cond_;
+  int64_t wakeup_cnt_;
+  bool is_closed_;
 };
 
 }  // namespace oneflow
@@ -0,0 +1,177 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/thread/thread_pool.h"
+#include "oneflow/core/common/blocking_counter.h"
+#include "oneflow/core/common/channel.h"
+
+namespace oneflow {
+
+namespace {
+
+// the round-robin channel dispatch ThreadPool used before, kept as the benchmark baseline
+class RoundRobinChannelPool final {
+ public:
+  explicit RoundRobinChannelPool(int32_t thread_num)
+      : work_chans_(thread_num), threads_(thread_num), work_cnt_(0) {
+    FOR_RANGE(int32_t, i, 0, thread_num) {
+      Channel<std::function<void()>>* chan = &(work_chans_.at(i));
+      threads_[i] = std::thread([chan]() {
+        std::function<void()> work;
+        while (chan->Receive(&work) == kChannelStatusSuccess) { work(); }
+      });
+    }
+  }
+  ~RoundRobinChannelPool() {
+    FOR_RANGE(int32_t, i, 0, work_chans_.size()) {
+      work_chans_.at(i).Close();
+      threads_.at(i).join();
+    }
+  }
+  void AddWork(const std::function<void()>& work) {
+    work_chans_.at(work_cnt_.fetch_add(1) % work_chans_.size()).Send(work);
+  }
+
+ private:
+  std::vector<Channel<std::function<void()>>> work_chans_;
+  std::vector<std::thread> threads_;
+  std::atomic<size_t> work_cnt_;
+};
+
+void BusyWaitNanos(int64_t nanos) {
+  const auto start = std::chrono::steady_clock::now();
+  while (std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()
+                                                              - start)
+             .count()
+         < nanos) {}
+}
+
+// one of every 64 works is 200x slower than the others
+template<typename PoolT>
+void BenchmarkSkewedWorks(const std::string& name, PoolT* pool) {
+  const int64_t work_num = 20000;
+  std::vector<int64_t> latencies(work_num);
+  BlockingCounter bc(work_num);
+  const auto start = std::chrono::steady_clock::now();
+  FOR_RANGE(int64_t, i, 0, work_num) {
+    const auto enqueue_time = std::chrono::steady_clock::now();
+    pool->AddWork([i, enqueue_time, &latencies, &bc]() {
+      latencies.at(i) = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now() - enqueue_time)
+                            .count();
+      BusyWaitNanos(i % 64 == 0 ? 200000 : 1000);
+      bc.Decrease();
+    });
+  }
+  bc.WaitUntilCntEqualZero();
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::sort(latencies.begin(), latencies.end());
+  LOG(INFO) << name << ": " << work_num / seconds << " works/s, p50 latency "
+            << latencies.at(work_num / 2) / 1000 << "us, p99 latency "
+            << latencies.at(work_num * 99 / 100) / 1000 << "us";
+}
+
+}  // namespace
+
+TEST(ThreadPool, all_works_done) {
+  ThreadPool pool(4);
+  std::atomic<int64_t> sum(0);
+  BlockingCounter bc(1000);
+  FOR_RANGE(int64_t, i, 0, 1000) {
+    pool.AddWork([i, &sum, &bc]() {
+      sum += i;
+      bc.Decrease();
+    });
+  }
+  bc.WaitUntilCntEqualZero();
+  ASSERT_EQ(sum, 999 * 1000 / 2);
+}
+
+TEST(ThreadPool, single_thread_fifo) {
+  std::vector<int64_t> order;
+  {
+    ThreadPool pool(1);
+    FOR_RANGE(int64_t, i, 0, 100) { pool.AddWork([i, &order]() { order.push_back(i); }); }
+  }
+  ASSERT_EQ(order.size(), 100);
+  FOR_RANGE(int64_t, i, 0, 100) { ASSERT_EQ(order.at(i), i); }
+}
+
+TEST(ThreadPool, nested_add_work) {
+  std::atomic<int64_t> cnt(0);
+  {
+    ThreadPool pool(4);
+    FOR_RANGE(int64_t, i, 0, 16) {
+      pool.AddWork([&pool, &cnt]() {
+        ASSERT_TRUE(pool.IsInWorkerThread());
+        // more works than the local deque capacity
+        FOR_RANGE(int64_t, j, 0, 5000) { pool.AddWork([&cnt]() { cnt += 1; }); }
+      });
+    }
+    ASSERT_FALSE(pool.IsInWorkerThread());
+  }
+  ASSERT_EQ(cnt, 16 * 5000);
+}
+
+TEST(ThreadPool, parallel_for) {
+  ThreadPool pool(4);
+  for (ParallelForSchedule schedule : {ParallelForSchedule::kStatic, ParallelForSchedule::kDynamic,
+                                       ParallelForSchedule::kGuided}) {
+    for (size_t num : {0, 1, 7, 1000, 12345}) {
+      std::vector<std::atomic<int32_t>> visits(num);
+      for (auto& visit : visits) { visit = 0; }
+      pool.ParallelFor(num, 16, schedule, [&](size_t begin, size_t end) {
+        ASSERT_LT(begin, end);
+        ASSERT_LE(end, num);
+        if (end != num) { ASSERT_GE(end - begin, 16); }
+        FOR_RANGE(size_t, i, begin, end) { visits.at(i) += 1; }
+      });
+      FOR_RANGE(size_t, i, 0, num) { ASSERT_EQ(visits.at(i), 1); }
+    }
+  }
+}
+
+TEST(ThreadPool, nested_parallel_for) {
+  ThreadPool pool(4);
+  std::atomic<int64_t> cnt(0);
+  pool.ParallelFor(64, 1, ParallelForSchedule::kDynamic, [&](size_t begin, size_t end) {
+    FOR_RANGE(size_t, i, begin, end) {
+      pool.ParallelFor(100, 1, ParallelForSchedule::kGuided,
+                       [&](size_t inner_begin, size_t inner_end) {
+                         cnt += inner_end - inner_begin;
+                       });
+    }
+  });
+  ASSERT_EQ(cnt, 64 * 100);
+}
+
+TEST(ThreadPool, DISABLED_benchmark_skewed_works) {
+  const int32_t thread_num = 4;
+  {
+    RoundRobinChannelPool pool(thread_num);
+    BenchmarkSkewedWorks("round robin channel pool", &pool);
+  }
+  {
+    ThreadPool pool(thread_num, 0);
+    BenchmarkSkewedWorks("work stealing pool", &pool);
+  }
+  {
+    ThreadPool pool(thread_num, 1024);
+    BenchmarkSkewedWorks("work stealing pool with spinning", &pool);
+  }
+}
+
+}  // namespace oneflow
@@ -19,6 +19,8 @@ limitations under the License.
 #include "oneflow/core/vm/instruction.msg.h"
 #include "oneflow/core/vm/thread_ctx.msg.h"
 #include "oneflow/core/vm/naive_instruction_status_querier.h"
+#include "oneflow/core/vm/cpu_caching_allocator.h"
+#include "oneflow/core/vm/thread_safe_allocator.h"
 #include "oneflow/core/device/cpu_device_context.h"
 #include "oneflow/core/common/util.h"
 
@@ -27,7 +29,13 @@ namespace vm {
 
 void AsyncCpuStreamType::InitDeviceCtx(std::unique_ptr<DeviceCtx>* device_ctx,
                                        Stream* stream) const {
-  device_ctx->reset(new CpuDeviceCtx());
+  if (ParseBooleanFromEnv("ONEFLOW_VM_CPU_CACHING_ALLOCATOR", false)) {
+    // each cpu device owns its caching allocator
+    device_ctx->reset(new CpuDeviceCtx(std::unique_ptr<Allocator>(new ThreadSafeAllocator(
+        std::unique_ptr<Allocator>(new CpuCachingAllocator(stream->device_id()))))));
+  } else {
+    device_ctx->reset(new CpuDeviceCtx());
+  }
 }
 
 void AsyncCpuStreamType::InitInstructionStatus(const Stream& stream,
@@ -0,0 +1,331 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <cstdlib>
+#include "oneflow/core/vm/cpu_caching_allocator.h"
+
+namespace oneflow {
+namespace vm {
+
+namespace {
+
+inline size_t CpuMemAlignedBytes(size_t bytes) { return RoundUp(bytes, kHostAlignSize); }
+
+inline bool IsAlignedSize(size_t size) { return size % kHostAlignSize == 0; }
+
+constexpr size_t kPieceSplitThreshold = 1 << 20;  // 1MiB
+
+constexpr size_t kMinBlockSize = 2 << 20;  // 2MiB
+constexpr size_t kMinAlloc =
+    1 << 20;  // allocations less than 1MiB should be packed in kMinBlockSize bytes.
+
+}  // namespace
+
+std::string CpuCachingAllocatorStat::ToString() const {
+  std::stringstream ss;
+  ss << "total_bytes: " << total_bytes << ", in_use_bytes: " << in_use_bytes
+     << ", cached_bytes: " << cached_bytes
+     << ", largest_free_piece_bytes: " << largest_free_piece_bytes
+     << ", num_allocate: " << num_allocate << ", num_cache_hit: " << num_cache_hit
+     << ", hit_rate: " << HitRate() << ", fragmentation: " << Fragmentation()
+     << ", num_block_allocate: " << num_block_allocate << ", num_block_free: " << num_block_free
+     << ", num_garbage_collection: " << num_garbage_collection;
+  return ss.str();
+}
+
+CpuCachingAllocator::CpuCachingAllocator(int64_t device_id)
+    : CpuCachingAllocator(
+        device_id,
+        ParseIntegerFromEnv("ONEFLOW_VM_CPU_CACHING_ALLOCATOR_SOFT_LIMIT_MB", 0) * 1048576) {}
+
+CpuCachingAllocator::CpuCachingAllocator(int64_t device_id, size_t soft_limit_bytes)
+    : Allocator(),
+      device_id_(device_id),
+      soft_limit_bytes_(soft_limit_bytes),
+      total_memory_bytes_(0),
+      in_use_bytes_(0),
+      num_allocate_(0),
+      num_cache_hit_(0),
+      num_block_allocate_(0),
+      num_block_free_(0),
+      num_garbage_collection_(0),
+      recycle_piece_list_(nullptr) {
+  bins_.resize(kBinNumSize);
+  for (int i = 0; i < kBinNumSize; ++i) {
+    size_t bin_size = BinSize4BinNum(i);
+    bins_.at(i).size = bin_size;
+    CHECK_EQ(BinNum4BinSize(bin_size), i);
+    CHECK_EQ(BinNum4BinSize(bin_size + kCpuMemAllocAlignSize - 1), i);
+    CHECK_EQ(BinNum4BinSize(bin_size * 2 - 1), i);
+    CHECK_EQ(BinNum4BinSize(bin_size * 2), i == (kBinNumSize - 1) ? i : i + 1);
+  }
+}
+
+CpuCachingAllocator::~CpuCachingAllocator() {
+  VLOG(1) << "CpuCachingAllocator of device " << device_id_ << " " << GetStat().ToString();
+  for (auto& pair : mem_ptr2block_) { std::free(pair.first); }
+}
+
+CpuCachingAllocatorStat CpuCachingAllocator::GetStat() const {
+  CpuCachingAllocatorStat stat;
+  stat.total_bytes = total_memory_bytes_;
+  stat.in_use_bytes = in_use_bytes_;
+  stat.cached_bytes = total_memory_bytes_ - in_use_bytes_;
+  for (int32_t bin_num = kBinNumSize - 1; bin_num >= 0; --bin_num) {
+    const auto& pieces = bins_.at(bin_num).pieces;
+    if (!pieces.empty()) {
+      stat.largest_free_piece_bytes = (*pieces.rbegin())->size;
+      break;
+    }
+  }
+  stat.num_allocate = num_allocate_;
+  stat.num_cache_hit = num_cache_hit_;
+  stat.num_block_allocate = num_block_allocate_;
+  stat.num_block_free = num_block_free_;
+  stat.num_garbage_collection = num_garbage_collection_;
+  return stat;
+}
+
+void CpuCachingAllocator::InsertPiece2Bin(Piece* piece) {
+  CHECK(piece->is_free && piece->bin_num == kInvalidBinNum);
+  int32_t bin_num = BinNum4BinSize(piece->size);
+  piece->bin_num = bin_num;
+  CHECK(bins_.at(bin_num).pieces.insert(piece).second);
+}
+
+void CpuCachingAllocator::RemovePieceFromBin(Piece* piece) {
+  CHECK(piece->is_free);
+  CHECK_NE(piece->bin_num, kInvalidBinNum);
+  CHECK_GT(bins_.at(piece->bin_num).pieces.erase(piece), 0);
+  piece->bin_num = kInvalidBinNum;
+}
+
+CpuCachingAllocator::Piece* CpuCachingAllocator::AllocatePiece() {
+  if (recycle_piece_list_) {
+    Piece* ret = recycle_piece_list_;
+    recycle_piece_list_ = recycle_piece_list_->next;
+    return ret;
+  } else {
+    pieces_.emplace_back(new Piece());
+    return pieces_.at(pieces_.size() - 1).get();
+  }
+}
+
+void CpuCachingAllocator::DeallocatePiece(Piece* piece) {
+  piece->ptr = nullptr;
+  piece->size = 0;
+  piece->bin_num = kInvalidBinNum;
+  piece->is_free = true;
+  piece->prev = nullptr;
+  piece->next = recycle_piece_list_;
+  recycle_piece_list_ = piece;
+}
+
+void CpuCachingAllocator::MarkPiece(Piece* piece) {
+  CHECK_NOTNULL(piece->ptr);
+  CHECK(ptr2piece_.emplace(piece->ptr, piece).second);
+}
+
+void CpuCachingAllocator::UnMarkPiece(Piece* piece) {
+  CHECK_NOTNULL(piece->ptr);
+  auto it = ptr2piece_.find(piece->ptr);
+  CHECK(it != ptr2piece_.end());
+  ptr2piece_.erase(it);
+}
+
+CpuCachingAllocator::Piece* CpuCachingAllocator::FindPiece(size_t aligned_size) {
+  CHECK(IsAlignedSize(aligned_size));
+  for (int32_t bin_num = BinNum4BinSize(aligned_size); bin_num < kBinNumSize; ++bin_num) {
+    Bin* bin = &bins_.at(bin_num);
+    // pieces are ordered by size, so the first fitting piece is the best fit in this bin
+    for (auto it = bin->pieces.begin(); it != bin->pieces.end(); ++it) {
+      Piece* piece = *it;
+      CHECK(piece->is_free);
+      CHECK_NOTNULL(piece->ptr);
+      CHECK_EQ(piece->bin_num, bin_num);
+      CHECK(IsAlignedSize(piece->size));
+      if (piece->size >= aligned_size) {
+        bin->pieces.erase(it);
+        piece->bin_num = kInvalidBinNum;
+        piece->is_free = false;
+        if (piece->size >= aligned_size * 2 || piece->size - aligned_size >= kPieceSplitThreshold) {
+          Piece* new_piece = AllocatePiece();
+          new_piece->ptr = piece->ptr + aligned_size;
+          new_piece->size = piece->size - aligned_size;
+          piece->size = aligned_size;
+
+          Piece* next_p = piece->next;
+          piece->next = new_piece;
+          new_piece->prev = piece;
+          new_piece->next = next_p;
+          if (next_p != nullptr) { next_p->prev = new_piece; }
+
+          new_piece->is_free = true;
+          new_piece->bin_num = kInvalidBinNum;
+          CHECK(IsAlignedSize(piece->size));
+          CHECK(IsAlignedSize(new_piece->size));
+          InsertPiece2Bin(new_piece);
+          MarkPiece(new_piece);
+        }
+        return piece;
+      }
+    }
+  }
+  return nullptr;
+}
+
+void CpuCachingAllocator::MergeNeighbourFreePiece(Piece* lhs, Piece* rhs) {
+  CHECK(lhs->is_free);
+  CHECK(rhs->is_free);
+  CHECK(lhs->next == rhs);
+  CHECK(lhs == rhs->prev);
+  CHECK(lhs->ptr + lhs->size == rhs->ptr);
+
+  lhs->size += rhs->size;
+  lhs->next = rhs->next;
+  if (rhs->next != nullptr) { rhs->next->prev = lhs; }
+  UnMarkPiece(rhs);
+  DeallocatePiece(rhs);
+}
+
+bool CpuCachingAllocator::AllocateBlockToExtendTotalMem(size_t aligned_size) {
+  CHECK(IsAlignedSize(aligned_size));
+  size_t allocate_bytes = aligned_size;
+  if (allocate_bytes < kMinAlloc) { allocate_bytes = kMinBlockSize; }
+  const size_t final_allocate_bytes = CpuMemAlignedBytes(allocate_bytes);
+
+  char* mem_ptr = reinterpret_cast<char*>(aligned_alloc(kHostAlignSize, final_allocate_bytes));
+  if (mem_ptr == nullptr) { return false; }
+
+  total_memory_bytes_ += final_allocate_bytes;
+  num_block_allocate_ += 1;
+
+  Piece* piece = AllocatePiece();
+  piece->size = final_allocate_bytes;
+  piece->ptr = mem_ptr;
+  piece->prev = nullptr;
+  piece->next = nullptr;
+  piece->is_free = true;
+  piece->bin_num = kInvalidBinNum;
+  InsertPiece2Bin(piece);
+  MarkPiece(piece);
+
+  CHECK(mem_ptr2block_.emplace(mem_ptr, Block(piece)).second);
+
+  return true;
+}
+
+bool CpuCachingAllocator::DeallocateFreeBlockForGarbageCollection() {
+  num_garbage_collection_ += 1;
+  size_t total_free_bytes = 0;
+  HashSet<char*> free_block_ptrs;
+  for (const auto& pair : mem_ptr2block_) {
+    const Block& block = pair.second;
+    // a free Block is always merged into its start Piece
+    if (block.start_piece->is_free && block.start_piece->next == nullptr) {
+      CHECK_EQ(block.start_piece->size, block.size);
+      total_free_bytes += block.size;
+      free_block_ptrs.insert(pair.first);
+    }
+  }
+
+  total_memory_bytes_ -= total_free_bytes;
+
+  if (total_free_bytes > 0) {
+    VLOG(1) << "CpuCachingAllocator try deallocate free block for garbage collection. "
+            << " deallocate free bytes : " << total_free_bytes;
+    for (char* ptr : free_block_ptrs) {
+      auto it = mem_ptr2block_.find(ptr);
+      CHECK(it != mem_ptr2block_.end());
+      Piece* piece = it->second.start_piece;
+      CHECK_EQ(piece->ptr, ptr);
+      RemovePieceFromBin(piece);
+      UnMarkPiece(piece);
+      DeallocatePiece(piece);
+      mem_ptr2block_.erase(it);
+      num_block_free_ += 1;
+      std::free(ptr);
+    }
+  }
+
+  return total_free_bytes > 0;
+}
+
+void CpuCachingAllocator::Allocate(char** mem_ptr, std::size_t size) {
+  if (size == 0) {
+    *mem_ptr = nullptr;
+    return;
+  }
+  size_t aligned_size = CpuMemAlignedBytes(size);
+  num_allocate_ += 1;
+
+  Piece* piece = FindPiece(aligned_size);
+  if (piece != nullptr) {
+    num_cache_hit_ += 1;
+  } else {
+    if (soft_limit_bytes_ > 0 && total_memory_bytes_ + aligned_size > soft_limit_bytes_) {
+      DeallocateFreeBlockForGarbageCollection();
+    }
+    if (AllocateBlockToExtendTotalMem(aligned_size)) { piece = FindPiece(aligned_size); }
+  }
+
+  if (piece == nullptr) {
+    if (DeallocateFreeBlockForGarbageCollection() && AllocateBlockToExtendTotalMem(aligned_size)) {
+      piece = FindPiece(aligned_size);
+    }
+  }
+
+  CHECK(piece != nullptr) << "Error! : Out of memory when allocate size : " << size;
+  CHECK_NOTNULL(piece->ptr);
+  CHECK(ptr2piece_.find(piece->ptr) != ptr2piece_.end());
+  in_use_bytes_ += piece->size;
+  *mem_ptr = piece->ptr;
+}
+
+void CpuCachingAllocator::Deallocate(char* mem_ptr, std::size_t size) {
+  if (mem_ptr == nullptr) { return; }
+
+  auto it = ptr2piece_.find(mem_ptr);
+  CHECK(it != ptr2piece_.end()) << "Error! : Try deallocate mem_ptr non-existent. mem ptr = "
+                                << reinterpret_cast<void*>(mem_ptr) << " size = " << size;
+  Piece* piece = it->second;
+  CHECK_NOTNULL(piece);
+  CHECK_EQ(piece->ptr, mem_ptr);
+  CHECK(!piece->is_free);
+
+  piece->is_free = true;
+  in_use_bytes_ -= piece->size;
+
+  Piece* last_piece_insert_to_bin = piece;
+  Piece* next_p = piece->next;
+  Piece* prev_p = piece->prev;
+
+  if (next_p != nullptr && next_p->is_free) {
+    CHECK_EQ(next_p->ptr, piece->ptr + piece->size);
+    RemovePieceFromBin(next_p);
+    MergeNeighbourFreePiece(piece, next_p);
+  }
+
+  if (prev_p != nullptr && prev_p->is_free) {
+    CHECK_EQ(piece->ptr, prev_p->ptr + prev_p->size);
+    RemovePieceFromBin(prev_p);
+    MergeNeighbourFreePiece(prev_p, piece);
+    last_piece_insert_to_bin = prev_p;
+  }
+  InsertPiece2Bin(last_piece_insert_to_bin);
+}
+
+}  // namespace vm
+}  // namespace oneflow
@@ -0,0 +1,151 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_VM_CPU_CACHING_ALLOCATOR_H_
+#define ONEFLOW_CORE_VM_CPU_CACHING_ALLOCATOR_H_
+
+#include <cstdint>
+#include "oneflow/core/vm/allocator.h"
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+namespace vm {
+
+struct CpuCachingAllocatorStat {
+  // bytes obtained from the system and not yet released
+  size_t total_bytes = 0;
+  // bytes handed out to callers (after alignment)
+  size_t in_use_bytes = 0;
+  // bytes held in free Pieces, i.e. total_bytes - in_use_bytes
+  size_t cached_bytes = 0;
+  // size of the largest free Piece
+  size_t largest_free_piece_bytes = 0;
+  int64_t num_allocate = 0;
+  // allocations served by a cached free Piece without touching the system allocator
+  int64_t num_cache_hit = 0;
+  int64_t num_block_allocate = 0;
+  int64_t num_block_free = 0;
+  int64_t num_garbage_collection = 0;
+
+  double HitRate() const {
+    return num_allocate == 0 ? 0.0 : static_cast<double>(num_cache_hit) / num_allocate;
+  }
+  // 0 means all cached bytes are in one contiguous Piece, close to 1 means they are scattered
+  double Fragmentation() const {
+    return cached_bytes == 0 ? 0.0
+                             : 1.0 - static_cast<double>(largest_free_piece_bytes) / cached_bytes;
+  }
+  std::string ToString() const;
+};
+
+// CpuCachingAllocator is the host memory counterpart of CudaAllocator. It caches memory obtained
+// by aligned_alloc in Blocks, splits them into Pieces on Allocate() and coalesces neighbour free
+// Pieces on Deallocate(), so that eager cpu tensors do not hit the system allocator every time.
+//
+// CpuCachingAllocator is not thread safe, wrap it with ThreadSafeAllocator when shared.
+class CpuCachingAllocator final : public Allocator {
+ public:
+  explicit CpuCachingAllocator(int64_t device_id);
+  // Free Blocks are released before extending the total memory beyond soft_limit_bytes.
+  // soft_limit_bytes == 0 means garbage collection only happens when aligned_alloc fails.
+  CpuCachingAllocator(int64_t device_id, size_t soft_limit_bytes);
+  ~CpuCachingAllocator() override;
+
+  void Allocate(char** mem_ptr, std::size_t size) override;
+  void Deallocate(char* mem_ptr, std::size_t size) override;
+
+  CpuCachingAllocatorStat GetStat() const;
+
+ private:
+  static constexpr int32_t kInvalidBinNum = -1;
+  static constexpr int32_t kBinNumSize = 24;
+  static constexpr size_t kCpuMemAllocAlignSize = kHostAlignSize;
+
+  // Piece is the basic memory unit of CpuCachingAllocator, see CudaAllocator::Piece
+  struct Piece {
+    size_t size = 0;
+    char* ptr = nullptr;
+    bool is_free = false;
+    Piece* prev = nullptr;
+    Piece* next = nullptr;
+    int32_t bin_num = kInvalidBinNum;
+  };
+
+  // Bin stores free Pieces of similar size. The size of each Bin is twice the size of the
+  // previous Bin, like
+  //    BinNum:   Bin0, Bin1, Bin2, Bin3, ..., Bin23
+  //    BinSize:  64,   128,  256,  512,  ..., 512MB
+  struct Bin {
+    size_t size = 0;
+
+    struct PieceCmp {
+      bool operator()(const Piece* lhs, const Piece* rhs) const {
+        if (lhs->size != rhs->size) { return lhs->size < rhs->size; }
+        return lhs->ptr < rhs->ptr;
+      }
+    };
+    std::set<Piece*, PieceCmp> pieces;
+  };
+
+  // Block is the memory actually allocated from the system
+  struct Block {
+    size_t size = 0;
+    char* ptr = nullptr;
+    Piece* start_piece = nullptr;
+    Block(Piece* p) : size(p->size), ptr(p->ptr), start_piece(p) {}
+  };
+
+  size_t BinSize4BinNum(int32_t bin_num) { return kCpuMemAllocAlignSize << bin_num; }
+
+  int32_t BinNum4BinSize(size_t size) {
+    uint64_t value = std::max(size, kCpuMemAllocAlignSize) >> 6;
+    return std::min(kBinNumSize - 1, static_cast<int32_t>(63 ^ __builtin_clzll(value)));
+  }
+
+  Piece* FindPiece(size_t aligned_size);
+  void InsertPiece2Bin(Piece* piece);
+  void RemovePieceFromBin(Piece* piece);
+
+  Piece* AllocatePiece();
+  void DeallocatePiece(Piece* piece);
+  void MarkPiece(Piece* piece);
+  void UnMarkPiece(Piece* piece);
+
+  void MergeNeighbourFreePiece(Piece* lhs, Piece* rhs);
+
+  bool AllocateBlockToExtendTotalMem(size_t aligned_size);
+  bool DeallocateFreeBlockForGarbageCollection();
+
+  int64_t device_id_;
+  size_t soft_limit_bytes_;
+  size_t total_memory_bytes_;
+  size_t in_use_bytes_;
+  int64_t num_allocate_;
+  int64_t num_cache_hit_;
+  int64_t num_block_allocate_;
+  int64_t num_block_free_;
+  int64_t num_garbage_collection_;
+  HashMap<char*, Block> mem_ptr2block_;
+
+  std::vector<Bin> bins_;
+  std::vector<std::unique_ptr<Piece>> pieces_;
+  HashMap<char*, Piece*> ptr2piece_;
+  Piece* recycle_piece_list_;
+};
+
+}  // namespace vm
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_VM_CPU_CACHING_ALLOCATOR_H_
@@ -0,0 +1,79 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/vm/cpu_caching_allocator.h"
+#include "oneflow/core/vm/thread_safe_allocator.h"
+
+namespace oneflow {
+namespace vm {
+
+TEST(CpuCachingAllocator, allocate_and_reuse) {
+  CpuCachingAllocator allocator(0, 0);
+  std::vector<char*> ptrs;
+  for (int i = 0; i < 512; ++i) {
+    char* ptr = nullptr;
+    allocator.Allocate(&ptr, 1);
+    ASSERT_TRUE(ptr != nullptr);
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(ptr) % kHostAlignSize, 0);
+    ptrs.push_back(ptr);
+  }
+  std::sort(ptrs.begin(), ptrs.end());
+  for (int i = 0; i < 512; ++i) {
+    if (i > 0) { ASSERT_TRUE(ptrs.at(i) - ptrs.at(i - 1) >= kHostAlignSize); }
+    allocator.Deallocate(ptrs.at(i), 1);
+  }
+  CpuCachingAllocatorStat stat = allocator.GetStat();
+  ASSERT_EQ(stat.in_use_bytes, 0);
+  ASSERT_EQ(stat.num_allocate, 512);
+  ASSERT_EQ(stat.num_block_allocate, 1);
+  ASSERT_EQ(stat.num_cache_hit, 511);
+  // all pieces are merged back into the only block
+  ASSERT_EQ(stat.largest_free_piece_bytes, stat.total_bytes);
+  ASSERT_EQ(stat.Fragmentation(), 0.0);
+
+  char* data_ptr_1 = nullptr;
+  allocator.Allocate(&data_ptr_1, 2048 * sizeof(float));
+  char* data_ptr_2 = nullptr;
+  allocator.Allocate(&data_ptr_2, 4096 * sizeof(double));
+  ASSERT_TRUE(data_ptr_1 + 2048 * sizeof(float) <= data_ptr_2
+              || data_ptr_2 + 4096 * sizeof(double) <= data_ptr_1);
+  std::memset(data_ptr_1, 1, 2048 * sizeof(float));
+  std::memset(data_ptr_2, 2, 4096 * sizeof(double));
+  ASSERT_EQ(allocator.GetStat().num_block_allocate, 1);
+  allocator.Deallocate(data_ptr_2, 4096 * sizeof(double));
+  allocator.Deallocate(data_ptr_1, 2048 * sizeof(float));
+}
+
+TEST(CpuCachingAllocator, garbage_collection_on_soft_limit) {
+  const size_t soft_limit_bytes = 8 << 20;
+  std::unique_ptr<CpuCachingAllocator> backend(new CpuCachingAllocator(0, soft_limit_bytes));
+  CpuCachingAllocator* caching_allocator = backend.get();
+  ThreadSafeAllocator allocator(std::move(backend));
+  char* large_ptr = nullptr;
+  allocator.Allocate(&large_ptr, 6 << 20);
+  allocator.Deallocate(large_ptr, 6 << 20);
+  ASSERT_EQ(caching_allocator->GetStat().cached_bytes, 6 << 20);
+  // the cached 6MiB block can not serve 7MiB and is released to stay under the soft limit
+  allocator.Allocate(&large_ptr, 7 << 20);
+  CpuCachingAllocatorStat stat = caching_allocator->GetStat();
+  ASSERT_EQ(stat.num_garbage_collection, 1);
+  ASSERT_EQ(stat.num_block_free, 1);
+  ASSERT_EQ(stat.total_bytes, 7 << 20);
+  ASSERT_EQ(stat.in_use_bytes, 7 << 20);
+  allocator.Deallocate(large_ptr, 7 << 20);
+}
+
+}  // namespace vm
+}  // namespace oneflow
@@ -13,6 +13,7 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 */
+#include <chrono>
 #include <iostream>
 #include "oneflow/core/vm/virtual_machine.msg.h"
 #include "oneflow/core/vm/control_stream_type.h"
@@ -24,6 +25,7 @@ limitations under the License.
 #include "oneflow/core/vm/stream_desc.msg.h"
 #include "oneflow/core/object_msg/object_msg_reflection.h"
 #include "oneflow/core/common/util.h"
+#include "oneflow/core/common/cached_object_msg_allocator.h"
 
 namespace oneflow {
 namespace vm {
@@ -47,6 +49,59 @@ TEST(VirtualMachine, ToDot) {
   // std::cout << std::endl;
 }
 
+// schedules `round_cnt` batches of `batch_size` Nop instructions which all mutate the same object,
+// so that every instruction creates accesses and an edge to its predecessor.
+double ScheduleNopInstructionsPerSecond(VirtualMachine* vm, int64_t round_cnt, int64_t batch_size) {
+  const auto RunUntilEmpty = [vm]() {
+    while (!vm->Empty()) {
+      vm->Schedule();
+      OBJECT_MSG_LIST_FOR_EACH_PTR(vm->mut_thread_ctx_list(), t) { t->TryReceiveAndRun(); }
+    }
+  };
+  InstructionMsgList list;
+  int64_t object_id = TestUtil::NewObject(&list, "cpu", "0:0");
+  vm->Receive(&list);
+  RunUntilEmpty();
+  const auto start = std::chrono::steady_clock::now();
+  FOR_RANGE(int64_t, round, 0, round_cnt) {
+    FOR_RANGE(int64_t, i, 0, batch_size) {
+      auto nop_instr_msg = NewInstruction("Nop");
+      nop_instr_msg->add_mut_operand(object_id);
+      list.EmplaceBack(std::move(nop_instr_msg));
+    }
+    vm->Receive(&list);
+    RunUntilEmpty();
+  }
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return round_cnt * batch_size / seconds;
+}
+
+// Everything runs on the test thread, so the scheduler objects of the second vm can come from a
+// ThreadUnsafeObjectMsgAllocator.
+TEST(VirtualMachine, DISABLED_benchmark_schedule) {
+  TestResourceDescScope scope(1, 1);
+  auto vm_desc = ObjectMsgPtr<VmDesc>::New(TestUtil::NewVmResourceDesc().Get());
+  TestUtil::AddStreamDescByInstrNames(vm_desc.Mutable(), {"Nop", "NewObject"});
+  const int64_t kRoundCnt = 200;
+  for (int64_t batch_size : {1, 16, 256}) {
+    double default_allocator_ips = 0;
+    {
+      auto vm = ObjectMsgPtr<VirtualMachine>::New(vm_desc.Get());
+      default_allocator_ips = ScheduleNopInstructionsPerSecond(vm.Mutable(), kRoundCnt, batch_size);
+    }
+    double pooled_allocator_ips = 0;
+    {
+      ThreadUnsafeObjectMsgAllocator allocator(16, 16);
+      auto vm = ObjectMsgPtr<VirtualMachine>::New(vm_desc.Get(), &allocator);
+      pooled_allocator_ips = ScheduleNopInstructionsPerSecond(vm.Mutable(), kRoundCnt, batch_size);
+    }
+    LOG(INFO) << "vm schedule, batch " << batch_size << ": default allocator "
+              << default_allocator_ips << " instructions/s, pooled allocator "
+              << pooled_allocator_ips << " instructions/s";
+  }
+}
+
 }  // namespace
 
 }  // namespace test
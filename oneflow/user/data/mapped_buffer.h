@@ -0,0 +1,46 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_DATA_MAPPED_BUFFER_H_
+#define ONEFLOW_USER_DATA_MAPPED_BUFFER_H_
+
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+
+namespace data {
+
+class MappedBuffer final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(MappedBuffer);
+  MappedBuffer(const std::string& filename);
+  ~MappedBuffer();
+
+  const void* ptr() const { return mapped_; }
+  size_t size() const { return size_; }
+
+  // Hint the kernel to start paging in [offset, offset + len) asynchronously
+  void WillNeed(size_t offset, size_t len) const;
+
+ private:
+  void* mapped_;
+  size_t size_;
+};
+
+}  // namespace data
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_DATA_MAPPED_BUFFER_H_
@@ -0,0 +1,50 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_DATA_MAPPED_OFRECORD_DATA_READER_H_
+#define ONEFLOW_USER_DATA_MAPPED_OFRECORD_DATA_READER_H_
+
+#include "oneflow/user/data/data_reader.h"
+#include "oneflow/user/data/mapped_ofrecord_dataset.h"
+#include "oneflow/user/data/mapped_ofrecord_parser.h"
+#include "oneflow/user/data/random_shuffle_dataset.h"
+#include "oneflow/user/data/batch_dataset.h"
+
+namespace oneflow {
+namespace data {
+
+class MappedOFRecordDataReader final : public DataReader<MappedOFRecord> {
+ public:
+  MappedOFRecordDataReader(user_op::KernelInitContext* ctx) : DataReader<MappedOFRecord>(ctx) {
+    loader_.reset(new MappedOFRecordDataset(ctx));
+    parser_.reset(new MappedOFRecordParser());
+    if (ctx->Attr<bool>("random_shuffle")) {
+      loader_.reset(new RandomShuffleDataset<MappedOFRecord>(ctx, std::move(loader_)));
+    }
+    int32_t batch_size = ctx->TensorDesc4ArgNameAndIndex("out", 0)->shape().elem_cnt();
+    loader_.reset(new BatchDataset<MappedOFRecord>(batch_size, std::move(loader_)));
+    StartLoadThread();
+  }
+  ~MappedOFRecordDataReader() = default;
+
+ protected:
+  using DataReader<MappedOFRecord>::loader_;
+  using DataReader<MappedOFRecord>::parser_;
+};
+
+}  // namespace data
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_DATA_MAPPED_OFRECORD_DATA_READER_H_
@@ -0,0 +1,147 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_DATA_MAPPED_OFRECORD_DATASET_H_
+#define ONEFLOW_USER_DATA_MAPPED_OFRECORD_DATASET_H_
+
+#include "oneflow/user/data/dataset.h"
+#include "oneflow/user/data/mapped_buffer.h"
+#include "oneflow/user/data/ofrecord_dataset.h"
+#include "oneflow/core/common/balanced_splitter.h"
+
+namespace oneflow {
+namespace data {
+
+// A serialized OFRecord living inside a mapped part file, the mapping is kept alive as long as
+// any record referencing it is
+struct MappedOFRecord {
+  std::shared_ptr<const MappedBuffer> file;
+  const char* data;
+  int64_t size;
+};
+
+class MappedOFRecordDataset final : public Dataset<MappedOFRecord> {
+ public:
+  using LoadTargetPtr = std::shared_ptr<MappedOFRecord>;
+  using LoadTargetPtrList = std::vector<LoadTargetPtr>;
+  OF_DISALLOW_COPY_AND_MOVE(MappedOFRecordDataset);
+  MappedOFRecordDataset(user_op::KernelInitContext* ctx)
+      : MappedOFRecordDataset(
+          GetOFRecordDataFilePaths(ctx),
+          BalancedSplitter(ctx->Attr<int32_t>("data_part_num"), ctx->parallel_ctx().parallel_num())
+              .At(ctx->parallel_ctx().parallel_id()),
+          ctx->Attr<bool>("shuffle_after_epoch")) {}
+  MappedOFRecordDataset(const std::vector<std::string>& data_file_paths, Range range,
+                        bool shuffle_after_epoch)
+      : shuffle_after_epoch_(shuffle_after_epoch),
+        current_epoch_(0),
+        range_(range),
+        data_file_paths_(data_file_paths),
+        prefetch_bytes_(
+            ParseIntegerFromEnv("ONEFLOW_OFRECORD_MMAP_PREFETCH_BYTES", 32 * 1024 * 1024)),
+        file_idx_(-1),
+        record_idx_(0),
+        prefetched_end_(0) {
+    CHECK_GT(range_.size(), 0);
+    CHECK_LE(range_.end(), data_file_paths_.size());
+    CHECK_GE(prefetch_bytes_, 0);
+  }
+  ~MappedOFRecordDataset() = default;
+
+  LoadTargetPtrList Next() override {
+    int64_t empty_file_cnt = 0;
+    while (record_idx_ >= record_index_.size()) {
+      CHECK_LE(empty_file_cnt, range_.size()) << "no OFRecord found in the local part files";
+      OpenNextFile();
+      if (record_index_.empty()) { ++empty_file_cnt; }
+    }
+    const std::pair<int64_t, int64_t>& record = record_index_.at(record_idx_);
+    ++record_idx_;
+    Prefetch(record.first + record.second);
+    LoadTargetPtrList ret;
+    LoadTargetPtr sample_ptr(new MappedOFRecord());
+    sample_ptr->file = file_;
+    sample_ptr->data = static_cast<const char*>(file_->ptr()) + record.first;
+    sample_ptr->size = record.second;
+    ret.push_back(std::move(sample_ptr));
+    return ret;
+  }
+
+ private:
+  void OpenNextFile() {
+    ++file_idx_;
+    if (file_idx_ == range_.size()) {
+      if (shuffle_after_epoch_) { ShuffleAfterEpoch(); }
+      file_idx_ = 0;
+    }
+    // records handed out earlier still hold the previous mapping
+    file_.reset(new MappedBuffer(data_file_paths_.at(range_.begin() + file_idx_)));
+    record_idx_ = 0;
+    prefetched_end_ = 0;
+    Prefetch(0);
+    BuildRecordIndex();
+  }
+
+  // Each record is stored as an int64 byte size followed by the serialized OFRecord
+  void BuildRecordIndex() {
+    record_index_.clear();
+    const char* base = static_cast<const char*>(file_->ptr());
+    const int64_t file_size = file_->size();
+    int64_t offset = 0;
+    while (offset < file_size) {
+      int64_t record_size = -1;
+      CHECK_LE(offset + static_cast<int64_t>(sizeof(int64_t)), file_size);
+      std::memcpy(&record_size, base + offset, sizeof(int64_t));
+      offset += sizeof(int64_t);
+      CHECK_GT(record_size, 0);
+      CHECK_LE(offset + record_size, file_size);
+      record_index_.emplace_back(offset, record_size);
+      offset += record_size;
+    }
+  }
+
+  // Keep at least half of the prefetch window ahead of the consumed position paged in
+  void Prefetch(int64_t consumed_end) {
+    if (prefetch_bytes_ == 0 || prefetched_end_ >= static_cast<int64_t>(file_->size())) { return; }
+    if (consumed_end + prefetch_bytes_ / 2 < prefetched_end_) { return; }
+    const int64_t begin = std::max(prefetched_end_, consumed_end);
+    file_->WillNeed(begin, prefetch_bytes_);
+    prefetched_end_ = begin + prefetch_bytes_;
+  }
+
+  void ShuffleAfterEpoch() {
+    current_epoch_++;  // move to next epoch
+    std::mt19937 g(kOneflowDatasetSeed + current_epoch_);
+    std::shuffle(data_file_paths_.begin(), data_file_paths_.end(), g);
+  }
+
+  bool shuffle_after_epoch_;
+  int32_t current_epoch_;
+  Range range_;
+  std::vector<std::string> data_file_paths_;
+  int64_t prefetch_bytes_;
+
+  int64_t file_idx_;
+  std::shared_ptr<const MappedBuffer> file_;
+  // (offset, size) of each record in the current file
+  std::vector<std::pair<int64_t, int64_t>> record_index_;
+  size_t record_idx_;
+  int64_t prefetched_end_;
+};
+
+}  // namespace data
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_DATA_MAPPED_OFRECORD_DATASET_H_
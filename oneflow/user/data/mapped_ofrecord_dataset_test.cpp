@@ -0,0 +1,119 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/data/mapped_ofrecord_dataset.h"
+#include <fstream>
+#include <unistd.h>
+
+namespace oneflow {
+namespace data {
+
+namespace test {
+
+namespace {
+
+std::string MakeRecord(int32_t file_id, int32_t record_id) {
+  return std::string(1 + (file_id * 7 + record_id * 13) % 97, 'a' + file_id)
+         + std::to_string(record_id);
+}
+
+std::vector<std::string> WriteTestFiles(const std::string& dir, int32_t file_num,
+                                        const std::vector<int32_t>& record_nums) {
+  std::vector<std::string> paths;
+  FOR_RANGE(int32_t, i, 0, file_num) {
+    std::string path = dir + "/part-" + std::to_string(i);
+    std::ofstream out(path, std::ios::binary);
+    FOR_RANGE(int32_t, j, 0, record_nums.at(i)) {
+      std::string record = MakeRecord(i, j);
+      int64_t size = record.size();
+      out.write(reinterpret_cast<const char*>(&size), sizeof(int64_t));
+      out.write(record.data(), record.size());
+    }
+    paths.push_back(path);
+  }
+  return paths;
+}
+
+std::string MakeTempDir() {
+  char tmpl[] = "/tmp/mapped_ofrecord_dataset_test_XXXXXX";
+  CHECK(mkdtemp(tmpl) != nullptr);
+  return tmpl;
+}
+
+void RemoveFiles(const std::string& dir, const std::vector<std::string>& paths) {
+  for (const auto& path : paths) { unlink(path.c_str()); }
+  rmdir(dir.c_str());
+}
+
+std::string NextRecord(MappedOFRecordDataset* dataset) {
+  auto samples = dataset->Next();
+  CHECK_EQ(samples.size(), 1);
+  const MappedOFRecord& record = *samples.at(0);
+  const char* begin = static_cast<const char*>(record.file->ptr());
+  CHECK(record.data >= begin && record.data + record.size <= begin + record.file->size());
+  return std::string(record.data, record.size);
+}
+
+}  // namespace
+
+TEST(MappedOFRecordDataset, cyclic) {
+  std::string dir = MakeTempDir();
+  std::vector<int32_t> record_nums{3, 0, 5, 2};
+  std::vector<std::string> paths = WriteTestFiles(dir, 4, record_nums);
+  MappedOFRecordDataset dataset(paths, Range(1, 4), false);
+  FOR_RANGE(int32_t, epoch, 0, 3) {
+    FOR_RANGE(int32_t, i, 1, 4) {
+      FOR_RANGE(int32_t, j, 0, record_nums.at(i)) {
+        ASSERT_EQ(NextRecord(&dataset), MakeRecord(i, j));
+      }
+    }
+  }
+  RemoveFiles(dir, paths);
+}
+
+TEST(MappedOFRecordDataset, shuffle_after_epoch) {
+  std::string dir = MakeTempDir();
+  std::vector<int32_t> record_nums{4, 1, 6, 3, 2};
+  std::vector<std::string> paths = WriteTestFiles(dir, 5, record_nums);
+  std::vector<std::string> expected;
+  FOR_RANGE(int32_t, i, 0, 5) {
+    FOR_RANGE(int32_t, j, 0, record_nums.at(i)) { expected.push_back(MakeRecord(i, j)); }
+  }
+  std::sort(expected.begin(), expected.end());
+  MappedOFRecordDataset dataset(paths, Range(0, 5), true);
+  FOR_RANGE(int32_t, epoch, 0, 4) {
+    std::vector<std::string> records;
+    FOR_RANGE(size_t, i, 0, expected.size()) { records.push_back(NextRecord(&dataset)); }
+    std::sort(records.begin(), records.end());
+    ASSERT_EQ(records, expected);
+  }
+  RemoveFiles(dir, paths);
+}
+
+TEST(MappedOFRecordDataset, records_outlive_file) {
+  std::string dir = MakeTempDir();
+  std::vector<int32_t> record_nums{2, 2};
+  std::vector<std::string> paths = WriteTestFiles(dir, 2, record_nums);
+  MappedOFRecordDataset dataset(paths, Range(0, 2), false);
+  auto first = dataset.Next();
+  FOR_RANGE(int32_t, i, 0, 7) { dataset.Next(); }
+  ASSERT_EQ(std::string(first.at(0)->data, first.at(0)->size), MakeRecord(0, 0));
+  RemoveFiles(dir, paths);
+}
+
+}  // namespace test
+
+}  // namespace data
+}  // namespace oneflow
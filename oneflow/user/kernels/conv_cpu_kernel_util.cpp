@@ -0,0 +1,1067 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/conv_cpu_kernel_util.h"
+#include "oneflow/core/common/blas.h"
+#include "oneflow/core/thread/thread_manager.h"
+#include "oneflow/core/thread/thread_pool.h"
+
+namespace oneflow {
+
+namespace {
+
+// the column buffer of a tile takes at most this many bytes, so that it stays in L2 while the
+// GEMM of the tile reads it
+constexpr int64_t kColBufByteSize = 256 << 10;
+// a tile has at least this many output positions, so that GEMMs don't get too thin
+constexpr int64_t kMinTileSize = 256;
+// partial weight diffs of filter backward take at most this many bytes besides the weight diff
+constexpr int64_t kFilterBackwardPartBufByteSize = 16 << 20;
+// out channels of a filter backward task, fewer would redo the same im2col too many times
+constexpr int64_t kMinFilterBackwardBlockChannels = 16;
+// weight diff elements summed over parts by one ParallelFor chunk
+constexpr int64_t kFilterBackwardSumGrainElemCnt = 16384;
+// output elements computed by one ParallelFor chunk of a depthwise convolution
+constexpr int64_t kDepthwiseGrainElemCnt = 16384;
+// the transformed inputs and outputs of a Winograd block take at most this many bytes
+constexpr int64_t kWinogradBufByteSize = 1 << 20;
+// a Winograd block has at least this many tiles, so that its GEMMs don't get too thin
+constexpr int64_t kMinWinogradBlockSize = 32;
+// below this many input or output channels, transforms cost more than what Winograd saves
+constexpr int64_t kMinWinogradChannels = 16;
+// Winograd transforms work on this many tiles at once
+constexpr int kWinogradLaneChunk = 8;
+// Winograd weight transforms gather this many input channels before writing them out
+constexpr int kWinogradWeightChunk = 64;
+
+int64_t InSpatialSize(const ConvCpuShape& shape) {
+  return shape.in_size[0] * shape.in_size[1] * shape.in_size[2];
+}
+
+int64_t OutSpatialSize(const ConvCpuShape& shape) {
+  return shape.out_size[0] * shape.out_size[1] * shape.out_size[2];
+}
+
+int64_t KernelSpatialSize(const ConvCpuShape& shape) {
+  return shape.kernel_size[0] * shape.kernel_size[1] * shape.kernel_size[2];
+}
+
+// offset of the input index of kernel index k along axis dim, input index = out * stride + offset
+int64_t TapOffset(const ConvCpuShape& shape, int dim, int64_t k) {
+  return k * shape.dilation_rate[dim] - shape.padding_before[dim];
+}
+
+// [begin, end) of the output indices along axis dim whose input index is in range for a tap of
+// the given offset
+void ValidOutRange(const ConvCpuShape& shape, int dim, int64_t offset, int64_t* begin,
+                   int64_t* end) {
+  const int64_t stride = shape.strides[dim];
+  const int64_t lower = offset >= 0 ? 0 : (-offset + stride - 1) / stride;
+  const int64_t upper_in = shape.in_size[dim] - 1 - offset;
+  const int64_t upper = upper_in < 0 ? 0 : upper_in / stride + 1;
+  *begin = std::min(lower, shape.out_size[dim]);
+  *end = std::max(*begin, std::min(upper, shape.out_size[dim]));
+}
+
+// Sets the output positions [pos_begin, pos_end) of channels [channel_begin, channel_end) of one
+// sample to bias
+template<typename T>
+void FillWithBias(const ConvCpuShape& shape, const T* bias, int64_t channel_begin,
+                  int64_t channel_end, int64_t pos_begin, int64_t pos_end, T* y) {
+  if (shape.channels_last) {
+    FOR_RANGE(int64_t, pos, pos_begin, pos_end) {
+      T* y_pos = y + pos * shape.out_channels;
+      FOR_RANGE(int64_t, c, channel_begin, channel_end) { y_pos[c] = bias[c]; }
+    }
+  } else {
+    const int64_t out_spatial_size = OutSpatialSize(shape);
+    FOR_RANGE(int64_t, c, channel_begin, channel_end) {
+      std::fill(y + c * out_spatial_size + pos_begin, y + c * out_spatial_size + pos_end, bias[c]);
+    }
+  }
+}
+
+// row-major c = a * b + beta * c with explicit leading dimensions
+template<typename T>
+void Gemm(enum CBLAS_TRANSPOSE trans_a, enum CBLAS_TRANSPOSE trans_b, int64_t m, int64_t n,
+          int64_t k, const T* a, int64_t lda, const T* b, int64_t ldb, T beta, T* c, int64_t ldc) {
+  cblas_gemm<T>(CblasRowMajor, trans_a, trans_b, m, n, k, static_cast<T>(1), a, lda, b, ldb, beta,
+                c, ldc);
+}
+
+// Splits the output positions of a sample into tiles of about max_tile_size positions, tiles
+// are balanced so that the last one is not much smaller than the others
+int64_t BalancedTileSize(const ConvCpuShape& shape, int64_t max_tile_size) {
+  const int64_t out_spatial_size = std::max<int64_t>(OutSpatialSize(shape), 1);
+  const int64_t tile_num = (out_spatial_size + max_tile_size - 1) / max_tile_size;
+  return (out_spatial_size + tile_num - 1) / tile_num;
+}
+
+// Tiles whose column buffer of col_rows rows fits in L2
+template<typename T>
+int64_t Im2ColTileSize(const ConvCpuShape& shape, int64_t col_rows) {
+  const int64_t max_tile_size = kColBufByteSize / (std::max<int64_t>(col_rows, 1) * sizeof(T));
+  return BalancedTileSize(shape, std::max(max_tile_size, kMinTileSize));
+}
+
+template<typename T>
+int64_t ColBufElemCnt(const ConvCpuShape& shape) {
+  const int64_t col_rows = shape.in_channels / shape.groups * KernelSpatialSize(shape);
+  return col_rows * Im2ColTileSize<T>(shape, col_rows);
+}
+
+// The tmp buffer of thread_num threads doing im2col holds a column buffer per thread
+template<typename T>
+size_t Im2ColTmpBufferSize(const ConvCpuShape& shape, int64_t thread_num) {
+  return thread_num * ColBufElemCnt<T>(shape) * sizeof(T);
+}
+
+// The most threads, up to those of the pool, whose tmp buffer fits in tmp_buffer_size
+int64_t TmpBufferThreadNum(size_t tmp_buffer_size,
+                           const std::function<size_t(int64_t thread_num)>& TmpBufferSize) {
+  int64_t thread_num = Global<ThreadPool>::Get()->thread_num();
+  while (thread_num > 1 && TmpBufferSize(thread_num) > tmp_buffer_size) { thread_num -= 1; }
+  CHECK_LE(TmpBufferSize(thread_num), tmp_buffer_size);
+  return thread_num;
+}
+
+// Runs Task on every task of [0, task_num) on at most thread_num threads, which take tasks on
+// demand. A thread owns the buffer of buf_elem_cnt elements at its index in bufs.
+template<typename T>
+void ParallelForWithBuf(int64_t task_num, int64_t thread_num, int64_t buf_elem_cnt, T* bufs,
+                        const std::function<void(int64_t task, T* buf)>& Task) {
+  if (task_num == 0) { return; }
+  std::atomic<int64_t> next_task(0);
+  ParallelFor(std::min(task_num, thread_num), 1, ParallelForSchedule::kStatic,
+              [&](size_t begin, size_t end) {
+                T* buf = bufs + begin * buf_elem_cnt;
+                for (int64_t task = next_task++; task < task_num; task = next_task++) {
+                  Task(task, buf);
+                }
+              });
+}
+
+template<typename T>
+void ParallelForWithColBuf(const ConvCpuShape& shape, int64_t task_num, int64_t thread_num,
+                           T* col_bufs, const std::function<void(int64_t task, T* col_buf)>& Task) {
+  ParallelForWithBuf<T>(task_num, thread_num, ColBufElemCnt<T>(shape), col_bufs, Task);
+}
+
+// Without a column buffer, samples are only split for enough parallelism
+int64_t ParallelTileSize(const ConvCpuShape& shape) {
+  const int64_t thread_num = Global<ThreadPool>::Get()->thread_num();
+  const int64_t tile_num =
+      std::max<int64_t>((2 * thread_num + shape.batch_size - 1) / shape.batch_size, 1);
+  const int64_t out_spatial_size = std::max<int64_t>(OutSpatialSize(shape), 1);
+  return BalancedTileSize(shape, std::max((out_spatial_size + tile_num - 1) / tile_num,
+                                          std::min(kMinTileSize, out_spatial_size)));
+}
+
+// im2col writes the column matrix from an image, padding positions are 0
+template<typename T>
+struct Im2ColMover {
+  using ImagePtr = const T*;
+  using ColPtr = T*;
+  static void Pad(ColPtr col, int64_t n) { std::fill(col, col + n, static_cast<T>(0)); }
+  static void Move(ImagePtr image, ColPtr col) { *col = *image; }
+};
+
+// col2im adds the column matrix back to an image, padding positions are dropped
+template<typename T>
+struct Col2ImMover {
+  using ImagePtr = T*;
+  using ColPtr = const T*;
+  static void Pad(ColPtr col, int64_t n) {}
+  static void Move(ImagePtr image, ColPtr col) { *image += *col; }
+};
+
+// Moves data between one group of an image and its column matrix restricted to the output
+// positions [pos_begin, pos_end), the column matrix is [rows, pos_end - pos_begin] with rows
+// ordered like the weight of the group
+template<typename Mover>
+void MoveColBufTile(const ConvCpuShape& shape, int64_t group, int64_t pos_begin, int64_t pos_end,
+                    typename Mover::ImagePtr image, typename Mover::ColPtr col_buf) {
+  const int64_t group_in_channels = shape.in_channels / shape.groups;
+  const int64_t kernel_spatial_size = KernelSpatialSize(shape);
+  const int64_t tile_size = pos_end - pos_begin;
+  const int64_t ow_size = shape.out_size[2];
+  const int64_t oh_size = shape.out_size[1];
+  const int64_t w_stride = shape.channels_last ? shape.in_channels : 1;
+  FOR_RANGE(int64_t, row, 0, group_in_channels * kernel_spatial_size) {
+    int64_t c = 0;
+    int64_t tap = 0;
+    if (shape.channels_last) {
+      tap = row / group_in_channels;
+      c = group * group_in_channels + row % group_in_channels;
+    } else {
+      tap = row % kernel_spatial_size;
+      c = group * group_in_channels + row / kernel_spatial_size;
+    }
+    const int64_t kw = tap % shape.kernel_size[2];
+    const int64_t kh = tap / shape.kernel_size[2] % shape.kernel_size[1];
+    const int64_t kd = tap / (shape.kernel_size[2] * shape.kernel_size[1]);
+    const int64_t offset_d = TapOffset(shape, 0, kd);
+    const int64_t offset_h = TapOffset(shape, 1, kh);
+    const int64_t offset_w = TapOffset(shape, 2, kw);
+    int64_t valid_ow_begin = 0;
+    int64_t valid_ow_end = 0;
+    ValidOutRange(shape, 2, offset_w, &valid_ow_begin, &valid_ow_end);
+    auto col = col_buf + row * tile_size;
+    int64_t pos = pos_begin;
+    // one output row of the tile at a time
+    while (pos < pos_end) {
+      const int64_t ow_begin = pos % ow_size;
+      const int64_t ow_end = std::min(ow_size, ow_begin + pos_end - pos);
+      const int64_t oh = pos / ow_size % oh_size;
+      const int64_t od = pos / (ow_size * oh_size);
+      const int64_t id = od * shape.strides[0] + offset_d;
+      const int64_t ih = oh * shape.strides[1] + offset_h;
+      if (id < 0 || id >= shape.in_size[0] || ih < 0 || ih >= shape.in_size[1]) {
+        Mover::Pad(col, ow_end - ow_begin);
+      } else {
+        const int64_t in_row = id * shape.in_size[1] + ih;
+        const int64_t in_offset =
+            shape.channels_last
+                ? in_row * shape.in_size[2] * shape.in_channels + c
+                : (c * shape.in_size[0] * shape.in_size[1] + in_row) * shape.in_size[2];
+        const auto in = image + in_offset;
+        const int64_t valid_begin = std::min(std::max(valid_ow_begin, ow_begin), ow_end);
+        const int64_t valid_end = std::max(std::min(valid_ow_end, ow_end), valid_begin);
+        Mover::Pad(col, valid_begin - ow_begin);
+        FOR_RANGE(int64_t, ow, valid_begin, valid_end) {
+          Mover::Move(in + (ow * shape.strides[2] + offset_w) * w_stride, col + ow - ow_begin);
+        }
+        Mover::Pad(col + valid_end - ow_begin, ow_end - valid_end);
+      }
+      col += ow_end - ow_begin;
+      pos += ow_end - ow_begin;
+    }
+  }
+}
+
+template<typename T>
+void ForwardByIm2ColGemm(const ConvCpuShape& shape, const T* x, const T* weight, const T* bias,
+                         T* y, int64_t thread_num, T* col_bufs) {
+  const int64_t out_spatial_size = OutSpatialSize(shape);
+  const int64_t group_in_channels = shape.in_channels / shape.groups;
+  const int64_t group_out_channels = shape.out_channels / shape.groups;
+  const int64_t col_rows = group_in_channels * KernelSpatialSize(shape);
+  const int64_t tile_size = Im2ColTileSize<T>(shape, col_rows);
+  const int64_t tile_num = (out_spatial_size + tile_size - 1) / tile_size;
+  const int64_t x_sample_size = shape.in_channels * InSpatialSize(shape);
+  const int64_t y_sample_size = shape.out_channels * out_spatial_size;
+  const int64_t task_num = shape.batch_size * tile_num;
+  ParallelForWithColBuf<T>(shape, task_num, thread_num, col_bufs, [&](int64_t i, T* col_buf) {
+    const int64_t n = i / tile_num;
+    const int64_t pos_begin = i % tile_num * tile_size;
+    const int64_t pos_end = std::min(pos_begin + tile_size, out_spatial_size);
+    const int64_t cur_tile_size = pos_end - pos_begin;
+    const T* x_sample = x + n * x_sample_size;
+    T* y_sample = y + n * y_sample_size;
+    FOR_RANGE(int64_t, g, 0, shape.groups) {
+      MoveColBufTile<Im2ColMover<T>>(shape, g, pos_begin, pos_end, x_sample, col_buf);
+      const T* group_weight = weight + g * group_out_channels * col_rows;
+      const int64_t channel_begin = g * group_out_channels;
+      T beta = 0;
+      if (bias != nullptr) {
+        FillWithBias(shape, bias, channel_begin, channel_begin + group_out_channels, pos_begin,
+                     pos_end, y_sample);
+        beta = 1;
+      }
+      if (shape.channels_last) {
+        // y[pos, c] = col(T) * weight(T)
+        Gemm(CblasTrans, CblasTrans, cur_tile_size, group_out_channels, col_rows, col_buf,
+             cur_tile_size, group_weight, col_rows, beta,
+             y_sample + pos_begin * shape.out_channels + channel_begin, shape.out_channels);
+      } else {
+        // y[c, pos] = weight * col
+        Gemm(CblasNoTrans, CblasNoTrans, group_out_channels, cur_tile_size, col_rows,
+             group_weight, col_rows, col_buf, cur_tile_size, beta,
+             y_sample + channel_begin * out_spatial_size + pos_begin, out_spatial_size);
+      }
+    }
+  });
+}
+
+// 1x1 kernel with stride 1 and no padding, x is the column matrix itself
+template<typename T>
+void Forward1x1(const ConvCpuShape& shape, const T* x, const T* weight, const T* bias, T* y) {
+  const int64_t spatial_size = OutSpatialSize(shape);
+  const int64_t group_in_channels = shape.in_channels / shape.groups;
+  const int64_t group_out_channels = shape.out_channels / shape.groups;
+  const int64_t tile_size = ParallelTileSize(shape);
+  const int64_t tile_num = (spatial_size + tile_size - 1) / tile_size;
+  ParallelFor(shape.batch_size * tile_num, 1, ParallelForSchedule::kDynamic,
+              [&](size_t begin, size_t end) {
+                FOR_RANGE(int64_t, i, begin, end) {
+                  const int64_t n = i / tile_num;
+                  const int64_t pos_begin = i % tile_num * tile_size;
+                  const int64_t pos_end = std::min(pos_begin + tile_size, spatial_size);
+                  const int64_t cur_tile_size = pos_end - pos_begin;
+                  const T* x_sample = x + n * shape.in_channels * spatial_size;
+                  T* y_sample = y + n * shape.out_channels * spatial_size;
+                  FOR_RANGE(int64_t, g, 0, shape.groups) {
+                    const T* group_weight = weight + g * group_out_channels * group_in_channels;
+                    const int64_t channel_begin = g * group_out_channels;
+                    T beta = 0;
+                    if (bias != nullptr) {
+                      FillWithBias(shape, bias, channel_begin, channel_begin + group_out_channels,
+                                   pos_begin, pos_end, y_sample);
+                      beta = 1;
+                    }
+                    if (shape.channels_last) {
+                      // y[pos, c] = x[pos, c_in] * weight(T)
+                      Gemm(CblasNoTrans, CblasTrans, cur_tile_size, group_out_channels,
+                           group_in_channels,
+                           x_sample + pos_begin * shape.in_channels + g * group_in_channels,
+                           shape.in_channels, group_weight, group_in_channels, beta,
+                           y_sample + pos_begin * shape.out_channels + channel_begin,
+                           shape.out_channels);
+                    } else {
+                      // y[c, pos] = weight * x[c_in, pos]
+                      Gemm(CblasNoTrans, CblasNoTrans, group_out_channels, cur_tile_size,
+                           group_in_channels, group_weight, group_in_channels,
+                           x_sample + g * group_in_channels * spatial_size + pos_begin,
+                           spatial_size, beta,
+                           y_sample + channel_begin * spatial_size + pos_begin, spatial_size);
+                    }
+                  }
+                }
+              });
+}
+
+// Every output channel reads a single input channel, computed directly without im2col
+template<typename T>
+void ForwardDepthwise(const ConvCpuShape& shape, const T* x, const T* weight, const T* bias,
+                      T* y) {
+  const int64_t out_spatial_size = OutSpatialSize(shape);
+  const int64_t in_spatial_size = InSpatialSize(shape);
+  const int64_t kernel_spatial_size = KernelSpatialSize(shape);
+  const int64_t multiplier = shape.out_channels / shape.in_channels;
+  const auto& ForEachTap = [&](const std::function<void(int64_t, int64_t, int64_t, int64_t)>&
+                                   Handler) {
+    FOR_RANGE(int64_t, kd, 0, shape.kernel_size[0]) {
+      FOR_RANGE(int64_t, kh, 0, shape.kernel_size[1]) {
+        FOR_RANGE(int64_t, kw, 0, shape.kernel_size[2]) {
+          Handler((kd * shape.kernel_size[1] + kh) * shape.kernel_size[2] + kw,
+                  TapOffset(shape, 0, kd), TapOffset(shape, 1, kh), TapOffset(shape, 2, kw));
+        }
+      }
+    }
+  };
+  if (shape.channels_last) {
+    // weight transposed to [tap, c] so that the innermost loop over channels is contiguous
+    std::vector<T> weight_t(kernel_spatial_size * shape.out_channels);
+    FOR_RANGE(int64_t, c, 0, shape.out_channels) {
+      FOR_RANGE(int64_t, tap, 0, kernel_spatial_size) {
+        weight_t[tap * shape.out_channels + c] = weight[c * kernel_spatial_size + tap];
+      }
+    }
+    const int64_t row_num = shape.batch_size * shape.out_size[0] * shape.out_size[1];
+    const int64_t row_elem_cnt = shape.out_size[2] * shape.out_channels;
+    const size_t grain = std::max<int64_t>(kDepthwiseGrainElemCnt / row_elem_cnt, 1);
+    ParallelFor(row_num, grain, ParallelForSchedule::kStatic, [&](size_t begin, size_t end) {
+      FOR_RANGE(int64_t, row, begin, end) {
+        const int64_t oh = row % shape.out_size[1];
+        const int64_t od = row / shape.out_size[1] % shape.out_size[0];
+        const int64_t n = row / (shape.out_size[1] * shape.out_size[0]);
+        const T* x_sample = x + n * in_spatial_size * shape.in_channels;
+        T* y_row = y + row * row_elem_cnt;
+        FOR_RANGE(int64_t, ow, 0, shape.out_size[2]) {
+          T* dst = y_row + ow * shape.out_channels;
+          if (bias != nullptr) {
+            std::copy(bias, bias + shape.out_channels, dst);
+          } else {
+            std::fill(dst, dst + shape.out_channels, static_cast<T>(0));
+          }
+          ForEachTap([&](int64_t tap, int64_t offset_d, int64_t offset_h, int64_t offset_w) {
+            const int64_t id = od * shape.strides[0] + offset_d;
+            const int64_t ih = oh * shape.strides[1] + offset_h;
+            const int64_t iw = ow * shape.strides[2] + offset_w;
+            if (id < 0 || id >= shape.in_size[0] || ih < 0 || ih >= shape.in_size[1] || iw < 0
+                || iw >= shape.in_size[2]) {
+              return;
+            }
+            const T* src =
+                x_sample
+                + ((id * shape.in_size[1] + ih) * shape.in_size[2] + iw) * shape.in_channels;
+            const T* tap_weight = weight_t.data() + tap * shape.out_channels;
+            if (multiplier == 1) {
+              FOR_RANGE(int64_t, c, 0, shape.out_channels) { dst[c] += tap_weight[c] * src[c]; }
+            } else {
+              FOR_RANGE(int64_t, c, 0, shape.out_channels) {
+                dst[c] += tap_weight[c] * src[c / multiplier];
+              }
+            }
+          });
+        }
+      }
+    });
+  } else {
+    const int64_t plane_num = shape.batch_size * shape.out_channels;
+    const size_t grain = std::max<int64_t>(kDepthwiseGrainElemCnt / out_spatial_size, 1);
+    ParallelFor(plane_num, grain, ParallelForSchedule::kStatic, [&](size_t begin, size_t end) {
+      FOR_RANGE(int64_t, plane, begin, end) {
+        const int64_t oc = plane % shape.out_channels;
+        const int64_t n = plane / shape.out_channels;
+        const T* x_plane = x + (n * shape.in_channels + oc / multiplier) * in_spatial_size;
+        T* y_plane = y + plane * out_spatial_size;
+        std::fill(y_plane, y_plane + out_spatial_size,
+                  bias != nullptr ? bias[oc] : static_cast<T>(0));
+        ForEachTap([&](int64_t tap, int64_t offset_d, int64_t offset_h, int64_t offset_w) {
+          const T tap_weight = weight[oc * kernel_spatial_size + tap];
+          int64_t od_begin = 0;
+          int64_t od_end = 0;
+          int64_t oh_begin = 0;
+          int64_t oh_end = 0;
+          int64_t ow_begin = 0;
+          int64_t ow_end = 0;
+          ValidOutRange(shape, 0, offset_d, &od_begin, &od_end);
+          ValidOutRange(shape, 1, offset_h, &oh_begin, &oh_end);
+          ValidOutRange(shape, 2, offset_w, &ow_begin, &ow_end);
+          const int64_t stride_w = shape.strides[2];
+          FOR_RANGE(int64_t, od, od_begin, od_end) {
+            const int64_t id = od * shape.strides[0] + offset_d;
+            FOR_RANGE(int64_t, oh, oh_begin, oh_end) {
+              const int64_t ih = oh * shape.strides[1] + offset_h;
+              const T* src = x_plane + (id * shape.in_size[1] + ih) * shape.in_size[2] + offset_w;
+              T* dst = y_plane + (od * shape.out_size[1] + oh) * shape.out_size[2];
+              if (stride_w == 1) {
+                FOR_RANGE(int64_t, ow, ow_begin, ow_end) { dst[ow] += tap_weight * src[ow]; }
+              } else {
+                FOR_RANGE(int64_t, ow, ow_begin, ow_end) {
+                  dst[ow] += tap_weight * src[ow * stride_w];
+                }
+              }
+            }
+          }
+        });
+      }
+    });
+  }
+}
+
+bool Is1x1WithoutStrideAndPadding(const ConvCpuShape& shape) {
+  FOR_RANGE(int, dim, 0, 3) {
+    if (shape.kernel_size[dim] != 1 || shape.strides[dim] != 1 || shape.padding_before[dim] != 0
+        || shape.out_size[dim] != shape.in_size[dim]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Winograd F(m x m, 3 x 3) transforms from Lavin and Gray, "Fast Algorithms for Convolutional
+// Neural Networks". Input tiles are alpha x alpha with alpha = m + 2, 2d transforms apply the 1d
+// ones to the columns then to the rows of a tile.
+template<typename T, int m>
+struct WinogradTransform;
+
+template<typename T>
+struct WinogradTransform<T, 2> {
+  static constexpr int kAlpha = 4;
+  // G, alpha x 3
+  static constexpr double kG[12] = {1, 0, 0, 0.5, 0.5, 0.5, 0.5, -0.5, 0.5, 0, 0, 1};
+  // r = B(T) * d
+  static void Input1D(const T* d, int64_t d_stride, T* r, int64_t r_stride) {
+    const T d0 = d[0];
+    const T d1 = d[d_stride];
+    const T d2 = d[2 * d_stride];
+    const T d3 = d[3 * d_stride];
+    r[0] = d0 - d2;
+    r[r_stride] = d1 + d2;
+    r[2 * r_stride] = d2 - d1;
+    r[3 * r_stride] = d1 - d3;
+  }
+  // o = A(T) * p
+  static void Output1D(const T* p, int64_t p_stride, T* o, int64_t o_stride) {
+    const T p1 = p[p_stride];
+    const T p2 = p[2 * p_stride];
+    o[0] = p[0] + p1 + p2;
+    o[o_stride] = p1 - p2 - p[3 * p_stride];
+  }
+};
+
+template<typename T>
+struct WinogradTransform<T, 4> {
+  static constexpr int kAlpha = 6;
+  static constexpr double kG[18] = {1.0 / 4,  0,         0,        -1.0 / 6, -1.0 / 6, -1.0 / 6,
+                                    -1.0 / 6, 1.0 / 6,   -1.0 / 6, 1.0 / 24, 1.0 / 12, 1.0 / 6,
+                                    1.0 / 24, -1.0 / 12, 1.0 / 6,  0,        0,        1};
+  static void Input1D(const T* d, int64_t d_stride, T* r, int64_t r_stride) {
+    const T d0 = d[0];
+    const T d1 = d[d_stride];
+    const T d2 = d[2 * d_stride];
+    const T d3 = d[3 * d_stride];
+    const T d4 = d[4 * d_stride];
+    const T d5 = d[5 * d_stride];
+    const T a = d4 - 4 * d2;
+    const T b = d3 - 4 * d1;
+    const T c = d4 - d2;
+    const T e = 2 * (d3 - d1);
+    r[0] = 4 * d0 - 5 * d2 + d4;
+    r[r_stride] = a + b;
+    r[2 * r_stride] = a - b;
+    r[3 * r_stride] = c + e;
+    r[4 * r_stride] = c - e;
+    r[5 * r_stride] = 4 * d1 - 5 * d3 + d5;
+  }
+  static void Output1D(const T* p, int64_t p_stride, T* o, int64_t o_stride) {
+    const T p0 = p[0];
+    const T p1 = p[p_stride];
+    const T p2 = p[2 * p_stride];
+    const T p3 = p[3 * p_stride];
+    const T p4 = p[4 * p_stride];
+    const T p5 = p[5 * p_stride];
+    const T a = p1 + p2;
+    const T b = p1 - p2;
+    const T c = p3 + p4;
+    const T e = p3 - p4;
+    o[0] = p0 + a + c;
+    o[o_stride] = b + 2 * e;
+    o[2 * o_stride] = a + 4 * c;
+    o[3 * o_stride] = b + 8 * e + p5;
+  }
+};
+
+template<typename T>
+constexpr double WinogradTransform<T, 2>::kG[];
+template<typename T>
+constexpr double WinogradTransform<T, 4>::kG[];
+
+// u = G * w * G(T) for kWinogradWeightChunk filters, element (i, j) of a filter is
+// w[(i * 3 + j) * kWinogradWeightChunk + lane] and goes to u[(i * alpha + j) * kWinogradWeightChunk
+// + lane]
+template<typename T, int m>
+void WinogradFilterTransform(const T* w, T* u) {
+  constexpr int kAlpha = WinogradTransform<T, m>::kAlpha;
+  constexpr int kLanes = kWinogradWeightChunk;
+  const double* g = WinogradTransform<T, m>::kG;
+  T gw[kAlpha * 3 * kLanes];
+  FOR_RANGE(int, i, 0, kAlpha) {
+    const T g0 = static_cast<T>(g[i * 3]);
+    const T g1 = static_cast<T>(g[i * 3 + 1]);
+    const T g2 = static_cast<T>(g[i * 3 + 2]);
+    FOR_RANGE(int, j, 0, 3) {
+      T* dst = gw + (i * 3 + j) * kLanes;
+      const T* w0 = w + j * kLanes;
+      const T* w1 = w + (3 + j) * kLanes;
+      const T* w2 = w + (6 + j) * kLanes;
+      FOR_RANGE(int, lane, 0, kLanes) { dst[lane] = g0 * w0[lane] + g1 * w1[lane] + g2 * w2[lane]; }
+    }
+  }
+  FOR_RANGE(int, j, 0, kAlpha) {
+    const T g0 = static_cast<T>(g[j * 3]);
+    const T g1 = static_cast<T>(g[j * 3 + 1]);
+    const T g2 = static_cast<T>(g[j * 3 + 2]);
+    FOR_RANGE(int, i, 0, kAlpha) {
+      T* dst = u + (i * kAlpha + j) * kLanes;
+      const T* gw0 = gw + i * 3 * kLanes;
+      const T* gw1 = gw0 + kLanes;
+      const T* gw2 = gw1 + kLanes;
+      FOR_RANGE(int, lane, 0, kLanes) {
+        dst[lane] = g0 * gw0[lane] + g1 * gw1[lane] + g2 * gw2[lane];
+      }
+    }
+  }
+}
+
+// v = B(T) * d * B for lane_stride tiles, element (i, j) of a tile is
+// d[(i * alpha + j) * lane_stride + lane] and goes to v[(i * alpha + j) * v_stride + lane]
+template<typename T, int m>
+void WinogradInputTransform(const T* d, int64_t lane_stride, T* v, int64_t v_stride) {
+  using Transform = WinogradTransform<T, m>;
+  constexpr int kAlpha = Transform::kAlpha;
+  // lanes go through local buffers, which the compiler knows not to alias, so that they vectorize
+  for (int64_t lane_begin = 0; lane_begin < lane_stride; lane_begin += kWinogradLaneChunk) {
+    T tile[kAlpha * kAlpha][kWinogradLaneChunk];
+    T tmp[kAlpha * kAlpha][kWinogradLaneChunk];
+    T out[kAlpha * kAlpha][kWinogradLaneChunk];
+    FOR_RANGE(int, k, 0, kAlpha * kAlpha) {
+      FOR_RANGE(int, l, 0, kWinogradLaneChunk) { tile[k][l] = d[k * lane_stride + lane_begin + l]; }
+    }
+    FOR_RANGE(int, j, 0, kAlpha) {
+      FOR_RANGE(int, l, 0, kWinogradLaneChunk) {
+        Transform::Input1D(&tile[j][l], kAlpha * kWinogradLaneChunk, &tmp[j][l],
+                           kAlpha * kWinogradLaneChunk);
+      }
+    }
+    FOR_RANGE(int, i, 0, kAlpha) {
+      FOR_RANGE(int, l, 0, kWinogradLaneChunk) {
+        Transform::Input1D(&tmp[i * kAlpha][l], kWinogradLaneChunk, &out[i * kAlpha][l],
+                           kWinogradLaneChunk);
+      }
+    }
+    FOR_RANGE(int, k, 0, kAlpha * kAlpha) {
+      FOR_RANGE(int, l, 0, kWinogradLaneChunk) { v[k * v_stride + lane_begin + l] = out[k][l]; }
+    }
+  }
+}
+
+// o = A(T) * p * A for lane_stride tiles, element (i, j) of a tile is
+// p[(i * alpha + j) * p_stride + lane] and element (i, j) of its output goes to
+// o[(i * m + j) * lane_stride + lane]
+template<typename T, int m>
+void WinogradOutputTransform(const T* p, int64_t p_stride, T* o, int64_t lane_stride) {
+  using Transform = WinogradTransform<T, m>;
+  constexpr int kAlpha = Transform::kAlpha;
+  for (int64_t lane_begin = 0; lane_begin < lane_stride; lane_begin += kWinogradLaneChunk) {
+    T tile[kAlpha * kAlpha][kWinogradLaneChunk];
+    T tmp[m * kAlpha][kWinogradLaneChunk];
+    T out[m * m][kWinogradLaneChunk];
+    FOR_RANGE(int, k, 0, kAlpha * kAlpha) {
+      FOR_RANGE(int, l, 0, kWinogradLaneChunk) { tile[k][l] = p[k * p_stride + lane_begin + l]; }
+    }
+    FOR_RANGE(int, j, 0, kAlpha) {
+      FOR_RANGE(int, l, 0, kWinogradLaneChunk) {
+        Transform::Output1D(&tile[j][l], kAlpha * kWinogradLaneChunk, &tmp[j][l],
+                            kAlpha * kWinogradLaneChunk);
+      }
+    }
+    FOR_RANGE(int, i, 0, m) {
+      FOR_RANGE(int, l, 0, kWinogradLaneChunk) {
+        Transform::Output1D(&tmp[i * kAlpha][l], kWinogradLaneChunk, &out[i * m][l],
+                            kWinogradLaneChunk);
+      }
+    }
+    FOR_RANGE(int, k, 0, m * m) {
+      FOR_RANGE(int, l, 0, kWinogradLaneChunk) { o[k * lane_stride + lane_begin + l] = out[k][l]; }
+    }
+  }
+}
+
+int64_t WinogradTileNum(const ConvCpuShape& shape, int32_t output_tile) {
+  return ((shape.out_size[1] + output_tile - 1) / output_tile)
+         * ((shape.out_size[2] + output_tile - 1) / output_tile);
+}
+
+// Multiplications per pair of channels of the GEMMs in the transformed domain and of the weight
+// transform, which callers may redo on every call
+int64_t WinogradCost(const ConvCpuShape& shape, int32_t output_tile) {
+  const int64_t a = output_tile + 2;
+  return shape.batch_size * WinogradTileNum(shape, output_tile) * a * a + 3 * a * (3 + a);
+}
+
+// Tiles of all samples are split into blocks as large as kWinogradBufByteSize allows but no fewer
+// than the threads. Rows of the block buffers are lane_stride long, tiles beyond the block go
+// through transforms but are never used.
+struct WinogradBlocking {
+  int64_t block_num;
+  int64_t block_size;
+  int64_t lane_stride;
+  // elements of the v, p and tile buffers of a block
+  int64_t buf_elem_cnt;
+};
+
+WinogradBlocking GetWinogradBlocking(const ConvCpuShape& shape, int32_t output_tile,
+                                     int64_t elem_byte_size, int64_t thread_num) {
+  const int64_t alpha = output_tile + 2;
+  const int64_t tile_num = shape.batch_size * WinogradTileNum(shape, output_tile);
+  const int64_t buf_block_size = kWinogradBufByteSize
+                                 / (alpha * alpha * (shape.in_channels + shape.out_channels)
+                                    * elem_byte_size);
+  const int64_t max_block_size = std::max(
+      std::min(buf_block_size, (tile_num + thread_num - 1) / thread_num), kMinWinogradBlockSize);
+  WinogradBlocking blocking;
+  blocking.block_num = (tile_num + max_block_size - 1) / max_block_size;
+  blocking.block_size = (tile_num + blocking.block_num - 1) / blocking.block_num;
+  blocking.lane_stride = RoundUp(blocking.block_size, kWinogradLaneChunk);
+  blocking.buf_elem_cnt =
+      alpha * alpha * (shape.in_channels + shape.out_channels + 1) * blocking.lane_stride;
+  return blocking;
+}
+
+// The tmp buffer of thread_num threads doing Winograd holds the block buffers of every thread
+template<typename T>
+size_t WinogradTmpBufferSizeOnThreads(const ConvCpuShape& shape, int32_t output_tile,
+                                      int64_t thread_num) {
+  const WinogradBlocking blocking = GetWinogradBlocking(shape, output_tile, sizeof(T), thread_num);
+  return std::min(blocking.block_num, thread_num) * blocking.buf_elem_cnt * sizeof(T);
+}
+
+template<typename T, int m>
+void TransformWinogradWeight(const ConvCpuShape& shape, const T* weight, T* transformed_weight) {
+  constexpr int kAlpha = WinogradTransform<T, m>::kAlpha;
+  const int64_t ci = shape.in_channels;
+  const int64_t co = shape.out_channels;
+  ParallelFor(co, 1, ParallelForSchedule::kStatic, [&](size_t begin, size_t end) {
+    // filters of a chunk of input channels are transformed together, then every transformed
+    // element is written out as a contiguous run
+    T w_buf[9 * kWinogradWeightChunk];
+    T u_buf[kAlpha * kAlpha * kWinogradWeightChunk];
+    FOR_RANGE(int64_t, oc, begin, end) {
+      for (int64_t c0 = 0; c0 < ci; c0 += kWinogradWeightChunk) {
+        const int64_t chunk = std::min<int64_t>(kWinogradWeightChunk, ci - c0);
+        FOR_RANGE(int64_t, k, 0, 9) {
+          T* dst = w_buf + k * kWinogradWeightChunk;
+          if (shape.channels_last) {
+            const T* src = weight + (oc * 9 + k) * ci + c0;
+            std::copy(src, src + chunk, dst);
+          } else {
+            FOR_RANGE(int64_t, i, 0, chunk) { dst[i] = weight[(oc * ci + c0 + i) * 9 + k]; }
+          }
+          std::fill(dst + chunk, dst + kWinogradWeightChunk, static_cast<T>(0));
+        }
+        WinogradFilterTransform<T, m>(w_buf, u_buf);
+        FOR_RANGE(int64_t, e, 0, kAlpha * kAlpha) {
+          std::copy(u_buf + e * kWinogradWeightChunk, u_buf + e * kWinogradWeightChunk + chunk,
+                    transformed_weight + e * co * ci + oc * ci + c0);
+        }
+      }
+    }
+  });
+}
+
+// Tiles of all samples are processed in blocks, for every block its inputs are transformed into
+// v [alpha * alpha, in_channels, block], multiplied by the transformed weight into
+// p [alpha * alpha, out_channels, block] and p is transformed back into y
+template<typename T, int m>
+void WinogradForward(const ConvCpuShape& shape, const T* transformed_weight, const T* x,
+                     const T* bias, T* y, const WinogradBlocking& blocking, int64_t thread_num,
+                     T* bufs) {
+  constexpr int kAlpha = WinogradTransform<T, m>::kAlpha;
+  const int64_t ci = shape.in_channels;
+  const int64_t co = shape.out_channels;
+  const int64_t ih_size = shape.in_size[1];
+  const int64_t iw_size = shape.in_size[2];
+  const int64_t oh_size = shape.out_size[1];
+  const int64_t ow_size = shape.out_size[2];
+  const int64_t tiles_w = (ow_size + m - 1) / m;
+  const int64_t sample_tile_num = WinogradTileNum(shape, m);
+  const int64_t tile_num = shape.batch_size * sample_tile_num;
+  const int64_t block_num = blocking.block_num;
+  const int64_t block_size = blocking.block_size;
+  const int64_t lane_stride = blocking.lane_stride;
+  // strides of channels and pixels in a sample of x and y
+  const int64_t x_c_stride = shape.channels_last ? 1 : ih_size * iw_size;
+  const int64_t x_pixel_stride = shape.channels_last ? ci : 1;
+  const int64_t y_c_stride = shape.channels_last ? 1 : oh_size * ow_size;
+  const int64_t y_pixel_stride = shape.channels_last ? co : 1;
+  const int64_t buf_elem_cnt = blocking.buf_elem_cnt;
+  ParallelForWithBuf<T>(block_num, thread_num, buf_elem_cnt, bufs, [&](int64_t block, T* buf) {
+    // tiles of a block are the innermost dim of every buffer
+    T* v_buf = buf;
+    T* p_buf = v_buf + kAlpha * kAlpha * ci * lane_stride;
+    T* tile_buf = p_buf + kAlpha * kAlpha * co * lane_stride;
+    const int64_t tile_begin = block * block_size;
+    const int64_t tile_end = std::min(tile_begin + block_size, tile_num);
+    const int64_t cur_block_size = tile_end - tile_begin;
+    FOR_RANGE(int64_t, c, 0, ci) {
+      FOR_RANGE(int64_t, tile, tile_begin, tile_end) {
+        const int64_t n = tile / sample_tile_num;
+        const int64_t sample_tile = tile % sample_tile_num;
+        const int64_t h_begin = sample_tile / tiles_w * m - shape.padding_before[1];
+        const int64_t w_begin = sample_tile % tiles_w * m - shape.padding_before[2];
+        const T* x_channel = x + n * ci * ih_size * iw_size + c * x_c_stride;
+        T* d = tile_buf + tile - tile_begin;
+        FOR_RANGE(int, dh, 0, kAlpha) {
+          const int64_t ih = h_begin + dh;
+          const bool is_valid_h = ih >= 0 && ih < ih_size;
+          FOR_RANGE(int, dw, 0, kAlpha) {
+            const int64_t iw = w_begin + dw;
+            d[(dh * kAlpha + dw) * lane_stride] =
+                (is_valid_h && iw >= 0 && iw < iw_size)
+                    ? x_channel[(ih * iw_size + iw) * x_pixel_stride]
+                    : static_cast<T>(0);
+          }
+        }
+      }
+      WinogradInputTransform<T, m>(tile_buf, lane_stride, v_buf + c * lane_stride,
+                                   ci * lane_stride);
+    }
+    FOR_RANGE(int64_t, xi, 0, kAlpha * kAlpha) {
+      Gemm(CblasNoTrans, CblasNoTrans, co, cur_block_size, ci, transformed_weight + xi * co * ci,
+           ci, v_buf + xi * ci * lane_stride, lane_stride, static_cast<T>(0),
+           p_buf + xi * co * lane_stride, lane_stride);
+    }
+    FOR_RANGE(int64_t, oc, 0, co) {
+      WinogradOutputTransform<T, m>(p_buf + oc * lane_stride, co * lane_stride,
+                                    tile_buf, lane_stride);
+      const T b = bias != nullptr ? bias[oc] : static_cast<T>(0);
+      FOR_RANGE(int64_t, tile, tile_begin, tile_end) {
+        const int64_t n = tile / sample_tile_num;
+        const int64_t sample_tile = tile % sample_tile_num;
+        const int64_t oh_begin = sample_tile / tiles_w * m;
+        const int64_t ow_begin = sample_tile % tiles_w * m;
+        const int64_t oh_end = std::min<int64_t>(oh_begin + m, oh_size);
+        const int64_t ow_end = std::min<int64_t>(ow_begin + m, ow_size);
+        const T* o = tile_buf + tile - tile_begin;
+        T* y_channel = y + n * co * oh_size * ow_size + oc * y_c_stride;
+        FOR_RANGE(int64_t, oh, oh_begin, oh_end) {
+          FOR_RANGE(int64_t, ow, ow_begin, ow_end) {
+            y_channel[(oh * ow_size + ow) * y_pixel_stride] =
+                o[((oh - oh_begin) * m + ow - ow_begin) * lane_stride] + b;
+          }
+        }
+      }
+    }
+  });
+}
+
+// Filter backward sums the weight diff of every part of the samples separately, parts besides the
+// first one need buffers so there are only as many as kFilterBackwardPartBufByteSize allows
+template<typename T>
+int64_t FilterBackwardPartNum(const ConvCpuShape& shape, int64_t thread_num) {
+  const int64_t weight_byte_size = shape.out_channels * shape.in_channels / shape.groups
+                                   * KernelSpatialSize(shape) * static_cast<int64_t>(sizeof(T));
+  return std::max<int64_t>(
+      std::min({shape.batch_size, thread_num,
+                kFilterBackwardPartBufByteSize / std::max<int64_t>(weight_byte_size, 1) + 1}),
+      1);
+}
+
+// The tmp buffer of filter backward holds the partial weight diffs, then the column buffers
+template<typename T>
+size_t FilterBackwardTmpBufferSizeOnThreads(const ConvCpuShape& shape, int64_t thread_num) {
+  const int64_t weight_elem_cnt =
+      shape.out_channels * shape.in_channels / shape.groups * KernelSpatialSize(shape);
+  return (FilterBackwardPartNum<T>(shape, thread_num) - 1) * weight_elem_cnt * sizeof(T)
+         + Im2ColTmpBufferSize<T>(shape, thread_num);
+}
+
+bool IsDepthwise(const ConvCpuShape& shape) {
+  return shape.groups > 1 && shape.groups == shape.in_channels;
+}
+
+}  // namespace
+
+template<typename T>
+size_t ConvCpuKernelUtil<T>::ForwardTmpBufferSize(const ConvCpuShape& shape) {
+  if (IsDepthwise(shape) || Is1x1WithoutStrideAndPadding(shape)) { return 0; }
+  return Im2ColTmpBufferSize<T>(shape, Global<ThreadPool>::Get()->thread_num());
+}
+
+template<typename T>
+void ConvCpuKernelUtil<T>::Forward(const ConvCpuShape& shape, const T* x, const T* weight,
+                                   const T* bias, T* y, void* tmp_buffer,
+                                   size_t tmp_buffer_size) {
+  if (shape.batch_size == 0 || OutSpatialSize(shape) == 0 || shape.out_channels == 0) { return; }
+  if (IsDepthwise(shape)) {
+    ForwardDepthwise(shape, x, weight, bias, y);
+  } else if (Is1x1WithoutStrideAndPadding(shape)) {
+    Forward1x1(shape, x, weight, bias, y);
+  } else {
+    const int64_t thread_num = TmpBufferThreadNum(tmp_buffer_size, [&](int64_t thread_num) {
+      return Im2ColTmpBufferSize<T>(shape, thread_num);
+    });
+    ForwardByIm2ColGemm(shape, x, weight, bias, y, thread_num, static_cast<T*>(tmp_buffer));
+  }
+}
+
+template<typename T>
+size_t ConvCpuKernelUtil<T>::DataBackwardTmpBufferSize(const ConvCpuShape& shape) {
+  return Im2ColTmpBufferSize<T>(shape, Global<ThreadPool>::Get()->thread_num());
+}
+
+template<typename T>
+void ConvCpuKernelUtil<T>::DataBackward(const ConvCpuShape& shape, const T* dy, const T* weight,
+                                        T* dx, void* tmp_buffer, size_t tmp_buffer_size) {
+  const int64_t out_spatial_size = OutSpatialSize(shape);
+  const int64_t group_in_channels = shape.in_channels / shape.groups;
+  const int64_t group_out_channels = shape.out_channels / shape.groups;
+  const int64_t col_rows = group_in_channels * KernelSpatialSize(shape);
+  const int64_t tile_size = Im2ColTileSize<T>(shape, col_rows);
+  const int64_t dx_sample_size = shape.in_channels * InSpatialSize(shape);
+  const int64_t dy_sample_size = shape.out_channels * out_spatial_size;
+  const int64_t thread_num = TmpBufferThreadNum(tmp_buffer_size, [&](int64_t thread_num) {
+    return Im2ColTmpBufferSize<T>(shape, thread_num);
+  });
+  T* col_bufs = static_cast<T*>(tmp_buffer);
+  const int64_t batch_size = shape.batch_size;
+  // tiles of a sample all add to the same dx sample, so samples are the unit of parallelism
+  ParallelForWithColBuf<T>(shape, batch_size, thread_num, col_bufs, [&](int64_t n, T* col_buf) {
+    const T* dy_sample = dy + n * dy_sample_size;
+    T* dx_sample = dx + n * dx_sample_size;
+    std::fill(dx_sample, dx_sample + dx_sample_size, static_cast<T>(0));
+    for (int64_t pos_begin = 0; pos_begin < out_spatial_size; pos_begin += tile_size) {
+      const int64_t pos_end = std::min(pos_begin + tile_size, out_spatial_size);
+      const int64_t cur_tile_size = pos_end - pos_begin;
+      FOR_RANGE(int64_t, g, 0, shape.groups) {
+        const T* group_weight = weight + g * group_out_channels * col_rows;
+        const int64_t channel_begin = g * group_out_channels;
+        // col = weight(T) * dy
+        if (shape.channels_last) {
+          Gemm(CblasTrans, CblasTrans, col_rows, cur_tile_size, group_out_channels, group_weight,
+               col_rows, dy_sample + pos_begin * shape.out_channels + channel_begin,
+               shape.out_channels, static_cast<T>(0), col_buf, cur_tile_size);
+        } else {
+          Gemm(CblasTrans, CblasNoTrans, col_rows, cur_tile_size, group_out_channels, group_weight,
+               col_rows, dy_sample + channel_begin * out_spatial_size + pos_begin,
+               out_spatial_size, static_cast<T>(0), col_buf, cur_tile_size);
+        }
+        MoveColBufTile<Col2ImMover<T>>(shape, g, pos_begin, pos_end, dx_sample, col_buf);
+      }
+    }
+  });
+}
+
+template<typename T>
+size_t ConvCpuKernelUtil<T>::FilterBackwardTmpBufferSize(const ConvCpuShape& shape) {
+  return FilterBackwardTmpBufferSizeOnThreads<T>(shape, Global<ThreadPool>::Get()->thread_num());
+}
+
+template<typename T>
+void ConvCpuKernelUtil<T>::FilterBackward(const ConvCpuShape& shape, const T* x, const T* dy,
+                                          T* weight_diff, void* tmp_buffer,
+                                          size_t tmp_buffer_size) {
+  const int64_t out_spatial_size = OutSpatialSize(shape);
+  const int64_t group_in_channels = shape.in_channels / shape.groups;
+  const int64_t group_out_channels = shape.out_channels / shape.groups;
+  const int64_t col_rows = group_in_channels * KernelSpatialSize(shape);
+  const int64_t weight_elem_cnt = shape.out_channels * col_rows;
+  const int64_t tile_size = Im2ColTileSize<T>(shape, col_rows);
+  const int64_t x_sample_size = shape.in_channels * InSpatialSize(shape);
+  const int64_t dy_sample_size = shape.out_channels * out_spatial_size;
+  // Every part sums the weight diff of a fixed range of samples, then parts are summed in order
+  // so that the result doesn't depend on scheduling. There are only as many parts as the buffer
+  // budget allows and the out channels of every group are split into blocks for the remaining
+  // parallelism, each block doing its own im2col.
+  const int64_t thread_num = TmpBufferThreadNum(tmp_buffer_size, [&](int64_t thread_num) {
+    return FilterBackwardTmpBufferSizeOnThreads<T>(shape, thread_num);
+  });
+  const int64_t part_num = FilterBackwardPartNum<T>(shape, thread_num);
+  const int64_t block_num = std::max<int64_t>(
+      std::min(group_out_channels / kMinFilterBackwardBlockChannels,
+               (thread_num + part_num * shape.groups - 1) / (part_num * shape.groups)),
+      1);
+  T* part_weight_diff = static_cast<T*>(tmp_buffer);
+  T* col_bufs = part_weight_diff + (part_num - 1) * weight_elem_cnt;
+  std::fill(part_weight_diff, col_bufs, static_cast<T>(0));
+  std::fill(weight_diff, weight_diff + weight_elem_cnt, static_cast<T>(0));
+  const int64_t task_num = part_num * shape.groups * block_num;
+  ParallelForWithColBuf<T>(shape, task_num, thread_num, col_bufs, [&](int64_t task, T* col_buf) {
+    const int64_t part = task / (shape.groups * block_num);
+    const int64_t g = task / block_num % shape.groups;
+    const int64_t block = task % block_num;
+    T* part_diff = part == 0 ? weight_diff : part_weight_diff + (part - 1) * weight_elem_cnt;
+    const int64_t channel_begin = g * group_out_channels + group_out_channels * block / block_num;
+    const int64_t channel_num = g * group_out_channels
+                                + group_out_channels * (block + 1) / block_num - channel_begin;
+    const int64_t n_begin = shape.batch_size * part / part_num;
+    const int64_t n_end = shape.batch_size * (part + 1) / part_num;
+    FOR_RANGE(int64_t, n, n_begin, n_end) {
+      const T* x_sample = x + n * x_sample_size;
+      const T* dy_sample = dy + n * dy_sample_size;
+      for (int64_t pos_begin = 0; pos_begin < out_spatial_size; pos_begin += tile_size) {
+        const int64_t pos_end = std::min(pos_begin + tile_size, out_spatial_size);
+        const int64_t cur_tile_size = pos_end - pos_begin;
+        MoveColBufTile<Im2ColMover<T>>(shape, g, pos_begin, pos_end, x_sample, col_buf);
+        // weight_diff += dy * col(T)
+        if (shape.channels_last) {
+          Gemm(CblasTrans, CblasTrans, channel_num, col_rows, cur_tile_size,
+               dy_sample + pos_begin * shape.out_channels + channel_begin, shape.out_channels,
+               col_buf, cur_tile_size, static_cast<T>(1), part_diff + channel_begin * col_rows,
+               col_rows);
+        } else {
+          Gemm(CblasNoTrans, CblasTrans, channel_num, col_rows, cur_tile_size,
+               dy_sample + channel_begin * out_spatial_size + pos_begin, out_spatial_size,
+               col_buf, cur_tile_size, static_cast<T>(1), part_diff + channel_begin * col_rows,
+               col_rows);
+        }
+      }
+    }
+  });
+  if (part_num == 1) { return; }
+  ParallelFor(weight_elem_cnt, kFilterBackwardSumGrainElemCnt, ParallelForSchedule::kStatic,
+              [&](size_t begin, size_t end) {
+                FOR_RANGE(int64_t, part, 1, part_num) {
+                  const T* part_diff = part_weight_diff + (part - 1) * weight_elem_cnt;
+                  FOR_RANGE(int64_t, i, begin, end) { weight_diff[i] += part_diff[i]; }
+                }
+              });
+}
+
+template<typename T>
+bool ConvCpuKernelUtil<T>::IsWinogradApplicable(const ConvCpuShape& shape) {
+  if (shape.groups != 1 || shape.in_size[0] != 1 || shape.kernel_size[0] != 1) { return false; }
+  FOR_RANGE(int, dim, 1, 3) {
+    if (shape.kernel_size[dim] != 3 || shape.strides[dim] != 1 || shape.dilation_rate[dim] != 1) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template<typename T>
+int32_t ConvCpuKernelUtil<T>::WinogradOutputTileByHeuristic(const ConvCpuShape& shape) {
+  if (!IsWinogradApplicable(shape) || shape.in_channels < kMinWinogradChannels
+      || shape.out_channels < kMinWinogradChannels) {
+    return 0;
+  }
+  const int32_t output_tile = WinogradCost(shape, 4) <= WinogradCost(shape, 2) ? 4 : 2;
+  const int64_t im2col_cost = shape.batch_size * shape.out_size[1] * shape.out_size[2] * 9;
+  return WinogradCost(shape, output_tile) < im2col_cost ? output_tile : 0;
+}
+
+template<typename T>
+int64_t ConvCpuKernelUtil<T>::WinogradWeightElemCnt(const ConvCpuShape& shape,
+                                                   int32_t output_tile) {
+  return (output_tile + 2) * (output_tile + 2) * shape.out_channels * shape.in_channels;
+}
+
+template<typename T>
+void ConvCpuKernelUtil<T>::WinogradTransformWeight(const ConvCpuShape& shape, int32_t output_tile,
+                                                   const T* weight, T* transformed_weight) {
+  CHECK(IsWinogradApplicable(shape));
+  if (output_tile == 2) {
+    TransformWinogradWeight<T, 2>(shape, weight, transformed_weight);
+  } else if (output_tile == 4) {
+    TransformWinogradWeight<T, 4>(shape, weight, transformed_weight);
+  } else {
+    UNIMPLEMENTED();
+  }
+}
+
+template<typename T>
+size_t ConvCpuKernelUtil<T>::WinogradTmpBufferSize(const ConvCpuShape& shape,
+                                                   int32_t output_tile) {
+  return WinogradTmpBufferSizeOnThreads<T>(shape, output_tile,
+                                           Global<ThreadPool>::Get()->thread_num());
+}
+
+template<typename T>
+void ConvCpuKernelUtil<T>::ForwardByWinograd(const ConvCpuShape& shape, int32_t output_tile,
+                                             const T* transformed_weight, const T* x,
+                                             const T* bias, T* y, void* tmp_buffer,
+                                             size_t tmp_buffer_size) {
+  CHECK(IsWinogradApplicable(shape));
+  if (shape.batch_size == 0 || OutSpatialSize(shape) == 0 || shape.out_channels == 0) { return; }
+  CHECK(output_tile == 2 || output_tile == 4);
+  // Blocks are planned for the threads of the pool. A tmp buffer inferred for fewer threads runs
+  // fewer blocks at once, one without room for a single block gets the smaller blocks of more
+  // threads.
+  const int64_t pool_thread_num = Global<ThreadPool>::Get()->thread_num();
+  int64_t block_thread_num = pool_thread_num;
+  WinogradBlocking blocking = GetWinogradBlocking(shape, output_tile, sizeof(T), block_thread_num);
+  while (blocking.buf_elem_cnt * sizeof(T) > tmp_buffer_size
+         && blocking.block_size > kMinWinogradBlockSize) {
+    block_thread_num += 1;
+    blocking = GetWinogradBlocking(shape, output_tile, sizeof(T), block_thread_num);
+  }
+  const size_t buf_byte_size = blocking.buf_elem_cnt * sizeof(T);
+  CHECK_LE(buf_byte_size, tmp_buffer_size);
+  const int64_t thread_num = std::min<int64_t>(pool_thread_num, tmp_buffer_size / buf_byte_size);
+  T* bufs = static_cast<T*>(tmp_buffer);
+  if (output_tile == 2) {
+    WinogradForward<T, 2>(shape, transformed_weight, x, bias, y, blocking, thread_num, bufs);
+  } else {
+    WinogradForward<T, 4>(shape, transformed_weight, x, bias, y, blocking, thread_num, bufs);
+  }
+}
+
+template struct ConvCpuKernelUtil<float>;
+template struct ConvCpuKernelUtil<double>;
+
+}  // namespace oneflow
@@ -0,0 +1,83 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_KERNELS_CONV_CPU_KERNEL_UTIL_H_
+#define ONEFLOW_USER_KERNELS_CONV_CPU_KERNEL_UTIL_H_
+
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+
+// Geometry of a 1d, 2d or 3d convolution seen as a 3d one, missing leading spatial dims are 1.
+// x is [batch_size, in_channels, d, h, w] or [batch_size, d, h, w, in_channels] when
+// channels_last, weight is [out_channels, in_channels / groups, kd, kh, kw] or
+// [out_channels, kd, kh, kw, in_channels / groups] and y is laid out like x.
+struct ConvCpuShape {
+  int64_t batch_size;
+  int64_t in_channels;
+  int64_t out_channels;
+  int64_t groups;
+  int64_t in_size[3];
+  int64_t out_size[3];
+  int64_t kernel_size[3];
+  int32_t strides[3];
+  int32_t dilation_rate[3];
+  int32_t padding_before[3];
+  bool channels_last;
+};
+
+// Convolution forward on host memory, work is spread over Global<ThreadPool>.
+// Depthwise convolutions are computed directly, 1x1 convolutions with stride 1 and no padding
+// are a GEMM over x, others are im2col + GEMM on tiles of output positions whose column buffer
+// fits in L2, each thread using its own column buffer. Backward goes through the same column
+// tiles for every kind of convolution.
+// Column and Winograd block buffers are carved from tmp_buffer, whose size for all threads of the
+// pool is given by the *TmpBufferSize functions. A smaller tmp_buffer runs on fewer threads, down
+// to one.
+template<typename T>
+struct ConvCpuKernelUtil {
+  static size_t ForwardTmpBufferSize(const ConvCpuShape& shape);
+  // bias is nullable
+  static void Forward(const ConvCpuShape& shape, const T* x, const T* weight, const T* bias, T* y,
+                      void* tmp_buffer, size_t tmp_buffer_size);
+  static size_t DataBackwardTmpBufferSize(const ConvCpuShape& shape);
+  // dx is overwritten
+  static void DataBackward(const ConvCpuShape& shape, const T* dy, const T* weight, T* dx,
+                           void* tmp_buffer, size_t tmp_buffer_size);
+  // the partial weight diffs of FilterBackward are in tmp_buffer too
+  static size_t FilterBackwardTmpBufferSize(const ConvCpuShape& shape);
+  // weight_diff is overwritten, samples are summed in an order fixed by the thread number
+  static void FilterBackward(const ConvCpuShape& shape, const T* x, const T* dy, T* weight_diff,
+                             void* tmp_buffer, size_t tmp_buffer_size);
+
+  // Winograd F(m x m, 3 x 3) forward for 2d 3x3 convolutions with stride and dilation 1 and no
+  // groups, output_tile m is 2 or 4. The weight is transformed beforehand into
+  // [(m + 2) * (m + 2), out_channels, in_channels] so that callers can keep it across calls.
+  static bool IsWinogradApplicable(const ConvCpuShape& shape);
+  // the output tile needing the fewest multiplications, 0 if im2col is expected to be faster
+  static int32_t WinogradOutputTileByHeuristic(const ConvCpuShape& shape);
+  static int64_t WinogradWeightElemCnt(const ConvCpuShape& shape, int32_t output_tile);
+  static void WinogradTransformWeight(const ConvCpuShape& shape, int32_t output_tile,
+                                      const T* weight, T* transformed_weight);
+  // the block buffers of every thread, the transformed weight is not in tmp_buffer
+  static size_t WinogradTmpBufferSize(const ConvCpuShape& shape, int32_t output_tile);
+  static void ForwardByWinograd(const ConvCpuShape& shape, int32_t output_tile,
+                                const T* transformed_weight, const T* x, const T* bias, T* y,
+                                void* tmp_buffer, size_t tmp_buffer_size);
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_KERNELS_CONV_CPU_KERNEL_UTIL_H_
@@ -0,0 +1,459 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/conv_cpu_kernel_util.h"
+#include "oneflow/core/common/blas.h"
+#include "oneflow/core/thread/thread_pool.h"
+#include <random>
+
+namespace oneflow {
+
+namespace {
+
+class ConvCpuKernelUtilTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    Global<ThreadPool>::New(std::max<int32_t>(std::thread::hardware_concurrency(), 1));
+  }
+  void TearDown() override { Global<ThreadPool>::Delete(); }
+};
+
+std::vector<float> RandomVector(int64_t size) {
+  std::mt19937 gen(size);
+  std::uniform_real_distribution<float> dist(-1.0, 1.0);
+  std::vector<float> vec(size);
+  for (float& v : vec) { v = dist(gen); }
+  return vec;
+}
+
+// 2d shape, out size follows from symmetric padding
+ConvCpuShape Make2DShape(int64_t batch_size, int64_t in_channels, int64_t out_channels,
+                         int64_t groups, int64_t in_size, int64_t kernel_size, int32_t stride,
+                         int32_t dilation, int32_t padding, bool channels_last) {
+  ConvCpuShape shape{};
+  shape.batch_size = batch_size;
+  shape.in_channels = in_channels;
+  shape.out_channels = out_channels;
+  shape.groups = groups;
+  shape.channels_last = channels_last;
+  FOR_RANGE(int, dim, 0, 3) {
+    const bool is_spatial = dim > 0;
+    shape.in_size[dim] = is_spatial ? in_size : 1;
+    shape.kernel_size[dim] = is_spatial ? kernel_size : 1;
+    shape.strides[dim] = is_spatial ? stride : 1;
+    shape.dilation_rate[dim] = is_spatial ? dilation : 1;
+    shape.padding_before[dim] = is_spatial ? padding : 0;
+    shape.out_size[dim] =
+        (shape.in_size[dim] + 2 * shape.padding_before[dim]
+         - shape.dilation_rate[dim] * (shape.kernel_size[dim] - 1) - 1)
+            / shape.strides[dim]
+        + 1;
+  }
+  return shape;
+}
+
+int64_t Size(const int64_t* dims) { return dims[0] * dims[1] * dims[2]; }
+
+// Calls fn(x_index, weight_index, y_index) for every product of the convolution, output
+// element by output element
+template<typename Fn>
+void ForEachConvProduct(const ConvCpuShape& shape, const Fn& fn) {
+  const int64_t group_in_channels = shape.in_channels / shape.groups;
+  const int64_t group_out_channels = shape.out_channels / shape.groups;
+  const int64_t in_spatial_size = Size(shape.in_size);
+  const int64_t out_spatial_size = Size(shape.out_size);
+  const int64_t kernel_spatial_size = Size(shape.kernel_size);
+  FOR_RANGE(int64_t, n, 0, shape.batch_size) {
+    FOR_RANGE(int64_t, oc, 0, shape.out_channels) {
+      const int64_t g = oc / group_out_channels;
+      FOR_RANGE(int64_t, pos, 0, out_spatial_size) {
+        const int64_t ow = pos % shape.out_size[2];
+        const int64_t oh = pos / shape.out_size[2] % shape.out_size[1];
+        const int64_t od = pos / (shape.out_size[2] * shape.out_size[1]);
+        const int64_t y_index = shape.channels_last
+                                    ? (n * out_spatial_size + pos) * shape.out_channels + oc
+                                    : (n * shape.out_channels + oc) * out_spatial_size + pos;
+        FOR_RANGE(int64_t, ic, 0, group_in_channels) {
+          FOR_RANGE(int64_t, tap, 0, kernel_spatial_size) {
+            const int64_t kw = tap % shape.kernel_size[2];
+            const int64_t kh = tap / shape.kernel_size[2] % shape.kernel_size[1];
+            const int64_t kd = tap / (shape.kernel_size[2] * shape.kernel_size[1]);
+            const int64_t id =
+                od * shape.strides[0] + kd * shape.dilation_rate[0] - shape.padding_before[0];
+            const int64_t ih =
+                oh * shape.strides[1] + kh * shape.dilation_rate[1] - shape.padding_before[1];
+            const int64_t iw =
+                ow * shape.strides[2] + kw * shape.dilation_rate[2] - shape.padding_before[2];
+            if (id < 0 || id >= shape.in_size[0] || ih < 0 || ih >= shape.in_size[1] || iw < 0
+                || iw >= shape.in_size[2]) {
+              continue;
+            }
+            const int64_t c = g * group_in_channels + ic;
+            const int64_t in_pos = (id * shape.in_size[1] + ih) * shape.in_size[2] + iw;
+            const int64_t x_index = shape.channels_last
+                                        ? (n * in_spatial_size + in_pos) * shape.in_channels + c
+                                        : (n * shape.in_channels + c) * in_spatial_size + in_pos;
+            const int64_t weight_index =
+                shape.channels_last ? (oc * kernel_spatial_size + tap) * group_in_channels + ic
+                                    : (oc * group_in_channels + ic) * kernel_spatial_size + tap;
+            fn(x_index, weight_index, y_index);
+          }
+        }
+      }
+    }
+  }
+}
+
+// sums in double precision
+void NaiveConvForward(const ConvCpuShape& shape, const float* x, const float* weight,
+                      const float* bias, float* y) {
+  const int64_t y_size = shape.batch_size * shape.out_channels * Size(shape.out_size);
+  std::vector<double> sum(y_size, 0);
+  ForEachConvProduct(shape, [&](int64_t x_index, int64_t weight_index, int64_t y_index) {
+    sum[y_index] += static_cast<double>(x[x_index]) * weight[weight_index];
+  });
+  const int64_t bias_stride = shape.channels_last ? 1 : Size(shape.out_size);
+  FOR_RANGE(int64_t, i, 0, y_size) {
+    const double b = bias != nullptr ? bias[i / bias_stride % shape.out_channels] : 0;
+    y[i] = sum[i] + b;
+  }
+}
+
+void NaiveConvBackward(const ConvCpuShape& shape, const float* x, const float* weight,
+                       const float* dy, float* dx, float* weight_diff) {
+  const int64_t x_size = shape.batch_size * shape.in_channels * Size(shape.in_size);
+  const int64_t weight_size =
+      shape.out_channels * shape.in_channels / shape.groups * Size(shape.kernel_size);
+  std::vector<double> dx_sum(x_size, 0);
+  std::vector<double> weight_diff_sum(weight_size, 0);
+  ForEachConvProduct(shape, [&](int64_t x_index, int64_t weight_index, int64_t y_index) {
+    dx_sum[x_index] += static_cast<double>(dy[y_index]) * weight[weight_index];
+    weight_diff_sum[weight_index] += static_cast<double>(dy[y_index]) * x[x_index];
+  });
+  std::copy(dx_sum.begin(), dx_sum.end(), dx);
+  std::copy(weight_diff_sum.begin(), weight_diff_sum.end(), weight_diff);
+}
+
+// what the conv kernel used to do: for every sample and group im2col into a column buffer of
+// the whole output, then one GEMM, all on the calling thread. Channels first only.
+void SerialIm2ColGemmForward(const ConvCpuShape& shape, const float* x, const float* weight,
+                             float* col_buf, float* y) {
+  const int64_t group_in_channels = shape.in_channels / shape.groups;
+  const int64_t group_out_channels = shape.out_channels / shape.groups;
+  const int64_t in_spatial_size = Size(shape.in_size);
+  const int64_t out_spatial_size = Size(shape.out_size);
+  const int64_t kernel_spatial_size = Size(shape.kernel_size);
+  const int64_t col_rows = group_in_channels * kernel_spatial_size;
+  FOR_RANGE(int64_t, n, 0, shape.batch_size) {
+    FOR_RANGE(int64_t, g, 0, shape.groups) {
+      FOR_RANGE(int64_t, row, 0, col_rows) {
+        const int64_t c = g * group_in_channels + row / kernel_spatial_size;
+        const int64_t tap = row % kernel_spatial_size;
+        const int64_t kw = tap % shape.kernel_size[2];
+        const int64_t kh = tap / shape.kernel_size[2];
+        const float* x_plane = x + (n * shape.in_channels + c) * in_spatial_size;
+        float* dst = col_buf + row * out_spatial_size;
+        FOR_RANGE(int64_t, oh, 0, shape.out_size[1]) {
+          const int64_t ih =
+              oh * shape.strides[1] + kh * shape.dilation_rate[1] - shape.padding_before[1];
+          FOR_RANGE(int64_t, ow, 0, shape.out_size[2]) {
+            const int64_t iw =
+                ow * shape.strides[2] + kw * shape.dilation_rate[2] - shape.padding_before[2];
+            *(dst++) = (ih < 0 || ih >= shape.in_size[1] || iw < 0 || iw >= shape.in_size[2])
+                           ? 0
+                           : x_plane[ih * shape.in_size[2] + iw];
+          }
+        }
+      }
+      cblas_gemm<float>(CblasRowMajor, CblasNoTrans, CblasNoTrans, group_out_channels,
+                        out_spatial_size, col_rows, 1.0f,
+                        weight + g * group_out_channels * col_rows, col_rows, col_buf,
+                        out_spatial_size, 0.0f,
+                        y + (n * shape.out_channels + g * group_out_channels) * out_spatial_size,
+                        out_spatial_size);
+    }
+  }
+}
+
+// tmp_buffer_thread_num < 0 takes the tmp buffer of all threads
+void CheckForward(const ConvCpuShape& shape, bool has_bias, int64_t tmp_buffer_thread_num = -1) {
+  const int64_t x_size = shape.batch_size * shape.in_channels * Size(shape.in_size);
+  const int64_t weight_size =
+      shape.out_channels * shape.in_channels / shape.groups * Size(shape.kernel_size);
+  const int64_t y_size = shape.batch_size * shape.out_channels * Size(shape.out_size);
+  const std::vector<float> x = RandomVector(x_size);
+  const std::vector<float> weight = RandomVector(weight_size);
+  const std::vector<float> bias = RandomVector(shape.out_channels);
+  const float* bias_ptr = has_bias ? bias.data() : nullptr;
+  std::vector<float> expected(y_size);
+  std::vector<float> y(y_size, 123.0f);
+  size_t tmp_buffer_size = ConvCpuKernelUtil<float>::ForwardTmpBufferSize(shape);
+  if (tmp_buffer_thread_num > 0) {
+    tmp_buffer_size =
+        tmp_buffer_size / Global<ThreadPool>::Get()->thread_num() * tmp_buffer_thread_num;
+  }
+  std::vector<char> tmp_buffer(tmp_buffer_size);
+  NaiveConvForward(shape, x.data(), weight.data(), bias_ptr, expected.data());
+  ConvCpuKernelUtil<float>::Forward(shape, x.data(), weight.data(), bias_ptr, y.data(),
+                                    tmp_buffer.data(), tmp_buffer.size());
+  FOR_RANGE(int64_t, i, 0, y_size) { ASSERT_NEAR(y[i], expected[i], 1e-4) << "index " << i; }
+}
+
+void CheckBackward(const ConvCpuShape& shape) {
+  const int64_t x_size = shape.batch_size * shape.in_channels * Size(shape.in_size);
+  const int64_t weight_size =
+      shape.out_channels * shape.in_channels / shape.groups * Size(shape.kernel_size);
+  const int64_t y_size = shape.batch_size * shape.out_channels * Size(shape.out_size);
+  const std::vector<float> x = RandomVector(x_size);
+  const std::vector<float> weight = RandomVector(weight_size);
+  const std::vector<float> dy = RandomVector(y_size);
+  std::vector<float> expected_dx(x_size);
+  std::vector<float> expected_weight_diff(weight_size);
+  std::vector<float> dx(x_size, 123.0f);
+  std::vector<float> weight_diff(weight_size, 123.0f);
+  NaiveConvBackward(shape, x.data(), weight.data(), dy.data(), expected_dx.data(),
+                    expected_weight_diff.data());
+  std::vector<char> data_tmp_buffer(ConvCpuKernelUtil<float>::DataBackwardTmpBufferSize(shape));
+  std::vector<char> filter_tmp_buffer(
+      ConvCpuKernelUtil<float>::FilterBackwardTmpBufferSize(shape));
+  ConvCpuKernelUtil<float>::DataBackward(shape, dy.data(), weight.data(), dx.data(),
+                                         data_tmp_buffer.data(), data_tmp_buffer.size());
+  ConvCpuKernelUtil<float>::FilterBackward(shape, x.data(), dy.data(), weight_diff.data(),
+                                           filter_tmp_buffer.data(), filter_tmp_buffer.size());
+  FOR_RANGE(int64_t, i, 0, x_size) { ASSERT_NEAR(dx[i], expected_dx[i], 1e-4) << "index " << i; }
+  FOR_RANGE(int64_t, i, 0, weight_size) {
+    ASSERT_NEAR(weight_diff[i], expected_weight_diff[i], 1e-3) << "index " << i;
+  }
+}
+
+void CheckWinogradForward(const ConvCpuShape& shape, int32_t output_tile,
+                          int64_t tmp_buffer_thread_num = -1) {
+  ASSERT_TRUE(ConvCpuKernelUtil<float>::IsWinogradApplicable(shape));
+  const int64_t x_size = shape.batch_size * shape.in_channels * Size(shape.in_size);
+  const int64_t weight_size = shape.out_channels * shape.in_channels * Size(shape.kernel_size);
+  const int64_t y_size = shape.batch_size * shape.out_channels * Size(shape.out_size);
+  const std::vector<float> x = RandomVector(x_size);
+  const std::vector<float> weight = RandomVector(weight_size);
+  const std::vector<float> bias = RandomVector(shape.out_channels);
+  std::vector<float> transformed_weight(
+      ConvCpuKernelUtil<float>::WinogradWeightElemCnt(shape, output_tile));
+  size_t tmp_buffer_size = ConvCpuKernelUtil<float>::WinogradTmpBufferSize(shape, output_tile);
+  if (tmp_buffer_thread_num > 0) {
+    tmp_buffer_size =
+        tmp_buffer_size / Global<ThreadPool>::Get()->thread_num() * tmp_buffer_thread_num;
+  }
+  std::vector<char> tmp_buffer(tmp_buffer_size);
+  std::vector<float> expected(y_size);
+  std::vector<float> y(y_size, 123.0f);
+  NaiveConvForward(shape, x.data(), weight.data(), bias.data(), expected.data());
+  ConvCpuKernelUtil<float>::WinogradTransformWeight(shape, output_tile, weight.data(),
+                                                    transformed_weight.data());
+  ConvCpuKernelUtil<float>::ForwardByWinograd(shape, output_tile, transformed_weight.data(),
+                                              x.data(), bias.data(), y.data(), tmp_buffer.data(),
+                                              tmp_buffer.size());
+  FOR_RANGE(int64_t, i, 0, y_size) { ASSERT_NEAR(y[i], expected[i], 1e-3) << "index " << i; }
+}
+
+TEST_F(ConvCpuKernelUtilTest, forward) {
+  for (bool channels_last : {false, true}) {
+    for (bool has_bias : {false, true}) {
+      // im2col + GEMM, with a column buffer of several tiles for the larger ones
+      CheckForward(Make2DShape(2, 3, 4, 1, 7, 3, 1, 1, 1, channels_last), has_bias);
+      CheckForward(Make2DShape(3, 5, 6, 1, 9, 3, 2, 1, 1, channels_last), has_bias);
+      CheckForward(Make2DShape(2, 4, 3, 1, 11, 5, 1, 2, 3, channels_last), has_bias);
+      CheckForward(Make2DShape(2, 64, 8, 1, 40, 3, 1, 1, 1, channels_last), has_bias);
+      CheckForward(Make2DShape(2, 6, 4, 2, 8, 3, 1, 1, 0, channels_last), has_bias);
+      // 1x1, direct or strided
+      CheckForward(Make2DShape(2, 16, 8, 1, 20, 1, 1, 1, 0, channels_last), has_bias);
+      CheckForward(Make2DShape(2, 16, 8, 4, 20, 1, 1, 1, 0, channels_last), has_bias);
+      CheckForward(Make2DShape(2, 16, 8, 1, 9, 1, 2, 1, 0, channels_last), has_bias);
+      // depthwise
+      CheckForward(Make2DShape(2, 8, 8, 8, 9, 3, 1, 1, 1, channels_last), has_bias);
+      CheckForward(Make2DShape(2, 4, 8, 4, 10, 3, 2, 1, 1, channels_last), has_bias);
+      CheckForward(Make2DShape(1, 3, 3, 3, 12, 5, 1, 2, 2, channels_last), has_bias);
+    }
+  }
+}
+
+TEST_F(ConvCpuKernelUtilTest, forward_with_smaller_tmp_buffer) {
+  // the tmp buffer may have been inferred on a machine with fewer threads
+  Global<ThreadPool>::Delete();
+  Global<ThreadPool>::New(4);
+  for (int64_t tmp_buffer_thread_num : {1, 3}) {
+    for (bool channels_last : {false, true}) {
+      CheckForward(Make2DShape(2, 64, 8, 1, 40, 3, 1, 1, 1, channels_last), true,
+                   tmp_buffer_thread_num);
+      CheckWinogradForward(Make2DShape(2, 64, 32, 1, 30, 3, 1, 1, 1, channels_last), 4,
+                           tmp_buffer_thread_num);
+    }
+  }
+}
+
+TEST_F(ConvCpuKernelUtilTest, backward) {
+  for (bool channels_last : {false, true}) {
+    CheckBackward(Make2DShape(2, 3, 4, 1, 7, 3, 1, 1, 1, channels_last));
+    CheckBackward(Make2DShape(3, 5, 6, 1, 9, 3, 2, 1, 1, channels_last));
+    CheckBackward(Make2DShape(2, 4, 3, 1, 11, 5, 1, 2, 3, channels_last));
+    CheckBackward(Make2DShape(2, 64, 8, 1, 40, 3, 1, 1, 1, channels_last));
+    CheckBackward(Make2DShape(2, 6, 4, 2, 8, 3, 1, 1, 0, channels_last));
+    CheckBackward(Make2DShape(5, 16, 8, 4, 20, 1, 1, 1, 0, channels_last));
+    CheckBackward(Make2DShape(2, 4, 8, 4, 10, 3, 2, 1, 1, channels_last));
+    // filter backward splits out channels when there are fewer samples than threads
+    CheckBackward(Make2DShape(1, 8, 48, 1, 10, 3, 1, 1, 1, channels_last));
+    CheckBackward(Make2DShape(3, 4, 64, 2, 9, 3, 1, 1, 1, channels_last));
+  }
+}
+
+TEST_F(ConvCpuKernelUtilTest, winograd_forward) {
+  for (bool channels_last : {false, true}) {
+    for (int32_t output_tile : {2, 4}) {
+      CheckWinogradForward(Make2DShape(2, 3, 4, 1, 7, 3, 1, 1, 1, channels_last), output_tile);
+      CheckWinogradForward(Make2DShape(2, 16, 8, 1, 13, 3, 1, 1, 0, channels_last), output_tile);
+      CheckWinogradForward(Make2DShape(3, 5, 6, 1, 9, 3, 1, 1, 2, channels_last), output_tile);
+      CheckWinogradForward(Make2DShape(1, 64, 32, 1, 30, 3, 1, 1, 1, channels_last), output_tile);
+    }
+  }
+  EXPECT_FALSE(ConvCpuKernelUtil<float>::IsWinogradApplicable(
+      Make2DShape(1, 16, 16, 1, 8, 3, 2, 1, 1, false)));
+  EXPECT_FALSE(ConvCpuKernelUtil<float>::IsWinogradApplicable(
+      Make2DShape(1, 16, 16, 1, 8, 3, 1, 2, 2, false)));
+  EXPECT_FALSE(ConvCpuKernelUtil<float>::IsWinogradApplicable(
+      Make2DShape(1, 16, 16, 2, 8, 3, 1, 1, 1, false)));
+  EXPECT_FALSE(ConvCpuKernelUtil<float>::IsWinogradApplicable(
+      Make2DShape(1, 16, 16, 1, 8, 5, 1, 1, 2, false)));
+}
+
+TEST_F(ConvCpuKernelUtilTest, conv_1d_and_3d) {
+  for (bool channels_last : {false, true}) {
+    ConvCpuShape shape_1d = Make2DShape(2, 4, 5, 1, 1, 1, 1, 1, 0, channels_last);
+    shape_1d.in_size[2] = 17;
+    shape_1d.kernel_size[2] = 3;
+    shape_1d.padding_before[2] = 1;
+    shape_1d.out_size[2] = 17;
+    CheckForward(shape_1d, true);
+    CheckBackward(shape_1d);
+    ConvCpuShape shape_3d = Make2DShape(2, 3, 4, 1, 6, 3, 1, 1, 1, channels_last);
+    shape_3d.in_size[0] = 5;
+    shape_3d.kernel_size[0] = 3;
+    shape_3d.strides[0] = 2;
+    shape_3d.out_size[0] = 2;
+    CheckForward(shape_3d, true);
+    CheckBackward(shape_3d);
+  }
+}
+
+TEST_F(ConvCpuKernelUtilTest, DISABLED_benchmark_forward) {
+  const int64_t kIters = 3;
+  // resnet style layers as (channels in, channels out, groups, size, kernel size, stride)
+  const std::vector<std::vector<int64_t>> layers = {
+      {64, 64, 1, 56, 3, 1},    {64, 256, 1, 56, 1, 1},   {256, 64, 1, 56, 1, 1},
+      {128, 128, 1, 28, 3, 1},  {256, 256, 1, 14, 3, 1},  {512, 512, 1, 7, 3, 1},
+      {128, 128, 1, 56, 3, 2},  {128, 128, 128, 56, 3, 1}, {512, 512, 512, 14, 3, 1},
+  };
+  for (const auto& layer : layers) {
+    const ConvCpuShape shape = Make2DShape(8, layer[0], layer[1], layer[2], layer[3], layer[4],
+                                           layer[5], 1, layer[4] / 2, false);
+    const std::vector<float> x = RandomVector(shape.batch_size * shape.in_channels
+                                              * Size(shape.in_size));
+    const std::vector<float> weight = RandomVector(shape.out_channels * shape.in_channels
+                                                   / shape.groups * Size(shape.kernel_size));
+    std::vector<float> col_buf(shape.in_channels / shape.groups * Size(shape.kernel_size)
+                               * Size(shape.out_size));
+    std::vector<float> y(shape.batch_size * shape.out_channels * Size(shape.out_size));
+    std::vector<char> tmp_buffer(ConvCpuKernelUtil<float>::ForwardTmpBufferSize(shape));
+    const auto serial_start = std::chrono::steady_clock::now();
+    FOR_RANGE(int64_t, iter, 0, kIters) {
+      SerialIm2ColGemmForward(shape, x.data(), weight.data(), col_buf.data(), y.data());
+    }
+    const auto parallel_start = std::chrono::steady_clock::now();
+    FOR_RANGE(int64_t, iter, 0, kIters) {
+      ConvCpuKernelUtil<float>::Forward(shape, x.data(), weight.data(), nullptr, y.data(),
+                                        tmp_buffer.data(), tmp_buffer.size());
+    }
+    const auto parallel_end = std::chrono::steady_clock::now();
+    const double serial_ms =
+        std::chrono::duration<double, std::milli>(parallel_start - serial_start).count() / kIters;
+    const double parallel_ms =
+        std::chrono::duration<double, std::milli>(parallel_end - parallel_start).count() / kIters;
+    LOG(INFO) << "conv forward n" << shape.batch_size << " c" << shape.in_channels << "->"
+              << shape.out_channels << " g" << shape.groups << " " << layer[3] << "x" << layer[3]
+              << " k" << layer[4] << " s" << layer[5] << ": serial im2col " << serial_ms
+              << "ms, parallel " << parallel_ms << "ms, speedup " << serial_ms / parallel_ms;
+  }
+}
+
+TEST_F(ConvCpuKernelUtilTest, DISABLED_benchmark_winograd) {
+  const int64_t kIters = 3;
+  // resnet and vgg style 3x3 stride 1 layers as (channels, size)
+  const std::vector<std::vector<int64_t>> layers = {
+      {64, 56}, {128, 28}, {256, 14}, {512, 7}, {64, 112},
+  };
+  for (const auto& layer : layers) {
+    const ConvCpuShape shape =
+        Make2DShape(8, layer[0], layer[0], 1, layer[1], 3, 1, 1, 1, false);
+    const std::vector<float> x = RandomVector(shape.batch_size * shape.in_channels
+                                              * Size(shape.in_size));
+    const std::vector<float> weight =
+        RandomVector(shape.out_channels * shape.in_channels * Size(shape.kernel_size));
+    const int64_t y_size = shape.batch_size * shape.out_channels * Size(shape.out_size);
+    std::vector<float> im2col_y(y_size);
+    std::vector<char> tmp_buffer(ConvCpuKernelUtil<float>::ForwardTmpBufferSize(shape));
+    const auto im2col_start = std::chrono::steady_clock::now();
+    FOR_RANGE(int64_t, iter, 0, kIters) {
+      ConvCpuKernelUtil<float>::Forward(shape, x.data(), weight.data(), nullptr, im2col_y.data(),
+                                        tmp_buffer.data(), tmp_buffer.size());
+    }
+    const double im2col_ms = std::chrono::duration<double, std::milli>(
+                                 std::chrono::steady_clock::now() - im2col_start)
+                                 .count()
+                             / kIters;
+    std::string result;
+    for (int32_t output_tile : {2, 4}) {
+      std::vector<float> transformed_weight(
+          ConvCpuKernelUtil<float>::WinogradWeightElemCnt(shape, output_tile));
+      std::vector<char> winograd_tmp_buffer(
+          ConvCpuKernelUtil<float>::WinogradTmpBufferSize(shape, output_tile));
+      std::vector<float> y(y_size);
+      const auto start = std::chrono::steady_clock::now();
+      FOR_RANGE(int64_t, iter, 0, kIters) {
+        // the kernel transforms the weight on every call
+        ConvCpuKernelUtil<float>::WinogradTransformWeight(shape, output_tile, weight.data(),
+                                                          transformed_weight.data());
+        ConvCpuKernelUtil<float>::ForwardByWinograd(
+            shape, output_tile, transformed_weight.data(), x.data(), nullptr, y.data(),
+            winograd_tmp_buffer.data(), winograd_tmp_buffer.size());
+      }
+      const double ms =
+          std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+              .count()
+          / kIters;
+      float max_diff = 0;
+      FOR_RANGE(int64_t, i, 0, y_size) {
+        max_diff = std::max(max_diff, std::abs(y[i] - im2col_y[i]));
+      }
+      result += ", F(" + std::to_string(output_tile) + "x" + std::to_string(output_tile)
+                + ", 3x3) " + std::to_string(ms) + "ms speedup " + std::to_string(im2col_ms / ms)
+                + " max diff " + std::to_string(max_diff);
+    }
+    LOG(INFO) << "conv 3x3 n" << shape.batch_size << " c" << shape.in_channels << " "
+              << layer[1] << "x" << layer[1] << ": im2col " << im2col_ms << "ms" << result
+              << ", heuristic F("
+              << ConvCpuKernelUtil<float>::WinogradOutputTileByHeuristic(shape) << ")";
+  }
+}
+
+}  // namespace
+
+}  // namespace oneflow
@@ -17,287 +17,19 @@ limitations under the License.
 #include "oneflow/user/ops/nn_util.h"
 #include "oneflow/core/kernel/new_kernel_util.h"
 #include "oneflow/core/kernel/kernel_util.h"
+#include "oneflow/user/kernels/conv_cpu_kernel_util.h"
 
 namespace oneflow {
 
 namespace {
 
-template<typename T>
-using Im2ColFunc = void (*)(const T* in_dptr, const ShapeView& in_shape,
-                            const ShapeView& weight_shape, const ShapeView& out_shape,
-                            const int32_t* strides, const int32_t* dilation_rate,
-                            const int32_t* padding_before, T* col_buf);
-
-template<typename T>
-using Col2ImFunc = void (*)(const T* col_buf, const ShapeView& in_shape,
-                            const ShapeView& weight_shape, const ShapeView& out_shape,
-                            const int32_t* strides, const int32_t* dilation_rate,
-                            const int32_t* padding_before, T* in_diff_ptr);
-
-template<typename T>
-using GemmFunc = void (*)(enum CBLAS_TRANSPOSE trans_a, enum CBLAS_TRANSPOSE trans_b, const int m,
-                          const int n, const int k, const T alpha, const T* a, const T* b,
-                          const T beta, T* c);
-
-template<typename T>
-void Gemm4ChannelFirst(enum CBLAS_TRANSPOSE trans_a, enum CBLAS_TRANSPOSE trans_b, const int m,
-                       const int n, const int k, const T alpha, const T* a, const T* b,
-                       const T beta, T* c) {
-  NewKernelUtil<DeviceType::kCPU>::OFGemm(nullptr, trans_a, trans_b, m, n, k, alpha, a, b, beta, c);
-}
-
-template<typename T>
-void Gemm4ChannelLast(enum CBLAS_TRANSPOSE trans_a, enum CBLAS_TRANSPOSE trans_b, const int m,
-                      const int n, const int k, const T alpha, const T* a, const T* b, const T beta,
-                      T* c) {
-  trans_a = (trans_a == CblasNoTrans) ? CblasTrans : CblasNoTrans;
-  trans_b = (trans_b == CblasNoTrans) ? CblasTrans : CblasNoTrans;
-  NewKernelUtil<DeviceType::kCPU>::OFGemm(nullptr, trans_b, trans_a, n, m, k, alpha, b, a, beta, c);
-}
-
-template<typename T>
-T* GetImgMutDptr(user_op::Tensor* tensor, int64_t idx) {
-  return tensor->mut_dptr<T>() + tensor->shape().Count(1) * idx;
-}
-
 template<typename T>
 const T* GetImgDptr(const user_op::Tensor* tensor, int64_t idx) {
   return tensor->dptr<T>() + tensor->shape().Count(1) * idx;
 }
 
-size_t CalcElemNumOfColBuf(const ShapeView& out_shape, const ShapeView& weight_shape,
-                           const int32_t idx_offset) {
-  int64_t col_buf_elem_cnt = 1;
-  int64_t ndims = out_shape.NumAxes() - 2;
-
-  for (size_t i = 0; i != ndims + 1; ++i) { col_buf_elem_cnt *= weight_shape.At(i + 1); }
-  for (size_t i = 0; i != ndims; ++i) { col_buf_elem_cnt *= out_shape.At(idx_offset + i); }
-  return col_buf_elem_cnt;
-}
-
-template<typename T>
-class ColBufWriter {
- public:
-  ColBufWriter(const T* src_ptr, T* dst_ptr, int64_t c_size, int64_t id_size, int64_t ih_size,
-               int64_t iw_size, int64_t od_size, int64_t oh_size, int64_t ow_size)
-      : src_ptr_(src_ptr),
-        dst_ptr_(dst_ptr),
-        c_size_(c_size),
-        id_size_(id_size),
-        ih_size_(ih_size),
-        iw_size_(iw_size),
-        od_size_(od_size),
-        oh_size_(oh_size),
-        ow_size_(ow_size) {}
-  virtual ~ColBufWriter() = default;
-  virtual void DHWCWrite(int64_t c, int64_t id, int64_t ih, int64_t iw) = 0;
-  virtual void CDHWWrite(int64_t c, int64_t id, int64_t ih, int64_t iw) = 0;
-  virtual void InvalidDFunc() = 0;
-  virtual void InvalidHFunc() = 0;
-  virtual void InvalidWFunc() = 0;
-  virtual void NextImCSize() = 0;
-
- protected:
-  const T* src_ptr_;
-  T* dst_ptr_;
-  int64_t c_size_;
-  int64_t id_size_;
-  int64_t ih_size_;
-  int64_t iw_size_;
-  int64_t od_size_;
-  int64_t oh_size_;
-  int64_t ow_size_;
-};
-
-template<typename T>
-class Im2ColWriter final : public ColBufWriter<T> {
- public:
-  Im2ColWriter(const T* src_ptr, T* dst_ptr, int64_t c_size, int64_t id_size, int64_t ih_size,
-               int64_t iw_size, int64_t od_size, int64_t oh_size, int64_t ow_size)
-      : ColBufWriter<T>::ColBufWriter(src_ptr, dst_ptr, c_size, id_size, ih_size, iw_size, od_size,
-                                      oh_size, ow_size) {}
-  ~Im2ColWriter() = default;
-  void DHWCWrite(int64_t c, int64_t id, int64_t ih, int64_t iw) override {
-    *(this->dst_ptr_++) =
-        this->src_ptr_[id * this->id_size_ + ih * this->ih_size_ + iw * this->iw_size_ + c];
-  }
-  void CDHWWrite(int64_t c, int64_t id, int64_t ih, int64_t iw) override {
-    *(this->dst_ptr_++) = this->src_ptr_[id * this->id_size_ + ih * this->ih_size_ + iw];
-  }
-  void InvalidDFunc() override {
-    FOR_RANGE(int64_t, i, 0, this->od_size_) { *(this->dst_ptr_++) = 0; }
-  }
-  void InvalidHFunc() override {
-    FOR_RANGE(int64_t, i, 0, this->oh_size_) { *(this->dst_ptr_++) = 0; }
-  }
-  void InvalidWFunc() override {
-    FOR_RANGE(int64_t, i, 0, this->ow_size_) { *(this->dst_ptr_++) = 0; }
-  }
-  void NextImCSize() override { this->src_ptr_ += this->c_size_; }
-};
-
-template<typename T>
-class Col2ImWriter final : public ColBufWriter<T> {
- public:
-  Col2ImWriter(const T* src_ptr, T* dst_ptr, int64_t c_size, int64_t id_size, int64_t ih_size,
-               int64_t iw_size, int64_t od_size, int64_t oh_size, int64_t ow_size)
-      : ColBufWriter<T>::ColBufWriter(src_ptr, dst_ptr, c_size, id_size, ih_size, iw_size, od_size,
-                                      oh_size, ow_size) {}
-  ~Col2ImWriter() = default;
-  void DHWCWrite(int64_t c, int64_t id, int64_t ih, int64_t iw) override {
-    this->dst_ptr_[id * this->id_size_ + ih * this->ih_size_ + iw * this->iw_size_ + c] +=
-        *(this->src_ptr_++);
-  }
-  void CDHWWrite(int64_t c, int64_t id, int64_t ih, int64_t iw) override {
-    this->dst_ptr_[id * this->id_size_ + ih * this->ih_size_ + iw] += *(this->src_ptr_++);
-  }
-  void InvalidDFunc() override { this->src_ptr_ += this->od_size_; }
-  void InvalidHFunc() override { this->src_ptr_ += this->oh_size_; }
-  void InvalidWFunc() override { this->src_ptr_ += this->ow_size_; }
-  void NextImCSize() override { this->dst_ptr_ += this->c_size_; }
-};
-
-template<typename T>
-using DHWValidFunc = void (ColBufWriter<T>::*)(int64_t c, int64_t kd, int64_t kh, int64_t kw);
-
-template<typename T>
-class ColBufUtil final {
- public:
-  ColBufUtil(const ShapeView& in_shape, const ShapeView& out_shape, int32_t dhw_offset,
-             const int32_t* strides, const int32_t* dilation_rate, const int32_t* padding_before)
-      : strides_(strides), dilation_rate_(dilation_rate), padding_before_(padding_before) {
-    id_num_ = in_shape.At(dhw_offset);
-    ih_num_ = in_shape.At(dhw_offset + 1);
-    iw_num_ = in_shape.At(dhw_offset + 2);
-    od_num_ = out_shape.At(dhw_offset);
-    oh_num_ = out_shape.At(dhw_offset + 1);
-    ow_num_ = out_shape.At(dhw_offset + 2);
-    if (dhw_offset == 2) {
-      dhw_valid_func_ = &ColBufWriter<T>::CDHWWrite;
-    } else {
-      dhw_valid_func_ = &ColBufWriter<T>::DHWCWrite;
-    }
-  }
-  void operator()(ColBufWriter<T>* col_buf_writer, int64_t c, int64_t kd, int64_t kh, int64_t kw) {
-    int64_t id = kd * dilation_rate_[0] - padding_before_[0];
-    FOR_RANGE(int64_t, od, 0, od_num_) {
-      if (id < 0 || id >= id_num_) {
-        col_buf_writer->InvalidDFunc();
-      } else {
-        int64_t ih = kh * dilation_rate_[1] - padding_before_[1];
-        FOR_RANGE(int64_t, oh, 0, oh_num_) {
-          if (ih < 0 || ih >= ih_num_) {
-            col_buf_writer->InvalidHFunc();
-          } else {
-            int64_t iw = kw * dilation_rate_[2] - padding_before_[2];
-            FOR_RANGE(int64_t, ow, 0, ow_num_) {
-              if (iw < 0 || iw >= iw_num_) {
-                col_buf_writer->InvalidWFunc();
-              } else {
-                (col_buf_writer->*dhw_valid_func_)(c, id, ih, iw);
-              }
-              iw += strides_[2];
-            }
-          }
-          ih += strides_[1];
-        }
-      }
-      id += strides_[0];
-    }
-  }
-
- private:
-  int64_t id_num_;
-  int64_t ih_num_;
-  int64_t iw_num_;
-  int64_t od_num_;
-  int64_t oh_num_;
-  int64_t ow_num_;
-  const int32_t* strides_;
-  const int32_t* dilation_rate_;
-  const int32_t* padding_before_;
-  DHWValidFunc<T> dhw_valid_func_;
-};
-
-template<typename T>
-struct ConvKernelUtil final {
- public:
-  static void NCDHWIm2Col(const T* in_dptr, const ShapeView& in_shape,
-                          const ShapeView& weight_shape, const ShapeView& out_shape,
-                          const int32_t* strides, const int32_t* dilation_rate,
-                          const int32_t* padding_before, T* col_buf_ptr) {
-    ColBufUtil<T> col_buf_util(in_shape, out_shape, 2, strides, dilation_rate, padding_before);
-    Im2ColWriter<T> col_buf_writer(in_dptr, col_buf_ptr, in_shape.Count(2), in_shape.Count(3),
-                                   in_shape.Count(4), 1, out_shape.Count(3), out_shape.Count(4), 1);
-    DoNCDWHFunc(weight_shape, col_buf_util, &col_buf_writer);
-  }
-
-  static void NDHWCIm2Col(const T* in_dptr, const ShapeView& in_shape,
-                          const ShapeView& weight_shape, const ShapeView& out_shape,
-                          const int32_t* strides, const int32_t* dilation_rate,
-                          const int32_t* padding_before, T* col_buf_ptr) {
-    ColBufUtil<T> col_buf_util(in_shape, out_shape, 1, strides, dilation_rate, padding_before);
-    Im2ColWriter<T> col_buf_writer(in_dptr, col_buf_ptr, in_shape.Count(2), in_shape.Count(2),
-                                   in_shape.Count(3), in_shape.Count(4), out_shape.Count(2, 4),
-                                   out_shape.Count(3, 4), 1);
-    DoNDWHCFunc(weight_shape, col_buf_util, &col_buf_writer);
-  }
-
-  static void NCDHWCol2Im(const T* col_buf_ptr, const ShapeView& in_shape,
-                          const ShapeView& weight_shape, const ShapeView& out_shape,
-                          const int32_t* strides, const int32_t* dilation_rate,
-                          const int32_t* padding_before, T* in_diff_ptr) {
-    ColBufUtil<T> col_buf_util(in_shape, out_shape, 2, strides, dilation_rate, padding_before);
-    Col2ImWriter<T> col_buf_writer(col_buf_ptr, in_diff_ptr, in_shape.Count(2), in_shape.Count(3),
-                                   in_shape.Count(4), 1, out_shape.Count(3), out_shape.Count(4), 1);
-    DoNCDWHFunc(weight_shape, col_buf_util, &col_buf_writer);
-  }
-
-  static void NDHWCCol2Im(const T* col_buf_ptr, const ShapeView& in_shape,
-                          const ShapeView& weight_shape, const ShapeView& out_shape,
-                          const int32_t* strides, const int32_t* dilation_rate,
-                          const int32_t* padding_before, T* in_diff_ptr) {
-    ColBufUtil<T> col_buf_util(in_shape, out_shape, 1, strides, dilation_rate, padding_before);
-    Col2ImWriter<T> col_buf_writer(col_buf_ptr, in_diff_ptr, in_shape.Count(2), in_shape.Count(2),
-                                   in_shape.Count(3), in_shape.Count(4), out_shape.Count(2, 4),
-                                   out_shape.Count(3, 4), 1);
-    DoNDWHCFunc(weight_shape, col_buf_util, &col_buf_writer);
-  }
-
- private:
-  static void DoNCDWHFunc(const ShapeView& weight_shape, ColBufUtil<T>& col_buf_util,
-                          ColBufWriter<T>* col_buf_writer) {
-    for (int64_t c = 0; c != weight_shape.At(1); col_buf_writer->NextImCSize(), ++c) {
-      for (int64_t kd = 0; kd != weight_shape.At(2); ++kd) {
-        for (int64_t kh = 0; kh != weight_shape.At(3); ++kh) {
-          for (int64_t kw = 0; kw != weight_shape.At(4); ++kw) {
-            col_buf_util(col_buf_writer, c, kd, kh, kw);
-          }
-        }
-      }
-    }
-  }
-
-  static void DoNDWHCFunc(const ShapeView& weight_shape, ColBufUtil<T>& col_buf_util,
-                          ColBufWriter<T>* col_buf_writer) {
-    for (int64_t kd = 0; kd != weight_shape.At(1); ++kd) {
-      for (int64_t kh = 0; kh != weight_shape.At(2); ++kh) {
-        for (int64_t kw = 0; kw != weight_shape.At(3); ++kw) {
-          for (int64_t c = 0; c != weight_shape.At(4); ++c) {
-            col_buf_util(col_buf_writer, c, kd, kh, kw);
-          }
-        }
-      }
-    }
-  }
-};
-
 template<typename T>
 struct ConvOpKernelState final : public user_op::OpKernelState {
-  Im2ColFunc<T> im2col_func_;
-  Col2ImFunc<T> col2im_func_;
-  GemmFunc<T> forward_func_;
-
   Shape in_5d_shape_;
   Shape out_5d_shape_;
   Shape weight_5d_shape_;
@@ -306,7 +38,6 @@ struct ConvOpKernelState final : public user_op::OpKernelState {
   std::vector<int32_t> dilation_rate_3d_;
   std::vector<int32_t> padding_before_3d_;
 
-  enum CBLAS_TRANSPOSE is_out_diff_need_trans_;
   int32_t idx_offset_;
   bool is_dynamic_;
 
@@ -335,16 +66,8 @@ std::shared_ptr<ConvOpKernelState<T>> CreateConvOpKernelState(user_op::KernelCom
 
   std::shared_ptr<ConvOpKernelState<T>> state(new ConvOpKernelState<T>());
   if (data_format == "channels_first") {
-    state->im2col_func_ = ConvKernelUtil<T>::NCDHWIm2Col;
-    state->col2im_func_ = ConvKernelUtil<T>::NCDHWCol2Im;
-    state->forward_func_ = Gemm4ChannelFirst;
-    state->is_out_diff_need_trans_ = CblasNoTrans;
     state->idx_offset_ = 2;
   } else {
-    state->im2col_func_ = ConvKernelUtil<T>::NDHWCIm2Col;
-    state->col2im_func_ = ConvKernelUtil<T>::NDHWCCol2Im;
-    state->forward_func_ = Gemm4ChannelLast;
-    state->is_out_diff_need_trans_ = CblasTrans;
     state->idx_offset_ = 1;
   }
 
@@ -387,6 +110,94 @@ void InitBiasMulBuf(T* dptr, int64_t num) {
   for (int64_t i = 0; i < num; ++i) { dptr[i] = 1; }
 }
 
+template<typename T>
+ConvCpuShape GenConvCpuShape(const ConvOpKernelState<T>& conv_state, int64_t groups) {
+  const int32_t idx_offset = conv_state.idx_offset_;
+  const int32_t channel_axis = (idx_offset == 2) ? 1 : 4;
+  ConvCpuShape shape{};
+  shape.batch_size = conv_state.in_5d_shape_.At(0);
+  shape.in_channels = conv_state.in_5d_shape_.At(channel_axis);
+  shape.out_channels = conv_state.out_5d_shape_.At(channel_axis);
+  shape.groups = groups;
+  FOR_RANGE(int32_t, dim, 0, 3) {
+    shape.in_size[dim] = conv_state.in_5d_shape_.At(idx_offset + dim);
+    shape.out_size[dim] = conv_state.out_5d_shape_.At(idx_offset + dim);
+    shape.kernel_size[dim] = conv_state.weight_5d_shape_.At(idx_offset + dim);
+    shape.strides[dim] = conv_state.strides_3d_.at(dim);
+    shape.dilation_rate[dim] = conv_state.dilation_rate_3d_.at(dim);
+    shape.padding_before[dim] = conv_state.padding_before_3d_.at(dim);
+  }
+  shape.channels_last = (idx_offset == 1);
+  return shape;
+}
+
+// a tmp buffer whose inferred size is 0 may be missing
+void* TmpBufferPtr(user_op::Tensor* tmp_buffer) {
+  return tmp_buffer != nullptr ? tmp_buffer->mut_raw_dptr() : nullptr;
+}
+
+size_t TmpBufferSize(const user_op::Tensor* tmp_buffer) {
+  return tmp_buffer != nullptr ? tmp_buffer->shape().elem_cnt() : 0;
+}
+
+// GenConvCpuShape for tmp buffer sizes, x, y and weight are the shapes of the conv forward
+ConvCpuShape InferConvCpuShape(user_op::InferContext* ctx, const Shape& x_shape,
+                               const Shape& y_shape, const Shape& weight_shape) {
+  const std::string& data_format = ctx->Attr<std::string>("data_format");
+  const int32_t idx_offset = IdxOffset(data_format);
+  const int32_t channel_idx = ChannelIdx(data_format, x_shape.NumAxes());
+  const int32_t ndims = x_shape.NumAxes() - 2;
+  const auto& strides = ctx->Attr<std::vector<int32_t>>("strides");
+  const auto& dilation_rate = ctx->Attr<std::vector<int32_t>>("dilation_rate");
+  const auto& padding_before = ctx->Attr<std::vector<int32_t>>("padding_before");
+  ConvCpuShape shape{};
+  shape.batch_size = x_shape.At(0);
+  shape.in_channels = x_shape.At(channel_idx);
+  shape.out_channels = y_shape.At(channel_idx);
+  shape.groups = ctx->Attr<int32_t>("groups");
+  FOR_RANGE(int32_t, dim, 0, 3) {
+    // missing leading spatial dims are 1
+    const int32_t index = dim - (3 - ndims);
+    shape.in_size[dim] = index < 0 ? 1 : x_shape.At(idx_offset + index);
+    shape.out_size[dim] = index < 0 ? 1 : y_shape.At(idx_offset + index);
+    shape.kernel_size[dim] = index < 0 ? 1 : weight_shape.At(idx_offset + index);
+    shape.strides[dim] = index < 0 ? 1 : strides.at(index);
+    shape.dilation_rate[dim] = index < 0 ? 1 : dilation_rate.at(index);
+    shape.padding_before[dim] = index < 0 ? 0 : padding_before.at(index);
+  }
+  shape.channels_last = (idx_offset == 1);
+  return shape;
+}
+
+// ONEFLOW_CONV_CPU_WINOGRAD_OUTPUT_TILE opts 3x3 convs Winograd applies to into Winograd:
+// 0 or unset is im2col, 2 and 4 are Winograd F(2x2, 3x3) and F(4x4, 3x3), -1 picks by shape
+template<typename T>
+int32_t WinogradOutputTile(const ConvCpuShape& shape) {
+  static const int64_t output_tile =
+      ParseIntegerFromEnv("ONEFLOW_CONV_CPU_WINOGRAD_OUTPUT_TILE", 0);
+  if (output_tile < 0) { return ConvCpuKernelUtil<T>::WinogradOutputTileByHeuristic(shape); }
+  if (output_tile == 0 || !ConvCpuKernelUtil<T>::IsWinogradApplicable(shape)) { return 0; }
+  CHECK(output_tile == 2 || output_tile == 4)
+      << "ONEFLOW_CONV_CPU_WINOGRAD_OUTPUT_TILE should be -1, 0, 2 or 4, got " << output_tile;
+  return output_tile;
+}
+
+// Winograd keeps the transformed weight at the front of the tmp buffer, its block buffers follow
+template<typename T>
+size_t WinogradWeightByteSize(const ConvCpuShape& shape, int32_t output_tile) {
+  return ConvCpuKernelUtil<T>::WinogradWeightElemCnt(shape, output_tile) * sizeof(T);
+}
+
+template<typename T>
+size_t ConvForwardTmpBufferSize(const ConvCpuShape& shape) {
+  const int32_t output_tile = WinogradOutputTile<T>(shape);
+  if (output_tile > 0) {
+    return WinogradWeightByteSize<T>(shape, output_tile)
+           + ConvCpuKernelUtil<T>::WinogradTmpBufferSize(shape, output_tile);
+  }
+  return ConvCpuKernelUtil<T>::ForwardTmpBufferSize(shape);
+}
+
 template<typename T, size_t NDims>
 class ConvCpuKernel final : public user_op::OpKernel {
  public:
@@ -402,77 +213,45 @@ class ConvCpuKernel final : public user_op::OpKernel {
 
     const user_op::Tensor* in = ctx->Tensor4ArgNameAndIndex("in", 0);
     const user_op::Tensor* weight = ctx->Tensor4ArgNameAndIndex("weight", 0);
-    user_op::Tensor* tmp_buffer = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
+    const user_op::Tensor* bias = ctx->Tensor4ArgNameAndIndex("bias", 0);
     user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
+    user_op::Tensor* tmp_buffer = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
 
-    T* col_buf_dptr = tmp_buffer->mut_dptr<T>();
-
-    bool is_bias_mul_inited = false;
-    for (int64_t i = 0; i < in->shape().At(0); ++i) {
-      conv_state->im2col_func_(GetImgDptr<T>(in, i), ShapeView(conv_state->in_5d_shape_),
-                               ShapeView(conv_state->weight_5d_shape_),
-                               ShapeView(conv_state->out_5d_shape_), conv_state->strides_3d_.data(),
-                               conv_state->dilation_rate_3d_.data(),
-                               conv_state->padding_before_3d_.data(), col_buf_dptr);
-
-      // channels first: out = weight * col_buf
-      // channels last:  out = (weight * col_buf)(T)
-      int32_t idx_offset = conv_state->idx_offset_;
-      conv_state->forward_func_(
-          CblasNoTrans, CblasNoTrans,
-          conv_state->weight_5d_shape_.At(0),                           // filter
-          conv_state->out_5d_shape_.Count(idx_offset, idx_offset + 3),  // od * oh * ow
-          conv_state->weight_5d_shape_.Count(1),                        // ci * kd * kh * kw
-          static_cast<T>(1), weight->dptr<T>(), col_buf_dptr, static_cast<T>(0),
-          GetImgMutDptr<T>(out, i));
-
-      const user_op::Tensor* bias = ctx->Tensor4ArgNameAndIndex("bias", 0);
-      if (bias != nullptr) {
-        int64_t num_of_col_buf = CalcElemNumOfColBuf(out->shape(), weight->shape(), idx_offset);
-        int64_t num_of_bias_mul =
-            (tmp_buffer->shape().elem_cnt() - num_of_col_buf * sizeof(T)) / sizeof(T);
-        CHECK_GT(num_of_bias_mul, 0);
-        T* bias_mul_dptr = col_buf_dptr + num_of_col_buf;
-        if (!is_bias_mul_inited) {
-          InitBiasMulBuf(bias_mul_dptr, num_of_bias_mul);
-          is_bias_mul_inited = true;
-        }
-
-        // channels first:  out += bias * bias_mul
-        // channels last:   out += (bias * bias_mul)(T)
-        conv_state->forward_func_(
-            CblasNoTrans, CblasNoTrans,
-            conv_state->weight_5d_shape_.At(0),                           // filter
-            conv_state->out_5d_shape_.Count(idx_offset, idx_offset + 3),  // od * oh * ow
-            1,                                                            // 1
-            static_cast<T>(1), bias->dptr<T>(), bias_mul_dptr, static_cast<T>(1),
-            GetImgMutDptr<T>(out, i));
-      }
+    const ConvCpuShape shape = GenConvCpuShape(*conv_state, ctx->Attr<int32_t>("groups"));
+    const T* bias_ptr = bias != nullptr ? bias->dptr<T>() : nullptr;
+    const int32_t output_tile = WinogradOutputTile<T>(shape);
+    if (output_tile > 0) {
+      // The weight is transformed on every call. A kernel does not know whether its weight changed
+      // since the last one, and eager mode shares one kernel among all convs of a kind.
+      const size_t weight_byte_size = WinogradWeightByteSize<T>(shape, output_tile);
+      CHECK_NOTNULL(tmp_buffer);
+      CHECK_GE(TmpBufferSize(tmp_buffer), weight_byte_size);
+      T* transformed_weight = tmp_buffer->mut_dptr<T>();
+      ConvCpuKernelUtil<T>::WinogradTransformWeight(shape, output_tile, weight->dptr<T>(),
+                                                    transformed_weight);
+      ConvCpuKernelUtil<T>::ForwardByWinograd(
+          shape, output_tile, transformed_weight, in->dptr<T>(), bias_ptr, out->mut_dptr<T>(),
+          tmp_buffer->mut_dptr<char>() + weight_byte_size,
+          TmpBufferSize(tmp_buffer) - weight_byte_size);
+    } else {
+      ConvCpuKernelUtil<T>::Forward(shape, in->dptr<T>(), weight->dptr<T>(), bias_ptr,
+                                    out->mut_dptr<T>(), TmpBufferPtr(tmp_buffer),
+                                    TmpBufferSize(tmp_buffer));
     }
   }
 };
 
-#define REGISTER_CONV_KERNEL(op_name, dtype, ndims)                                         \
-  REGISTER_USER_KERNEL(#op_name)                                                            \
-      .SetCreateFn<ConvCpuKernel<dtype, ndims>>()                                           \
-      .SetIsMatchedHob((user_op::HobDeviceTag() == "cpu")                                   \
-                       & (user_op::HobAttr<int32_t>("groups") == 1)                         \
-                       & (user_op::HobDataType("in", 0) == GetDataType<dtype>::value))      \
-      .SetInferTmpSizeFn([](user_op::InferContext* ctx) -> size_t {                         \
-        size_t tmp_buffer_size = 0;                                                         \
-        const auto& out_shape = ctx->OutputTensorDesc("out", 0)->shape();                   \
-        const auto& weight_shape = ctx->InputTensorDesc("weight", 0).shape();               \
-                                                                                            \
-        int64_t idx_offset = IdxOffset(ctx->Attr<std::string>("data_format"));              \
-        tmp_buffer_size +=                                                                  \
-            CalcElemNumOfColBuf(out_shape, weight_shape, idx_offset) * sizeof(dtype);       \
-        bool has_bias = ctx->has_input("bias", 0);                                          \
-        if (has_bias) {                                                                     \
-          int64_t bias_mul_cnt = 1;                                                         \
-          for (int i = 0; i < ndims; ++i) { bias_mul_cnt *= out_shape.At(idx_offset + i); } \
-          tmp_buffer_size += bias_mul_cnt * sizeof(dtype);                                  \
-        }                                                                                   \
-        return tmp_buffer_size;                                                             \
+#define REGISTER_CONV_KERNEL(op_name, dtype, ndims)                                    \
+  REGISTER_USER_KERNEL(#op_name)                                                       \
+      .SetCreateFn<ConvCpuKernel<dtype, ndims>>()                                      \
+      .SetIsMatchedHob((user_op::HobDeviceTag() == "cpu")                              \
+                       & (user_op::HobDataType("in", 0) == GetDataType<dtype>::value)) \
+      .SetInferTmpSizeFn([](user_op::InferContext* ctx) -> size_t {                    \
+        const ConvCpuShape shape =                                                     \
+            InferConvCpuShape(ctx, ctx->InputTensorDesc("in", 0).shape(),              \
+                              ctx->OutputTensorDesc("out", 0)->shape(),                \
+                              ctx->InputTensorDesc("weight", 0).shape());              \
+        return ConvForwardTmpBufferSize<dtype>(shape);                                 \
       })
 
 REGISTER_CONV_KERNEL(conv1d, float, 1);
@@ -499,30 +278,11 @@ class ConvDataGradCpuKernel final : public user_op::OpKernel {
     const user_op::Tensor* dy = ctx->Tensor4ArgNameAndIndex("dy", 0);
     const user_op::Tensor* filter = ctx->Tensor4ArgNameAndIndex("filter", 0);
     user_op::Tensor* dx = ctx->Tensor4ArgNameAndIndex("dx", 0);
-    user_op::Tensor* col_buf = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
-
-    Memset<DeviceType::kCPU>(ctx->device_ctx(), dx->mut_dptr<T>(), 0,
-                             dx->shape().elem_cnt() * sizeof(T));
+    user_op::Tensor* tmp_buffer = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
 
-    int32_t idx_offset = conv_state->idx_offset_;
-    FOR_RANGE(int64_t, i, 0, dy->shape().At(0)) {
-      // channels first:  col_buf' = weight(T) * out[i]'
-      // channels last :  col_buf' = weight(T) * out[i]'(T)
-      NewKernelUtil<DeviceType::kCPU>::OFGemm(
-          nullptr, CblasTrans, conv_state->is_out_diff_need_trans_,
-          conv_state->weight_5d_shape_.Count(1),                        //  ci * kd * kh * kw
-          conv_state->out_5d_shape_.Count(idx_offset, idx_offset + 3),  //  od * oh * ow
-          conv_state->weight_5d_shape_.At(0),                           //  filter
-          static_cast<T>(1), filter->dptr<T>(), GetImgDptr<T>(dy, i), static_cast<T>(0),
-          col_buf->mut_dptr<T>());
-
-      // in' = col2im(col_buf')
-      conv_state->col2im_func_(col_buf->dptr<T>(), ShapeView(conv_state->in_5d_shape_),
-                               ShapeView(conv_state->weight_5d_shape_),
-                               ShapeView(conv_state->out_5d_shape_), conv_state->strides_3d_.data(),
-                               conv_state->dilation_rate_3d_.data(),
-                               conv_state->padding_before_3d_.data(), GetImgMutDptr<T>(dx, i));
-    }
+    const ConvCpuShape shape = GenConvCpuShape(*conv_state, ctx->Attr<int32_t>("groups"));
+    ConvCpuKernelUtil<T>::DataBackward(shape, dy->dptr<T>(), filter->dptr<T>(), dx->mut_dptr<T>(),
+                                       TmpBufferPtr(tmp_buffer), TmpBufferSize(tmp_buffer));
     if (ctx->has_input("_add_to_output", 0)) {
       const user_op::Tensor* add_to_output = ctx->Tensor4ArgNameAndIndex("_add_to_output", 0);
       CHECK_EQ(add_to_output->data_type(), dx->data_type());
@@ -534,21 +294,17 @@ class ConvDataGradCpuKernel final : public user_op::OpKernel {
   }
 };
 
-#define REGISTER_CONV_DATA_GRAD_KERNEL(op_name, dtype)                                     \
-  REGISTER_USER_KERNEL(#op_name)                                                           \
-      .SetCreateFn<ConvDataGradCpuKernel<dtype>>()                                         \
-      .SetIsMatchedHob((user_op::HobDeviceTag() == "cpu")                                  \
-                       & (user_op::HobAttr<int32_t>("groups") == 1)                        \
-                       & (user_op::HobDataType("dy", 0) == GetDataType<dtype>::value))     \
-      .SetInferTmpSizeFn([](user_op::InferContext* ctx) -> size_t {                        \
-        size_t tmp_buffer_size = 0;                                                        \
-        const auto& out_diff_shape = ctx->InputTensorDesc("dy", 0).shape();                \
-        const auto& weight_shape = ctx->InputTensorDesc("filter", 0).shape();              \
-                                                                                           \
-        int64_t idx_offset = IdxOffset(ctx->Attr<std::string>("data_format"));             \
-        tmp_buffer_size +=                                                                 \
-            CalcElemNumOfColBuf(out_diff_shape, weight_shape, idx_offset) * sizeof(dtype); \
-        return tmp_buffer_size;                                                            \
+#define REGISTER_CONV_DATA_GRAD_KERNEL(op_name, dtype)                                 \
+  REGISTER_USER_KERNEL(#op_name)                                                       \
+      .SetCreateFn<ConvDataGradCpuKernel<dtype>>()                                     \
+      .SetIsMatchedHob((user_op::HobDeviceTag() == "cpu")                              \
+                       & (user_op::HobDataType("dy", 0) == GetDataType<dtype>::value)) \
+      .SetInferTmpSizeFn([](user_op::InferContext* ctx) -> size_t {                    \
+        const ConvCpuShape shape =                                                     \
+            InferConvCpuShape(ctx, ctx->OutputTensorDesc("dx", 0)->shape(),            \
+                              ctx->InputTensorDesc("dy", 0).shape(),                   \
+                              ctx->InputTensorDesc("filter", 0).shape());              \
+        return ConvCpuKernelUtil<dtype>::DataBackwardTmpBufferSize(shape);             \
       })
 
 REGISTER_CONV_DATA_GRAD_KERNEL(conv_data_grad, float);
@@ -571,46 +327,26 @@ class ConvFilterGradCpuKernel final : public user_op::OpKernel {
     const user_op::Tensor* dy = ctx->Tensor4ArgNameAndIndex("dy", 0);
     const user_op::Tensor* x = ctx->Tensor4ArgNameAndIndex("x", 0);
     user_op::Tensor* filter_diff = ctx->Tensor4ArgNameAndIndex("filter_diff", 0);
-    user_op::Tensor* col_buf = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
+    user_op::Tensor* tmp_buffer = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
 
-    Memset<DeviceType::kCPU>(ctx->device_ctx(), filter_diff->mut_dptr<T>(), 0,
-                             filter_diff->shape().elem_cnt() * sizeof(T));
-    int32_t idx_offset = conv_state->idx_offset_;
-    FOR_RANGE(int64_t, i, 0, dy->shape().At(0)) {
-      conv_state->im2col_func_(GetImgDptr<T>(x, i), ShapeView(conv_state->in_5d_shape_),
-                               ShapeView(conv_state->weight_5d_shape_),
-                               ShapeView(conv_state->out_5d_shape_), conv_state->strides_3d_.data(),
-                               conv_state->dilation_rate_3d_.data(),
-                               conv_state->padding_before_3d_.data(), col_buf->mut_dptr<T>());
-
-      // channels first:  weight' += out[i]' * col_buf(T)
-      // channels last :  weight' += out[i]'(T) * col_buf(T)
-      NewKernelUtil<DeviceType::kCPU>::OFGemm(
-          nullptr, conv_state->is_out_diff_need_trans_, CblasTrans,
-          conv_state->weight_5d_shape_.At(0),                           //  filter
-          conv_state->weight_5d_shape_.Count(1),                        //  ci * kd * kh * kw
-          conv_state->out_5d_shape_.Count(idx_offset, idx_offset + 3),  //  od * oh * ow
-          static_cast<T>(1), GetImgDptr<T>(dy, i), col_buf->dptr<T>(), static_cast<T>(1),
-          filter_diff->mut_dptr<T>());
-    }
+    const ConvCpuShape shape = GenConvCpuShape(*conv_state, ctx->Attr<int32_t>("groups"));
+    ConvCpuKernelUtil<T>::FilterBackward(shape, x->dptr<T>(), dy->dptr<T>(),
+                                         filter_diff->mut_dptr<T>(), TmpBufferPtr(tmp_buffer),
+                                         TmpBufferSize(tmp_buffer));
   }
 };
 
-#define REGISTER_CONV_FILTER_GRAD_KERNEL(op_name, dtype)                                        \
-  REGISTER_USER_KERNEL(#op_name)                                                                \
-      .SetCreateFn<ConvFilterGradCpuKernel<dtype>>()                                            \
-      .SetIsMatchedHob((user_op::HobDeviceTag() == "cpu")                                       \
-                       & (user_op::HobAttr<int32_t>("groups") == 1)                             \
-                       & (user_op::HobDataType("dy", 0) == GetDataType<dtype>::value))          \
-      .SetInferTmpSizeFn([](user_op::InferContext* ctx) -> size_t {                             \
-        size_t tmp_buffer_size = 0;                                                             \
-        const auto& out_diff_shape = ctx->InputTensorDesc("dy", 0).shape();                     \
-        const auto& weight_diff_shape = ctx->OutputTensorDesc("filter_diff", 0)->shape();       \
-                                                                                                \
-        int64_t idx_offset = IdxOffset(ctx->Attr<std::string>("data_format"));                  \
-        tmp_buffer_size +=                                                                      \
-            CalcElemNumOfColBuf(out_diff_shape, weight_diff_shape, idx_offset) * sizeof(dtype); \
-        return tmp_buffer_size;                                                                 \
+#define REGISTER_CONV_FILTER_GRAD_KERNEL(op_name, dtype)                               \
+  REGISTER_USER_KERNEL(#op_name)                                                       \
+      .SetCreateFn<ConvFilterGradCpuKernel<dtype>>()                                   \
+      .SetIsMatchedHob((user_op::HobDeviceTag() == "cpu")                              \
+                       & (user_op::HobDataType("dy", 0) == GetDataType<dtype>::value)) \
+      .SetInferTmpSizeFn([](user_op::InferContext* ctx) -> size_t {                    \
+        const ConvCpuShape shape =                                                     \
+            InferConvCpuShape(ctx, ctx->InputTensorDesc("x", 0).shape(),               \
+                              ctx->InputTensorDesc("dy", 0).shape(),                   \
+                              ctx->OutputTensorDesc("filter_diff", 0)->shape());       \
+        return ConvCpuKernelUtil<dtype>::FilterBackwardTmpBufferSize(shape);           \
       })
 
 REGISTER_CONV_FILTER_GRAD_KERNEL(conv_filter_grad, float);
@@ -13,6 +13,7 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 */
+#include "oneflow/core/common/container_util.h"
 #include "oneflow/core/framework/framework.h"
 #include "oneflow/core/ccl/ccl.h"
 #include "oneflow/core/job/parallel_desc.h"
@@ -71,4 +72,130 @@ REGISTER_USER_KERNEL("eager_nccl_broadcast")
     .SetCreateFn<EagerCclBroadcastKernel>()
     .SetIsMatchedHob(user_op::HobDeviceTag() == "cpu");
 
+class EagerCclAllReduceKernel final : public user_op::OpKernel {
+ public:
+  EagerCclAllReduceKernel() = default;
+  ~EagerCclAllReduceKernel() override = default;
+
+  std::shared_ptr<user_op::OpKernelState> CreateOpKernelState(
+      user_op::KernelInitContext* ctx) const override {
+    return std::make_shared<EagerCclOpKernelState>(ctx);
+  }
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx, user_op::OpKernelState* state) const override {
+    auto* kernel_state = dynamic_cast<EagerCclOpKernelState*>(state);
+    CHECK(kernel_state != nullptr);
+    const user_op::Tensor* in = ctx->Tensor4ArgNameAndIndex("in", 0);
+    user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
+    CHECK_EQ(in->shape(), out->shape());
+    CHECK_EQ(in->data_type(), out->data_type());
+    CHECK_JUST(ccl::AllReduce<DeviceType::kCPU>(
+        in->dptr(), out->mut_dptr(), in->shape().elem_cnt(), in->data_type(), ccl::kSum,
+        kernel_state->parallel_desc(), ctx->device_ctx()));
+  };
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+REGISTER_USER_KERNEL("eager_nccl_all_reduce")
+    .SetCreateFn<EagerCclAllReduceKernel>()
+    .SetIsMatchedHob(user_op::HobDeviceTag() == "cpu");
+
+class EagerCclReduceKernel final : public user_op::OpKernel {
+ public:
+  EagerCclReduceKernel() = default;
+  ~EagerCclReduceKernel() override = default;
+
+  std::shared_ptr<user_op::OpKernelState> CreateOpKernelState(
+      user_op::KernelInitContext* ctx) const override {
+    return std::make_shared<EagerCclOpKernelState>(ctx);
+  }
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx, user_op::OpKernelState* state) const override {
+    auto* kernel_state = dynamic_cast<EagerCclOpKernelState*>(state);
+    CHECK(kernel_state != nullptr);
+    const user_op::Tensor* in = ctx->Tensor4ArgNameAndIndex("in", 0);
+    user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
+    CHECK_EQ(in->shape(), out->shape());
+    CHECK_EQ(in->data_type(), out->data_type());
+    int64_t root = ctx->Attr<int64_t>("root");
+    CHECK_JUST(ccl::Reduce<DeviceType::kCPU>(in->dptr(), out->mut_dptr(), in->shape().elem_cnt(),
+                                             in->data_type(), ccl::kSum, root,
+                                             kernel_state->parallel_desc(), ctx->device_ctx()));
+  };
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+REGISTER_USER_KERNEL("eager_nccl_reduce")
+    .SetCreateFn<EagerCclReduceKernel>()
+    .SetIsMatchedHob(user_op::HobDeviceTag() == "cpu");
+
+class EagerCclReduceScatterKernel final : public user_op::OpKernel {
+ public:
+  EagerCclReduceScatterKernel() = default;
+  ~EagerCclReduceScatterKernel() override = default;
+
+  std::shared_ptr<user_op::OpKernelState> CreateOpKernelState(
+      user_op::KernelInitContext* ctx) const override {
+    return std::make_shared<EagerCclOpKernelState>(ctx);
+  }
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx, user_op::OpKernelState* state) const override {
+    auto* kernel_state = dynamic_cast<EagerCclOpKernelState*>(state);
+    CHECK(kernel_state != nullptr);
+    const user_op::Tensor* in = ctx->Tensor4ArgNameAndIndex("in", 0);
+    user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
+    CHECK_EQ(in->shape().elem_cnt(),
+             out->shape().elem_cnt() * kernel_state->parallel_desc()->parallel_num());
+    CHECK_EQ(in->data_type(), out->data_type());
+    const auto& op_type = ctx->Attr<std::string>("op_type");
+    CHECK_JUST(ccl::ReduceScatter<DeviceType::kCPU>(
+        in->dptr(), out->mut_dptr(), out->shape().elem_cnt(), in->data_type(),
+        CHECK_JUST(MapAt(op_type2reduce_type, op_type)), kernel_state->parallel_desc(),
+        ctx->device_ctx()));
+  };
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+
+  static HashMap<std::string, ccl::ReduceType> op_type2reduce_type;
+};
+
+HashMap<std::string, ccl::ReduceType> EagerCclReduceScatterKernel::op_type2reduce_type = {
+    {"sum", ccl::kSum}, {"max", ccl::kMax}};
+
+REGISTER_USER_KERNEL("eager_nccl_reduce_scatter")
+    .SetCreateFn<EagerCclReduceScatterKernel>()
+    .SetIsMatchedHob(user_op::HobDeviceTag() == "cpu");
+
+class EagerCclAllGatherKernel final : public user_op::OpKernel {
+ public:
+  EagerCclAllGatherKernel() = default;
+  ~EagerCclAllGatherKernel() override = default;
+
+  std::shared_ptr<user_op::OpKernelState> CreateOpKernelState(
+      user_op::KernelInitContext* ctx) const override {
+    return std::make_shared<EagerCclOpKernelState>(ctx);
+  }
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx, user_op::OpKernelState* state) const override {
+    auto* kernel_state = dynamic_cast<EagerCclOpKernelState*>(state);
+    CHECK(kernel_state != nullptr);
+    const user_op::Tensor* in = ctx->Tensor4ArgNameAndIndex("in", 0);
+    user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
+    CHECK_EQ(in->shape().elem_cnt() * kernel_state->parallel_desc()->parallel_num(),
+             out->shape().elem_cnt());
+    CHECK_EQ(in->data_type(), out->data_type());
+    CHECK_JUST(ccl::AllGather<DeviceType::kCPU>(in->dptr(), out->mut_dptr(),
+                                                in->shape().elem_cnt(), in->data_type(),
+                                                kernel_state->parallel_desc(), ctx->device_ctx()));
+  };
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+REGISTER_USER_KERNEL("eager_nccl_all_gather")
+    .SetCreateFn<EagerCclAllGatherKernel>()
+    .SetIsMatchedHob(user_op::HobDeviceTag() == "cpu");
+
 }  // namespace oneflow
@@ -18,6 +18,7 @@ limitations under the License.
 #include "oneflow/core/framework/framework.h"
 
 #include "oneflow/core/common/data_type.h"
+#include "oneflow/core/cpu/elementwise.h"
 
 namespace oneflow {
 template<DeviceType device_type, typename FunctorT, typename OutputT, typename InputA>
@@ -30,7 +31,7 @@ template<typename FunctorT, typename OutputT, typename InputA>
 struct UnaryElemwiseXpuLauncher<DeviceType::kCPU, FunctorT, OutputT, InputA> final {
   void operator()(DeviceCtx* ctx, int64_t elem_cnt, OutputT* out, const InputA* input_a,
                   FunctorT functor) {
-    FOR_RANGE(int64_t, i, 0, elem_cnt) { out[i] = functor(input_a[i]); }
+    cpu::elementwise::Unary(functor, elem_cnt, out, input_a);
   }
 };
 
@@ -45,7 +46,7 @@ template<typename FunctorT, typename OutputT, typename InputA, typename InputB>
 struct BinaryElemwiseXpuLauncher<DeviceType::kCPU, FunctorT, OutputT, InputA, InputB> final {
   void operator()(DeviceCtx* ctx, int64_t elem_cnt, OutputT* out, const InputA* input_a,
                   const InputB* input_b, FunctorT functor) {
-    FOR_RANGE(int64_t, i, 0, elem_cnt) { out[i] = functor(input_a[i], input_b[i]); }
+    cpu::elementwise::Binary(functor, elem_cnt, out, input_a, input_b);
   }
 };
 
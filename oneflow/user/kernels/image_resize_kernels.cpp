@@ -138,38 +138,40 @@ class ImageResizeToFixedSizeKernel final : public user_op::OpKernel {
     CHECK_EQ(scale_tensor->shape().At(0), batch_size);
     CHECK_EQ(scale_tensor->shape().At(1), 2);
 
-    MultiThreadLoop(batch_size, [&](size_t i) {
-      const TensorBuffer& in_buffer = in_tensor->dptr<TensorBuffer>()[i];
-      CHECK_EQ(in_buffer.shape().NumAxes(), 3);
-      const int64_t origin_height = in_buffer.shape().At(0);
-      const int64_t origin_width = in_buffer.shape().At(1);
-      CHECK_EQ(in_buffer.shape().At(2), channels);
-      DataType dtype = ctx->Attr<DataType>("data_type");
-      int interp_flag = GetCvInterpolationFlag(ctx->Attr<std::string>("interpolation_type"),
-                                               origin_width, origin_height, res_w, res_h);
-
-      const cv::Mat in_img_mat = GenCvMat4ImageBuffer(in_buffer);
-      cv::Mat out_img_mat = GenCvMat4ImageTensor(out_tensor, i);
-      if (in_buffer.data_type() == dtype) {
-        cv::resize(in_img_mat, out_img_mat, cv::Size(res_w, res_h), 0, 0, interp_flag);
-      } else {
-        cv::Mat res_img_mat;
-        cv::resize(in_img_mat, res_img_mat, cv::Size(res_w, res_h), 0, 0, interp_flag);
-        CvMatConvertToDataType(res_img_mat, &out_img_mat, dtype);
-      }
-
-      char* cur_out_dptr =
-          out_tensor->mut_dptr<char>() + i * elem_cnt_per_img * GetSizeOfDataType(dtype);
-      CHECK(out_img_mat.isContinuous());
-      CHECK_EQ(out_img_mat.ptr<void>(), static_cast<void*>(cur_out_dptr));
-      CHECK_EQ(out_img_mat.cols, res_w);
-      CHECK_EQ(out_img_mat.rows, res_h);
-      CHECK_EQ(out_img_mat.channels(), channels);
-
-      if (scale_tensor) {
-        float* scale_dptr = scale_tensor->mut_dptr<float>() + i * 2;
-        scale_dptr[0] = static_cast<float>(res_w) / static_cast<float>(origin_width);
-        scale_dptr[1] = static_cast<float>(res_h) / static_cast<float>(origin_height);
+    ParallelFor(batch_size, 1, ParallelForSchedule::kDynamic, [&](size_t begin, size_t end) {
+      FOR_RANGE(size_t, i, begin, end) {
+        const TensorBuffer& in_buffer = in_tensor->dptr<TensorBuffer>()[i];
+        CHECK_EQ(in_buffer.shape().NumAxes(), 3);
+        const int64_t origin_height = in_buffer.shape().At(0);
+        const int64_t origin_width = in_buffer.shape().At(1);
+        CHECK_EQ(in_buffer.shape().At(2), channels);
+        DataType dtype = ctx->Attr<DataType>("data_type");
+        int interp_flag = GetCvInterpolationFlag(ctx->Attr<std::string>("interpolation_type"),
+                                                 origin_width, origin_height, res_w, res_h);
+
+        const cv::Mat in_img_mat = GenCvMat4ImageBuffer(in_buffer);
+        cv::Mat out_img_mat = GenCvMat4ImageTensor(out_tensor, i);
+        if (in_buffer.data_type() == dtype) {
+          cv::resize(in_img_mat, out_img_mat, cv::Size(res_w, res_h), 0, 0, interp_flag);
+        } else {
+          cv::Mat res_img_mat;
+          cv::resize(in_img_mat, res_img_mat, cv::Size(res_w, res_h), 0, 0, interp_flag);
+          CvMatConvertToDataType(res_img_mat, &out_img_mat, dtype);
+        }
+
+        char* cur_out_dptr =
+            out_tensor->mut_dptr<char>() + i * elem_cnt_per_img * GetSizeOfDataType(dtype);
+        CHECK(out_img_mat.isContinuous());
+        CHECK_EQ(out_img_mat.ptr<void>(), static_cast<void*>(cur_out_dptr));
+        CHECK_EQ(out_img_mat.cols, res_w);
+        CHECK_EQ(out_img_mat.rows, res_h);
+        CHECK_EQ(out_img_mat.channels(), channels);
+
+        if (scale_tensor) {
+          float* scale_dptr = scale_tensor->mut_dptr<float>() + i * 2;
+          scale_dptr[0] = static_cast<float>(res_w) / static_cast<float>(origin_width);
+          scale_dptr[1] = static_cast<float>(res_h) / static_cast<float>(origin_height);
+        }
       }
     });
   }
@@ -202,21 +204,23 @@ class ImageResizeKeepAspectRatioKernel final : public user_op::OpKernel {
     const int32_t max_size = ctx->Attr<int32_t>("max_size");
     const std::string& interp_type = ctx->Attr<std::string>("interpolation_type");
 
-    MultiThreadLoop(num_images, [&](size_t i) {
-      ImageTargetResize(in_img_buf[i], out_img_buf + i, resize_longer, target_size, min_size,
-                        max_size, interp_type);
-      const int64_t org_h = in_img_buf[i].shape().At(0);
-      const int64_t org_w = in_img_buf[i].shape().At(1);
-      const int64_t res_h = out_img_buf[i].shape().At(0);
-      const int64_t res_w = out_img_buf[i].shape().At(1);
-
-      scale_buf[i].Resize(Shape({2}), DataType::kFloat);
-      scale_buf[i].mut_data<float>()[0] = static_cast<float>(res_w) / static_cast<float>(org_w);
-      scale_buf[i].mut_data<float>()[1] = static_cast<float>(res_h) / static_cast<float>(org_h);
-
-      size_buf[i].Resize(Shape({2}), DataType::kInt32);
-      size_buf[i].mut_data<int32_t>()[0] = static_cast<int32_t>(res_w);
-      size_buf[i].mut_data<int32_t>()[1] = static_cast<int32_t>(res_h);
+    ParallelFor(num_images, 1, ParallelForSchedule::kDynamic, [&](size_t begin, size_t end) {
+      FOR_RANGE(size_t, i, begin, end) {
+        ImageTargetResize(in_img_buf[i], out_img_buf + i, resize_longer, target_size, min_size,
+                          max_size, interp_type);
+        const int64_t org_h = in_img_buf[i].shape().At(0);
+        const int64_t org_w = in_img_buf[i].shape().At(1);
+        const int64_t res_h = out_img_buf[i].shape().At(0);
+        const int64_t res_w = out_img_buf[i].shape().At(1);
+
+        scale_buf[i].Resize(Shape({2}), DataType::kFloat);
+        scale_buf[i].mut_data<float>()[0] = static_cast<float>(res_w) / static_cast<float>(org_w);
+        scale_buf[i].mut_data<float>()[1] = static_cast<float>(res_h) / static_cast<float>(org_h);
+
+        size_buf[i].Resize(Shape({2}), DataType::kInt32);
+        size_buf[i].mut_data<int32_t>()[0] = static_cast<int32_t>(res_w);
+        size_buf[i].mut_data<int32_t>()[1] = static_cast<int32_t>(res_h);
+      }
     });
   }
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
@@ -0,0 +1,252 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/layer_norm_cpu_kernel_util.h"
+#include "oneflow/core/thread/thread_manager.h"
+#include "oneflow/core/thread/thread_pool.h"
+
+namespace oneflow {
+
+namespace {
+
+// each lane runs an independent Welford over a strided subset of the row so that the inner loop
+// shares one reciprocal and can be vectorized
+constexpr int64_t kWelfordLanes = 8;
+
+template<typename T>
+void WelfordMeanAndVariance(int64_t n, const T* x, T* mean, T* variance) {
+  T lane_mean[kWelfordLanes] = {0};
+  T lane_m2[kWelfordLanes] = {0};
+  const int64_t vec_n = n / kWelfordLanes * kWelfordLanes;
+  int64_t lane_cnt = 0;
+  for (int64_t i = 0; i < vec_n; i += kWelfordLanes) {
+    lane_cnt += 1;
+    const T inv_cnt = static_cast<T>(1) / static_cast<T>(lane_cnt);
+    for (int64_t l = 0; l < kWelfordLanes; ++l) {
+      const T val = x[i + l];
+      const T delta = val - lane_mean[l];
+      lane_mean[l] += delta * inv_cnt;
+      lane_m2[l] += delta * (val - lane_mean[l]);
+    }
+  }
+  T row_mean = 0;
+  T row_m2 = 0;
+  int64_t row_cnt = 0;
+  if (lane_cnt > 0) {
+    // all lanes have the same count, so the merged mean is the plain average of lane means
+    for (int64_t l = 0; l < kWelfordLanes; ++l) { row_mean += lane_mean[l]; }
+    row_mean /= static_cast<T>(kWelfordLanes);
+    for (int64_t l = 0; l < kWelfordLanes; ++l) {
+      const T delta = lane_mean[l] - row_mean;
+      row_m2 += lane_m2[l] + delta * delta * static_cast<T>(lane_cnt);
+    }
+    row_cnt = vec_n;
+  }
+  for (int64_t i = vec_n; i < n; ++i) {
+    row_cnt += 1;
+    const T delta = x[i] - row_mean;
+    row_mean += delta / static_cast<T>(row_cnt);
+    row_m2 += delta * (x[i] - row_mean);
+  }
+  *mean = row_mean;
+  *variance = row_m2 / static_cast<T>(n);
+}
+
+template<typename T, bool scale, bool center>
+void ForwardRows(int64_t begin, int64_t end, int64_t norm_size, T epsilon, const T* x,
+                 const T* gamma, const T* beta, T* normalized, T* y, T* mean, T* inv_variance) {
+  FOR_RANGE(int64_t, i, begin, end) {
+    const int64_t offset = i * norm_size;
+    const T* row_x = x + offset;
+    T row_mean;
+    T row_variance;
+    WelfordMeanAndVariance<T>(norm_size, row_x, &row_mean, &row_variance);
+    const T row_inv_variance = static_cast<T>(1) / std::sqrt(row_variance + epsilon);
+    mean[i] = row_mean;
+    inv_variance[i] = row_inv_variance;
+    T* row_normalized = normalized + offset;
+    T* row_y = y + offset;
+    for (int64_t j = 0; j < norm_size; ++j) {
+      const T normalized_val = (row_x[j] - row_mean) * row_inv_variance;
+      if (scale) { row_normalized[j] = normalized_val; }
+      T y_val = normalized_val;
+      if (scale) { y_val *= gamma[j]; }
+      if (center) { y_val += beta[j]; }
+      row_y[j] = y_val;
+    }
+  }
+}
+
+template<typename T, bool scale, bool center>
+void ScaleCenterRows(int64_t begin, int64_t end, int64_t instance_size, const T* in,
+                     const T* gamma, const T* beta, T* y) {
+  FOR_RANGE(int64_t, i, begin, end) {
+    const T* row_in = in + i * instance_size;
+    T* row_y = y + i * instance_size;
+    for (int64_t j = 0; j < instance_size; ++j) {
+      T y_val = row_in[j];
+      if (scale) { y_val *= gamma[j]; }
+      if (center) { y_val += beta[j]; }
+      row_y[j] = y_val;
+    }
+  }
+}
+
+}  // namespace
+
+template<typename T>
+void LayerNormCpuKernelUtil<T>::Forward(int64_t num_instances, int64_t norm_size, double epsilon,
+                                        const T* x, const T* gamma, const T* beta, T* normalized,
+                                        T* y, T* mean, T* inv_variance) {
+  if (num_instances == 0 || norm_size == 0) { return; }
+  const T eps = static_cast<T>(epsilon);
+  ParallelFor(num_instances, GetRowGrainSize(norm_size), ParallelForSchedule::kStatic,
+              [&](size_t begin, size_t end) {
+                if (gamma != nullptr && beta != nullptr) {
+                  ForwardRows<T, true, true>(begin, end, norm_size, eps, x, gamma, beta,
+                                             normalized, y, mean, inv_variance);
+                } else if (gamma != nullptr) {
+                  ForwardRows<T, true, false>(begin, end, norm_size, eps, x, gamma, beta,
+                                              normalized, y, mean, inv_variance);
+                } else if (beta != nullptr) {
+                  ForwardRows<T, false, true>(begin, end, norm_size, eps, x, gamma, beta,
+                                              normalized, y, mean, inv_variance);
+                } else {
+                  ForwardRows<T, false, false>(begin, end, norm_size, eps, x, gamma, beta,
+                                               normalized, y, mean, inv_variance);
+                }
+              });
+}
+
+template<typename T>
+void LayerNormCpuKernelUtil<T>::ScaleCenter(int64_t batch_size, int64_t instance_size,
+                                            const T* in, const T* gamma, const T* beta, T* y) {
+  if (batch_size == 0 || instance_size == 0) { return; }
+  ParallelFor(batch_size, GetRowGrainSize(instance_size), ParallelForSchedule::kStatic,
+              [&](size_t begin, size_t end) {
+                if (gamma != nullptr && beta != nullptr) {
+                  ScaleCenterRows<T, true, true>(begin, end, instance_size, in, gamma, beta, y);
+                } else if (gamma != nullptr) {
+                  ScaleCenterRows<T, true, false>(begin, end, instance_size, in, gamma, beta, y);
+                } else if (beta != nullptr) {
+                  ScaleCenterRows<T, false, true>(begin, end, instance_size, in, gamma, beta, y);
+                } else {
+                  ScaleCenterRows<T, false, false>(begin, end, instance_size, in, gamma, beta, y);
+                }
+              });
+}
+
+template<typename T>
+void LayerNormCpuKernelUtil<T>::Backward(int64_t num_instances, int64_t norm_size, const T* dy,
+                                         const T* x, const T* mean, const T* inv_variance,
+                                         const T* add_to_output, T* dx) {
+  if (num_instances == 0 || norm_size == 0) { return; }
+  const T inv_norm_size = static_cast<T>(1) / static_cast<T>(norm_size);
+  // dx = inv_variance * (dy - mean(dy) - normalized * mean(dy * normalized))
+  ParallelFor(num_instances, GetRowGrainSize(norm_size), ParallelForSchedule::kStatic,
+              [&](size_t begin, size_t end) {
+                FOR_RANGE(int64_t, i, begin, end) {
+                  const int64_t offset = i * norm_size;
+                  const T* row_dy = dy + offset;
+                  const T* row_x = x + offset;
+                  const T row_mean = mean[i];
+                  const T row_inv_variance = inv_variance[i];
+                  T sum_dy = 0;
+                  T sum_dy_normalized = 0;
+                  for (int64_t j = 0; j < norm_size; ++j) {
+                    sum_dy += row_dy[j];
+                    sum_dy_normalized += row_dy[j] * (row_x[j] - row_mean) * row_inv_variance;
+                  }
+                  const T mean_dy = sum_dy * inv_norm_size;
+                  const T mean_dy_normalized = sum_dy_normalized * inv_norm_size;
+                  T* row_dx = dx + offset;
+                  if (add_to_output != nullptr) {
+                    const T* row_add = add_to_output + offset;
+                    for (int64_t j = 0; j < norm_size; ++j) {
+                      const T normalized = (row_x[j] - row_mean) * row_inv_variance;
+                      row_dx[j] = row_add[j]
+                                  + row_inv_variance
+                                        * (row_dy[j] - mean_dy - normalized * mean_dy_normalized);
+                    }
+                  } else {
+                    for (int64_t j = 0; j < norm_size; ++j) {
+                      const T normalized = (row_x[j] - row_mean) * row_inv_variance;
+                      row_dx[j] = row_inv_variance
+                                  * (row_dy[j] - mean_dy - normalized * mean_dy_normalized);
+                    }
+                  }
+                }
+              });
+}
+
+template<typename T>
+void LayerNormCpuKernelUtil<T>::ParamBackward(int64_t batch_size, int64_t instance_size,
+                                              const T* dy, const T* normalized, const T* gamma,
+                                              T* gamma_diff, T* beta_diff, T* normalized_diff) {
+  if (instance_size == 0) { return; }
+  // rows are split into one part per thread, every part accumulates its own partial gamma_diff
+  // and beta_diff which are summed up in part order at the end, so the result is deterministic
+  const int64_t num_parts = std::max<int64_t>(
+      std::min<int64_t>(batch_size, Global<ThreadPool>::Get()->thread_num()), 1);
+  std::vector<T> gamma_diff_parts(gamma_diff != nullptr ? num_parts * instance_size : 0, 0);
+  std::vector<T> beta_diff_parts(beta_diff != nullptr ? num_parts * instance_size : 0, 0);
+  ParallelFor(num_parts, 1, ParallelForSchedule::kStatic, [&](size_t begin, size_t end) {
+    FOR_RANGE(int64_t, part_id, begin, end) {
+      const int64_t row_begin = batch_size * part_id / num_parts;
+      const int64_t row_end = batch_size * (part_id + 1) / num_parts;
+      T* part_gamma_diff =
+          gamma_diff != nullptr ? gamma_diff_parts.data() + part_id * instance_size : nullptr;
+      T* part_beta_diff =
+          beta_diff != nullptr ? beta_diff_parts.data() + part_id * instance_size : nullptr;
+      FOR_RANGE(int64_t, i, row_begin, row_end) {
+        const int64_t offset = i * instance_size;
+        const T* row_dy = dy + offset;
+        if (part_gamma_diff != nullptr) {
+          const T* row_normalized = normalized + offset;
+          for (int64_t j = 0; j < instance_size; ++j) {
+            part_gamma_diff[j] += row_dy[j] * row_normalized[j];
+          }
+        }
+        if (part_beta_diff != nullptr) {
+          for (int64_t j = 0; j < instance_size; ++j) { part_beta_diff[j] += row_dy[j]; }
+        }
+        if (normalized_diff != nullptr) {
+          T* row_normalized_diff = normalized_diff + offset;
+          if (gamma != nullptr) {
+            for (int64_t j = 0; j < instance_size; ++j) {
+              row_normalized_diff[j] = row_dy[j] * gamma[j];
+            }
+          } else {
+            std::copy(row_dy, row_dy + instance_size, row_normalized_diff);
+          }
+        }
+      }
+    }
+  });
+  const auto ReduceParts = [&](const std::vector<T>& parts, T* out) {
+    std::copy(parts.begin(), parts.begin() + instance_size, out);
+    FOR_RANGE(int64_t, part_id, 1, num_parts) {
+      const T* part = parts.data() + part_id * instance_size;
+      for (int64_t j = 0; j < instance_size; ++j) { out[j] += part[j]; }
+    }
+  };
+  if (gamma_diff != nullptr) { ReduceParts(gamma_diff_parts, gamma_diff); }
+  if (beta_diff != nullptr) { ReduceParts(beta_diff_parts, beta_diff); }
+}
+
+template struct LayerNormCpuKernelUtil<float>;
+template struct LayerNormCpuKernelUtil<double>;
+
+}  // namespace oneflow
@@ -0,0 +1,47 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_KERNELS_LAYER_NORM_CPU_KERNEL_UTIL_H_
+#define ONEFLOW_USER_KERNELS_LAYER_NORM_CPU_KERNEL_UTIL_H_
+
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+
+// Row-wise LayerNorm on host memory. Every row of norm_size elements is handled by a single
+// thread in one Welford pass, rows are spread over Global<ThreadPool>.
+template<typename T>
+struct LayerNormCpuKernelUtil {
+  // gamma and beta are nullable and have norm_size elements, normalized may be the same as y when
+  // gamma is null
+  static void Forward(int64_t num_instances, int64_t norm_size, double epsilon, const T* x,
+                      const T* gamma, const T* beta, T* normalized, T* y, T* mean,
+                      T* inv_variance);
+  // y = in * gamma + beta row by row, gamma and beta are nullable and have instance_size elements
+  static void ScaleCenter(int64_t batch_size, int64_t instance_size, const T* in, const T* gamma,
+                          const T* beta, T* y);
+  // dy is the diff of normalized, add_to_output is nullable and may be the same as dx
+  static void Backward(int64_t num_instances, int64_t norm_size, const T* dy, const T* x,
+                       const T* mean, const T* inv_variance, const T* add_to_output, T* dx);
+  // any of gamma_diff, beta_diff and normalized_diff is nullable, normalized is required by
+  // gamma_diff and gamma is nullable
+  static void ParamBackward(int64_t batch_size, int64_t instance_size, const T* dy,
+                            const T* normalized, const T* gamma, T* gamma_diff, T* beta_diff,
+                            T* normalized_diff);
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_KERNELS_LAYER_NORM_CPU_KERNEL_UTIL_H_
@@ -0,0 +1,225 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/layer_norm_cpu_kernel_util.h"
+#include "oneflow/core/thread/thread_pool.h"
+#include <random>
+
+namespace oneflow {
+
+namespace {
+
+class LayerNormCpuKernelUtilTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    Global<ThreadPool>::New(std::max<int32_t>(std::thread::hardware_concurrency(), 1));
+  }
+  void TearDown() override { Global<ThreadPool>::Delete(); }
+};
+
+std::vector<float> RandomVector(int64_t size, float offset) {
+  std::mt19937 gen(size);
+  std::uniform_real_distribution<float> dist(-1.0, 1.0);
+  std::vector<float> vec(size);
+  for (float& v : vec) { v = dist(gen) + offset; }
+  return vec;
+}
+
+// the layer norm forward as a chain of separate row reduce and elementwise passes with temporary
+// buffers, which is what composing ndarray reduce and broadcast ops does
+void CompositeLayerNormForward(int64_t num_instances, int64_t norm_size, float epsilon,
+                               const float* x, const float* gamma, const float* beta,
+                               float* centered_buf, float* normalized, float* y, float* mean,
+                               float* inv_variance) {
+  FOR_RANGE(int64_t, i, 0, num_instances) {
+    float sum = 0;
+    FOR_RANGE(int64_t, j, 0, norm_size) { sum += x[i * norm_size + j]; }
+    mean[i] = sum / norm_size;
+  }
+  FOR_RANGE(int64_t, i, 0, num_instances) {
+    FOR_RANGE(int64_t, j, 0, norm_size) {
+      centered_buf[i * norm_size + j] = x[i * norm_size + j] - mean[i];
+    }
+  }
+  FOR_RANGE(int64_t, i, 0, num_instances) {
+    float sum = 0;
+    FOR_RANGE(int64_t, j, 0, norm_size) {
+      sum += centered_buf[i * norm_size + j] * centered_buf[i * norm_size + j];
+    }
+    inv_variance[i] = 1.0f / std::sqrt(sum / norm_size + epsilon);
+  }
+  FOR_RANGE(int64_t, i, 0, num_instances) {
+    FOR_RANGE(int64_t, j, 0, norm_size) {
+      normalized[i * norm_size + j] = centered_buf[i * norm_size + j] * inv_variance[i];
+    }
+  }
+  FOR_RANGE(int64_t, i, 0, num_instances) {
+    FOR_RANGE(int64_t, j, 0, norm_size) {
+      y[i * norm_size + j] = normalized[i * norm_size + j] * gamma[j];
+    }
+  }
+  FOR_RANGE(int64_t, i, 0, num_instances) {
+    FOR_RANGE(int64_t, j, 0, norm_size) { y[i * norm_size + j] += beta[j]; }
+  }
+}
+
+void CheckForward(int64_t num_instances, int64_t norm_size) {
+  const float epsilon = 1e-5;
+  const int64_t elem_cnt = num_instances * norm_size;
+  // a large offset makes the naive sum of squares lose precision
+  const std::vector<float> x = RandomVector(elem_cnt, 100.0);
+  const std::vector<float> gamma = RandomVector(norm_size, 1.0);
+  const std::vector<float> beta = RandomVector(norm_size, 0.0);
+  std::vector<float> normalized(elem_cnt);
+  std::vector<float> y(elem_cnt);
+  std::vector<float> mean(num_instances);
+  std::vector<float> inv_variance(num_instances);
+  LayerNormCpuKernelUtil<float>::Forward(num_instances, norm_size, epsilon, x.data(),
+                                         gamma.data(), beta.data(), normalized.data(), y.data(),
+                                         mean.data(), inv_variance.data());
+  FOR_RANGE(int64_t, i, 0, num_instances) {
+    double sum = 0;
+    FOR_RANGE(int64_t, j, 0, norm_size) { sum += x[i * norm_size + j]; }
+    const double ref_mean = sum / norm_size;
+    double sq_sum = 0;
+    FOR_RANGE(int64_t, j, 0, norm_size) {
+      sq_sum += (x[i * norm_size + j] - ref_mean) * (x[i * norm_size + j] - ref_mean);
+    }
+    const double ref_inv_variance = 1.0 / std::sqrt(sq_sum / norm_size + epsilon);
+    ASSERT_NEAR(mean[i], ref_mean, 1e-4);
+    ASSERT_NEAR(inv_variance[i], ref_inv_variance, ref_inv_variance * 1e-4);
+    FOR_RANGE(int64_t, j, 0, norm_size) {
+      const double ref_normalized = (x[i * norm_size + j] - ref_mean) * ref_inv_variance;
+      ASSERT_NEAR(normalized[i * norm_size + j], ref_normalized, 1e-3);
+      ASSERT_NEAR(y[i * norm_size + j], ref_normalized * gamma[j] + beta[j], 1e-3);
+    }
+  }
+}
+
+}  // namespace
+
+TEST_F(LayerNormCpuKernelUtilTest, forward) {
+  CheckForward(1, 1);
+  CheckForward(3, 7);
+  CheckForward(17, 768);
+  CheckForward(5, 1023);
+}
+
+TEST_F(LayerNormCpuKernelUtilTest, backward) {
+  const int64_t num_instances = 9;
+  const int64_t norm_size = 130;
+  const int64_t elem_cnt = num_instances * norm_size;
+  const float epsilon = 1e-5;
+  const std::vector<float> x = RandomVector(elem_cnt, 0.5);
+  const std::vector<float> dy = RandomVector(elem_cnt + 1, 0.0);
+  const std::vector<float> add_to_output = RandomVector(elem_cnt + 2, 0.0);
+  std::vector<float> normalized(elem_cnt);
+  std::vector<float> mean(num_instances);
+  std::vector<float> inv_variance(num_instances);
+  LayerNormCpuKernelUtil<float>::Forward(num_instances, norm_size, epsilon, x.data(), nullptr,
+                                         nullptr, normalized.data(), normalized.data(),
+                                         mean.data(), inv_variance.data());
+  std::vector<float> dx(elem_cnt);
+  LayerNormCpuKernelUtil<float>::Backward(num_instances, norm_size, dy.data(), x.data(),
+                                          mean.data(), inv_variance.data(), nullptr, dx.data());
+  std::vector<float> inplace_dx(add_to_output.begin(), add_to_output.begin() + elem_cnt);
+  LayerNormCpuKernelUtil<float>::Backward(num_instances, norm_size, dy.data(), x.data(),
+                                          mean.data(), inv_variance.data(), inplace_dx.data(),
+                                          inplace_dx.data());
+  FOR_RANGE(int64_t, i, 0, num_instances) {
+    double sum_dy = 0;
+    double sum_dy_normalized = 0;
+    FOR_RANGE(int64_t, j, 0, norm_size) {
+      sum_dy += dy[i * norm_size + j];
+      sum_dy_normalized += dy[i * norm_size + j] * normalized[i * norm_size + j];
+    }
+    FOR_RANGE(int64_t, j, 0, norm_size) {
+      const int64_t k = i * norm_size + j;
+      const double ref_dx =
+          inv_variance[i]
+          * (dy[k] - sum_dy / norm_size - normalized[k] * sum_dy_normalized / norm_size);
+      ASSERT_NEAR(dx[k], ref_dx, 1e-4);
+      ASSERT_NEAR(inplace_dx[k], ref_dx + add_to_output[k], 1e-4);
+    }
+  }
+}
+
+TEST_F(LayerNormCpuKernelUtilTest, param_backward) {
+  const int64_t batch_size = 37;
+  const int64_t instance_size = 21;
+  const int64_t elem_cnt = batch_size * instance_size;
+  const std::vector<float> dy = RandomVector(elem_cnt, 0.0);
+  const std::vector<float> normalized = RandomVector(elem_cnt + 1, 0.0);
+  const std::vector<float> gamma = RandomVector(instance_size, 1.0);
+  std::vector<float> gamma_diff(instance_size);
+  std::vector<float> beta_diff(instance_size);
+  std::vector<float> normalized_diff(elem_cnt);
+  LayerNormCpuKernelUtil<float>::ParamBackward(batch_size, instance_size, dy.data(),
+                                               normalized.data(), gamma.data(), gamma_diff.data(),
+                                               beta_diff.data(), normalized_diff.data());
+  FOR_RANGE(int64_t, j, 0, instance_size) {
+    double ref_gamma_diff = 0;
+    double ref_beta_diff = 0;
+    FOR_RANGE(int64_t, i, 0, batch_size) {
+      const int64_t k = i * instance_size + j;
+      ref_gamma_diff += dy[k] * normalized[k];
+      ref_beta_diff += dy[k];
+      ASSERT_FLOAT_EQ(normalized_diff[k], dy[k] * gamma[j]);
+    }
+    ASSERT_NEAR(gamma_diff[j], ref_gamma_diff, 1e-4);
+    ASSERT_NEAR(beta_diff[j], ref_beta_diff, 1e-4);
+  }
+  LayerNormCpuKernelUtil<float>::ParamBackward(batch_size, instance_size, dy.data(), nullptr,
+                                               nullptr, nullptr, nullptr, normalized_diff.data());
+  ASSERT_EQ(normalized_diff, dy);
+}
+
+TEST_F(LayerNormCpuKernelUtilTest, DISABLED_benchmark_forward) {
+  const int64_t num_instances = 512;
+  const int64_t kIters = 20;
+  for (const int64_t norm_size : {768, 1024, 2048, 4096}) {
+    const int64_t elem_cnt = num_instances * norm_size;
+    const std::vector<float> x = RandomVector(elem_cnt, 0.0);
+    const std::vector<float> gamma = RandomVector(norm_size, 1.0);
+    const std::vector<float> beta = RandomVector(norm_size, 0.0);
+    std::vector<float> centered_buf(elem_cnt);
+    std::vector<float> normalized(elem_cnt);
+    std::vector<float> y(elem_cnt);
+    std::vector<float> mean(num_instances);
+    std::vector<float> inv_variance(num_instances);
+    const auto composite_start = std::chrono::steady_clock::now();
+    FOR_RANGE(int64_t, iter, 0, kIters) {
+      CompositeLayerNormForward(num_instances, norm_size, 1e-5, x.data(), gamma.data(),
+                                beta.data(), centered_buf.data(), normalized.data(), y.data(),
+                                mean.data(), inv_variance.data());
+    }
+    const auto fused_start = std::chrono::steady_clock::now();
+    FOR_RANGE(int64_t, iter, 0, kIters) {
+      LayerNormCpuKernelUtil<float>::Forward(num_instances, norm_size, 1e-5, x.data(),
+                                             gamma.data(), beta.data(), normalized.data(),
+                                             y.data(), mean.data(), inv_variance.data());
+    }
+    const auto fused_end = std::chrono::steady_clock::now();
+    const double composite_us =
+        std::chrono::duration<double, std::micro>(fused_start - composite_start).count() / kIters;
+    const double fused_us =
+        std::chrono::duration<double, std::micro>(fused_end - fused_start).count() / kIters;
+    LOG(INFO) << "layer norm forward " << num_instances << "x" << norm_size
+              << ": composite " << composite_us << "us, fused " << fused_us << "us, speedup "
+              << composite_us / fused_us;
+  }
+}
+
+}  // namespace oneflow
@@ -15,6 +15,7 @@ limitations under the License.
 */
 #include "oneflow/core/framework/framework.h"
 #include "oneflow/user/data/ofrecord_data_reader.h"
+#include "oneflow/user/data/mapped_ofrecord_data_reader.h"
 
 namespace oneflow {
 
@@ -22,13 +23,27 @@ namespace {
 
 class OFRecordReaderWrapper final : public user_op::OpKernelState {
  public:
-  explicit OFRecordReaderWrapper(user_op::KernelInitContext* ctx) : reader_(ctx) {}
+  explicit OFRecordReaderWrapper(user_op::KernelInitContext* ctx) {
+    // mmap mode parses records in place from the page cache, the data must be on local disk
+    if (ParseBooleanFromEnv("ONEFLOW_OFRECORD_READER_USE_MMAP", false)) {
+      mapped_reader_.reset(new data::MappedOFRecordDataReader(ctx));
+    } else {
+      reader_.reset(new data::OFRecordDataReader(ctx));
+    }
+  }
   ~OFRecordReaderWrapper() = default;
 
-  void Read(user_op::KernelComputeContext* ctx) { reader_.Read(ctx); }
+  void Read(user_op::KernelComputeContext* ctx) {
+    if (mapped_reader_) {
+      mapped_reader_->Read(ctx);
+    } else {
+      reader_->Read(ctx);
+    }
+  }
 
  private:
-  data::OFRecordDataReader reader_;
+  std::unique_ptr<data::OFRecordDataReader> reader_;
+  std::unique_ptr<data::MappedOFRecordDataReader> mapped_reader_;
 };
 
 }  // namespace
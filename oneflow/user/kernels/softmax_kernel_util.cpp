@@ -14,93 +14,67 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/user/kernels/softmax_kernel_util.h"
-#include "oneflow/core/ndarray/ndarray_util.h"
+#include "oneflow/core/thread/thread_manager.h"
 
 namespace oneflow {
 
 namespace {
 
+// A row is small enough to stay in cache between passes, so every row reads in once and writes
+// prob once, and no temp storage is needed. Computing the max and the sum in a single online pass
+// would need a second exp per element to rescale the partial sum, which costs more than the extra
+// cache-resident max pass.
 template<typename T>
-size_t GetProbTmpSize(int64_t n, int64_t w) {
-  return GetCudaAlignedSize(n * sizeof(T));
-}
-
-template<typename T>
-size_t GetDiffTmpSize(int64_t n, int64_t w) {
-  return GetCudaAlignedSize(n * sizeof(T));
+void ComputeProbRow(const int64_t w, const T* in, T* prob) {
+  T max_val = in[0];
+  for (int64_t j = 1; j < w; ++j) { max_val = std::max(max_val, in[j]); }
+  T sum = 0;
+  for (int64_t j = 0; j < w; ++j) {
+    const T exp_val = std::exp(in[j] - max_val);
+    prob[j] = exp_val;
+    sum += exp_val;
+  }
+  const T inv_sum = static_cast<T>(1) / sum;
+  for (int64_t j = 0; j < w; ++j) { prob[j] *= inv_sum; }
 }
 
+// dx = out * (dy - dot(out, dy)), dx may be the same as dy
 template<typename T>
-size_t GetReduceTempStorageSize(int64_t n, int64_t w) {
-  return GetCudaAlignedSize(n * w * sizeof(T));
+void ComputeDiffRow(const int64_t w, const T* dy, const T* out, T* dx) {
+  T dot = 0;
+  for (int64_t j = 0; j < w; ++j) { dot += out[j] * dy[j]; }
+  for (int64_t j = 0; j < w; ++j) { dx[j] = out[j] * (dy[j] - dot); }
 }
 
 }  // namespace
 
 template<typename T>
 struct SoftmaxKernelUtil<DeviceType::kCPU, T> {
-  static size_t GetComputeProbTempStorageSizeInBytes(int64_t n, int64_t w) {
-    return GetProbTmpSize<T>(n, w) + GetReduceTempStorageSize<T>(n, w);
-  }
+  static size_t GetComputeProbTempStorageSizeInBytes(int64_t n, int64_t w) { return 0; }
 
-  static size_t GetComputeDiffTempStorageSizeInBytes(int64_t n, int64_t w) {
-    return GetDiffTmpSize<T>(n, w) + GetReduceTempStorageSize<T>(n, w);
-  }
+  static size_t GetComputeDiffTempStorageSizeInBytes(int64_t n, int64_t w) { return 0; }
 
   static void ComputeProb(DeviceCtx* ctx, const int64_t n, const int64_t w, const T* in, T* prob,
                           void* temp_storage, const size_t temp_storage_bytes) {
-    auto Val = NdarrayUtil<DeviceType::kCPU, T>::GetValNdarrayBuilder();
-    auto Var = NdarrayUtil<DeviceType::kCPU, T>::GetVarNdarrayBuilder();
-    const size_t min_temp_storage_bytes =
-        SoftmaxKernelUtil<DeviceType::kCPU, T>::GetComputeProbTempStorageSizeInBytes(n, w);
-    CHECK_GE(temp_storage_bytes, min_temp_storage_bytes);
-    const size_t reduce_temp_storage_bytes = GetReduceTempStorageSize<T>(n, w);
-    T* reduce_storage = reinterpret_cast<T*>(temp_storage);
-    auto reduce_storage_var =
-        Var({static_cast<int64_t>(reduce_temp_storage_bytes / sizeof(T))}, reduce_storage);
-    T* tmp = reinterpret_cast<T*>(reinterpret_cast<unsigned char*>(temp_storage)
-                                  + reduce_temp_storage_bytes);
-    // max | tmp[i] = Max_j(in[i][j])
-    NdarrayUtil<DeviceType::kCPU, T>::ReduceMax(ctx, Var({n, 1}, tmp), Val({n, w}, in),
-                                                reduce_storage_var);
-    // sub | prob[i][j] = in[i][j] - tmp[i]
-    NdarrayUtil<DeviceType::kCPU, T>::BroadcastSub(ctx, Var({n, w}, prob), Val({n, w}, in),
-                                                   Val({n, 1}, tmp));
-    // exp | prob[i][j] = exp(prob[i][j])
-    NdarrayUtil<DeviceType::kCPU, T>::InplaceExp(ctx, Var({n, w}, prob));
-    // sum | tmp[i] = Sum_j(prob[i][j])
-    NdarrayUtil<DeviceType::kCPU, T>::ReduceSum(ctx, Var({n, 1}, tmp), Val({n, w}, prob),
-                                                reduce_storage_var);
-    // div | prob[i][j] /= tmp[i]
-    NdarrayUtil<DeviceType::kCPU, T>::InplaceBroadcastDiv(ctx, Var({n, w}, prob), Val({n, 1}, tmp));
+    if (n == 0 || w == 0) { return; }
+    ParallelFor(n, GetRowGrainSize(w), ParallelForSchedule::kStatic,
+                [&](size_t begin, size_t end) {
+                  FOR_RANGE(int64_t, i, begin, end) {
+                    ComputeProbRow<T>(w, in + i * w, prob + i * w);
+                  }
+                });
   }
 
   static void ComputeDiff(DeviceCtx* ctx, const int64_t n, const int64_t w, const T* dy,
                           const T* out, T* dx, void* temp_storage,
                           const size_t temp_storage_bytes) {
-    auto Val = NdarrayUtil<DeviceType::kCPU, T>::GetValNdarrayBuilder();
-    auto Var = NdarrayUtil<DeviceType::kCPU, T>::GetVarNdarrayBuilder();
-    const size_t min_temp_storage_bytes =
-        SoftmaxKernelUtil<DeviceType::kCPU, T>::GetComputeProbTempStorageSizeInBytes(n, w);
-    CHECK_GE(temp_storage_bytes, min_temp_storage_bytes);
-    const size_t reduce_temp_storage_bytes = GetReduceTempStorageSize<T>(n, w);
-    T* reduce_storage = reinterpret_cast<T*>(temp_storage);
-    auto reduce_storage_var =
-        Var({static_cast<int64_t>(reduce_temp_storage_bytes / sizeof(T))}, reduce_storage);
-    T* sum_vec = reinterpret_cast<T*>(reinterpret_cast<unsigned char*>(temp_storage)
-                                      + reduce_temp_storage_bytes);
-    // it's safe to use dx as tmp
-    // dot product | get dot product sum_vec[i] from out[i] * dy[i]
-    T* tmp = dx;
-    NdarrayUtil<DeviceType::kCPU, T>::Mul(ctx, Var({n * w}, tmp), Val({n * w}, out),
-                                          Val({n * w}, dy));
-    NdarrayUtil<DeviceType::kCPU, T>::ReduceSum(ctx, Var({n, 1}, sum_vec), Val({n, w}, tmp),
-                                                reduce_storage_var);
-    // sub | dx[i][j] = dy[i][j] - sum_vec[i]
-    NdarrayUtil<DeviceType::kCPU, T>::BroadcastSub(ctx, Var({n, w}, dx), Val({n, w}, dy),
-                                                   Val({n, 1}, sum_vec));
-    // elementwise multiplication | dx[i][j] *= out[i][j]
-    NdarrayUtil<DeviceType::kCPU, T>::InplaceMul(ctx, Var({n * w}, dx), Val({n * w}, out));
+    if (n == 0 || w == 0) { return; }
+    ParallelFor(n, GetRowGrainSize(w), ParallelForSchedule::kStatic,
+                [&](size_t begin, size_t end) {
+                  FOR_RANGE(int64_t, i, begin, end) {
+                    ComputeDiffRow<T>(w, dy + i * w, out + i * w, dx + i * w);
+                  }
+                });
   }
 };
 
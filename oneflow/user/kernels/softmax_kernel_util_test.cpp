@@ -0,0 +1,125 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/softmax_kernel_util.h"
+#include "oneflow/core/thread/thread_pool.h"
+#include <random>
+
+namespace oneflow {
+
+namespace {
+
+class SoftmaxKernelUtilTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    Global<ThreadPool>::New(std::max<int32_t>(std::thread::hardware_concurrency(), 1));
+  }
+  void TearDown() override { Global<ThreadPool>::Delete(); }
+};
+
+std::vector<float> RandomVector(int64_t size, float scale) {
+  std::mt19937 gen(size);
+  std::uniform_real_distribution<float> dist(-scale, scale);
+  std::vector<float> vec(size);
+  for (float& v : vec) { v = dist(gen); }
+  return vec;
+}
+
+// the five full-tensor passes of ReduceMax, BroadcastSub, InplaceExp, ReduceSum and
+// InplaceBroadcastDiv over an n-sized temp buffer
+void CompositeSoftmax(int64_t n, int64_t w, const float* in, float* tmp, float* prob) {
+  FOR_RANGE(int64_t, i, 0, n) {
+    tmp[i] = in[i * w];
+    FOR_RANGE(int64_t, j, 1, w) { tmp[i] = std::max(tmp[i], in[i * w + j]); }
+  }
+  FOR_RANGE(int64_t, i, 0, n) {
+    FOR_RANGE(int64_t, j, 0, w) { prob[i * w + j] = in[i * w + j] - tmp[i]; }
+  }
+  FOR_RANGE(int64_t, k, 0, n * w) { prob[k] = std::exp(prob[k]); }
+  FOR_RANGE(int64_t, i, 0, n) {
+    tmp[i] = 0;
+    FOR_RANGE(int64_t, j, 0, w) { tmp[i] += prob[i * w + j]; }
+  }
+  FOR_RANGE(int64_t, i, 0, n) {
+    FOR_RANGE(int64_t, j, 0, w) { prob[i * w + j] /= tmp[i]; }
+  }
+}
+
+void CheckSoftmax(int64_t n, int64_t w, float scale) {
+  using Util = SoftmaxKernelUtil<DeviceType::kCPU, float>;
+  ASSERT_EQ(Util::GetComputeProbTempStorageSizeInBytes(n, w), 0);
+  ASSERT_EQ(Util::GetComputeDiffTempStorageSizeInBytes(n, w), 0);
+  const std::vector<float> in = RandomVector(n * w, scale);
+  const std::vector<float> dy = RandomVector(n * w + 1, 1.0);
+  std::vector<float> prob(n * w);
+  Util::ComputeProb(nullptr, n, w, in.data(), prob.data(), nullptr, 0);
+  std::vector<float> dx(n * w);
+  Util::ComputeDiff(nullptr, n, w, dy.data(), prob.data(), dx.data(), nullptr, 0);
+  FOR_RANGE(int64_t, i, 0, n) {
+    double max_val = in[i * w];
+    FOR_RANGE(int64_t, j, 0, w) { max_val = std::max<double>(max_val, in[i * w + j]); }
+    double sum = 0;
+    FOR_RANGE(int64_t, j, 0, w) { sum += std::exp(in[i * w + j] - max_val); }
+    double dot = 0;
+    FOR_RANGE(int64_t, j, 0, w) {
+      const double ref_prob = std::exp(in[i * w + j] - max_val) / sum;
+      ASSERT_NEAR(prob[i * w + j], ref_prob, 1e-6);
+      dot += ref_prob * dy[i * w + j];
+    }
+    FOR_RANGE(int64_t, j, 0, w) {
+      ASSERT_NEAR(dx[i * w + j], prob[i * w + j] * (dy[i * w + j] - dot), 1e-6);
+    }
+  }
+}
+
+}  // namespace
+
+TEST_F(SoftmaxKernelUtilTest, softmax) {
+  CheckSoftmax(1, 1, 1.0);
+  CheckSoftmax(3, 5, 1.0);
+  CheckSoftmax(17, 1000, 10.0);
+  // would overflow exp without subtracting the row max
+  CheckSoftmax(4, 33, 1000.0);
+}
+
+TEST_F(SoftmaxKernelUtilTest, DISABLED_benchmark_softmax) {
+  const int64_t kIters = 20;
+  for (const auto& nw : std::vector<std::pair<int64_t, int64_t>>{
+           {4096, 128}, {1024, 512}, {256, 1000}, {64, 32768}}) {
+    const int64_t n = nw.first;
+    const int64_t w = nw.second;
+    const std::vector<float> in = RandomVector(n * w, 5.0);
+    std::vector<float> tmp(n);
+    std::vector<float> prob(n * w);
+    const auto composite_start = std::chrono::steady_clock::now();
+    FOR_RANGE(int64_t, iter, 0, kIters) {
+      CompositeSoftmax(n, w, in.data(), tmp.data(), prob.data());
+    }
+    const auto fused_start = std::chrono::steady_clock::now();
+    FOR_RANGE(int64_t, iter, 0, kIters) {
+      SoftmaxKernelUtil<DeviceType::kCPU, float>::ComputeProb(nullptr, n, w, in.data(),
+                                                              prob.data(), nullptr, 0);
+    }
+    const auto fused_end = std::chrono::steady_clock::now();
+    const double composite_us =
+        std::chrono::duration<double, std::micro>(fused_start - composite_start).count() / kIters;
+    const double fused_us =
+        std::chrono::duration<double, std::micro>(fused_end - fused_start).count() / kIters;
+    LOG(INFO) << "softmax " << n << "x" << w << ": composite " << composite_us << "us, fused "
+              << fused_us << "us, speedup " << composite_us / fused_us;
+  }
+}
+
+}  // namespace oneflow
@@ -14,9 +14,366 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/user/kernels/unique_kernel_util.h"
+#include "oneflow/core/thread/thread_manager.h"
 
 namespace oneflow {
 
+namespace {
+
+// Inputs of at least this many elements are radix partitioned by the high bits of the key hash
+// and the partitions are made unique in parallel, each partition with a table of its own. That
+// touches the data about twice as much as a single table does, so it needs a few threads to pay.
+constexpr int64_t kPartitionedUniqueMinSize = 1 << 17;
+constexpr int64_t kPartitionedUniqueMinThreadNum = 4;
+constexpr int64_t kUniquePartitionBits = 6;
+constexpr int64_t kUniquePartitionNum = 1 << kUniquePartitionBits;
+constexpr int64_t kUniqueChunkSize = 1 << 15;
+constexpr int64_t kUniqueTableMinCapacity = 1 << 10;
+
+// keys comparing equal have the same bits, so -0.0 is taken as 0.0
+template<typename KEY>
+uint64_t KeyBits(KEY key) {
+  return static_cast<uint64_t>(key);
+}
+
+template<>
+uint64_t KeyBits<float>(float key) {
+  if (key == 0) { return 0; }
+  uint32_t bits;
+  std::memcpy(&bits, &key, sizeof(bits));
+  return bits;
+}
+
+template<>
+uint64_t KeyBits<double>(double key) {
+  if (key == 0) { return 0; }
+  uint64_t bits;
+  std::memcpy(&bits, &key, sizeof(bits));
+  return bits;
+}
+
+// NaNs never compare equal, each one is a unique of its own like it was with HashMap
+template<typename KEY>
+bool IsNaN(KEY key) {
+  return false;
+}
+
+template<>
+bool IsNaN<float>(float key) {
+  return std::isnan(key);
+}
+
+template<>
+bool IsNaN<double>(double key) {
+  return std::isnan(key);
+}
+
+// Fibonacci hashing with the high half folded into the low one, high bits pick the partition
+template<typename KEY>
+uint64_t HashKey(KEY key) {
+  const uint64_t h = KeyBits<KEY>(key) * 0x9e3779b97f4a7c15ULL;
+  return h ^ (h >> 32);
+}
+
+int64_t PartitionOf(uint64_t hash) {
+  return static_cast<int64_t>(hash >> (64 - kUniquePartitionBits));
+}
+
+// two slots per key keep the load factor at most 0.5
+int64_t UniqueTableCapacity(int64_t n) { return 2 * n; }
+
+template<typename KEY, typename IDX>
+struct UniqueTableSlot {
+  KEY key;
+  IDX idx;  // negative if the slot is empty
+};
+
+// Open addressing with linear probing over slots owned by the caller, keys are never erased.
+// The table starts small and doubles up to max_capacity, so that inputs with few uniques probe
+// a table which stays in cache. Capacities need not be powers of two.
+template<typename KEY, typename IDX>
+class UniqueTable final {
+ public:
+  UniqueTable(UniqueTableSlot<KEY, IDX>* slots, int64_t max_capacity)
+      : slots_(slots),
+        max_capacity_(max_capacity),
+        capacity_(std::min(kUniqueTableMinCapacity, max_capacity)),
+        size_(0) {
+    Clear();
+  }
+
+  IDX size() const { return size_; }
+
+  // The idx of key, a key not seen before gets idx size() and *inserted is set. When the table
+  // grows, ReinsertAll(this) has to Reinsert() every unique found so far.
+  template<typename ReinsertAllFn>
+  IDX FindOrInsert(KEY key, bool* inserted, const ReinsertAllFn& ReinsertAll) {
+    if (IsNaN<KEY>(key)) {
+      *inserted = true;
+      return size_++;
+    }
+    UniqueTableSlot<KEY, IDX>* slot = FindSlot(key);
+    if (slot->idx >= 0) {
+      *inserted = false;
+      return slot->idx;
+    }
+    if (2 * (static_cast<int64_t>(size_) + 1) > capacity_ && capacity_ < max_capacity_) {
+      capacity_ = std::min(2 * capacity_, max_capacity_);
+      Clear();
+      ReinsertAll(this);
+      slot = FindSlot(key);
+    }
+    slot->key = key;
+    slot->idx = size_;
+    *inserted = true;
+    return size_++;
+  }
+  void Reinsert(KEY key, IDX idx) {
+    if (IsNaN<KEY>(key)) { return; }
+    UniqueTableSlot<KEY, IDX>* slot = FindSlot(key);
+    slot->key = key;
+    slot->idx = idx;
+  }
+
+ private:
+  // the slot holding key or the empty one where it goes
+  UniqueTableSlot<KEY, IDX>* FindSlot(KEY key) {
+    const uint64_t hash = HashKey<KEY>(key);
+    const uint64_t capacity = static_cast<uint64_t>(capacity_);
+    // all but the largest capacity are powers of two, which are indexed without a division
+    int64_t i = static_cast<int64_t>((capacity & (capacity - 1)) == 0 ? hash & (capacity - 1)
+                                                                       : hash % capacity);
+    while (slots_[i].idx >= 0 && !(slots_[i].key == key)) {
+      i += 1;
+      if (i == capacity_) { i = 0; }
+    }
+    return slots_ + i;
+  }
+  void Clear() {
+    FOR_RANGE(int64_t, i, 0, capacity_) { slots_[i].idx = -1; }
+  }
+
+  UniqueTableSlot<KEY, IDX>* slots_;
+  int64_t max_capacity_;
+  int64_t capacity_;
+  IDX size_;
+};
+
+template<typename KEY, typename IDX>
+class UniqueWorkspace final {
+ public:
+  UniqueWorkspace(int64_t n, void* ptr) : n_(n), ptr_(reinterpret_cast<char*>(ptr)), size_(0) {}
+
+  int64_t size() const { return size_; }
+
+  UniqueTableSlot<KEY, IDX>* Slots(int64_t capacity) {
+    return Alloc<UniqueTableSlot<KEY, IDX>>(capacity);
+  }
+  // keys scattered to partitions, each partition keeping the input order
+  KEY* PartKeys() { return Alloc<KEY>(n_); }
+  uint8_t* PartitionOfPositions() { return Alloc<uint8_t>(n_); }
+  // whether a partitioned key is the first occurrence of its key and its idx in the partition
+  uint8_t* FirstOccurrenceFlags() { return Alloc<uint8_t>(n_); }
+  IDX* LocalIdx() { return Alloc<IDX>(n_); }
+  // count of each unique of a partition, indexed by partition begin + local idx
+  IDX* LocalCounts() { return Alloc<IDX>(n_); }
+
+ private:
+  template<typename T>
+  T* Alloc(int64_t cnt) {
+    T* ret = reinterpret_cast<T*>(ptr_ == nullptr ? nullptr : ptr_ + size_);
+    size_ += GetCudaAlignedSize(cnt * sizeof(T));
+    return ret;
+  }
+
+  int64_t n_;
+  char* ptr_;
+  int64_t size_;
+};
+
+// Two table slots per key, the tables of all partitions taking as many slots as a single table.
+// Whether the partitioned path runs depends on the thread pool of the process running the kernel,
+// so its arrays are counted for every large input. With int64 keys and ids that is 32 bytes per
+// key below kPartitionedUniqueMinSize and 50 bytes per key above, 58 with counts.
+template<typename KEY, typename IDX>
+int64_t UniqueWorkspaceSize(int64_t n, bool with_counts) {
+  UniqueWorkspace<KEY, IDX> workspace(n, nullptr);
+  if (n >= kPartitionedUniqueMinSize) {
+    workspace.PartKeys();
+    workspace.PartitionOfPositions();
+    workspace.FirstOccurrenceFlags();
+    workspace.LocalIdx();
+    if (with_counts) { workspace.LocalCounts(); }
+  }
+  workspace.Slots(UniqueTableCapacity(n));
+  return workspace.size();
+}
+
+template<typename KEY, typename IDX>
+void FlatUniqueWithCounts(int64_t n, const KEY* in, IDX* num_unique, KEY* unique_out, IDX* idx_out,
+                          IDX* count, UniqueWorkspace<KEY, IDX>* workspace) {
+  const int64_t capacity = UniqueTableCapacity(n);
+  UniqueTable<KEY, IDX> table(workspace->Slots(capacity), capacity);
+  FOR_RANGE(int64_t, i, 0, n) {
+    const KEY key = in[i];
+    bool inserted;
+    const IDX idx = table.FindOrInsert(key, &inserted, [&](UniqueTable<KEY, IDX>* t) {
+      FOR_RANGE(IDX, u, 0, t->size()) { t->Reinsert(unique_out[u], u); }
+    });
+    if (inserted) {
+      unique_out[idx] = key;
+      if (count != nullptr) { count[idx] = 0; }
+    }
+    if (count != nullptr) { count[idx] += 1; }
+    idx_out[i] = idx;
+  }
+  *num_unique = table.size();
+}
+
+// Handler(i, p, j) for each input position i of chunk c in order, p being the partition of in[i]
+// and j its index among the partitioned keys
+template<typename Handler>
+void ForEachPartitionedPosition(int64_t n, int64_t c, const uint8_t* partition_of,
+                                const int64_t* chunk_part_begin, const Handler& handler) {
+  std::array<int64_t, kUniquePartitionNum> offset;
+  std::copy(chunk_part_begin + c * kUniquePartitionNum,
+            chunk_part_begin + (c + 1) * kUniquePartitionNum, offset.begin());
+  FOR_RANGE(int64_t, i, c * kUniqueChunkSize, std::min((c + 1) * kUniqueChunkSize, n)) {
+    const int64_t p = partition_of[i];
+    handler(i, p, offset[p]++);
+  }
+}
+
+// Keys are scattered to partitions by a stable counting sort over chunks of the input, then
+// every partition is made unique on its own. The uniques get their global idx from scans in
+// input order, which walk the partitioned data the same way as the scatter did so that accesses
+// to it stay sequential within each partition.
+template<typename KEY, typename IDX>
+void PartitionedUniqueWithCounts(int64_t n, const KEY* in, IDX* num_unique, KEY* unique_out,
+                                 IDX* idx_out, IDX* count, UniqueWorkspace<KEY, IDX>* workspace) {
+  constexpr int64_t P = kUniquePartitionNum;
+  KEY* part_keys = workspace->PartKeys();
+  uint8_t* partition_of = workspace->PartitionOfPositions();
+  uint8_t* is_first = workspace->FirstOccurrenceFlags();
+  IDX* local_idx = workspace->LocalIdx();
+  IDX* local_count = count == nullptr ? nullptr : workspace->LocalCounts();
+  UniqueTableSlot<KEY, IDX>* slots = workspace->Slots(UniqueTableCapacity(n));
+  const int64_t chunk_num = RoundUp(n, kUniqueChunkSize) / kUniqueChunkSize;
+
+  // chunk_part_begin[c * P + p] is where partition p gets the keys of chunk c
+  std::vector<int64_t> chunk_part_begin(chunk_num * P, 0);
+  ParallelFor(chunk_num, 1, ParallelForSchedule::kStatic, [&](size_t begin, size_t end) {
+    FOR_RANGE(int64_t, c, begin, end) {
+      int64_t* hist = chunk_part_begin.data() + c * P;
+      FOR_RANGE(int64_t, i, c * kUniqueChunkSize, std::min((c + 1) * kUniqueChunkSize, n)) {
+        const int64_t p = PartitionOf(HashKey<KEY>(in[i]));
+        partition_of[i] = static_cast<uint8_t>(p);
+        hist[p] += 1;
+      }
+    }
+  });
+  std::vector<int64_t> part_begin(P + 1);
+  std::vector<int64_t> table_begin(P + 1);
+  part_begin[0] = 0;
+  table_begin[0] = 0;
+  FOR_RANGE(int64_t, p, 0, P) {
+    int64_t offset = part_begin[p];
+    FOR_RANGE(int64_t, c, 0, chunk_num) {
+      const int64_t cnt = chunk_part_begin[c * P + p];
+      chunk_part_begin[c * P + p] = offset;
+      offset += cnt;
+    }
+    part_begin[p + 1] = offset;
+    const int64_t part_size = offset - part_begin[p];
+    table_begin[p + 1] = table_begin[p] + UniqueTableCapacity(part_size);
+  }
+  ParallelFor(chunk_num, 1, ParallelForSchedule::kStatic, [&](size_t begin, size_t end) {
+    FOR_RANGE(int64_t, c, begin, end) {
+      ForEachPartitionedPosition(n, c, partition_of, chunk_part_begin.data(),
+                                 [&](int64_t i, int64_t p, int64_t j) { part_keys[j] = in[i]; });
+    }
+  });
+
+  std::vector<int64_t> part_unique_begin(P + 1, 0);
+  ParallelFor(P, 1, ParallelForSchedule::kDynamic, [&](size_t begin, size_t end) {
+    FOR_RANGE(int64_t, p, begin, end) {
+      const int64_t part_offset = part_begin[p];
+      const int64_t part_size = part_begin[p + 1] - part_offset;
+      if (part_size == 0) { continue; }
+      UniqueTable<KEY, IDX> table(slots + table_begin[p], UniqueTableCapacity(part_size));
+      IDX* cnt = local_count == nullptr ? nullptr : local_count + part_offset;
+      FOR_RANGE(int64_t, j, part_offset, part_offset + part_size) {
+        const KEY key = part_keys[j];
+        bool inserted;
+        const IDX idx = table.FindOrInsert(key, &inserted, [&](UniqueTable<KEY, IDX>* t) {
+          FOR_RANGE(int64_t, k, part_offset, j) {
+            if (is_first[k]) { t->Reinsert(part_keys[k], local_idx[k]); }
+          }
+        });
+        if (cnt != nullptr) {
+          if (inserted) { cnt[idx] = 0; }
+          cnt[idx] += 1;
+        }
+        local_idx[j] = idx;
+        is_first[j] = inserted;
+      }
+      part_unique_begin[p + 1] = table.size();
+    }
+  });
+  FOR_RANGE(int64_t, p, 0, P) { part_unique_begin[p + 1] += part_unique_begin[p]; }
+  // global idx of each unique of a partition, indexed by partition begin among uniques + local
+  // idx, reusing the slots of the tables which are no longer needed
+  IDX* local_to_global = reinterpret_cast<IDX*>(slots);
+
+  // uniques are numbered in the order of their first occurrences
+  std::vector<int64_t> chunk_unique_begin(chunk_num + 1, 0);
+  ParallelFor(chunk_num, 1, ParallelForSchedule::kStatic, [&](size_t begin, size_t end) {
+    FOR_RANGE(int64_t, c, begin, end) {
+      int64_t unique_cnt = 0;
+      ForEachPartitionedPosition(n, c, partition_of, chunk_part_begin.data(),
+                                 [&](int64_t i, int64_t p, int64_t j) {
+                                   if (is_first[j]) { unique_cnt += 1; }
+                                 });
+      chunk_unique_begin[c + 1] = unique_cnt;
+    }
+  });
+  FOR_RANGE(int64_t, c, 0, chunk_num) { chunk_unique_begin[c + 1] += chunk_unique_begin[c]; }
+  ParallelFor(chunk_num, 1, ParallelForSchedule::kStatic, [&](size_t begin, size_t end) {
+    FOR_RANGE(int64_t, c, begin, end) {
+      IDX global_idx = chunk_unique_begin[c];
+      ForEachPartitionedPosition(n, c, partition_of, chunk_part_begin.data(),
+                                 [&](int64_t i, int64_t p, int64_t j) {
+                                   if (!is_first[j]) { return; }
+                                   local_to_global[part_unique_begin[p] + local_idx[j]] =
+                                       global_idx;
+                                   unique_out[global_idx] = in[i];
+                                   global_idx += 1;
+                                 });
+    }
+  });
+  ParallelFor(chunk_num, 1, ParallelForSchedule::kStatic, [&](size_t begin, size_t end) {
+    FOR_RANGE(int64_t, c, begin, end) {
+      ForEachPartitionedPosition(
+          n, c, partition_of, chunk_part_begin.data(), [&](int64_t i, int64_t p, int64_t j) {
+            idx_out[i] = local_to_global[part_unique_begin[p] + local_idx[j]];
+          });
+    }
+  });
+  if (count != nullptr) {
+    ParallelFor(P, 1, ParallelForSchedule::kStatic, [&](size_t begin, size_t end) {
+      FOR_RANGE(int64_t, p, begin, end) {
+        const int64_t unique_begin = part_unique_begin[p];
+        FOR_RANGE(int64_t, u, 0, part_unique_begin[p + 1] - unique_begin) {
+          count[local_to_global[unique_begin + u]] = local_count[part_begin[p] + u];
+        }
+      }
+    });
+  }
+  *num_unique = chunk_unique_begin[chunk_num];
+}
+
+}  // namespace
+
 template<typename KEY, typename IDX>
 struct UniqueKernelUtil<DeviceType::kCPU, KEY, IDX> {
   static void Unique(DeviceCtx* ctx, int64_t n, const KEY* in, IDX* num_unique, KEY* unique_out,
@@ -27,31 +384,25 @@ struct UniqueKernelUtil<DeviceType::kCPU, KEY, IDX> {
   static void UniqueWithCounts(DeviceCtx* ctx, int64_t n, const KEY* in, IDX* num_unique,
                                KEY* unique_out, IDX* idx_out, IDX* count, void* workspace,
                                int64_t workspace_size_in_bytes) {
-    HashMap<KEY, IDX> map;
-    FOR_RANGE(int64_t, i, 0, n) {
-      KEY in_i = in[i];
-      auto it = map.find(in_i);
-      if (it == map.end()) {
-        IDX idx = map.size();
-        if (count != nullptr) { count[idx] = 1; }
-        idx_out[i] = idx;
-        unique_out[idx] = in_i;
-        map[in_i] = idx;
-      } else {
-        IDX idx = it->second;
-        if (count != nullptr) { count[idx] += 1; }
-        idx_out[i] = idx;
-      }
+    const int64_t required_workspace_size = UniqueWorkspaceSize<KEY, IDX>(n, count != nullptr);
+    CHECK_GE(workspace_size_in_bytes, required_workspace_size);
+    UniqueWorkspace<KEY, IDX> unique_workspace(n, workspace);
+    if (n < kPartitionedUniqueMinSize
+        || Global<ThreadPool>::Get()->thread_num() < kPartitionedUniqueMinThreadNum) {
+      FlatUniqueWithCounts<KEY, IDX>(n, in, num_unique, unique_out, idx_out, count,
+                                     &unique_workspace);
+    } else {
+      PartitionedUniqueWithCounts<KEY, IDX>(n, in, num_unique, unique_out, idx_out, count,
+                                            &unique_workspace);
     }
-    *num_unique = map.size();
   }
   static void GetUniqueWorkspaceSizeInBytes(DeviceCtx* ctx, int64_t n,
                                             int64_t* workspace_size_in_bytes) {
-    *workspace_size_in_bytes = 1;
+    *workspace_size_in_bytes = UniqueWorkspaceSize<KEY, IDX>(n, false);
   }
   static void GetUniqueWithCountsWorkspaceSizeInBytes(DeviceCtx* ctx, int64_t n,
                                                       int64_t* workspace_size_in_bytes) {
-    *workspace_size_in_bytes = 1;
+    *workspace_size_in_bytes = UniqueWorkspaceSize<KEY, IDX>(n, true);
   }
 };
 
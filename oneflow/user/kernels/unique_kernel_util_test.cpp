@@ -0,0 +1,189 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/unique_kernel_util.h"
+#include "oneflow/core/thread/thread_pool.h"
+#include <random>
+
+namespace oneflow {
+
+namespace {
+
+class UniqueKernelUtilTest : public testing::Test {
+ protected:
+  void TearDown() override {
+    if (Global<ThreadPool>::Get() != nullptr) { Global<ThreadPool>::Delete(); }
+  }
+
+  void ResetThreadPool(int32_t thread_num) {
+    if (Global<ThreadPool>::Get() != nullptr) { Global<ThreadPool>::Delete(); }
+    Global<ThreadPool>::New(thread_num);
+  }
+};
+
+// the HashMap implementation UniqueKernelUtil<kCPU> used to have
+template<typename KEY, typename IDX>
+void HashMapUniqueWithCounts(int64_t n, const KEY* in, IDX* num_unique, KEY* unique_out,
+                             IDX* idx_out, IDX* count) {
+  HashMap<KEY, IDX> map;
+  FOR_RANGE(int64_t, i, 0, n) {
+    KEY in_i = in[i];
+    auto it = map.find(in_i);
+    if (it == map.end()) {
+      IDX idx = map.size();
+      if (count != nullptr) { count[idx] = 1; }
+      idx_out[i] = idx;
+      unique_out[idx] = in_i;
+      map[in_i] = idx;
+    } else {
+      IDX idx = it->second;
+      if (count != nullptr) { count[idx] += 1; }
+      idx_out[i] = idx;
+    }
+  }
+  *num_unique = map.size();
+}
+
+template<typename KEY>
+std::vector<KEY> RandomKeys(int64_t n, int64_t key_range) {
+  std::mt19937 gen(n + key_range);
+  std::uniform_int_distribution<int64_t> dist(0, key_range - 1);
+  std::vector<KEY> keys(n);
+  for (KEY& key : keys) { key = static_cast<KEY>(dist(gen)); }
+  return keys;
+}
+
+template<typename KEY, typename IDX>
+void TestUniqueWithCounts(const std::vector<KEY>& in, bool with_counts) {
+  using Util = UniqueKernelUtil<DeviceType::kCPU, KEY, IDX>;
+  const int64_t n = in.size();
+  IDX expected_num_unique;
+  std::vector<KEY> expected_unique_out(n);
+  std::vector<IDX> expected_idx_out(n);
+  std::vector<IDX> expected_count(n);
+  HashMapUniqueWithCounts<KEY, IDX>(n, in.data(), &expected_num_unique,
+                                    expected_unique_out.data(), expected_idx_out.data(),
+                                    expected_count.data());
+
+  int64_t workspace_size;
+  if (with_counts) {
+    Util::GetUniqueWithCountsWorkspaceSizeInBytes(nullptr, n, &workspace_size);
+  } else {
+    Util::GetUniqueWorkspaceSizeInBytes(nullptr, n, &workspace_size);
+  }
+  std::vector<char> workspace(workspace_size);
+  IDX num_unique;
+  std::vector<KEY> unique_out(n);
+  std::vector<IDX> idx_out(n);
+  std::vector<IDX> count(n);
+  if (with_counts) {
+    Util::UniqueWithCounts(nullptr, n, in.data(), &num_unique, unique_out.data(), idx_out.data(),
+                           count.data(), workspace.data(), workspace_size);
+  } else {
+    Util::Unique(nullptr, n, in.data(), &num_unique, unique_out.data(), idx_out.data(),
+                 workspace.data(), workspace_size);
+  }
+  ASSERT_EQ(num_unique, expected_num_unique);
+  // compare bits so that NaNs and the sign of zeros are checked too
+  ASSERT_EQ(std::memcmp(unique_out.data(), expected_unique_out.data(), num_unique * sizeof(KEY)),
+            0);
+  ASSERT_EQ(idx_out, expected_idx_out);
+  if (with_counts) {
+    ASSERT_TRUE(std::equal(count.begin(), count.begin() + num_unique, expected_count.begin()));
+  }
+}
+
+template<typename KEY, typename IDX>
+void TestUniqueWithCounts(const std::vector<KEY>& in) {
+  TestUniqueWithCounts<KEY, IDX>(in, true);
+  TestUniqueWithCounts<KEY, IDX>(in, false);
+}
+
+}  // namespace
+
+TEST_F(UniqueKernelUtilTest, unique_with_counts) {
+  // with 4 threads the largest sizes go through the partitioned path
+  for (const int32_t thread_num : {1, 4}) {
+    ResetThreadPool(thread_num);
+    for (const int64_t n : {1, 7, 1000, 100000, 300001, 1 << 20}) {
+      for (const int64_t key_range : {int64_t(1), int64_t(100), n / 3 + 1, n * 1000}) {
+        const std::vector<int64_t> keys = RandomKeys<int64_t>(n, key_range);
+        TestUniqueWithCounts<int64_t, int32_t>(keys);
+        TestUniqueWithCounts<int64_t, int64_t>(keys);
+        std::vector<int32_t> negative_keys(n);
+        FOR_RANGE(int64_t, i, 0, n) {
+          negative_keys[i] = -static_cast<int32_t>(keys[i] % 100003);
+        }
+        TestUniqueWithCounts<int32_t, int64_t>(negative_keys);
+      }
+      TestUniqueWithCounts<int8_t, int32_t>(RandomKeys<int8_t>(n, 256));
+      TestUniqueWithCounts<double, int64_t>(RandomKeys<double>(n, n / 2 + 1));
+    }
+  }
+}
+
+TEST_F(UniqueKernelUtilTest, unique_with_counts_of_floating_keys) {
+  for (const int32_t thread_num : {1, 4}) {
+    ResetThreadPool(thread_num);
+    for (const int64_t n : {10, 1000, 400000}) {
+      std::vector<float> keys = RandomKeys<float>(n, 1000);
+      FOR_RANGE(int64_t, i, 0, n) {
+        if (i % 7 == 0) { keys[i] = (i % 2 == 0) ? 0.0f : -0.0f; }
+        if (i % 1009 == 0) { keys[i] = std::numeric_limits<float>::quiet_NaN(); }
+        if (i % 13 == 0) { keys[i] += 0.5f; }
+      }
+      TestUniqueWithCounts<float, int32_t>(keys);
+      TestUniqueWithCounts<float, int64_t>(keys);
+    }
+  }
+}
+
+TEST_F(UniqueKernelUtilTest, DISABLED_benchmark_unique_with_counts) {
+  using Util = UniqueKernelUtil<DeviceType::kCPU, int64_t, int64_t>;
+  const int32_t thread_num = std::max<int32_t>(std::thread::hardware_concurrency(), 1);
+  ResetThreadPool(thread_num);
+  const int64_t kIters = 3;
+  for (const int64_t n : {1 << 16, 1 << 22}) {
+    for (const int64_t key_range : {n / 100, n / 2, int64_t(1) << 40}) {
+      const std::vector<int64_t> in = RandomKeys<int64_t>(n, key_range);
+      int64_t num_unique;
+      std::vector<int64_t> unique_out(n);
+      std::vector<int64_t> idx_out(n);
+      std::vector<int64_t> count(n);
+      int64_t workspace_size;
+      Util::GetUniqueWithCountsWorkspaceSizeInBytes(nullptr, n, &workspace_size);
+      std::vector<char> workspace(workspace_size);
+      const auto hash_map_start = std::chrono::steady_clock::now();
+      FOR_RANGE(int64_t, iter, 0, kIters) {
+        HashMapUniqueWithCounts<int64_t, int64_t>(n, in.data(), &num_unique, unique_out.data(),
+                                                  idx_out.data(), count.data());
+      }
+      const auto start = std::chrono::steady_clock::now();
+      FOR_RANGE(int64_t, iter, 0, kIters) {
+        Util::UniqueWithCounts(nullptr, n, in.data(), &num_unique, unique_out.data(),
+                               idx_out.data(), count.data(), workspace.data(), workspace_size);
+      }
+      const auto end = std::chrono::steady_clock::now();
+      const double hash_map_ms =
+          std::chrono::duration<double, std::milli>(start - hash_map_start).count() / kIters;
+      const double ms = std::chrono::duration<double, std::milli>(end - start).count() / kIters;
+      LOG(INFO) << "unique_with_counts n " << n << " num_unique " << num_unique << " threads "
+                << thread_num << ": HashMap " << hash_map_ms << " ms, open addressing " << ms
+                << " ms, speedup " << hash_map_ms / ms;
+    }
+  }
+}
+
+}  // namespace oneflow
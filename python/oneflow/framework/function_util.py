@@ -347,10 +347,37 @@ def policy_time_line(func_desc):
     return "use_time_line_algo"
 
 
+@oneflow_function_config("static_mem_alloc_policy_white_list.policy_refined_best_fit")
+def policy_refined_best_fit(func_desc):
+    """A static memory allocation policy called: refined_best_fit
+
+    Args:
+        func_desc ([type]): [description]
+
+    Returns:
+        [type]: [description]
+    """
+    return "use_refined_best_fit_algo"
+
+
+@oneflow_function_config("static_mem_alloc_refined_best_fit_time_budget_ms")
+def set_static_mem_alloc_refined_best_fit_time_budget_ms(func_desc, value):
+    """Set time budget in milliseconds of refined_best_fit policy for each memory block
+
+    Args:
+        func_desc ([type]): [description]
+        value ([type]): [description]
+    """
+    func_desc.job_config_proto.mutable_memory_allocation_algorithm_conf().set_refined_best_fit_time_budget_ms(
+        value
+    )
+
+
 @oneflow_function_config("static_mem_alloc_algo_white_list.show")
 def show_static_mem_alloc_algo_white_list(func_desc):
     """Show configuration of  static memory allocation policy,
-          including: "use_mem_size_first_algo", "use_mutual_exclusion_first_algo", "use_time_line_algo"
+          including: "use_mem_size_first_algo", "use_mutual_exclusion_first_algo", "use_time_line_algo",
+          "use_refined_best_fit_algo"
 
     Args:
         func_desc ([type]): [description]
@@ -362,6 +389,7 @@ def show_static_mem_alloc_algo_white_list(func_desc):
         "use_mem_size_first_algo",
         "use_mutual_exclusion_first_algo",
         "use_time_line_algo",
+        "use_refined_best_fit_algo",
     ]
 
 
@@ -22,54 +22,6 @@ from oneflow.nn.module import Module
 from oneflow.nn.modules.utils import _single, _pair, _triple
 
 
-def slice(x, begin, size):
-    ndim = len(x.shape)
-    if not isinstance(begin, (list, tuple)) or len(begin) != ndim:
-        raise ValueError(
-            "begin must be a list/tuple with the same length as input tensor's number of dimensions"
-        )
-    if not all((isinstance(b, int) or b is None for b in begin)):
-        raise ValueError("element of begin must be a int or None")
-    if not isinstance(size, (list, tuple)) or len(size) != ndim:
-        raise ValueError(
-            "size must be a list/tuple with the same length as input tensor's number of dimensions."
-        )
-    if not all((isinstance(s, int) or s is None for s in size)):
-        raise ValueError("element of size must be a int or None")
-    slice_tup_list = []
-    for (b, s, dim_size) in zip(begin, size, x.shape):
-        (start, stop, step) = (None, None, 1)
-        if b is not None:
-            if b < -dim_size or b >= dim_size:
-                raise ValueError("element of begin is out of range")
-            start = b
-        if s is not None:
-            if s == -1:
-                stop = dim_size
-            else:
-                if s <= 0 or s > dim_size:
-                    raise ValueError("element of size is invalid")
-                if b + s < dim_size:
-                    stop = b + s
-        slice_tup_list.append((start, stop, step))
-    return flow.slice(x, slice_tup_list)
-
-
-class ConvUtil(object):
-    @classmethod
-    def split(cls, x, axis, split_num):
-        split_len = x.shape[axis] // split_num
-        result_list = []
-        slice_begin = [0] * len(x.shape)
-        slice_size = [-1] * len(x.shape)
-        slice_size[axis] = split_len
-        for i in range(split_num):
-            slice_begin[axis] = i * split_len
-            result = slice(x, slice_begin, slice_size)
-            result_list.append(result)
-        return result_list
-
-
 class Conv1d(Module):
     """The interface is consistent with PyTorch.    
     The documentation is referenced from: https://pytorch.org/docs/master/generated/torch.nn.Conv1d.html#conv1d
@@ -203,49 +155,15 @@ class Conv1d(Module):
             init.uniform_(self.bias, -bound, bound)
 
     def forward(self, x):
-        if x.device.type == "cpu" and self.groups > 1:
-            in_channel_axis = 1
-            weight_channel_axis = 0
-            bias_channel_axis = 0
-            in_split_list = ConvUtil.split(
-                x, axis=in_channel_axis, split_num=self.groups
-            )
-            out_list = []
-            for i in range(len(in_split_list)):
-                out_list.append(
-                    flow.F.conv1d(
-                        in_split_list[i],
-                        self.weight[
-                            i
-                            * self.out_channel_groups : (i + 1)
-                            * self.out_channel_groups,
-                            :,
-                            :,
-                        ],
-                        self.bias[
-                            i
-                            * self.out_channel_groups : (i + 1)
-                            * self.out_channel_groups
-                        ]
-                        if self.bias
-                        else None,
-                        stride=self.stride,
-                        padding=self.padding,
-                        dilation=self.dilation,
-                        groups=1,
-                    )
-                )
-            res = flow.cat(out_list, dim=in_channel_axis)
-        else:
-            res = flow.F.conv1d(
-                x,
-                self.weight,
-                self.bias,
-                stride=self.stride,
-                padding=self.padding,
-                dilation=self.dilation,
-                groups=self.groups,
-            )
+        res = flow.F.conv1d(
+            x,
+            self.weight,
+            self.bias,
+            stride=self.stride,
+            padding=self.padding,
+            dilation=self.dilation,
+            groups=self.groups,
+        )
         return res
 
     def extra_repr(self):
@@ -424,48 +342,15 @@ class Conv2d(Module):
     def forward(self, x):
         if x.shape[1] != self.in_channels:
             raise ValueError("The input channels should be equal to self.in_channels")
-        if x.device.type == "cpu" and self.groups > 1:
-            in_channel_axis = 1
-            in_split_list = ConvUtil.split(
-                x, axis=in_channel_axis, split_num=self.groups
-            )
-            out_list = []
-            for i in range(len(in_split_list)):
-                out_list.append(
-                    flow.F.conv2d(
-                        in_split_list[i],
-                        self.weight[
-                            i
-                            * self.out_channel_groups : (i + 1)
-                            * self.out_channel_groups,
-                            :,
-                            :,
-                            :,
-                        ],
-                        self.bias[
-                            i
-                            * self.out_channel_groups : (i + 1)
-                            * self.out_channel_groups
-                        ]
-                        if self.bias
-                        else None,
-                        stride=self.stride,
-                        padding=self.padding,
-                        dilation=self.dilation,
-                        groups=1,
-                    )
-                )
-            res = flow.cat(out_list, dim=in_channel_axis)
-        else:
-            res = flow.F.conv2d(
-                x,
-                self.weight,
-                self.bias,
-                stride=self.stride,
-                padding=self.padding,
-                dilation=self.dilation,
-                groups=self.groups,
-            )
+        res = flow.F.conv2d(
+            x,
+            self.weight,
+            self.bias,
+            stride=self.stride,
+            padding=self.padding,
+            dilation=self.dilation,
+            groups=self.groups,
+        )
         return res
 
     def extra_repr(self):
@@ -628,48 +513,15 @@ class Conv3d(Module):
     def forward(self, x):
         if x.shape[1] != self.in_channels:
             raise ValueError("The input channels should be equal to self.in_channels")
-        if x.device.type == "cpu" and self.groups > 1:
-            in_channel_axis = 1
-            in_split_list = ConvUtil.split(
-                x, axis=in_channel_axis, split_num=self.groups
-            )
-            out_list = []
-            for i in range(len(in_split_list)):
-                out_list.append(
-                    flow.F.conv3d(
-                        in_split_list[i],
-                        self.weight[
-                            i
-                            * self.out_channel_groups : (i + 1)
-                            * self.out_channel_groups,
-                            :,
-                            :,
-                            :,
-                        ],
-                        self.bias[
-                            i
-                            * self.out_channel_groups : (i + 1)
-                            * self.out_channel_groups
-                        ]
-                        if self.bias
-                        else None,
-                        stride=self.stride,
-                        padding=self.padding,
-                        dilation=self.dilation,
-                        groups=1,
-                    )
-                )
-            res = flow.cat(out_list, dim=in_channel_axis)
-        else:
-            res = flow.F.conv3d(
-                x,
-                self.weight,
-                self.bias,
-                stride=self.stride,
-                padding=self.padding,
-                dilation=self.dilation,
-                groups=self.groups,
-            )
+        res = flow.F.conv3d(
+            x,
+            self.weight,
+            self.bias,
+            stride=self.stride,
+            padding=self.padding,
+            dilation=self.dilation,
+            groups=self.groups,
+        )
         return res
 
     def extra_repr(self):
@@ -0,0 +1,110 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import os
+import time
+import unittest
+
+import numpy as np
+
+import oneflow as flow
+import oneflow.unittest
+
+
+def _cpu_ccl_op(op_type_name, **attrs):
+    builder = (
+        flow.builtin_op(op_type_name)
+        .Input("in")
+        .Output("out")
+        .Attr("parallel_conf", 'device_tag: "cpu", device_name: "0:0-1"')
+    )
+    for (name, value) in attrs.items():
+        builder = builder.Attr(name, value)
+    return builder.Build()
+
+
+def _rank_array(rank, elem_cnt):
+    return np.arange(elem_cnt, dtype=np.float32) * (rank + 1)
+
+
+class TestCpuCcl(flow.unittest.TestCase):
+    @flow.unittest.skip_unless_1n2d()
+    def test_all_reduce(test_case):
+        all_reduce = _cpu_ccl_op("eager_nccl_all_reduce")
+        # small buffers use recursive doubling and large ones use the ring
+        for elem_cnt in [1, 5, 1024, 1024 * 1024 + 3]:
+            rank = flow.distributed.get_rank()
+            x = flow.Tensor(_rank_array(rank, elem_cnt))
+            y = all_reduce(x)[0]
+            expected = _rank_array(0, elem_cnt) + _rank_array(1, elem_cnt)
+            test_case.assertTrue(np.allclose(y.numpy(), expected))
+
+    @flow.unittest.skip_unless_1n2d()
+    def test_reduce(test_case):
+        for root in [0, 1]:
+            reduce = _cpu_ccl_op("eager_nccl_reduce", root=root)
+            for elem_cnt in [5, 1024 * 1024 + 3]:
+                rank = flow.distributed.get_rank()
+                x = flow.Tensor(_rank_array(rank, elem_cnt))
+                y = reduce(x)[0]
+                if rank == root:
+                    expected = _rank_array(0, elem_cnt) + _rank_array(1, elem_cnt)
+                    test_case.assertTrue(np.allclose(y.numpy(), expected))
+
+    @flow.unittest.skip_unless_1n2d()
+    def test_broadcast(test_case):
+        for root in [0, 1]:
+            broadcast = _cpu_ccl_op("eager_nccl_broadcast", root=root)
+            # large buffers are forwarded chunk by chunk
+            for elem_cnt in [5, 1024 * 1024 + 3]:
+                rank = flow.distributed.get_rank()
+                x = flow.Tensor(_rank_array(rank, elem_cnt))
+                y = broadcast(x)[0]
+                expected = _rank_array(root, elem_cnt)
+                test_case.assertTrue(np.allclose(y.numpy(), expected))
+
+    # a bandwidth sweep up to 64MB buffers, correctness is covered by test_all_reduce
+    @unittest.skipIf(
+        not os.getenv("ONEFLOW_TEST_CPU_CCL_BENCHMARK"),
+        "set ONEFLOW_TEST_CPU_CCL_BENCHMARK to run the benchmark",
+    )
+    @flow.unittest.skip_unless_1n2d()
+    def test_all_reduce_bus_bandwidth(test_case):
+        all_reduce = _cpu_ccl_op("eager_nccl_all_reduce")
+        rank_num = 2
+        iter_num = 10
+        for byte_size in [4 << 10, 256 << 10, 4 << 20, 64 << 20]:
+            elem_cnt = byte_size // 4
+            x = flow.Tensor(_rank_array(flow.distributed.get_rank(), elem_cnt))
+            all_reduce(x)[0].numpy()
+            start = time.perf_counter()
+            for _ in range(iter_num):
+                y = all_reduce(x)[0]
+            y_numpy = y.numpy()
+            seconds = (time.perf_counter() - start) / iter_num
+            expected = _rank_array(0, elem_cnt) + _rank_array(1, elem_cnt)
+            test_case.assertTrue(np.allclose(y_numpy, expected))
+            alg_bandwidth = byte_size / seconds / 1e9
+            bus_bandwidth = alg_bandwidth * 2 * (rank_num - 1) / rank_num
+            if flow.distributed.get_rank() == 0:
+                print(
+                    "cpu all_reduce %10d bytes: %8.3f ms, algbw %.3f GB/s, "
+                    "busbw %.3f GB/s"
+                    % (byte_size, seconds * 1e3, alg_bandwidth, bus_bandwidth)
+                )
+
+
+if __name__ == "__main__":
+    unittest.main()